@@ -11,7 +11,7 @@
 #include "ddConfig.h"
 
 #ifndef MAX_ARGS
-#define MAX_ARGS 10
+#define MAX_ARGS 16
 #endif
 
 #ifndef ENUM_VAL
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "ddConfig.h"
+#include "ServerInterface.h"
+
+/* Fixed pool of cache-line aligned receive buffers. A receive borrows a slot
+ * & hands the reference to the application, which releases it when done.
+ * Acquire is lock-free, retain/release may be called from any thread */
+
+#ifndef DD_CACHE_LINE
+#define DD_CACHE_LINE 64
+#endif
+
+struct ddBufferPool;
+
+struct ddPoolBuf
+{
+    _Alignas( DD_CACHE_LINE ) struct ddRecvMsg msg;
+
+    struct ddBufferPool* pool;
+    atomic_uint refs;
+    _Atomic uint32_t next;  // free list link ( slot index + 1, 0 = end )
+    uint32_t index;
+};
+
+struct ddBufferPool
+{
+    struct ddPoolBuf* slots;
+    uint32_t capacity;
+
+    // ( ABA tag << 32 ) | ( slot index + 1 ) of the free list head
+    _Alignas( DD_CACHE_LINE ) _Atomic uint64_t free_head;
+
+    _Alignas( DD_CACHE_LINE ) atomic_uint in_use;
+    atomic_uint high_water;  // most slots ever borrowed at once
+    atomic_uint exhausted;   // acquires that found the pool empty
+};
+
+bool dd_pool_init( struct ddBufferPool* c_restrict pool,
+                   const uint32_t capacity );
+
+void dd_pool_free( struct ddBufferPool* c_restrict pool );
+
+struct ddPoolBuf* dd_pool_acquire( struct ddBufferPool* c_restrict pool );
+
+void dd_pool_retain( struct ddPoolBuf* c_restrict buf );
+
+void dd_pool_release( struct ddPoolBuf* c_restrict buf );
+
+uint32_t dd_pool_high_water( const struct ddBufferPool* c_restrict pool );
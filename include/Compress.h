@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ddConfig.h"
+#include "ServerInterface.h"
+
+/* Optional compression stage for outgoing frames. A compressed frame keeps
+ * its kind & sets DDFRAME_COMPRESSED on the frame byte, followed by the
+ * codec id & the decompressed size. Frames below the sender's threshold or
+ * that don't shrink go out untouched. Listeners w/ accept_compressed look
+ * codecs up by id on receive, the built-in LZ codec is always registered */
+
+#ifndef DD_COMPRESS_MIN
+#define DD_COMPRESS_MIN 64  // smaller frames aren't worth the cpu
+#endif
+
+// codec id + u16 decompressed payload size after the frame byte
+#define DD_COMPRESS_HEADER_SIZE ( DDFRAME_HEADER_SIZE + 3 )
+
+enum
+{
+    DDCODEC_NONE = 0,
+    DDCODEC_LZ,  // built-in byte oriented LZ77
+};
+
+// both return bytes written or -1 when output_size is too small / the
+// input is corrupt
+typedef int32_t ( *dd_codec_fn )( const uint8_t* c_restrict input,
+                                  const uint32_t length,
+                                  uint8_t* c_restrict output,
+                                  const uint32_t output_size );
+
+struct ddCodec
+{
+    uint8_t id;
+    const char* name;
+    dd_codec_fn compress;
+    dd_codec_fn decompress;
+};
+
+extern const struct ddCodec dd_codec_lz;
+
+// makes a codec decodable on receive. false if the id is taken or 0
+bool dd_codec_register( const struct ddCodec* codec );
+
+const struct ddCodec* dd_codec_find( const uint8_t id );
+
+int32_t dd_lz_compress( const uint8_t* c_restrict input,
+                        const uint32_t length,
+                        uint8_t* c_restrict output,
+                        const uint32_t output_size );
+
+int32_t dd_lz_decompress( const uint8_t* c_restrict input,
+                          const uint32_t length,
+                          uint8_t* c_restrict output,
+                          const uint32_t output_size );
+
+static inline bool dd_frame_compressed( const char* c_restrict data,
+                                        const int32_t length )
+{
+    return length >= DD_COMPRESS_HEADER_SIZE &&
+           ( (uint8_t)data[0] & ~DDFRAME_KIND_MASK ) ==
+               ( DDFRAME_MARK | DDFRAME_COMPRESSED );
+}
+
+// compresses frame into output, returns 0 when it's below min_size, not a
+// frame or wouldn't shrink ( send the original )
+int32_t dd_frame_compress( const struct ddCodec* c_restrict codec,
+                           const uint32_t min_size,
+                           const char* c_restrict frame,
+                           const int32_t length,
+                           char* c_restrict output,
+                           const uint32_t output_size );
+
+// returns the original frame's length or -1 for unknown codecs & bad data
+int32_t dd_frame_decompress( const char* c_restrict data,
+                             const int32_t length,
+                             char* c_restrict output,
+                             const uint32_t output_size );
+
+// send side stage: the bytes to put on the wire for frame, either frame
+// itself or the compressed copy in scratch. Updates length
+const char* dd_compress_stage( const struct ddAddressInfo* c_restrict sender,
+                               const char* c_restrict frame,
+                               int32_t* c_restrict length,
+                               char* c_restrict scratch,
+                               const uint32_t scratch_size );
+
+// receive side stage: decompresses msg in place. false if it was
+// compressed but couldn't be decoded ( bytes_read is then 0 )
+bool dd_decompress_in_place( struct ddRecvMsg* c_restrict msg );
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "ddConfig.h"
 
 #if DD_PLATFORM == DD_WIN32
@@ -42,4 +43,23 @@ void console_set_output_log( const char* c_restrict file_location );
 
 void console_write( const uint32_t log_type,
                     const char* c_restrict fmt_str,
-                    ... );
\ No newline at end of file
+                    ... );
+
+/* Async mode: console_write only packs level, time, format pointer & args
+ * into a lock-free ring & a writer thread does the formatting & terminal I/O.
+ * Lines start w/ the capture time in seconds since console_async_start.
+ * Format strings must outlive the record (string literals). %s args are
+ * copied. A record whose strings don't fit is formatted up front & a line
+ * cut to fit ends in "...". Records are dropped & counted when the ring is
+ * full */
+
+#ifndef DD_LOG_RING_SIZE
+#define DD_LOG_RING_SIZE 4096  // records, power of 2
+#endif
+
+bool console_async_start();
+
+// drains queued records & joins the writer thread
+void console_async_stop();
+
+uint64_t console_async_dropped();
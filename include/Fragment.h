@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ddConfig.h"
+#include "ServerInterface.h"
+
+/* Splits payloads larger than one datagram into DDFRAME_FRAGMENT frames &
+ * reassembles them. Each fragment is copied once, straight to its offset in
+ * a preallocated reassembly buffer, which is handed to the caller when the
+ * last piece lands. Incomplete messages are dropped after a timeout & each
+ * peer may only hold a few buffers at once. Loop thread only */
+
+#ifndef DD_FRAG_MAX_MESSAGE
+#define DD_FRAG_MAX_MESSAGE 65536  // largest reassembled payload in bytes
+#endif
+
+#ifndef DD_FRAG_SLOTS
+#define DD_FRAG_SLOTS 32  // reassembly buffers shared by all peers
+#endif
+
+#ifndef DD_FRAG_PEER_SLOTS
+#define DD_FRAG_PEER_SLOTS 4  // incomplete messages a single peer may hold
+#endif
+
+#ifndef DD_FRAG_TIMEOUT
+#define DD_FRAG_TIMEOUT 2000000000ULL  // 2 sec since the last fragment
+#endif
+
+// message id + fragment index + fragment count after the frame byte. The
+// receive path keeps the last buffer byte for a terminator
+#define DD_FRAG_HEADER_SIZE ( DDFRAME_HEADER_SIZE + 6 )
+#define DD_FRAG_PAYLOAD ( MAX_MSG_LENGTH - 1 - DD_FRAG_HEADER_SIZE )
+#define DD_FRAG_MAX_COUNT                                                     \
+    ( ( DD_FRAG_MAX_MESSAGE + DD_FRAG_PAYLOAD - 1 ) / DD_FRAG_PAYLOAD )
+
+// completed message, owned by the caller until dd_frag_release
+struct ddFragMessage
+{
+    char* data;  // null terminated past length
+    uint32_t length;
+    struct sockaddr_storage sender;
+    socklen_t addr_len;
+};
+
+struct ddFragSlot
+{
+    struct ddFragMessage message;
+
+    uint64_t last_seen;
+    uint16_t msg_id;
+    uint16_t count;
+    uint16_t received;
+    bool in_use;     // assembling or handed out
+    bool complete;   // handed out, waiting on dd_frag_release
+    uint64_t bits[( DD_FRAG_MAX_COUNT + 63 ) / 64];  // fragments seen
+
+    struct ddFragSlot* next_free;
+};
+
+struct ddFragStats
+{
+    uint64_t completed;
+    uint64_t expired;     // incomplete messages timed out
+    uint64_t evicted;     // oldest incomplete message of a peer at its limit
+    uint64_t dropped;     // fragments w/ no free slot or a bad header
+    uint64_t duplicates;
+};
+
+struct ddReassembler
+{
+    struct ddFragSlot* slots;  // DD_FRAG_SLOTS
+    char* buffers;             // DD_FRAG_SLOTS x ( DD_FRAG_MAX_MESSAGE + 1 )
+    struct ddFragSlot* free_list;
+    uint32_t assembling;
+
+    struct ddFragStats stats;
+};
+
+bool dd_frag_init( struct ddReassembler* c_restrict reasm );
+
+void dd_frag_free( struct ddReassembler* c_restrict reasm );
+
+// fragments needed for a payload of length bytes ( 0 when too large )
+uint32_t dd_frag_count( const uint32_t length );
+
+// writes fragment index of data into output, returns bytes or -1
+int32_t dd_frag_encode( const char* c_restrict data,
+                        const uint32_t length,
+                        const uint16_t msg_id,
+                        const uint32_t index,
+                        char* c_restrict output,
+                        const uint32_t output_size );
+
+// fragments data to one address, as one UDP_SEGMENT run per
+// DD_GSO_MAX_SEGMENTS fragments from a gso sender. Returns fragments sent
+uint32_t dd_frag_send_to( const struct ddAddressInfo* c_restrict sender,
+                          const struct sockaddr* c_restrict addr,
+                          const socklen_t addr_len,
+                          const char* c_restrict data,
+                          const uint32_t length );
+
+// false when msg isn't a fragment frame. *out is set once a message is
+// complete & must be passed back to dd_frag_release
+bool dd_frag_recv( struct ddReassembler* c_restrict reasm,
+                   const struct ddRecvMsg* c_restrict msg,
+                   const uint64_t now,
+                   struct ddFragMessage** c_restrict out );
+
+void dd_frag_release( struct ddReassembler* c_restrict reasm,
+                      struct ddFragMessage* c_restrict message );
+
+// drops incomplete messages idle past DD_FRAG_TIMEOUT, returns the count
+uint32_t dd_frag_expire( struct ddReassembler* c_restrict reasm,
+                         const uint64_t now );
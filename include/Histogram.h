@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ddConfig.h"
+
+/* Log-linear histogram of nanosecond durations (HDR style). Each power of
+ * two is split into DD_HIST_SUB_BUCKETS linear buckets, so any recorded
+ * value is reported within ~6% of its true size */
+
+#define DD_HIST_SUB_BITS 4
+#define DD_HIST_SUB_BUCKETS ( 1 << DD_HIST_SUB_BITS )
+#define DD_HIST_MAX_BITS 48  // larger values land in the last bucket
+#define DD_HIST_BUCKETS                                                      \
+    ( ( DD_HIST_MAX_BITS - DD_HIST_SUB_BITS + 1 ) * DD_HIST_SUB_BUCKETS )
+
+struct ddHistogram
+{
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t buckets[DD_HIST_BUCKETS];
+};
+
+void dd_hist_reset( struct ddHistogram* c_restrict hist );
+
+void dd_hist_record( struct ddHistogram* c_restrict hist,
+                     const uint64_t value );
+
+// upper bound of the bucket holding the given fraction ( 0.0 - 1.0 )
+uint64_t dd_hist_percentile( const struct ddHistogram* c_restrict hist,
+                             const double fraction );
+
+double dd_hist_mean( const struct ddHistogram* c_restrict hist );
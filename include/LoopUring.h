@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ddConfig.h"
+#include "ServerInterface.h"
+
+/* io_uring backend for ddLoop ( DDLOOP_URING ). With a batch callback the
+ * listener keeps a multishot recvmsg armed on a ring of provided buffers,
+ * so datagrams land w/o a syscall each & fill the same ddRecvBatch. A plain
+ * read callback gets a poll on the listener instead. Watches, stdin & the
+ * wakeup eventfd are polls re-armed after each event, which keeps epoll's
+ * level triggered behaviour. dd_loop_send_to & the loop's send queues
+ * become SENDMSG entries submitted w/ the next wait, so one io_uring_enter
+ * per iteration does all submission & waiting. Raw syscalls, no liburing */
+
+#ifndef DD_URING_ENTRIES
+#define DD_URING_ENTRIES 256  // submission queue size
+#endif
+
+#ifndef DD_URING_RECV_BUFFERS
+#define DD_URING_RECV_BUFFERS 256  // provided receive buffers, power of 2
+#endif
+
+#ifndef DD_URING_SEND_SLOTS
+#define DD_URING_SEND_SLOTS 256  // sends queued or in flight
+#endif
+
+// kernel & build support io_uring w/ the operations the backend needs
+bool dd_uring_supported();
+
+// sets up the rings & arms the listener, watches, stdin & wakeup fd. Called
+// by dd_loop_run, false means fall back to epoll
+bool dd_uring_open( struct ddLoop* c_restrict loop );
+
+void dd_uring_close( struct ddLoop* c_restrict loop );
+
+// submits queued entries, sleeps until a completion or timeout ( UINT64_MAX
+// waits forever ) then dispatches callbacks. false on ring failure
+bool dd_uring_wait( struct ddLoop* c_restrict loop, const uint64_t timeout );
+
+// submits queued entries w/o waiting
+void dd_uring_submit( struct ddLoop* c_restrict loop );
+
+bool dd_uring_watch( struct ddLoop* c_restrict loop,
+                     struct ddLoopWatch* c_restrict watch );
+
+void dd_uring_unwatch( struct ddLoop* c_restrict loop,
+                       struct ddLoopWatch* c_restrict watch );
+
+// copies data into a send slot to go out on fd, waiting for an in flight
+// send when every slot is busy. false when the ring fails ( the caller
+// sends directly )
+bool dd_uring_send_to( struct ddLoop* c_restrict loop,
+                       const ddSocket fd,
+                       const char* c_restrict data,
+                       const int32_t length,
+                       const struct sockaddr* c_restrict addr,
+                       const socklen_t addr_len );
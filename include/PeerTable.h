@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ddConfig.h"
+#include "ServerInterface.h"
+
+/* Session table keyed by sender address. Open addressing w/ linear probing
+ * & backward-shift deletion. Peer pointers stay valid until the next insert
+ * or removal; use ddPeer.data for state that must outlive that */
+
+#ifndef DD_PEERS_MIN_CAPACITY
+#define DD_PEERS_MIN_CAPACITY 64
+#endif
+
+struct ddPeer;
+struct ddPeerTable;
+
+typedef void ( *dd_peer_cb )( struct ddPeerTable*, struct ddPeer* );
+
+struct ddPeer
+{
+    union {
+        struct sockaddr sa;
+        struct sockaddr_in v4;
+        struct sockaddr_in6 v6;
+    } addr;
+    socklen_t addr_len;
+    uint32_t hash;  // 0 marks an empty slot
+
+    uint64_t first_seen;
+    uint64_t last_seen;
+    void* data;  // user data
+};
+
+struct ddPeerTable
+{
+    struct ddPeer* entries;
+    uint32_t capacity;  // power of 2
+    uint32_t count;
+
+    uint64_t idle_timeout;  // nanoseconds ( 0 disables eviction )
+    dd_peer_cb evict_cb;    // called before an idle peer is removed
+    void* data;             // user data
+};
+
+// address key helpers, shared w/ other tables keyed by sender. Only ipv4 &
+// ipv6 addresses are supported. The hash is never 0
+bool dd_peers_supported( const struct sockaddr* c_restrict addr );
+
+uint32_t dd_peers_hash_addr( const struct sockaddr* c_restrict addr );
+
+bool dd_peers_addr_equal( const struct sockaddr* c_restrict lhs,
+                          const struct sockaddr* c_restrict rhs );
+
+bool dd_peers_init( struct ddPeerTable* c_restrict table,
+                    const uint32_t capacity_hint,
+                    const double idle_seconds,
+                    dd_peer_cb evict_cb );
+
+void dd_peers_free( struct ddPeerTable* c_restrict table );
+
+struct ddPeer* dd_peers_find( const struct ddPeerTable* c_restrict table,
+                              const struct sockaddr_storage* c_restrict addr );
+
+struct ddPeer* dd_peers_touch( struct ddPeerTable* c_restrict table,
+                               const struct sockaddr_storage* c_restrict addr,
+                               const socklen_t addr_len,
+                               const uint64_t now,
+                               bool* c_restrict created );
+
+bool dd_peers_remove( struct ddPeerTable* c_restrict table,
+                      const struct sockaddr_storage* c_restrict addr );
+
+uint32_t dd_peers_evict_idle( struct ddPeerTable* c_restrict table,
+                              const uint64_t now );
+
+// returns datagrams sent, one per peer. A multicast sender sends once to
+// its group instead, so it returns 1 when that send succeeded
+uint32_t dd_peers_broadcast( const struct ddAddressInfo* c_restrict sender,
+                             const struct ddPeerTable* c_restrict table,
+                             const uint32_t msg_type,
+                             const struct ddMsgVal* c_restrict msg );
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ddConfig.h"
+#include "ServerInterface.h"
+
+/* Lossy packing for large float arrays ( e.g. runs of DDMSG_FLOAT1..4
+ * values ). Each value is clamped to [min, max], quantized to 2^bits - 1
+ * steps & bit-packed LSB first, so 8 values always fill exactly bits bytes.
+ * x86-64 builds get SSE4.1 & AVX2 kernels picked at runtime, every ISA level
+ * produces the same bytes as the scalar fallback */
+
+#define DD_QUANT_MIN_BITS 1
+#define DD_QUANT_MAX_BITS 16
+
+// bits + u16 count + f32 min + f32 max after the frame byte
+#define DD_QUANT_HEADER_SIZE ( DDFRAME_HEADER_SIZE + 11 )
+
+// kernel sets behind dd_quant_pack & dd_quant_unpack
+enum
+{
+    DDQUANT_SCALAR = 0,
+    DDQUANT_SSE41,
+    DDQUANT_AVX2,
+    DDQUANT_ISA_COUNT,
+};
+
+struct ddQuantRange
+{
+    float min;
+    float max;
+    uint32_t bits;  // DD_QUANT_MIN_BITS - DD_QUANT_MAX_BITS
+};
+
+// defaults to the best level the cpu supports. Select at startup before
+// other threads pack; false & no change when the cpu lacks isa
+bool dd_quant_set_isa( const uint32_t isa );
+bool dd_quant_isa_supported( const uint32_t isa );
+uint32_t dd_quant_isa();
+const char* dd_quant_isa_name( const uint32_t isa );
+
+static inline uint32_t dd_quant_packed_size( const uint32_t count,
+                                             const uint32_t bits )
+{
+    return (uint32_t)( ( (uint64_t)count * bits + 7 ) / 8 );
+}
+
+// output must hold dd_quant_packed_size bytes. false for a bad range
+bool dd_quant_pack( const float* c_restrict values,
+                    const uint32_t count,
+                    const struct ddQuantRange* c_restrict range,
+                    uint8_t* c_restrict output );
+
+// input must hold dd_quant_packed_size bytes. false for a bad range
+bool dd_quant_unpack( const uint8_t* c_restrict input,
+                      const uint32_t count,
+                      const struct ddQuantRange* c_restrict range,
+                      float* c_restrict values );
+
+// DDFRAME_QUANT frame of count values, returns bytes written or -1 when the
+// range is bad or output_size is too small
+int32_t dd_quant_encode( const float* c_restrict values,
+                         const uint32_t count,
+                         const struct ddQuantRange* c_restrict range,
+                         char* c_restrict output,
+                         const uint32_t output_size );
+
+// returns the value count ( range filled in from the header ) or -1 when
+// data isn't a valid DDFRAME_QUANT frame or holds more than max_count
+int32_t dd_quant_decode( const char* c_restrict data,
+                         const int32_t length,
+                         float* c_restrict values,
+                         const uint32_t max_count,
+                         struct ddQuantRange* c_restrict range );
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ddConfig.h"
+#include "ServerInterface.h"
+
+/* Optional reliable, ordered stream between two endpoints. Frames are
+ * wrapped in a DDFRAME_RELIABLE envelope carrying a 16-bit sequence number
+ * plus the latest received sequence & a 32-bit bitfield of the ones before
+ * it, so every packet acks up to 33 others. Unacked frames are resent on an
+ * RTT-derived timeout ( RFC 6298 ). Transport agnostic: the owner moves
+ * bytes through send_cb & feeds received datagrams to dd_reliable_recv.
+ * Unreliable frames never queue behind the channel */
+
+#ifndef DD_RELIABLE_WINDOW
+#define DD_RELIABLE_WINDOW 32  // frames in flight, at most 32
+#endif
+
+#ifndef DD_RELIABLE_MIN_RTO
+#define DD_RELIABLE_MIN_RTO 10000000ULL  // 10 ms
+#endif
+
+#ifndef DD_RELIABLE_MAX_RTO
+#define DD_RELIABLE_MAX_RTO 2000000000ULL  // 2 sec
+#endif
+
+#ifndef DD_RELIABLE_INITIAL_RTO
+#define DD_RELIABLE_INITIAL_RTO 200000000ULL  // before the first rtt sample
+#endif
+
+#ifndef DD_RELIABLE_RTO_GRANULARITY
+#define DD_RELIABLE_RTO_GRANULARITY 1000000ULL  // 1 ms, timer resolution
+#endif
+
+#ifndef DD_RELIABLE_ACK_DELAY
+#define DD_RELIABLE_ACK_DELAY 1000000ULL  // standalone ack after 1 ms
+#endif
+
+#ifndef DD_RELIABLE_MAX_RETRIES
+#define DD_RELIABLE_MAX_RETRIES 20
+#endif
+
+// seq + ack + ack bitfield after the frame byte. The receive path keeps
+// the last buffer byte for a terminator
+#define DD_RELIABLE_HEADER_SIZE ( DDFRAME_HEADER_SIZE + 8 )
+#define DD_RELIABLE_MAX_FRAME ( MAX_MSG_LENGTH - 1 - DD_RELIABLE_HEADER_SIZE )
+
+struct ddReliableChannel;
+
+typedef bool ( *dd_reliable_send_cb )( struct ddReliableChannel*,
+                                       const char*,
+                                       const int32_t );
+
+// inner frame, delivered in send order exactly once
+typedef void ( *dd_reliable_deliver_cb )( struct ddReliableChannel*,
+                                          const char*,
+                                          const int32_t );
+
+struct ddReliablePacket
+{
+    uint64_t sent_at;  // last transmission
+    uint64_t rto;      // timeout for this packet, doubles per resend
+    uint16_t seq;
+    uint16_t length;   // inner frame bytes
+    uint8_t retries;
+    bool in_use;
+    char frame[DD_RELIABLE_MAX_FRAME];
+};
+
+struct ddReliableStats
+{
+    uint64_t sent;         // first transmissions
+    uint64_t retransmits;
+    uint64_t delivered;
+    uint64_t duplicates;   // received again after delivery or buffering
+    uint64_t acks_sent;    // standalone ack frames
+};
+
+struct ddReliableChannel
+{
+    // send side
+    struct ddReliablePacket* outgoing;  // DD_RELIABLE_WINDOW slots
+    uint16_t send_base;                 // oldest unacked sequence
+    uint16_t next_seq;
+
+    // receive side
+    struct ddReliablePacket* incoming;  // frames waiting on a gap
+    uint16_t recv_next;                 // next sequence to deliver
+    uint16_t recv_latest;               // newest sequence seen
+    uint32_t recv_bits;                 // bit i: recv_latest - 1 - i seen
+    bool received_any;
+    bool ack_pending;
+    uint64_t ack_due;
+
+    // RFC 6298 estimator ( nanoseconds )
+    uint64_t srtt;
+    uint64_t rttvar;
+    uint64_t rto;
+
+    bool failed;  // a frame hit DD_RELIABLE_MAX_RETRIES
+
+    dd_reliable_send_cb send_cb;
+    dd_reliable_deliver_cb deliver_cb;
+    void* data;  // user data
+
+    struct ddReliableStats stats;
+};
+
+bool dd_reliable_init( struct ddReliableChannel* c_restrict channel,
+                       dd_reliable_send_cb send_cb,
+                       dd_reliable_deliver_cb deliver_cb,
+                       void* data );
+
+void dd_reliable_free( struct ddReliableChannel* c_restrict channel );
+
+// false when the window is full ( caller retries later ) or too large
+bool dd_reliable_send_frame( struct ddReliableChannel* c_restrict channel,
+                             const char* c_restrict frame,
+                             const int32_t length,
+                             const uint64_t now );
+
+bool dd_reliable_send( struct ddReliableChannel* c_restrict channel,
+                       const uint32_t msg_type,
+                       const struct ddMsgVal* c_restrict msg,
+                       const uint64_t now );
+
+// false when data isn't a reliable or ack frame & should be handled as
+// an ordinary unreliable message
+bool dd_reliable_recv( struct ddReliableChannel* c_restrict channel,
+                       const char* c_restrict data,
+                       const int32_t length,
+                       const uint64_t now );
+
+// resends timed out frames & flushes delayed acks. Returns the next time
+// it needs to run ( UINT64_MAX when idle )
+uint64_t dd_reliable_update( struct ddReliableChannel* c_restrict channel,
+                             const uint64_t now );
+
+uint32_t dd_reliable_in_flight(
+    const struct ddReliableChannel* c_restrict channel );
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ddConfig.h"
+#include "ServerInterface.h"
+
+/* Per recipient send queues. Small frames are packed into DDFRAME_BUNDLE
+ * datagrams up to the set's MTU, so a chatty tick costs a few datagrams per
+ * peer instead of one per message. A loop given the set flushes it at the
+ * end of every iteration; every pending datagram goes out through as few
+ * sendmmsg calls as possible. Receivers split bundles w/ dd_bundle_next */
+
+#ifndef DD_SENDQ_MTU
+#define DD_SENDQ_MTU ( MAX_MSG_LENGTH - 1 )  // largest datagram received whole
+#endif
+
+// u16 length before each bundled frame
+#define DD_BUNDLE_PREFIX_SIZE 2
+
+struct ddSendQueue
+{
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+
+    uint32_t used;   // bytes in buf, bundle header included
+    uint32_t count;  // frames in buf
+
+    struct ddSendQueue* next_dirty;
+    bool dirty;  // on the set's flush list
+
+    char buf[MAX_MSG_LENGTH];
+};
+
+struct ddSendQueueStats
+{
+    uint64_t frames;     // frames queued
+    uint64_t datagrams;  // datagrams sent
+    uint64_t syscalls;   // sendto/sendmmsg calls
+    uint64_t errors;     // datagrams the socket refused
+};
+
+struct ddSendQueueSet
+{
+    const struct ddAddressInfo* sender;
+    uint32_t mtu;
+
+    struct ddSendQueue* dirty;  // queues holding unsent frames
+
+    struct ddSendQueueStats stats;
+};
+
+// mtu 0 picks DD_SENDQ_MTU. Larger values are clamped to it
+void dd_sendq_set_init( struct ddSendQueueSet* c_restrict set,
+                        const struct ddAddressInfo* c_restrict sender,
+                        const uint32_t mtu );
+
+void dd_sendq_init( struct ddSendQueue* c_restrict queue,
+                    const struct sockaddr* c_restrict addr,
+                    const socklen_t addr_len );
+
+// unlinks a queue w/o sending, call before freeing a queue's owner
+void dd_sendq_discard( struct ddSendQueueSet* c_restrict set,
+                       struct ddSendQueue* c_restrict queue );
+
+// queues an encoded frame. A full datagram is sent right away
+bool dd_sendq_push_frame( struct ddSendQueueSet* c_restrict set,
+                          struct ddSendQueue* c_restrict queue,
+                          const char* c_restrict frame,
+                          const int32_t length );
+
+bool dd_sendq_push_msg( struct ddSendQueueSet* c_restrict set,
+                        struct ddSendQueue* c_restrict queue,
+                        const uint32_t msg_type,
+                        const struct ddMsgVal* c_restrict msg );
+
+// sends every queued datagram, returns datagrams sent
+uint32_t dd_sendq_flush( struct ddSendQueueSet* c_restrict set );
+
+// takes a finished datagram, false to have the set send it directly
+typedef bool ( *dd_sendq_emit_cb )( void* ctx,
+                                    const char* data,
+                                    const uint32_t length,
+                                    const struct sockaddr* addr,
+                                    const socklen_t addr_len );
+
+// dd_sendq_flush that hands each datagram to emit ( e.g. an io_uring loop
+// queueing sends ) instead of calling sendmmsg. Returns datagrams sent
+uint32_t dd_sendq_drain( struct ddSendQueueSet* c_restrict set,
+                         dd_sendq_emit_cb emit,
+                         void* ctx );
+
+// walks the frames of a received datagram, starting w/ *offset 0. Anything
+// that isn't a bundle comes back whole as a single frame. Returns false
+// when done or the bundle is malformed
+bool dd_bundle_next( const char* c_restrict data,
+                     const int32_t length,
+                     int32_t* c_restrict offset,
+                     const char** c_restrict frame,
+                     int32_t* c_restrict frame_length );
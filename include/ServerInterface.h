@@ -2,8 +2,14 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 
 #include "ddConfig.h"
+#include "TimerWheel.h"
+
+#ifdef DD_LOOP_STATS
+#include "Histogram.h"
+#endif  // DD_LOOP_STATS
 
 #include <sys/types.h>
 #include <errno.h>
@@ -15,6 +21,8 @@
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #endif  // DD_PLATFORM
 
 #if DD_PLATFORM == DD_WIN32
@@ -39,10 +47,29 @@
 #define MAX_MSG_LENGTH 1024 - MAX_TAG_LENGTH
 #endif
 
-#ifndef MAX_ACTIVE_TIMERS
-#define MAX_ACTIVE_TIMERS 10
+#ifndef MAX_RECV_BATCH
+#define MAX_RECV_BATCH 64
+#endif
+
+#ifndef MAX_SEND_BATCH
+#define MAX_SEND_BATCH 64
+#endif
+
+#ifndef MAX_LOOP_EVENTS
+#define MAX_LOOP_EVENTS 64
 #endif
 
+#ifndef DD_GSO_MAX_SEGMENTS
+#define DD_GSO_MAX_SEGMENTS 64  // datagrams per UDP_SEGMENT send
+#endif
+
+// largest UDP payload, bounds a UDP_SEGMENT send & a UDP_GRO receive
+#define DD_GSO_MAX_BYTES 65507
+
+// ancillary data room per received datagram ( drop count, arrival time &
+// GRO size )
+#define DD_RECV_CONTROL_SIZE 128
+
 #ifndef ENUM_VAL
 #define ENUM_VAL( x ) 1 << x
 #endif  // !ENUM_VAL
@@ -54,10 +81,26 @@
 #endif  // DD_PLATFORM
 
 struct ddLoop;
-struct ddServerTimer;
+struct ddLoopWatch;
+struct ddRecvBatch;
+struct ddSocketOpts;
+struct ddBufferPool;
+struct ddPoolBuf;
+struct ddSendQueueSet;
+struct ddCodec;
+struct ddUring;
 
 typedef void ( *dd_loop_cb )( struct ddLoop* );
-typedef void ( *dd_timer_cb )( struct ddLoop*, struct ddServerTimer* );
+typedef void ( *dd_batch_cb )( struct ddLoop*, struct ddRecvBatch* );
+typedef void ( *dd_watch_cb )( struct ddLoop*, struct ddLoopWatch* );
+
+// event backends used by dd_loop_run
+enum
+{
+    DDLOOP_SELECT = 0,  // portable, polls every millisecond
+    DDLOOP_EPOLL,       // linux only, sleeps until next fd event or timer
+    DDLOOP_URING,       // linux only, io_uring recv & send, see LoopUring.h
+};
 
 struct ddAddressInfo
 {
@@ -67,29 +110,121 @@ struct ddAddressInfo
     int32_t status;
     int32_t port_num;
     ddSocket socket_fd;
+
+    const struct ddCodec* codec;  // compresses outgoing frames ( NULL = off )
+    uint32_t compress_min;        // smallest frame worth compressing
+
+    // receives inflate compressed frames, off they're handed on as sent
+    bool decompress;
+
+    bool gso;  // kernel segments dd_server_send_segments runs
+    bool gro;  // coalesced receives, split by dd_server_recieve_batch
+
+    int32_t recv_buffer;  // SO_RCVBUF & SO_SNDBUF as the kernel set them
+    int32_t send_buffer;
+
+    bool rx_timestamps;  // received msgs carry their kernel arrival time
+
+    // SO_RXQ_OVFL is on, so receives read the kernel's drop count. Datagrams
+    // dropped on the full receive queue as of the last count seen ( linux )
+    bool rxq_overflow;
+    uint32_t kernel_drops;
+
+    // ip was a multicast group: a listener joined it, a sender's broadcasts
+    // go to it as one datagram
+    bool multicast;
+};
+
+// optional settings for dd_create_socket ( NULL for defaults )
+struct ddSocketOpts
+{
+    bool reuse_port;  // SO_REUSEPORT for sharded listeners
+
+    const struct ddCodec* codec;  // see Compress.h
+    uint32_t compress_min;        // 0 picks DD_COMPRESS_MIN
+
+    // inflate compressed frames on receive. Off by default since any
+    // payload may start w/ a compressed frame byte, a codec turns it on
+    bool accept_compressed;
+
+    bool udp_gso;  // UDP_SEGMENT for runs of equal sized datagrams ( linux )
+    bool udp_gro;  // UDP_GRO, read only w/ dd_server_recieve_batch ( linux )
+
+    // SO_RCVBUF/SO_SNDBUF bytes, 0 keeps the system default. The kernel
+    // doubles the value & caps it at net.core.rmem_max/wmem_max
+    int32_t recv_buffer;
+    int32_t send_buffer;
+
+    bool rx_timestamps;  // SO_TIMESTAMPNS, fills ddRecvMsg.arrival ( linux )
+
+    // used when the ip is a multicast group. Routing always picks the
+    // interface outside linux
+    const char* multicast_iface;  // interface name, NULL lets routing pick
+    int32_t multicast_ttl;        // hops a send may take, 0 = 1 ( LAN only )
+    bool multicast_loop;          // local listeners get our own sends too
 };
 
-struct ddServerTimer
+// extra socket/file descriptor watched by the loop for read readiness
+struct ddLoopWatch
 {
-    uint64_t tick_rate;
-    bool repeat;
+    ddSocket fd;
+    uint32_t slot;
+    dd_watch_cb callback;
+    void* data;
+    struct ddLoopWatch* retired_next;
+    uint64_t poll_id;  // io_uring poll request id
 };
 
+#ifdef DD_LOOP_STATS
+// nanosecond timings collected by dd_loop_run
+struct ddLoopStats
+{
+    struct ddHistogram wait;        // time blocked in epoll_wait/select
+    struct ddHistogram read;        // listener receive + read callback
+    struct ddHistogram timer;       // each timer callback
+    struct ddHistogram timer_late;  // timer fire time past its deadline
+
+    // kernel arrival to batch callback, needs a listener w/ rx_timestamps.
+    // A plain read callback receives msgs itself, so they aren't recorded
+    struct ddHistogram queue;
+};
+#endif  // DD_LOOP_STATS
+
 struct ddLoop
 {
     uint64_t start_time;
     uint64_t active_time;
-    uint32_t timers_count;
 
     dd_loop_cb callback;
 
+    // when set, the loop drains the listener itself & hands over the batch
+    dd_batch_cb batch_callback;
+    struct ddRecvBatch* batch;
+
     struct ddAddressInfo* listener;
 
-    struct ddServerTimer timers[MAX_ACTIVE_TIMERS];
-    uint64_t timer_update[MAX_ACTIVE_TIMERS];
-    dd_timer_cb timer_cbs[MAX_ACTIVE_TIMERS];
+    struct ddTimerWheel timers;
 
-    bool active;
+    uint32_t backend;
+    int32_t poll_fd;  // epoll or io_uring instance ( -1 when not in use )
+    int32_t wake_fd;  // eventfd used by dd_loop_break from other threads
+
+    struct ddLoopWatch** watches;
+    uint32_t watches_count;
+    uint32_t watches_capacity;
+    struct ddLoopWatch* retired;  // removed watches freed after dispatch
+
+    struct ddSendQueueSet* send_queues;  // flushed after every iteration
+    struct ddUring* uring;               // DDLOOP_URING rings & buffers
+
+    void* data;    // user data
+    bool console;  // poll console input ( only one loop per process )
+
+#ifdef DD_LOOP_STATS
+    struct ddLoopStats* stats;
+#endif  // DD_LOOP_STATS
+
+    atomic_bool active;
 };
 
 enum
@@ -108,6 +243,25 @@ enum
     DDMSG_BOOL = ENUM_VAL( 9 ),
 };
 
+// Wire framing: the first byte is DDFRAME_MARK | frame kind, where kinds
+// 0-9 are the bit index of a DDMSG_* type. Numeric payloads follow as
+// fixed-width little-endian values. Frame bytes stay in 0x80-0xBF, which
+// valid UTF-8 text never starts with, so any other first byte is plain
+// text. Strings go out unframed unless they're empty or start in that range.
+// Kinds 10-15 are control & bulk frames that carry no single ddMsgVal
+#define DDFRAME_MARK 0x80
+#define DDFRAME_KIND_MASK 0x0f
+#define DDFRAME_COMPRESSED 0x20  // flag, payload packed by a ddCodec
+#define DDFRAME_TOPIC 0x10       // flag, TopicTable envelope, kind is its op
+#define DDFRAME_HEADER_SIZE 1
+
+#define DDFRAME_RELIABLE 10  // ReliableChannel envelope around a frame
+#define DDFRAME_ACK 11       // ReliableChannel standalone ack
+#define DDFRAME_FRAGMENT 12  // piece of a message larger than a datagram
+#define DDFRAME_BUNDLE 13    // frames coalesced by a ddSendQueue
+#define DDFRAME_SNAPSHOT 14  // Snapshot full state, delta or ack
+#define DDFRAME_QUANT 15     // Quantize bit-packed float array
+
 struct ddMsgVal
 {
     union {
@@ -124,6 +278,33 @@ struct ddRecvMsg
     int32_t bytes_read;
     struct sockaddr_storage sender;
     socklen_t addr_len;
+
+    // wall clock nanoseconds the kernel received the datagram ( see
+    // get_wall_time ), 0 unless the listener has rx_timestamps
+    uint64_t arrival;
+};
+
+// preallocated message slots filled by one recvmmsg call
+struct ddRecvBatch
+{
+    struct ddRecvMsg* msgs;
+    uint32_t capacity;
+    uint32_t count;
+    struct mmsghdr* headers;
+    struct iovec* iovecs;
+
+    // UDP_GRO super-packet split into msgs. Segments that don't fit wait
+    // for the next call, see dd_recv_batch_pending
+    char* coalesced;
+    uint32_t coalesced_length;
+    uint32_t coalesced_offset;
+    uint32_t segment_size;
+    struct sockaddr_storage coalesced_sender;
+    socklen_t coalesced_addr_len;
+    uint64_t coalesced_arrival;
+
+    // DD_RECV_CONTROL_SIZE bytes per slot for recvmmsg ancillary data
+    char* controls;
 };
 
 void dd_server_init_win32();
@@ -135,29 +316,153 @@ void dd_close_socket( ddSocket* c_restrict socket );
 void dd_close_clients( struct ddAddressInfo* c_restrict clients,
                        const uint32_t count );
 
-void dd_create_socket( struct ddAddressInfo* c_restrict address,
+bool dd_create_socket( struct ddAddressInfo* c_restrict address,
                        const char* const c_restrict ip,
                        const char* const c_restrict port,
-                       const bool create_server );
+                       const bool create_server,
+                       const struct ddSocketOpts* c_restrict opts );
 
 bool dd_create_socket2( struct ddAddressInfo* c_restrict address,
                         struct sockaddr_storage* client,
                         const uint32_t port );
 
+int32_t dd_msg_encode( const uint32_t msg_type,
+                       const struct ddMsgVal* c_restrict msg,
+                       char* c_restrict output,
+                       const uint32_t output_size );
+
+uint32_t dd_msg_decode( const char* c_restrict data,
+                        const int32_t length,
+                        struct ddMsgVal* c_restrict msg );
+
+// decodes & writes a received datagram to the console, a line per frame
+// when it's a bundle
+void dd_msg_print( const char* c_restrict data, const int32_t length );
+
 void dd_server_send_msg( const struct ddAddressInfo* c_restrict recipient,
                          const uint32_t msg_type,
                          const struct ddMsgVal* c_restrict msg );
 
-void dd_server_recieve_msg( const struct ddAddressInfo* c_restrict listener,
+void dd_server_send_to( const struct ddAddressInfo* c_restrict sender,
+                        const struct sockaddr* c_restrict addr,
+                        const socklen_t addr_len,
+                        const uint32_t msg_type,
+                        const struct ddMsgVal* c_restrict msg );
+
+uint32_t dd_server_send_many( const struct ddAddressInfo* c_restrict sender,
+                              const char* c_restrict data,
+                              const int32_t length,
+                              const struct sockaddr* const* addrs,
+                              const socklen_t* addr_lens,
+                              const uint32_t count,
+                              int32_t* c_restrict errors );
+
+// sends data as datagrams of segment_size bytes ( the last may be shorter )
+// to one address, as is w/o the compression stage. A gso sender hands the
+// kernel up to DD_GSO_MAX_SEGMENTS per message. Returns datagrams sent
+uint32_t dd_server_send_segments( const struct ddAddressInfo* c_restrict sender,
+                                  const char* c_restrict data,
+                                  const uint32_t length,
+                                  const uint32_t segment_size,
+                                  const struct sockaddr* c_restrict addr,
+                                  const socklen_t addr_len );
+
+// one datagram to a multicast sender's group. False on failure, w/ the
+// errno in error ( may be NULL )
+bool dd_server_send_group( const struct ddAddressInfo* c_restrict sender,
+                           const char* c_restrict data,
+                           const int32_t length,
+                           int32_t* c_restrict error );
+
+// returns datagrams sent, one per recipient. A multicast sender sends once
+// to its group instead, so it returns 1 when that send succeeded
+uint32_t dd_server_broadcast_msg(
+    const struct ddAddressInfo* c_restrict sender,
+    const struct ddAddressInfo* c_restrict recipients,
+    const uint32_t count,
+    const uint32_t msg_type,
+    const struct ddMsgVal* c_restrict msg,
+    int32_t* c_restrict errors );
+
+void dd_server_recieve_msg( struct ddAddressInfo* c_restrict listener,
                             struct ddRecvMsg* msg_data );
 
+bool dd_recv_batch_init( struct ddRecvBatch* c_restrict batch,
+                         const uint32_t capacity );
+
+void dd_recv_batch_free( struct ddRecvBatch* c_restrict batch );
+
+// a gro listener's super-packets are split into one msg per segment
+int32_t dd_server_recieve_batch(
+    struct ddAddressInfo* c_restrict listener,
+    struct ddRecvBatch* c_restrict batch );
+
+#if DD_PLATFORM == DD_LINUX
+// reads a received datagram's control data. An SO_RXQ_OVFL count moves
+// listener->kernel_drops & DDSTAT_KERNEL_DROPS up to it. Returns the
+// SO_TIMESTAMPNS arrival time, 0 when there is none
+uint64_t dd_recv_read_control( struct ddAddressInfo* c_restrict listener,
+                               struct msghdr* c_restrict header );
+#endif  // DD_PLATFORM
+
+// segments of a super-packet left over when the batch filled up. They're
+// already off the socket, so drain again before waiting on it
+static inline bool dd_recv_batch_pending(
+    const struct ddRecvBatch* c_restrict batch )
+{
+    return batch->coalesced_offset < batch->coalesced_length;
+}
+
+// borrows a pool slot for the datagram. *buf is NULL when the pool was empty
+// & the datagram dropped ( counted in DDSTAT_POOL_DROPS ). Release the slot
+// w/ dd_pool_release
+int32_t dd_server_recieve_pooled(
+    struct ddAddressInfo* c_restrict listener,
+    struct ddBufferPool* c_restrict pool,
+    struct ddPoolBuf** c_restrict buf );
+
+// active is false when the loop couldn't be set up, so dd_loop_run returns
+// at once. dd_loop_cleanup it either way
 struct ddLoop dd_server_new_loop( dd_loop_cb loop_cb,
                                   struct ddAddressInfo* listener );
 
-void dd_loop_add_timer( struct ddLoop* c_restrict loop,
-                        dd_timer_cb timer_cb,
-                        double seconds,
-                        bool repeat );
+void dd_loop_set_batch_cb( struct ddLoop* c_restrict loop,
+                           dd_batch_cb batch_cb,
+                           struct ddRecvBatch* batch );
+
+bool dd_loop_set_backend( struct ddLoop* c_restrict loop,
+                          const uint32_t backend );
+
+void dd_loop_set_send_queues( struct ddLoop* c_restrict loop,
+                              struct ddSendQueueSet* send_queues );
+
+// sends data from the loop's listener. On DDLOOP_URING it's queued &
+// submitted w/ the next wait, other backends send right away
+bool dd_loop_send_to( struct ddLoop* c_restrict loop,
+                      const char* c_restrict data,
+                      const int32_t length,
+                      const struct sockaddr* c_restrict addr,
+                      const socklen_t addr_len );
+
+struct ddLoopWatch* dd_loop_add_watch( struct ddLoop* c_restrict loop,
+                                       ddSocket fd,
+                                       dd_watch_cb watch_cb,
+                                       void* data );
+
+void dd_loop_remove_watch( struct ddLoop* c_restrict loop,
+                           struct ddLoopWatch* watch );
+
+ddTimerHandle dd_loop_add_timer( struct ddLoop* c_restrict loop,
+                                 dd_timer_cb timer_cb,
+                                 double seconds,
+                                 bool repeat,
+                                 void* data );
+
+bool dd_loop_cancel_timer( struct ddLoop* c_restrict loop,
+                           const ddTimerHandle handle );
+
+bool dd_loop_restart_timer( struct ddLoop* c_restrict loop,
+                            const ddTimerHandle handle );
 
 int64_t dd_loop_time_nano( struct ddLoop* c_restrict loop );
 
@@ -166,3 +471,20 @@ double dd_loop_time_seconds( struct ddLoop* c_restrict loop );
 void dd_loop_break( struct ddLoop* loop );
 
 void dd_loop_run( struct ddLoop* loop );
+
+void dd_loop_cleanup( struct ddLoop* loop );
+
+#ifdef DD_LOOP_STATS
+const struct ddLoopStats* dd_loop_stats( const struct ddLoop* loop );
+
+void dd_loop_stats_reset( struct ddLoop* loop );
+
+// records how long each msg in batch waited since its kernel arrival. The
+// backends call it right before the batch callback. Loops w/ a plain read
+// callback may call it on the msgs they receive
+void dd_loop_stats_queue( struct ddLoop* c_restrict loop,
+                          const struct ddRecvBatch* c_restrict batch );
+
+// logs count, mean & p50/p99/p99.9/max of each histogram
+void dd_loop_stats_print( const struct ddLoop* loop );
+#endif  // DD_LOOP_STATS
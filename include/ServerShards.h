@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ddConfig.h"
+#include "ServerInterface.h"
+
+#if DD_PLATFORM == DD_LINUX
+#include <pthread.h>
+#endif  // DD_PLATFORM
+
+/* Multi-core server: one SO_REUSEPORT socket & one ddLoop per worker thread.
+ * The kernel hashes senders across the shard sockets */
+
+struct ddShard;
+struct ddShardGroup;
+
+typedef void ( *dd_shard_cb )( struct ddShard* );
+
+struct ddShardConfig
+{
+    const char* ip;
+    const char* port;
+    uint32_t count;  // 0 = one shard per cpu the process may use
+    bool pin_cpus;   // pin shards to those cpus round robin
+
+    int32_t recv_buffer;  // SO_RCVBUF per shard socket, 0 = system default
+    bool rx_timestamps;   // kernel arrival times, see ddSocketOpts
+
+    dd_loop_cb read_cb;
+    dd_batch_cb batch_cb;  // optional, each shard drains a ddRecvBatch
+    dd_shard_cb setup_cb;  // optional, runs on the shard thread before loop
+    void* data;
+};
+
+struct ddShard
+{
+    struct ddAddressInfo listener;
+    struct ddLoop loop;  // loop.data points back at the shard
+    struct ddRecvBatch batch;
+
+    struct ddShardGroup* group;
+    uint32_t index;
+    int32_t cpu;  // -1 when not pinned
+
+#if DD_PLATFORM == DD_LINUX
+    pthread_t thread;
+#endif  // DD_PLATFORM
+    bool running;
+};
+
+struct ddShardGroup
+{
+    struct ddShard* shards;
+    uint32_t count;
+    struct ddShardConfig config;
+};
+
+bool dd_shards_create( struct ddShardGroup* c_restrict group,
+                       const struct ddShardConfig* c_restrict config );
+
+bool dd_shards_start( struct ddShardGroup* c_restrict group );
+
+void dd_shards_break( struct ddShardGroup* c_restrict group );
+
+void dd_shards_stop( struct ddShardGroup* c_restrict group );
+
+void dd_shards_free( struct ddShardGroup* c_restrict group );
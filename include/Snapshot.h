@@ -0,0 +1,123 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ddConfig.h"
+#include "ServerInterface.h"
+#include "Fragment.h"
+
+/* Snapshot replication for fixed layout numeric state ( 32-bit words, the
+ * same layout as the int/float vector messages ). The server keeps the last
+ * DD_SNAPSHOT_HISTORY snapshots & each peer's acknowledged baseline, then
+ * sends only the words that changed since it, XORed against the baseline &
+ * varint packed. Peers w/o a baseline, or whose baseline fell out of the
+ * history, get a full snapshot. Clients keep the same history so any acked
+ * baseline can be rebuilt */
+
+#ifndef DD_SNAPSHOT_HISTORY
+#define DD_SNAPSHOT_HISTORY 32  // power of 2
+#endif
+
+// snapshot type + sequence + baseline + word count after the frame byte
+#define DD_SNAPSHOT_HEADER_SIZE ( DDFRAME_HEADER_SIZE + 7 )
+
+// largest state a full snapshot can carry through the fragmenter
+#define DD_SNAPSHOT_MAX_WORDS                                                 \
+    ( ( DD_FRAG_MAX_MESSAGE - DD_SNAPSHOT_HEADER_SIZE ) / 4 )
+
+enum
+{
+    DDSNAP_FULL = 0,
+    DDSNAP_DELTA,
+    DDSNAP_ACK,
+};
+
+struct ddSnapshotStats
+{
+    uint64_t full;        // full snapshots encoded
+    uint64_t delta;       // deltas encoded
+    uint64_t bytes;       // encoded bytes
+    uint64_t full_bytes;  // bytes had every encode been a full snapshot
+};
+
+struct ddSnapshotServer
+{
+    uint32_t words;
+    uint32_t* history;  // DD_SNAPSHOT_HISTORY x words
+    uint16_t latest;    // sequence of the newest snapshot
+    uint32_t committed;  // snapshots in the history
+    char* scratch;      // encode buffer for dd_snapshot_send_to
+
+    struct ddSnapshotStats stats;
+};
+
+// per peer replication state, kept alongside the peer's other data
+struct ddSnapshotPeer
+{
+    uint16_t baseline;  // newest sequence the peer acked
+    bool has_baseline;
+};
+
+struct ddSnapshotClient
+{
+    uint32_t words;
+    uint32_t* history;  // DD_SNAPSHOT_HISTORY x words
+    uint16_t seqs[DD_SNAPSHOT_HISTORY];
+    bool filled[DD_SNAPSHOT_HISTORY];
+    uint16_t latest;
+    bool has_latest;
+};
+
+// false when words is 0 or above DD_SNAPSHOT_MAX_WORDS
+bool dd_snapshot_init( struct ddSnapshotServer* c_restrict server,
+                       const uint32_t words );
+
+void dd_snapshot_free( struct ddSnapshotServer* c_restrict server );
+
+// stores state as the newest snapshot, returns its sequence
+uint16_t dd_snapshot_commit( struct ddSnapshotServer* c_restrict server,
+                             const uint32_t* c_restrict state );
+
+// newest snapshot relative to the peer's baseline. Returns bytes written,
+// -1 when output_size can't hold even a full snapshot
+int32_t dd_snapshot_encode( struct ddSnapshotServer* c_restrict server,
+                            const struct ddSnapshotPeer* c_restrict peer,
+                            char* c_restrict output,
+                            const uint32_t output_size );
+
+// sends the encoded snapshot, fragmented when it exceeds a datagram
+bool dd_snapshot_send_to( struct ddSnapshotServer* c_restrict server,
+                          const struct ddSnapshotPeer* c_restrict peer,
+                          const struct ddAddressInfo* c_restrict sender,
+                          const struct sockaddr* c_restrict addr,
+                          const socklen_t addr_len );
+
+// moves the peer's baseline forward on a DDSNAP_ACK frame. false when data
+// isn't a snapshot ack
+bool dd_snapshot_on_ack( const struct ddSnapshotServer* c_restrict server,
+                         struct ddSnapshotPeer* c_restrict peer,
+                         const char* c_restrict data,
+                         const int32_t length );
+
+bool dd_snapshot_client_init( struct ddSnapshotClient* c_restrict client,
+                              const uint32_t words );
+
+void dd_snapshot_client_free( struct ddSnapshotClient* c_restrict client );
+
+// applies a full or delta snapshot frame. Returns its sequence, or -1 when
+// it isn't one, is stale, or builds on a baseline we no longer hold ( the
+// server sends a full snapshot once that baseline expires )
+int32_t dd_snapshot_apply( struct ddSnapshotClient* c_restrict client,
+                           const char* c_restrict data,
+                           const int32_t length );
+
+// DDSNAP_ACK for the newest applied snapshot, returns bytes or -1
+int32_t dd_snapshot_ack_encode(
+    const struct ddSnapshotClient* c_restrict client,
+    char* c_restrict output,
+    const uint32_t output_size );
+
+// newest applied state ( NULL before the first snapshot )
+const uint32_t* dd_snapshot_state(
+    const struct ddSnapshotClient* c_restrict client );
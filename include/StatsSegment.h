@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "ddConfig.h"
+
+/* Process wide counters in a shared memory segment ( /dev/shm on linux ).
+ * The server bumps relaxed atomics as it sends, receives & loops, tools like
+ * ddstat map the segment read-only & sample it, so scraping costs the server
+ * nothing. Until dd_stats_open every update is a pointer check. The layout
+ * only grows: new stats take spare slots & readers ignore ones they don't
+ * know, anything else bumps DD_STATS_VERSION */
+
+#ifndef DD_CACHE_LINE
+#define DD_CACHE_LINE 64
+#endif
+
+#define DD_STATS_MAGIC 0x54534444u  // "DDST"
+#define DD_STATS_VERSION 1
+#define DD_STATS_SLOTS 32  // room for stats added w/o a version bump
+
+enum
+{
+    // counters, only ever grow
+    DDSTAT_PACKETS_IN = 0,
+    DDSTAT_BYTES_IN,
+    DDSTAT_PACKETS_OUT,
+    DDSTAT_BYTES_OUT,
+    DDSTAT_SEND_ERRORS,
+    DDSTAT_RECV_ERRORS,
+    DDSTAT_TIMER_FIRES,
+    DDSTAT_LOOP_ITERATIONS,
+
+    // gauges, current values
+    DDSTAT_PEERS_ACTIVE,
+    DDSTAT_POOL_IN_USE,
+    DDSTAT_POOL_CAPACITY,
+
+    // added later, so past the gauges
+    DDSTAT_KERNEL_DROPS,  // receive queue overflows ( SO_RXQ_OVFL )
+    DDSTAT_POOL_DROPS,    // datagrams discarded while the buffer pool was empty
+
+    DDSTAT_COUNT,
+};
+
+// each stat on its own line so shard threads don't share one
+struct ddStatsSlot
+{
+    _Alignas( DD_CACHE_LINE ) _Atomic uint64_t value;
+};
+
+struct ddStatsSegment
+{
+    _Atomic uint32_t magic;  // stored last, once the header is filled in
+    uint32_t version;
+    uint32_t stat_count;  // DDSTAT_COUNT of the writer
+    int32_t pid;
+    uint64_t start_time;  // wall clock nanoseconds at dd_stats_open
+
+    struct ddStatsSlot slots[DD_STATS_SLOTS];
+};
+
+// the segment being written, NULL when stats are off
+extern struct ddStatsSegment* _Atomic dd_stats_segment;
+
+static inline bool dd_stats_enabled()
+{
+    return atomic_load_explicit( &dd_stats_segment, memory_order_relaxed );
+}
+
+static inline void dd_stats_add( const uint32_t stat, const uint64_t amount )
+{
+    struct ddStatsSegment* segment =
+        atomic_load_explicit( &dd_stats_segment, memory_order_relaxed );
+
+    if( segment )
+        atomic_fetch_add_explicit(
+            &segment->slots[stat].value, amount, memory_order_relaxed );
+}
+
+static inline void dd_stats_sub( const uint32_t stat, const uint64_t amount )
+{
+    struct ddStatsSegment* segment =
+        atomic_load_explicit( &dd_stats_segment, memory_order_relaxed );
+
+    if( segment )
+        atomic_fetch_sub_explicit(
+            &segment->slots[stat].value, amount, memory_order_relaxed );
+}
+
+// creates & publishes the segment. NULL name picks "/ddstat.<pid>". Call
+// before loops start, stats updated earlier are lost
+bool dd_stats_open( const char* c_restrict name );
+
+// unmaps & unlinks the segment. Call once every loop has stopped
+void dd_stats_close();
+
+// read-only view of another process's segment, NULL when missing or from an
+// unknown version
+const struct ddStatsSegment* dd_stats_attach( const char* c_restrict name );
+
+void dd_stats_detach( const struct ddStatsSegment* c_restrict segment );
+
+// 0 for stats the writer doesn't have
+uint64_t dd_stats_read( const struct ddStatsSegment* c_restrict segment,
+                        const uint32_t stat );
+
+const char* dd_stats_name( const uint32_t stat );
+
+// gauges hold a current value, the rest are counters w/ a rate
+bool dd_stats_is_gauge( const uint32_t stat );
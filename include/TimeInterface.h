@@ -1,12 +1,34 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #include "ddConfig.h"
 
 /* Interface for retrieving time information w/ nano-second granularity */
 
+#ifndef DD_TSC_CALIBRATE_NANO
+#define DD_TSC_CALIBRATE_NANO 20000000  // tsc calibration window ( 20 ms )
+#endif
+
+// clock sources behind get_high_res_time
+enum
+{
+    DDCLOCK_MONOTONIC = 0,  // clock_gettime( CLOCK_MONOTONIC_RAW )
+    DDCLOCK_TSC,            // calibrated rdtsc, invariant tsc only
+};
+
+// select at startup before other threads read the clock. Returns false &
+// keeps the monotonic clock when the tsc isn't usable
+bool dd_time_set_clock( const uint32_t clock );
+uint32_t dd_time_clock();
+double dd_time_tsc_ghz();  // calibrated tsc rate, 0 when not in use
+
 uint64_t get_high_res_time();
+
+// nanoseconds since the unix epoch, the clock of kernel receive timestamps.
+// Can step, so only compare it w/ other wall clock times
+uint64_t get_wall_time();
 uint64_t seconds_to_nano( double seconds );
 uint64_t nano_to_milli( uint64_t nanosecs );
 double nano_to_seconds( uint64_t nanosecs );
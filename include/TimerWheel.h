@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ddConfig.h"
+
+/* Hierarchical timing wheel w/ O(1) insert & cancel. Each level holds
+ * DD_WHEEL_SLOTS buckets and covers DD_WHEEL_SLOTS times the range of the
+ * level below it. Timers cascade down a level when their bucket comes due */
+
+#ifndef DD_WHEEL_LEVELS
+#define DD_WHEEL_LEVELS 5
+#endif
+
+#ifndef DD_WHEEL_TICK_NANO
+#define DD_WHEEL_TICK_NANO 1000000  // 1 ms resolution
+#endif
+
+#ifndef DD_TIMER_BLOCK
+#define DD_TIMER_BLOCK 1024  // timers allocated per slab block
+#endif
+
+#define DD_WHEEL_BITS 6
+#define DD_WHEEL_SLOTS ( 1 << DD_WHEEL_BITS )
+
+struct ddLoop;
+struct ddServerTimer;
+
+typedef void ( *dd_timer_cb )( struct ddLoop*, struct ddServerTimer* );
+
+// generation + slab index. 0 is never a valid handle
+typedef uint64_t ddTimerHandle;
+
+struct ddServerTimer
+{
+    uint64_t tick_rate;
+    bool repeat;
+    void* data;
+
+    dd_timer_cb callback;
+    uint64_t deadline;  // absolute nanosecond time
+    uint64_t expires;   // wheel tick
+
+    struct ddServerTimer* next;
+    struct ddServerTimer** pprev;  // NULL when not linked
+
+    uint32_t index;
+    uint32_t generation;
+    uint8_t level;
+    uint8_t slot;
+};
+
+struct ddTimerWheel
+{
+    uint64_t origin;  // nanosecond time of tick 0
+    uint64_t tick;    // next tick to process
+    uint32_t count;   // armed timers
+
+    struct ddServerTimer** slots;  // DD_WHEEL_LEVELS x DD_WHEEL_SLOTS
+    uint64_t* slot_min;  // lower bound on expiry per bucket
+    uint64_t occupied[DD_WHEEL_LEVELS];
+    struct ddServerTimer* pending;  // due timers being fired
+
+    struct ddServerTimer** blocks;
+    uint32_t blocks_count;
+    struct ddServerTimer* free_list;
+};
+
+bool dd_wheel_init( struct ddTimerWheel* c_restrict wheel, const uint64_t now );
+
+void dd_wheel_free( struct ddTimerWheel* c_restrict wheel );
+
+ddTimerHandle dd_wheel_add( struct ddTimerWheel* c_restrict wheel,
+                            dd_timer_cb timer_cb,
+                            const uint64_t now,
+                            const uint64_t tick_rate,
+                            const bool repeat,
+                            void* data );
+
+struct ddServerTimer* dd_wheel_get( const struct ddTimerWheel* c_restrict wheel,
+                                    const ddTimerHandle handle );
+
+bool dd_wheel_cancel( struct ddTimerWheel* c_restrict wheel,
+                      const ddTimerHandle handle );
+
+bool dd_wheel_restart( struct ddTimerWheel* c_restrict wheel,
+                       const ddTimerHandle handle,
+                       const uint64_t now );
+
+uint64_t dd_wheel_next_deadline( const struct ddTimerWheel* c_restrict wheel );
+
+uint32_t dd_wheel_advance( struct ddTimerWheel* c_restrict wheel,
+                           const uint64_t now,
+                           struct ddLoop* loop );
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ddConfig.h"
+#include "ServerInterface.h"
+
+/* Publish/subscribe routing on message tags. Tags are interned into dense
+ * topic ids & each topic keeps a packed array of subscriber addresses, so a
+ * publish encodes once & hands only that array to sendmmsg. A hash set of
+ * ( topic, address ) pairs finds a subscription in O(1) for subscribe &
+ * unsubscribe, so neither scans the other subscribers.
+ *
+ * Topic frames carry the tag in front of the payload:
+ *   DDFRAME_MARK | DDFRAME_TOPIC | op, tag length, tag, payload
+ * where a publish's payload is any other frame. Subscribers send subscribe
+ * & unsubscribe frames w/o a payload for topics the server interned, see
+ * dd_topics_handle */
+
+#ifndef DD_TOPICS_MIN_CAPACITY
+#define DD_TOPICS_MIN_CAPACITY 64
+#endif
+
+// op byte, tag length byte, tag
+#define DD_TOPIC_HEADER_SIZE( tag_length ) \
+    ( DDFRAME_HEADER_SIZE + 1 + ( tag_length ) )
+
+// tags are at most MAX_TAG_LENGTH - 1 bytes, no terminator on the wire
+#define DD_TOPIC_MAX_TAG ( MAX_TAG_LENGTH - 1 )
+
+// topic frame ops, the frame kind bits
+enum
+{
+    DDTOPIC_PUBLISH = 0,
+    DDTOPIC_SUBSCRIBE,
+    DDTOPIC_UNSUBSCRIBE,
+};
+
+#define DD_TOPIC_NONE UINT32_MAX
+
+struct ddSubscriber
+{
+    union {
+        struct sockaddr sa;
+        struct sockaddr_in v4;
+        struct sockaddr_in6 v6;
+    } addr;
+    socklen_t addr_len;
+};
+
+struct ddTopic
+{
+    char tag[MAX_TAG_LENGTH];
+    uint32_t tag_length;
+    uint32_t hash;
+
+    struct ddSubscriber* subs;  // unordered, removal swaps the last one in
+    uint32_t count;
+    uint32_t capacity;
+};
+
+// ( topic, subscriber ) set entry
+struct ddSubscription
+{
+    uint32_t hash;  // 0 marks an empty slot
+    uint32_t topic;
+    uint32_t index;  // into the topic's subs
+};
+
+struct ddTopicTable
+{
+    struct ddTopic* topics;  // indexed by topic id
+    uint32_t topic_count;
+    uint32_t topic_capacity;
+
+    uint32_t* tag_index;  // open addressing, topic id + 1 ( 0 = empty )
+    uint32_t tag_capacity;  // power of 2
+
+    struct ddSubscription* members;
+    uint32_t member_capacity;  // power of 2
+    uint32_t member_count;
+
+    uint64_t refused;  // subscribes to tags that were never interned
+};
+
+// decoded topic frame, pointers into the datagram
+struct ddTopicFrame
+{
+    uint32_t op;
+    const char* tag;
+    uint32_t tag_length;
+    const char* payload;
+    uint32_t payload_length;
+};
+
+bool dd_topics_init( struct ddTopicTable* c_restrict table,
+                     const uint32_t subscription_hint );
+
+void dd_topics_free( struct ddTopicTable* c_restrict table );
+
+// topic id for tag, added if new. Ids stay valid for the table's lifetime.
+// DD_TOPIC_NONE when the tag is empty, too long or allocation failed
+uint32_t dd_topics_intern( struct ddTopicTable* c_restrict table,
+                           const char* c_restrict tag,
+                           const uint32_t tag_length );
+
+// DD_TOPIC_NONE when the tag was never interned
+uint32_t dd_topics_find( const struct ddTopicTable* c_restrict table,
+                         const char* c_restrict tag,
+                         const uint32_t tag_length );
+
+// false when the address isn't ipv4/ipv6 or allocation failed. Subscribing
+// twice is a no-op
+bool dd_topics_subscribe( struct ddTopicTable* c_restrict table,
+                          const uint32_t topic,
+                          const struct sockaddr_storage* c_restrict addr,
+                          const socklen_t addr_len );
+
+bool dd_topics_unsubscribe( struct ddTopicTable* c_restrict table,
+                            const uint32_t topic,
+                            const struct sockaddr_storage* c_restrict addr );
+
+// drops every subscription of addr, one lookup per topic. Returns how many
+uint32_t dd_topics_unsubscribe_all(
+    struct ddTopicTable* c_restrict table,
+    const struct sockaddr_storage* c_restrict addr );
+
+// applies a subscribe/unsubscribe frame from msg's sender. False when msg
+// isn't one, so the caller handles it as usual. Peers can't add topics,
+// subscribes to a tag that isn't interned are counted in refused & dropped
+bool dd_topics_handle( struct ddTopicTable* c_restrict table,
+                       const struct ddRecvMsg* c_restrict msg );
+
+// wraps an encoded frame in a publish envelope & sends it to the topic's
+// subscribers in sendmmsg batches. Returns datagrams sent
+uint32_t dd_topics_publish_raw( const struct ddAddressInfo* c_restrict sender,
+                                const struct ddTopicTable* c_restrict table,
+                                const uint32_t topic,
+                                const char* c_restrict frame,
+                                const uint32_t frame_length );
+
+uint32_t dd_topics_publish( const struct ddAddressInfo* c_restrict sender,
+                            const struct ddTopicTable* c_restrict table,
+                            const uint32_t topic,
+                            const uint32_t msg_type,
+                            const struct ddMsgVal* c_restrict msg );
+
+// writes a topic frame. Returns its length, -1 when it won't fit in out or
+// MAX_MSG_LENGTH - 1 bytes, the most a receive reads
+int32_t dd_topic_encode( const uint32_t op,
+                         const char* c_restrict tag,
+                         const uint32_t tag_length,
+                         const char* c_restrict payload,
+                         const uint32_t payload_length,
+                         char* c_restrict out,
+                         const uint32_t out_size );
+
+bool dd_topic_decode( const char* c_restrict data,
+                      const int32_t length,
+                      struct ddTopicFrame* c_restrict frame );
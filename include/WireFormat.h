@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ddConfig.h"
+
+/* Little-endian field helpers shared by the frame encoders */
+
+static inline void dd_write_u16_le( uint8_t* c_restrict out,
+                                    const uint16_t val )
+{
+    out[0] = (uint8_t)val;
+    out[1] = (uint8_t)( val >> 8 );
+}
+
+static inline uint16_t dd_read_u16_le( const uint8_t* c_restrict in )
+{
+    return (uint16_t)( in[0] | ( in[1] << 8 ) );
+}
+
+static inline void dd_write_u32_le( uint8_t* c_restrict out,
+                                    const uint32_t val )
+{
+    out[0] = (uint8_t)val;
+    out[1] = (uint8_t)( val >> 8 );
+    out[2] = (uint8_t)( val >> 16 );
+    out[3] = (uint8_t)( val >> 24 );
+}
+
+static inline uint32_t dd_read_u32_le( const uint8_t* c_restrict in )
+{
+    return (uint32_t)in[0] | ( (uint32_t)in[1] << 8 ) |
+           ( (uint32_t)in[2] << 16 ) | ( (uint32_t)in[3] << 24 );
+}
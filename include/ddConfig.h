@@ -0,0 +1,30 @@
+#pragma once
+
+#define DD_VERSION_MAJOR 1
+#define DD_VERSION_MINOR 0
+#define DD_VERSION_PATCH 1
+/* #undef USE_CLANG */
+/* #undef VERBOSE */
+/* #undef DD_LOOP_STATS */
+
+#define ROOT_DIR "/root/repo"
+
+#ifdef _WIN32
+#define c_restrict __restrict
+#else
+#define c_restrict restrict
+#endif
+
+#ifndef UNUSED_VAR
+#define UNUSED_VAR( x ) (void)x
+#endif
+
+#define DD_WIN32 1
+#define DD_LINUX 2
+
+#ifdef _WIN32
+#define DD_PLATFORM DD_WIN32
+#define WIN32_LEAN_AND_MEAN 1
+#elif __linux__
+#define DD_PLATFORM DD_LINUX
+#endif
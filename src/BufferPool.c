@@ -0,0 +1,186 @@
+#include "BufferPool.h"
+#include "ConsoleWrite.h"
+#include "StatsSegment.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if DD_PLATFORM == DD_WIN32
+#include <malloc.h>
+#endif  // DD_PLATFORM
+
+#define HEAD_INDEX( head ) ( (uint32_t)( head ) )
+#define HEAD_TAG( head ) ( (uint32_t)( ( head ) >> 32 ) )
+#define MAKE_HEAD( tag, index ) ( ( (uint64_t)( tag ) << 32 ) | ( index ) )
+
+static void* alloc_aligned( const size_t size )
+{
+#if DD_PLATFORM == DD_WIN32
+    return _aligned_malloc( size, DD_CACHE_LINE );
+#else
+    // size is a multiple of the alignment since ddPoolBuf is line aligned
+    return aligned_alloc( DD_CACHE_LINE, size );
+#endif  // DD_PLATFORM
+}
+
+static void free_aligned( void* ptr )
+{
+#if DD_PLATFORM == DD_WIN32
+    _aligned_free( ptr );
+#else
+    free( ptr );
+#endif  // DD_PLATFORM
+}
+
+static void push_free( struct ddBufferPool* c_restrict pool,
+                       struct ddPoolBuf* c_restrict buf )
+{
+    uint64_t head = atomic_load_explicit( &pool->free_head,
+                                          memory_order_relaxed );
+    uint64_t next_head;
+
+    do
+    {
+        atomic_store_explicit(
+            &buf->next, HEAD_INDEX( head ), memory_order_relaxed );
+
+        next_head = MAKE_HEAD( HEAD_TAG( head ) + 1, buf->index + 1 );
+    } while( !atomic_compare_exchange_weak_explicit( &pool->free_head,
+                                                     &head,
+                                                     next_head,
+                                                     memory_order_release,
+                                                     memory_order_relaxed ) );
+}
+
+static struct ddPoolBuf* pop_free( struct ddBufferPool* c_restrict pool )
+{
+    uint64_t head = atomic_load_explicit( &pool->free_head,
+                                          memory_order_acquire );
+    uint64_t next_head;
+
+    do
+    {
+        if( HEAD_INDEX( head ) == 0 ) return NULL;
+
+        // stale reads are caught by the tag check in the exchange
+        const uint32_t next = atomic_load_explicit(
+            &pool->slots[HEAD_INDEX( head ) - 1].next, memory_order_relaxed );
+
+        next_head = MAKE_HEAD( HEAD_TAG( head ) + 1, next );
+    } while( !atomic_compare_exchange_weak_explicit( &pool->free_head,
+                                                     &head,
+                                                     next_head,
+                                                     memory_order_acquire,
+                                                     memory_order_acquire ) );
+
+    return &pool->slots[HEAD_INDEX( head ) - 1];
+}
+
+bool dd_pool_init( struct ddBufferPool* c_restrict pool,
+                   const uint32_t capacity )
+{
+    memset( pool, 0, sizeof( *pool ) );
+
+    if( capacity == 0 ) return false;
+
+    pool->slots = alloc_aligned( capacity * sizeof( struct ddPoolBuf ) );
+
+    if( !pool->slots )
+    {
+        console_write( LOG_ERROR, "Buffer pool allocation failed\n" );
+        return false;
+    }
+
+    pool->capacity = capacity;
+
+    // link slots in order so the first acquires walk memory forward
+    for( uint32_t i = 0; i < capacity; i++ )
+    {
+        struct ddPoolBuf* buf = &pool->slots[i];
+
+        buf->pool = pool;
+        buf->index = i;
+        atomic_init( &buf->refs, 0 );
+        atomic_init( &buf->next, i + 1 < capacity ? i + 2 : 0 );
+    }
+
+    atomic_init( &pool->free_head, MAKE_HEAD( 0, 1 ) );
+    atomic_init( &pool->in_use, 0 );
+    atomic_init( &pool->high_water, 0 );
+    atomic_init( &pool->exhausted, 0 );
+
+    dd_stats_add( DDSTAT_POOL_CAPACITY, capacity );
+
+    return true;
+}
+
+void dd_pool_free( struct ddBufferPool* c_restrict pool )
+{
+    const uint32_t in_use = atomic_load( &pool->in_use );
+
+    if( in_use )
+        console_write(
+            LOG_WARN, "Buffer pool freed with %u slots in use\n", in_use );
+
+    dd_stats_sub( DDSTAT_POOL_IN_USE, in_use );
+    dd_stats_sub( DDSTAT_POOL_CAPACITY, pool->capacity );
+
+    free_aligned( pool->slots );
+    memset( pool, 0, sizeof( *pool ) );
+}
+
+struct ddPoolBuf* dd_pool_acquire( struct ddBufferPool* c_restrict pool )
+{
+    struct ddPoolBuf* buf = pop_free( pool );
+
+    if( !buf )
+    {
+        atomic_fetch_add_explicit( &pool->exhausted, 1, memory_order_relaxed );
+        return NULL;
+    }
+
+    atomic_store_explicit( &buf->refs, 1, memory_order_relaxed );
+
+    const uint32_t in_use =
+        atomic_fetch_add_explicit( &pool->in_use, 1, memory_order_relaxed ) +
+        1;
+
+    dd_stats_add( DDSTAT_POOL_IN_USE, 1 );
+
+    uint32_t high = atomic_load_explicit( &pool->high_water,
+                                          memory_order_relaxed );
+
+    while( in_use > high &&
+           !atomic_compare_exchange_weak_explicit( &pool->high_water,
+                                                   &high,
+                                                   in_use,
+                                                   memory_order_relaxed,
+                                                   memory_order_relaxed ) )
+        ;
+
+    return buf;
+}
+
+void dd_pool_retain( struct ddPoolBuf* c_restrict buf )
+{
+    atomic_fetch_add_explicit( &buf->refs, 1, memory_order_relaxed );
+}
+
+void dd_pool_release( struct ddPoolBuf* c_restrict buf )
+{
+    // acq_rel so every holder's writes land before the slot is reused
+    if( atomic_fetch_sub_explicit( &buf->refs, 1, memory_order_acq_rel ) != 1 )
+        return;
+
+    struct ddBufferPool* pool = buf->pool;
+
+    atomic_fetch_sub_explicit( &pool->in_use, 1, memory_order_relaxed );
+    dd_stats_sub( DDSTAT_POOL_IN_USE, 1 );
+    push_free( pool, buf );
+}
+
+uint32_t dd_pool_high_water( const struct ddBufferPool* c_restrict pool )
+{
+    return atomic_load_explicit(
+        (atomic_uint*)&pool->high_water, memory_order_relaxed );
+}
@@ -0,0 +1,364 @@
+#include "Compress.h"
+#include "ConsoleWrite.h"
+#include "WireFormat.h"
+
+#include <string.h>
+
+/* LZ block format: a run of sequences, each a token byte ( literal count in
+ * the high nibble, match length - 4 in the low nibble ), extra length bytes
+ * when a nibble is 15, the literals, then a u16 back reference offset &
+ * extra match length bytes. The last sequence stops after its literals */
+
+#define LZ_MIN_MATCH 4
+#define LZ_MIN_HASH_BITS 8
+#define LZ_MAX_HASH_BITS 12
+#define LZ_MAX_OFFSET 0xffff
+
+const struct ddCodec dd_codec_lz = {
+    .id = DDCODEC_LZ,
+    .name = "lz",
+    .compress = dd_lz_compress,
+    .decompress = dd_lz_decompress,
+};
+
+static const struct ddCodec* s_codecs[256] = {[DDCODEC_LZ] = &dd_codec_lz};
+
+bool dd_codec_register( const struct ddCodec* codec )
+{
+    if( !codec || codec->id == DDCODEC_NONE || s_codecs[codec->id] )
+        return false;
+
+    s_codecs[codec->id] = codec;
+    return true;
+}
+
+const struct ddCodec* dd_codec_find( const uint8_t id )
+{
+    return s_codecs[id];
+}
+
+static uint32_t read_u32( const uint8_t* c_restrict in )
+{
+    uint32_t val;
+    memcpy( &val, in, sizeof( val ) );
+    return val;
+}
+
+static uint64_t read_u64( const uint8_t* c_restrict in )
+{
+    uint64_t val;
+    memcpy( &val, in, sizeof( val ) );
+    return val;
+}
+
+static uint32_t lz_hash( const uint32_t seq, const uint32_t bits )
+{
+    return ( seq * 2654435761u ) >> ( 32 - bits );
+}
+
+// 15 in the nibble, then 255s & a remainder byte
+static bool write_length( uint8_t** c_restrict out,
+                          const uint8_t* c_restrict end,
+                          uint32_t extra )
+{
+    for( ; extra >= 255; extra -= 255 )
+    {
+        if( *out == end ) return false;
+        *( *out )++ = 255;
+    }
+
+    if( *out == end ) return false;
+    *( *out )++ = (uint8_t)extra;
+
+    return true;
+}
+
+static bool read_length( const uint8_t** c_restrict in,
+                         const uint8_t* c_restrict end,
+                         uint32_t* c_restrict length )
+{
+    uint8_t byte;
+
+    do
+    {
+        if( *in == end ) return false;
+
+        byte = *( *in )++;
+        *length += byte;
+    } while( byte == 255 );
+
+    return true;
+}
+
+static bool emit_sequence( uint8_t** c_restrict out,
+                           const uint8_t* c_restrict end,
+                           const uint8_t* c_restrict literals,
+                           const uint32_t literal_count,
+                           const uint32_t offset,
+                           const uint32_t match_length )
+{
+    if( *out == end ) return false;
+
+    uint8_t* token = ( *out )++;
+    const uint32_t match_code = match_length ? match_length - LZ_MIN_MATCH : 0;
+
+    *token = (uint8_t)( ( literal_count < 15 ? literal_count : 15 ) << 4 |
+                        ( match_code < 15 ? match_code : 15 ) );
+
+    if( literal_count >= 15 && !write_length( out, end, literal_count - 15 ) )
+        return false;
+
+    if( (uint32_t)( end - *out ) < literal_count ) return false;
+
+    memcpy( *out, literals, literal_count );
+    *out += literal_count;
+
+    if( match_length == 0 ) return true;
+
+    if( end - *out < 2 ) return false;
+
+    dd_write_u16_le( *out, (uint16_t)offset );
+    *out += 2;
+
+    return match_code < 15 || write_length( out, end, match_code - 15 );
+}
+
+int32_t dd_lz_compress( const uint8_t* c_restrict input,
+                        const uint32_t length,
+                        uint8_t* c_restrict output,
+                        const uint32_t output_size )
+{
+    // last position seen for each 4 byte hash ( + 1, 0 = none ). Sized to
+    // the input so small frames don't pay to clear the whole table
+    uint32_t table[1 << LZ_MAX_HASH_BITS];
+    uint32_t bits = LZ_MIN_HASH_BITS;
+
+    while( bits < LZ_MAX_HASH_BITS && ( 1u << bits ) < length ) bits++;
+
+    memset( table, 0, sizeof( uint32_t ) << bits );
+
+    uint8_t* out = output;
+    const uint8_t* end = output + output_size;
+    uint32_t pos = 0;
+    uint32_t anchor = 0;
+
+    while( pos + LZ_MIN_MATCH <= length )
+    {
+        const uint32_t seq = read_u32( input + pos );
+        const uint32_t hash = lz_hash( seq, bits );
+        const uint32_t candidate = table[hash];
+
+        table[hash] = pos + 1;
+
+        if( candidate == 0 || pos - ( candidate - 1 ) > LZ_MAX_OFFSET ||
+            read_u32( input + candidate - 1 ) != seq )
+        {
+            pos++;
+            continue;
+        }
+
+        const uint32_t ref = candidate - 1;
+        uint32_t match = LZ_MIN_MATCH;
+
+        while( pos + match + 8 <= length &&
+               read_u64( input + ref + match ) ==
+                   read_u64( input + pos + match ) )
+            match += 8;
+
+        while( pos + match < length &&
+               input[ref + match] == input[pos + match] )
+            match++;
+
+        if( !emit_sequence( &out,
+                            end,
+                            input + anchor,
+                            pos - anchor,
+                            pos - ref,
+                            match ) )
+            return -1;
+
+        pos += match;
+        anchor = pos;
+    }
+
+    if( !emit_sequence( &out, end, input + anchor, length - anchor, 0, 0 ) )
+        return -1;
+
+    return (int32_t)( out - output );
+}
+
+int32_t dd_lz_decompress( const uint8_t* c_restrict input,
+                          const uint32_t length,
+                          uint8_t* c_restrict output,
+                          const uint32_t output_size )
+{
+    const uint8_t* in = input;
+    const uint8_t* in_end = input + length;
+    uint8_t* out = output;
+    const uint8_t* out_end = output + output_size;
+
+    while( in < in_end )
+    {
+        const uint8_t token = *in++;
+        uint32_t literal_count = token >> 4;
+
+        if( literal_count == 15 &&
+            !read_length( &in, in_end, &literal_count ) )
+            return -1;
+
+        if( (uint32_t)( in_end - in ) < literal_count ||
+            (uint32_t)( out_end - out ) < literal_count )
+            return -1;
+
+        memcpy( out, in, literal_count );
+        in += literal_count;
+        out += literal_count;
+
+        if( in == in_end ) break;
+
+        if( in_end - in < 2 ) return -1;
+
+        const uint32_t offset = dd_read_u16_le( in );
+        in += 2;
+
+        uint32_t match = token & 15;
+
+        if( match == 15 && !read_length( &in, in_end, &match ) ) return -1;
+
+        match += LZ_MIN_MATCH;
+
+        if( offset == 0 || offset > (uint32_t)( out - output ) ||
+            (uint32_t)( out_end - out ) < match )
+            return -1;
+
+        // a match may overlap its own output, so copy at most offset bytes
+        // at a time. Short offsets are runs & go byte by byte
+        const uint8_t* ref = out - offset;
+
+        if( offset < 8 )
+        {
+            for( uint32_t i = 0; i < match; i++ ) out[i] = ref[i];
+        }
+        else
+        {
+            for( uint32_t done = 0; done < match; done += offset )
+                memcpy( out + done,
+                        ref + done,
+                        match - done < offset ? match - done : offset );
+        }
+
+        out += match;
+    }
+
+    return (int32_t)( out - output );
+}
+
+int32_t dd_frame_compress( const struct ddCodec* c_restrict codec,
+                           const uint32_t min_size,
+                           const char* c_restrict frame,
+                           const int32_t length,
+                           char* c_restrict output,
+                           const uint32_t output_size )
+{
+    const uint8_t kind_byte = (uint8_t)frame[0];
+
+    // unframed text has no header to flag
+    if( !codec || length < (int32_t)min_size ||
+        length <= DD_COMPRESS_HEADER_SIZE + 1 ||
+        ( kind_byte & ~DDFRAME_KIND_MASK ) != DDFRAME_MARK ||
+        output_size <= DD_COMPRESS_HEADER_SIZE )
+        return 0;
+
+    const uint32_t payload = (uint32_t)length - DDFRAME_HEADER_SIZE;
+
+    // only worth it if the result is smaller than the frame
+    uint32_t budget = (uint32_t)length - 1 - DD_COMPRESS_HEADER_SIZE;
+    if( budget > output_size - DD_COMPRESS_HEADER_SIZE )
+        budget = output_size - DD_COMPRESS_HEADER_SIZE;
+
+    const int32_t packed = codec->compress(
+        (const uint8_t*)frame + DDFRAME_HEADER_SIZE,
+        payload,
+        (uint8_t*)output + DD_COMPRESS_HEADER_SIZE,
+        budget );
+
+    if( packed <= 0 ) return 0;
+
+    uint8_t* header = (uint8_t*)output;
+
+    header[0] = kind_byte | DDFRAME_COMPRESSED;
+    header[DDFRAME_HEADER_SIZE] = codec->id;
+    dd_write_u16_le( header + DDFRAME_HEADER_SIZE + 1, (uint16_t)payload );
+
+    return DD_COMPRESS_HEADER_SIZE + packed;
+}
+
+int32_t dd_frame_decompress( const char* c_restrict data,
+                             const int32_t length,
+                             char* c_restrict output,
+                             const uint32_t output_size )
+{
+    if( !dd_frame_compressed( data, length ) ) return -1;
+
+    const uint8_t* in = (const uint8_t*)data;
+    const struct ddCodec* codec = s_codecs[in[DDFRAME_HEADER_SIZE]];
+    const uint32_t payload = dd_read_u16_le( in + DDFRAME_HEADER_SIZE + 1 );
+
+    if( !codec || DDFRAME_HEADER_SIZE + payload > output_size ) return -1;
+
+    const int32_t unpacked = codec->decompress(
+        in + DD_COMPRESS_HEADER_SIZE,
+        (uint32_t)length - DD_COMPRESS_HEADER_SIZE,
+        (uint8_t*)output + DDFRAME_HEADER_SIZE,
+        payload );
+
+    if( unpacked != (int32_t)payload ) return -1;
+
+    output[0] = (char)( in[0] & ~DDFRAME_COMPRESSED );
+
+    return (int32_t)( DDFRAME_HEADER_SIZE + payload );
+}
+
+const char* dd_compress_stage( const struct ddAddressInfo* c_restrict sender,
+                               const char* c_restrict frame,
+                               int32_t* c_restrict length,
+                               char* c_restrict scratch,
+                               const uint32_t scratch_size )
+{
+    const int32_t packed = dd_frame_compress( sender->codec,
+                                              sender->compress_min,
+                                              frame,
+                                              *length,
+                                              scratch,
+                                              scratch_size );
+
+    if( packed <= 0 ) return frame;
+
+    *length = packed;
+    return scratch;
+}
+
+bool dd_decompress_in_place( struct ddRecvMsg* c_restrict msg )
+{
+    if( !dd_frame_compressed( msg->msg, msg->bytes_read ) ) return true;
+
+    char packed[MAX_MSG_LENGTH];
+    memcpy( packed, msg->msg, (size_t)msg->bytes_read );
+
+    // same room the socket read had, so the terminator still fits
+    const int32_t length = dd_frame_decompress(
+        packed, msg->bytes_read, msg->msg, MAX_MSG_LENGTH - 1 );
+
+    if( length == -1 )
+    {
+        console_write( LOG_WARN, "Undecodable compressed frame dropped\n" );
+        msg->bytes_read = 0;
+        msg->msg[0] = '\0';
+        return false;
+    }
+
+    msg->bytes_read = length;
+    msg->msg[length] = '\0';
+
+    return true;
+}
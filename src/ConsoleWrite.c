@@ -1,4 +1,5 @@
 #include "ConsoleWrite.h"
+#include "TimeInterface.h"
 
 #include <stdio.h>
 #include <stdarg.h>
@@ -215,6 +216,11 @@ void console_collect_stdin()
     bool update_line = false;
     uint32_t clear_line = 0;
 
+#if DD_PLATFORM == DD_LINUX
+    // async writer redraws the prompt from s_buffered_str
+    flockfile( stdout );
+#endif  // DD_PLATFORM == DD_LINUX
+
     while( ( ch = console_getchar() ) != EOF )
     {
         update_line = true;
@@ -353,6 +359,10 @@ void console_collect_stdin()
         fputs( "\e[?25l", stdout );  // hide cursor
 #endif
     }
+
+#if DD_PLATFORM == DD_LINUX
+    funlockfile( stdout );
+#endif  // DD_PLATFORM == DD_LINUX
 }
 
 void console_set_output_log( const char* c_restrict file_location )
@@ -371,9 +381,7 @@ void console_set_output_log( const char* c_restrict file_location )
     console_write( LOG_ERROR, "Invalid log file provided. Setting to stdout" );
 }
 
-void console_write( const uint32_t log_type,
-                    const char* c_restrict fmt_str,
-                    ... )
+static void init_output()
 {
     if( !s_log_set )
     {
@@ -391,21 +399,21 @@ void console_write( const uint32_t log_type,
 
         if( !s_buffered_str ) s_buffered_str = s_buffered_history;
     }
+}
 
+static void write_header( const uint32_t log_type )
+{
     set_output_color( 0, false );
 
     fprintf( s_logfile, "\r[%10s] ", console_header[log_type] );
     set_output_color( (uint8_t)log_type, false );
+}
 
-    va_list args;
-
-    va_start( args, fmt_str );
-    vfprintf( s_logfile, fmt_str, args );
-    va_end( args );
-
+static void write_prompt( const bool flush )
+{
     set_output_color( 4, false );
     fputs( "\rlocal_machine", stdout );
-    set_output_color( 0, true );
+    set_output_color( 0, flush );
     fprintf( stdout, ":$ %s", s_buffered_str );
 
 #if DD_PLATFORM == DD_LINUX
@@ -413,6 +421,614 @@ void console_write( const uint32_t log_type,
 #endif
 }
 
+#if DD_PLATFORM == DD_LINUX
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+#define LOG_MAX_ARGS 8
+#define LOG_STR_BYTES 192
+#define LOG_CUT_MARK "...\n"  // ends a preformatted line that didn't fit
+
+enum
+{
+    LOG_ARG_INT,
+    LOG_ARG_UINT,
+    LOG_ARG_DBL,
+    LOG_ARG_PTR,
+    LOG_ARG_STR,
+    LOG_ARG_BAD,  // unsupported spec, record is formatted up front
+};
+
+struct log_spec
+{
+    const char* start;  // '%'
+    uint32_t flags_len;  // flags, width & precision after '%'
+    char length[2];
+    char conv;
+    uint8_t type;
+};
+
+union log_arg
+{
+    long long i;
+    unsigned long long u;
+    double f;
+    const void* p;
+    uint32_t str;  // offset into log_record.strs
+};
+
+struct log_record
+{
+    _Atomic size_t seq;
+    uint32_t level;
+    uint32_t str_used;
+    uint64_t time;  // capture time, output may lag behind it
+    const char* fmt;  // NULL when strs holds the preformatted line
+    union log_arg args[LOG_MAX_ARGS];
+    char strs[LOG_STR_BYTES];
+};
+
+static struct
+{
+    struct log_record* ring;
+    size_t mask;
+
+    _Alignas( 64 ) _Atomic size_t enqueue_pos;
+    _Alignas( 64 ) atomic_uint_fast64_t dropped;
+    _Alignas( 64 ) size_t dequeue_pos;  // writer thread only
+    uint64_t dropped_reported;
+    uint64_t start;  // record times print relative to it
+
+    atomic_bool sleeping;
+    atomic_bool stopping;
+    atomic_bool running;
+    atomic_uint writers;  // console_write calls inside push_record
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_t thread;
+} s_async = {.lock = PTHREAD_MUTEX_INITIALIZER,
+             .wake = PTHREAD_COND_INITIALIZER};
+
+// parses the spec following a '%'. Returns the char after the conversion
+static const char* parse_spec( const char* p, struct log_spec* spec )
+{
+    spec->start = p - 1;
+    spec->length[0] = spec->length[1] = '\0';
+
+    const char* flags = p;
+    while( *p && strchr( "-+ #0123456789.", *p ) ) p++;
+
+    spec->flags_len = (uint32_t)( p - flags );
+
+    if( *p == '*' )
+    {
+        spec->type = LOG_ARG_BAD;
+        return p + 1;
+    }
+
+    if( *p && strchr( "hljztL", *p ) )
+    {
+        spec->length[0] = *p++;
+        if( ( *p == 'h' || *p == 'l' ) && *p == spec->length[0] )
+            spec->length[1] = *p++;
+    }
+
+    spec->conv = *p;
+
+    switch( spec->conv )
+    {
+        case 'd':
+        case 'i':
+            spec->type = LOG_ARG_INT;
+            break;
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+        case 'c':
+            spec->type = LOG_ARG_UINT;
+            break;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            spec->type = LOG_ARG_DBL;
+            break;
+        case 'p':
+            spec->type = LOG_ARG_PTR;
+            break;
+        case 's':
+            spec->type = spec->length[0] ? LOG_ARG_BAD : LOG_ARG_STR;
+            break;
+        default:
+            spec->type = LOG_ARG_BAD;
+            break;
+    }
+
+    return *p ? p + 1 : p;
+}
+
+static long long pull_int( const struct log_spec* spec, va_list* args )
+{
+    switch( spec->length[0] )
+    {
+        case 'l':
+            return spec->length[1] ? va_arg( *args, long long )
+                                   : va_arg( *args, long );
+        case 'j':
+            return va_arg( *args, intmax_t );
+        case 'z':
+            return va_arg( *args, ssize_t );
+        case 't':
+            return va_arg( *args, ptrdiff_t );
+        default:
+            return va_arg( *args, int );  // char & short are promoted
+    }
+}
+
+static unsigned long long pull_uint( const struct log_spec* spec,
+                                     va_list* args )
+{
+    switch( spec->length[0] )
+    {
+        case 'l':
+            return spec->length[1] ? va_arg( *args, unsigned long long )
+                                   : va_arg( *args, unsigned long );
+        case 'j':
+            return va_arg( *args, uintmax_t );
+        case 'z':
+            return va_arg( *args, size_t );
+        case 't':
+            return (unsigned long long)va_arg( *args, ptrdiff_t );
+        default:
+            return va_arg( *args, unsigned int );
+    }
+}
+
+// false when the format can't be captured as raw args, or its strings don't
+// all fit in strs
+static bool capture_args( struct log_record* c_restrict rec,
+                          const char* c_restrict fmt_str,
+                          va_list* args )
+{
+    uint32_t count = 0;
+
+    for( const char* p = fmt_str; *p; )
+    {
+        if( *p++ != '%' ) continue;
+        if( *p == '%' )
+        {
+            p++;
+            continue;
+        }
+
+        struct log_spec spec;
+        p = parse_spec( p, &spec );
+
+        if( spec.type == LOG_ARG_BAD || count == LOG_MAX_ARGS ) return false;
+
+        union log_arg* arg = &rec->args[count++];
+
+        switch( spec.type )
+        {
+            case LOG_ARG_INT:
+                arg->i = pull_int( &spec, args );
+                break;
+            case LOG_ARG_UINT:
+                arg->u = pull_uint( &spec, args );
+                break;
+            case LOG_ARG_DBL:
+                arg->f = spec.length[0] == 'L'
+                             ? (double)va_arg( *args, long double )
+                             : va_arg( *args, double );
+                break;
+            case LOG_ARG_PTR:
+                arg->p = va_arg( *args, void* );
+                break;
+            case LOG_ARG_STR:
+            {
+                const char* str = va_arg( *args, const char* );
+                if( !str ) str = "(null)";
+
+                const uint32_t space = LOG_STR_BYTES - rec->str_used;
+                const size_t len = strnlen( str, space );
+
+                // preformatted instead, where a cut line is marked
+                if( len == space ) return false;
+
+                arg->str = rec->str_used;
+                memcpy( rec->strs + rec->str_used, str, len + 1 );
+                rec->str_used += (uint32_t)len + 1;
+                break;
+            }
+        }
+    }
+
+    return true;
+}
+
+static void format_record( const struct log_record* c_restrict rec,
+                           char* c_restrict out,
+                           const size_t out_size )
+{
+    size_t used = 0;
+    uint32_t count = 0;
+    const char* p = rec->fmt;
+
+    while( *p && used + 1 < out_size )
+    {
+        if( *p != '%' )
+        {
+            out[used++] = *p++;
+            continue;
+        }
+
+        if( p[1] == '%' )
+        {
+            out[used++] = '%';
+            p += 2;
+            continue;
+        }
+
+        struct log_spec spec;
+        p = parse_spec( p + 1, &spec );
+
+        const union log_arg* arg = &rec->args[count++];
+
+        // rebuild the spec w/ the length modifier of the stored type
+        char sub_fmt[32];
+        const int flags_len = (int)spec.flags_len;
+        const char* mod = spec.type == LOG_ARG_INT ||
+                                  ( spec.type == LOG_ARG_UINT &&
+                                    spec.conv != 'c' )
+                              ? "ll"
+                              : "";
+
+        snprintf( sub_fmt,
+                  sizeof( sub_fmt ),
+                  "%%%.*s%s%c",
+                  flags_len,
+                  spec.start + 1,
+                  mod,
+                  spec.conv );
+
+        const size_t space = out_size - used;
+        int written = 0;
+
+        switch( spec.type )
+        {
+            case LOG_ARG_INT:
+                written = snprintf( out + used, space, sub_fmt, arg->i );
+                break;
+            case LOG_ARG_UINT:
+                written = spec.conv == 'c'
+                              ? snprintf( out + used, space, sub_fmt,
+                                          (int)arg->u )
+                              : snprintf( out + used, space, sub_fmt, arg->u );
+                break;
+            case LOG_ARG_DBL:
+                written = snprintf( out + used, space, sub_fmt, arg->f );
+                break;
+            case LOG_ARG_PTR:
+                written = snprintf( out + used, space, sub_fmt, arg->p );
+                break;
+            case LOG_ARG_STR:
+                written = snprintf(
+                    out + used, space, sub_fmt, rec->strs + arg->str );
+                break;
+        }
+
+        if( written < 0 ) break;
+
+        used += (size_t)written < space ? (size_t)written : space - 1;
+    }
+
+    out[used] = '\0';
+}
+
+static void write_record( const struct log_record* c_restrict rec )
+{
+    char line[IN_BUFF_SIZE * 2];
+
+    if( rec->fmt )
+        format_record( rec, line, sizeof( line ) );
+    else
+        snprintf( line, sizeof( line ), "%s", rec->strs );
+
+    write_header( rec->level );
+    fprintf( s_logfile,
+             "%.6f ",
+             nano_to_seconds( rec->time - s_async.start ) );
+    fputs( line, s_logfile );
+}
+
+static bool drain_ring()
+{
+    bool wrote = false;
+
+    while( true )
+    {
+        struct log_record* rec =
+            &s_async.ring[s_async.dequeue_pos & s_async.mask];
+
+        const size_t seq =
+            atomic_load_explicit( &rec->seq, memory_order_acquire );
+
+        if( seq != s_async.dequeue_pos + 1 ) break;
+
+        if( !wrote ) flockfile( stdout );
+        wrote = true;
+
+        write_record( rec );
+
+        // hand the cell back to producers one lap ahead
+        atomic_store_explicit( &rec->seq,
+                               s_async.dequeue_pos + s_async.mask + 1,
+                               memory_order_release );
+        s_async.dequeue_pos++;
+    }
+
+    if( wrote )
+    {
+        const uint64_t dropped = atomic_load_explicit( &s_async.dropped,
+                                                       memory_order_relaxed );
+
+        if( dropped != s_async.dropped_reported )
+        {
+            write_header( LOG_WARN );
+            fprintf( s_logfile,
+                     "%llu log records dropped\n",
+                     (unsigned long long)( dropped -
+                                           s_async.dropped_reported ) );
+            s_async.dropped_reported = dropped;
+        }
+
+        // one prompt redraw & flush per drained batch
+        write_prompt( true );
+        fflush( stdout );
+        if( s_logfile != stdout ) fflush( s_logfile );
+        funlockfile( stdout );
+    }
+
+    return wrote;
+}
+
+static bool ring_empty()
+{
+    const struct log_record* rec =
+        &s_async.ring[s_async.dequeue_pos & s_async.mask];
+
+    return atomic_load_explicit( &rec->seq, memory_order_acquire ) !=
+           s_async.dequeue_pos + 1;
+}
+
+static void* writer_thread( void* arg )
+{
+    UNUSED_VAR( arg );
+
+    while( true )
+    {
+        if( drain_ring() ) continue;
+
+        if( atomic_load( &s_async.stopping ) ) break;
+
+        pthread_mutex_lock( &s_async.lock );
+
+        // pairs w/ the fence in push_record so a wakeup can't be missed
+        atomic_store( &s_async.sleeping, true );
+
+        while( ring_empty() && !atomic_load( &s_async.stopping ) )
+        {
+            pthread_cond_wait( &s_async.wake, &s_async.lock );
+            atomic_store( &s_async.sleeping, true );
+        }
+
+        atomic_store( &s_async.sleeping, false );
+        pthread_mutex_unlock( &s_async.lock );
+    }
+
+    return NULL;
+}
+
+static void push_record( const uint32_t log_type,
+                         const char* c_restrict fmt_str,
+                         va_list* args )
+{
+    size_t pos =
+        atomic_load_explicit( &s_async.enqueue_pos, memory_order_relaxed );
+    struct log_record* rec;
+
+    // bounded MPSC queue, each cell's seq says whose turn it is
+    while( true )
+    {
+        rec = &s_async.ring[pos & s_async.mask];
+
+        const size_t seq =
+            atomic_load_explicit( &rec->seq, memory_order_acquire );
+        const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+        if( diff == 0 )
+        {
+            if( atomic_compare_exchange_weak_explicit( &s_async.enqueue_pos,
+                                                       &pos,
+                                                       pos + 1,
+                                                       memory_order_relaxed,
+                                                       memory_order_relaxed ) )
+                break;
+        }
+        else if( diff < 0 )
+        {
+            // full: drop rather than stall the caller on the terminal
+            atomic_fetch_add_explicit(
+                &s_async.dropped, 1, memory_order_relaxed );
+            return;
+        }
+        else
+            pos = atomic_load_explicit( &s_async.enqueue_pos,
+                                        memory_order_relaxed );
+    }
+
+    rec->level = log_type;
+    rec->time = get_high_res_time();
+    rec->fmt = fmt_str;
+    rec->str_used = 0;
+
+    va_list capture;
+    va_copy( capture, *args );
+
+    if( !capture_args( rec, fmt_str, &capture ) )
+    {
+        rec->fmt = NULL;
+
+        const int length =
+            vsnprintf( rec->strs, sizeof( rec->strs ), fmt_str, *args );
+
+        if( length >= (int)sizeof( rec->strs ) )
+            memcpy( rec->strs + sizeof( rec->strs ) - sizeof( LOG_CUT_MARK ),
+                    LOG_CUT_MARK,
+                    sizeof( LOG_CUT_MARK ) );
+    }
+
+    va_end( capture );
+
+    atomic_store_explicit( &rec->seq, pos + 1, memory_order_release );
+
+    atomic_thread_fence( memory_order_seq_cst );
+
+    // only the first record after the writer sleeps pays for the signal
+    if( atomic_load_explicit( &s_async.sleeping, memory_order_relaxed ) &&
+        atomic_exchange( &s_async.sleeping, false ) )
+    {
+        pthread_mutex_lock( &s_async.lock );
+        pthread_cond_signal( &s_async.wake );
+        pthread_mutex_unlock( &s_async.lock );
+    }
+}
+
+bool console_async_start()
+{
+    if( atomic_load( &s_async.running ) ) return true;
+
+    init_output();
+
+    s_async.ring = calloc( DD_LOG_RING_SIZE, sizeof( struct log_record ) );
+
+    if( !s_async.ring )
+    {
+        console_write( LOG_ERROR, "Async log ring allocation failed\n" );
+        return false;
+    }
+
+    s_async.mask = DD_LOG_RING_SIZE - 1;
+    s_async.dequeue_pos = 0;
+    s_async.dropped_reported = atomic_load( &s_async.dropped );
+    s_async.start = get_high_res_time();
+    atomic_store( &s_async.enqueue_pos, 0 );
+    atomic_store( &s_async.stopping, false );
+    atomic_store( &s_async.sleeping, false );
+
+    for( size_t i = 0; i < DD_LOG_RING_SIZE; i++ )
+        atomic_init( &s_async.ring[i].seq, i );
+
+    if( pthread_create( &s_async.thread, NULL, writer_thread, NULL ) != 0 )
+    {
+        free( s_async.ring );
+        s_async.ring = NULL;
+        console_write( LOG_ERROR, "Async log thread not created\n" );
+        return false;
+    }
+
+    atomic_store( &s_async.running, true );
+    return true;
+}
+
+void console_async_stop()
+{
+    if( !atomic_load( &s_async.running ) ) return;
+
+    // later writes go straight to the terminal again
+    atomic_store( &s_async.running, false );
+
+    // calls that saw running before the store may still be filling cells
+    while( atomic_load( &s_async.writers ) ) sched_yield();
+
+    pthread_mutex_lock( &s_async.lock );
+    atomic_store( &s_async.stopping, true );
+    pthread_cond_signal( &s_async.wake );
+    pthread_mutex_unlock( &s_async.lock );
+
+    pthread_join( s_async.thread, NULL );
+
+    // the writer drains before it exits, this thread owns the ring now
+    drain_ring();
+
+    free( s_async.ring );
+    s_async.ring = NULL;
+}
+
+uint64_t console_async_dropped()
+{
+    return atomic_load_explicit( &s_async.dropped, memory_order_relaxed );
+}
+
+#else
+
+bool console_async_start() { return false; }
+
+void console_async_stop() {}
+
+uint64_t console_async_dropped() { return 0; }
+
+#endif  // DD_PLATFORM == DD_LINUX
+
+void console_write( const uint32_t log_type,
+                    const char* c_restrict fmt_str,
+                    ... )
+{
+    va_list args;
+    va_start( args, fmt_str );
+
+#if DD_PLATFORM == DD_LINUX
+    if( atomic_load_explicit( &s_async.running, memory_order_relaxed ) )
+    {
+        // seq_cst against console_async_stop: either it waits for this
+        // call or the call sees running cleared & writes directly
+        atomic_fetch_add( &s_async.writers, 1 );
+
+        if( atomic_load( &s_async.running ) )
+        {
+            push_record( log_type, fmt_str, &args );
+            atomic_fetch_sub( &s_async.writers, 1 );
+            va_end( args );
+            return;
+        }
+
+        atomic_fetch_sub( &s_async.writers, 1 );
+    }
+
+    flockfile( stdout );
+#endif  // DD_PLATFORM == DD_LINUX
+
+    init_output();
+
+    write_header( log_type );
+    vfprintf( s_logfile, fmt_str, args );
+    va_end( args );
+
+    write_prompt( true );
+
+#if DD_PLATFORM == DD_LINUX
+    funlockfile( stdout );
+#endif  // DD_PLATFORM == DD_LINUX
+}
+
 void query_input( char* copy_to_buffer, const uint32_t copy_to_buffer_size )
 {
     assert( copy_to_buffer && copy_to_buffer_size > 1 );
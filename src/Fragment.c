@@ -0,0 +1,455 @@
+#ifdef __linux__
+#define _GNU_SOURCE  // sendmmsg
+#endif
+
+#include "Fragment.h"
+#include "ConsoleWrite.h"
+#include "WireFormat.h"
+#include "StatsSegment.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+// ids only need to differ between messages in flight to the same peer
+static atomic_uint s_next_msg_id;
+
+static struct ddFragSlot* slot_of( struct ddFragMessage* c_restrict message )
+{
+    return (struct ddFragSlot*)message;  // message is the first member
+}
+
+static bool same_sender( const struct ddFragMessage* c_restrict message,
+                         const struct ddRecvMsg* c_restrict msg )
+{
+    // both filled in by recvfrom, so unused address bytes match too
+    return message->addr_len == msg->addr_len &&
+           memcmp( &message->sender, &msg->sender, msg->addr_len ) == 0;
+}
+
+static void put_slot( struct ddReassembler* c_restrict reasm,
+                      struct ddFragSlot* c_restrict slot )
+{
+    if( !slot->complete ) reasm->assembling--;
+
+    slot->in_use = false;
+    slot->complete = false;
+    slot->next_free = reasm->free_list;
+    reasm->free_list = slot;
+}
+
+bool dd_frag_init( struct ddReassembler* c_restrict reasm )
+{
+    memset( reasm, 0, sizeof( *reasm ) );
+
+    reasm->slots = calloc( DD_FRAG_SLOTS, sizeof( struct ddFragSlot ) );
+    reasm->buffers =
+        malloc( (size_t)DD_FRAG_SLOTS * ( DD_FRAG_MAX_MESSAGE + 1 ) );
+
+    if( !reasm->slots || !reasm->buffers )
+    {
+        console_write( LOG_ERROR, "Reassembly buffer allocation failed\n" );
+        dd_frag_free( reasm );
+        return false;
+    }
+
+    for( uint32_t i = DD_FRAG_SLOTS; i-- > 0; )
+    {
+        struct ddFragSlot* slot = &reasm->slots[i];
+
+        slot->message.data =
+            reasm->buffers + (size_t)i * ( DD_FRAG_MAX_MESSAGE + 1 );
+        slot->next_free = reasm->free_list;
+        reasm->free_list = slot;
+    }
+
+    return true;
+}
+
+void dd_frag_free( struct ddReassembler* c_restrict reasm )
+{
+    free( reasm->slots );
+    free( reasm->buffers );
+
+    reasm->slots = NULL;
+    reasm->buffers = NULL;
+    reasm->free_list = NULL;
+}
+
+uint32_t dd_frag_count( const uint32_t length )
+{
+    if( length == 0 || length > DD_FRAG_MAX_MESSAGE ) return 0;
+
+    return ( length + DD_FRAG_PAYLOAD - 1 ) / DD_FRAG_PAYLOAD;
+}
+
+static void write_header( uint8_t* c_restrict out,
+                          const uint16_t msg_id,
+                          const uint32_t index,
+                          const uint32_t count )
+{
+    out[0] = (uint8_t)( DDFRAME_MARK | DDFRAME_FRAGMENT );
+    dd_write_u16_le( out + DDFRAME_HEADER_SIZE, msg_id );
+    dd_write_u16_le( out + DDFRAME_HEADER_SIZE + 2, (uint16_t)index );
+    dd_write_u16_le( out + DDFRAME_HEADER_SIZE + 4, (uint16_t)count );
+}
+
+static uint32_t fragment_bytes( const uint32_t length, const uint32_t index )
+{
+    const uint32_t offset = index * DD_FRAG_PAYLOAD;
+
+    return length - offset < DD_FRAG_PAYLOAD ? length - offset
+                                             : DD_FRAG_PAYLOAD;
+}
+
+int32_t dd_frag_encode( const char* c_restrict data,
+                        const uint32_t length,
+                        const uint16_t msg_id,
+                        const uint32_t index,
+                        char* c_restrict output,
+                        const uint32_t output_size )
+{
+    const uint32_t count = dd_frag_count( length );
+
+    if( index >= count ) return -1;
+
+    const uint32_t bytes = fragment_bytes( length, index );
+
+    if( DD_FRAG_HEADER_SIZE + bytes > output_size ) return -1;
+
+    write_header( (uint8_t*)output, msg_id, index, count );
+    memcpy( output + DD_FRAG_HEADER_SIZE,
+            data + (size_t)index * DD_FRAG_PAYLOAD,
+            bytes );
+
+    return (int32_t)( DD_FRAG_HEADER_SIZE + bytes );
+}
+
+#if DD_PLATFORM == DD_LINUX
+
+// every fragment but the last fills a whole datagram
+#define FRAG_SEGMENT ( DD_FRAG_HEADER_SIZE + DD_FRAG_PAYLOAD )
+
+// fragments copied end to end so the kernel splits them w/ UDP_SEGMENT
+static uint32_t send_segmented( const struct ddAddressInfo* c_restrict sender,
+                                const struct sockaddr* c_restrict addr,
+                                const socklen_t addr_len,
+                                const char* c_restrict data,
+                                const uint32_t length,
+                                const uint16_t msg_id,
+                                const uint32_t count )
+{
+    char run[DD_GSO_MAX_BYTES];
+
+    uint32_t per_run = DD_GSO_MAX_BYTES / FRAG_SEGMENT;
+    if( per_run > DD_GSO_MAX_SEGMENTS ) per_run = DD_GSO_MAX_SEGMENTS;
+
+    uint32_t sent_count = 0;
+
+    for( uint32_t first = 0; first < count; first += per_run )
+    {
+        const uint32_t last = count - first < per_run ? count : first + per_run;
+        uint32_t used = 0;
+
+        for( uint32_t i = first; i < last; i++ )
+            used += (uint32_t)dd_frag_encode(
+                data, length, msg_id, i, run + used, sizeof( run ) - used );
+
+        const uint32_t sent = dd_server_send_segments(
+            sender, run, used, FRAG_SEGMENT, addr, addr_len );
+
+        sent_count += sent;
+
+        // the rest of the message is useless to the receiver
+        if( sent < last - first ) break;
+    }
+
+    return sent_count;
+}
+
+#endif  // DD_PLATFORM
+
+uint32_t dd_frag_send_to( const struct ddAddressInfo* c_restrict sender,
+                          const struct sockaddr* c_restrict addr,
+                          const socklen_t addr_len,
+                          const char* c_restrict data,
+                          const uint32_t length )
+{
+    const uint32_t count = dd_frag_count( length );
+
+    if( count == 0 )
+    {
+        console_write( LOG_ERROR,
+                       "Fragmented message of %u bytes exceeds %u\n",
+                       length,
+                       (uint32_t)DD_FRAG_MAX_MESSAGE );
+        return 0;
+    }
+
+    const uint16_t msg_id = (uint16_t)atomic_fetch_add_explicit(
+        &s_next_msg_id, 1, memory_order_relaxed );
+
+    uint32_t sent_count = 0;
+
+#if DD_PLATFORM == DD_LINUX
+    if( sender->gso )
+        return send_segmented(
+            sender, addr, addr_len, data, length, msg_id, count );
+
+    // header & payload gathered by the kernel, the payload isn't copied
+    uint8_t headers[MAX_SEND_BATCH][DD_FRAG_HEADER_SIZE];
+    struct iovec iovecs[MAX_SEND_BATCH][2];
+    struct mmsghdr msgs[MAX_SEND_BATCH];
+
+    uint32_t next = 0;
+    while( next < count )
+    {
+        uint32_t batch_size = 0;
+        for( ; next < count && batch_size < MAX_SEND_BATCH; next++ )
+        {
+            write_header( headers[batch_size], msg_id, next, count );
+
+            iovecs[batch_size][0] = ( struct iovec ){
+                .iov_base = headers[batch_size],
+                .iov_len = DD_FRAG_HEADER_SIZE};
+            iovecs[batch_size][1] = ( struct iovec ){
+                .iov_base = (void*)( data + (size_t)next * DD_FRAG_PAYLOAD ),
+                .iov_len = fragment_bytes( length, next )};
+
+            msgs[batch_size] = ( struct mmsghdr ){
+                .msg_hdr = {
+                    .msg_name = (void*)addr,
+                    .msg_namelen = addr_len,
+                    .msg_iov = iovecs[batch_size],
+                    .msg_iovlen = 2,
+                }};
+            batch_size++;
+        }
+
+        uint32_t done = 0;
+        while( done < batch_size )
+        {
+            const int32_t rc = sendmmsg(
+                sender->socket_fd, msgs + done, batch_size - done, 0 );
+
+            if( rc == -1 )
+            {
+                if( errno == EINTR ) continue;
+
+                // the rest of the message is useless to the receiver
+                console_write( LOG_ERROR, "sendmmsg Failure\n" );
+                dd_stats_add( DDSTAT_SEND_ERRORS, 1 );
+                return sent_count;
+            }
+
+            dd_stats_add( DDSTAT_PACKETS_OUT, (uint64_t)rc );
+
+            for( int32_t i = 0; dd_stats_enabled() && i < rc; i++ )
+                dd_stats_add( DDSTAT_BYTES_OUT, msgs[done + i].msg_len );
+
+            done += (uint32_t)rc;
+            sent_count += (uint32_t)rc;
+        }
+    }
+#else
+    char output[MAX_MSG_LENGTH];
+
+    for( uint32_t i = 0; i < count; i++ )
+    {
+        const int32_t bytes = dd_frag_encode(
+            data, length, msg_id, i, output, sizeof( output ) );
+
+        if( sendto( sender->socket_fd,
+                    output,
+                    bytes,
+                    0,
+                    addr,
+                    (int)addr_len ) == -1 )
+        {
+            console_write( LOG_ERROR, "sendto Failure\n" );
+            dd_stats_add( DDSTAT_SEND_ERRORS, 1 );
+            return sent_count;
+        }
+
+        dd_stats_add( DDSTAT_PACKETS_OUT, 1 );
+        dd_stats_add( DDSTAT_BYTES_OUT, (uint64_t)bytes );
+        sent_count++;
+    }
+#endif  // DD_PLATFORM
+
+    return sent_count;
+}
+
+// the message being assembled from this sender under msg_id, if any
+static struct ddFragSlot* find_slot( struct ddReassembler* c_restrict reasm,
+                                     const struct ddRecvMsg* c_restrict msg,
+                                     const uint16_t msg_id )
+{
+    // few slots, so a scan beats keeping an index in sync
+    for( uint32_t i = 0; i < DD_FRAG_SLOTS; i++ )
+    {
+        struct ddFragSlot* slot = &reasm->slots[i];
+
+        if( slot->in_use && !slot->complete && slot->msg_id == msg_id &&
+            same_sender( &slot->message, msg ) )
+            return slot;
+    }
+
+    return NULL;
+}
+
+static struct ddFragSlot* claim_slot( struct ddReassembler* c_restrict reasm,
+                                      const struct ddRecvMsg* c_restrict msg,
+                                      const uint16_t msg_id,
+                                      const uint16_t count,
+                                      const uint64_t now )
+{
+    // cap what a single peer can pin, its oldest message makes way
+    struct ddFragSlot* oldest = NULL;
+    uint32_t held = 0;
+
+    for( uint32_t i = 0; i < DD_FRAG_SLOTS; i++ )
+    {
+        struct ddFragSlot* slot = &reasm->slots[i];
+
+        if( !slot->in_use || slot->complete ||
+            !same_sender( &slot->message, msg ) )
+            continue;
+
+        held++;
+        if( !oldest || slot->last_seen < oldest->last_seen ) oldest = slot;
+    }
+
+    if( held >= DD_FRAG_PEER_SLOTS )
+    {
+        put_slot( reasm, oldest );
+        reasm->stats.evicted++;
+    }
+
+    struct ddFragSlot* slot = reasm->free_list;
+
+    if( !slot ) return NULL;
+
+    reasm->free_list = slot->next_free;
+    reasm->assembling++;
+
+    slot->in_use = true;
+    slot->complete = false;
+    slot->msg_id = msg_id;
+    slot->count = count;
+    slot->received = 0;
+    slot->last_seen = now;
+    memset( slot->bits, 0, sizeof( slot->bits ) );
+
+    slot->message.length = 0;
+    slot->message.addr_len = msg->addr_len;
+    memcpy( &slot->message.sender, &msg->sender, msg->addr_len );
+
+    return slot;
+}
+
+bool dd_frag_recv( struct ddReassembler* c_restrict reasm,
+                   const struct ddRecvMsg* c_restrict msg,
+                   const uint64_t now,
+                   struct ddFragMessage** c_restrict out )
+{
+    *out = NULL;
+
+    const uint8_t* in = (const uint8_t*)msg->msg;
+
+    if( msg->bytes_read < 1 || in[0] != ( DDFRAME_MARK | DDFRAME_FRAGMENT ) )
+        return false;
+
+    if( msg->bytes_read <= DD_FRAG_HEADER_SIZE )
+    {
+        reasm->stats.dropped++;
+        return true;
+    }
+
+    const uint32_t payload =
+        (uint32_t)msg->bytes_read - DD_FRAG_HEADER_SIZE;
+
+    const uint16_t msg_id = dd_read_u16_le( in + DDFRAME_HEADER_SIZE );
+    const uint16_t index = dd_read_u16_le( in + DDFRAME_HEADER_SIZE + 2 );
+    const uint16_t count = dd_read_u16_le( in + DDFRAME_HEADER_SIZE + 4 );
+
+    // every fragment but the last fills a whole payload
+    const bool last = index + 1 == count;
+
+    if( count > DD_FRAG_MAX_COUNT || index >= count ||
+        ( !last && payload != DD_FRAG_PAYLOAD ) ||
+        index * DD_FRAG_PAYLOAD + payload > DD_FRAG_MAX_MESSAGE )
+    {
+        reasm->stats.dropped++;
+        return true;
+    }
+
+    struct ddFragSlot* slot = find_slot( reasm, msg, msg_id );
+
+    if( !slot ) slot = claim_slot( reasm, msg, msg_id, count, now );
+
+    if( !slot || slot->count != count )
+    {
+        reasm->stats.dropped++;
+        return true;
+    }
+
+    uint64_t* word = &slot->bits[index / 64];
+    const uint64_t bit = 1ULL << ( index % 64 );
+
+    if( *word & bit )
+    {
+        reasm->stats.duplicates++;
+        return true;
+    }
+
+    *word |= bit;
+    slot->received++;
+    slot->last_seen = now;
+
+    memcpy( slot->message.data + (size_t)index * DD_FRAG_PAYLOAD,
+            msg->msg + DD_FRAG_HEADER_SIZE,
+            payload );
+
+    if( last ) slot->message.length = index * DD_FRAG_PAYLOAD + payload;
+
+    if( slot->received == slot->count )
+    {
+        slot->complete = true;
+        slot->message.data[slot->message.length] = '\0';
+
+        reasm->assembling--;
+        reasm->stats.completed++;
+
+        *out = &slot->message;
+    }
+
+    return true;
+}
+
+void dd_frag_release( struct ddReassembler* c_restrict reasm,
+                      struct ddFragMessage* c_restrict message )
+{
+    put_slot( reasm, slot_of( message ) );
+}
+
+uint32_t dd_frag_expire( struct ddReassembler* c_restrict reasm,
+                         const uint64_t now )
+{
+    uint32_t expired = 0;
+
+    for( uint32_t i = 0; i < DD_FRAG_SLOTS && reasm->assembling; i++ )
+    {
+        struct ddFragSlot* slot = &reasm->slots[i];
+
+        if( !slot->in_use || slot->complete ||
+            now < slot->last_seen + DD_FRAG_TIMEOUT )
+            continue;
+
+        put_slot( reasm, slot );
+        expired++;
+    }
+
+    reasm->stats.expired += expired;
+    return expired;
+}
@@ -0,0 +1,92 @@
+#include "Histogram.h"
+
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+
+static uint32_t highest_bit( const uint64_t bits )
+{
+    unsigned long idx;
+    _BitScanReverse64( &idx, bits );
+    return (uint32_t)idx;
+}
+#else
+static uint32_t highest_bit( const uint64_t bits )
+{
+    return 63 - (uint32_t)__builtin_clzll( bits );
+}
+#endif  // _MSC_VER
+
+static uint32_t bucket_index( const uint64_t value )
+{
+    if( value < DD_HIST_SUB_BUCKETS ) return (uint32_t)value;
+
+    const uint32_t msb = highest_bit( value );
+
+    if( msb >= DD_HIST_MAX_BITS ) return DD_HIST_BUCKETS - 1;
+
+    // octave picks the row, the bits under the msb pick the column
+    const uint32_t shift = msb - DD_HIST_SUB_BITS;
+    const uint32_t sub =
+        (uint32_t)( value >> shift ) & ( DD_HIST_SUB_BUCKETS - 1 );
+
+    return ( shift + 1 ) * DD_HIST_SUB_BUCKETS + sub;
+}
+
+static uint64_t bucket_upper( const uint32_t idx )
+{
+    if( idx < DD_HIST_SUB_BUCKETS ) return idx;
+
+    const uint32_t shift = idx / DD_HIST_SUB_BUCKETS - 1;
+    const uint64_t sub = idx % DD_HIST_SUB_BUCKETS;
+
+    return ( ( DD_HIST_SUB_BUCKETS + sub + 1 ) << shift ) - 1;
+}
+
+void dd_hist_reset( struct ddHistogram* c_restrict hist )
+{
+    memset( hist, 0, sizeof( *hist ) );
+    hist->min = UINT64_MAX;
+}
+
+void dd_hist_record( struct ddHistogram* c_restrict hist,
+                     const uint64_t value )
+{
+    hist->buckets[bucket_index( value )]++;
+    hist->count++;
+    hist->sum += value;
+
+    if( value < hist->min ) hist->min = value;
+    if( value > hist->max ) hist->max = value;
+}
+
+uint64_t dd_hist_percentile( const struct ddHistogram* c_restrict hist,
+                             const double fraction )
+{
+    if( hist->count == 0 ) return 0;
+
+    uint64_t rank = (uint64_t)( fraction * (double)hist->count );
+    if( rank == 0 ) rank = 1;
+    if( rank > hist->count ) rank = hist->count;
+
+    uint64_t seen = 0;
+
+    for( uint32_t i = 0; i < DD_HIST_BUCKETS; i++ )
+    {
+        seen += hist->buckets[i];
+
+        if( seen >= rank )
+        {
+            const uint64_t upper = bucket_upper( i );
+            return upper < hist->max ? upper : hist->max;
+        }
+    }
+
+    return hist->max;
+}
+
+double dd_hist_mean( const struct ddHistogram* c_restrict hist )
+{
+    return hist->count ? (double)hist->sum / (double)hist->count : 0.0;
+}
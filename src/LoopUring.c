@@ -0,0 +1,906 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
+
+#include "LoopUring.h"
+#include "Compress.h"
+#include "ConsoleWrite.h"
+#include "StatsSegment.h"
+#include "TimeInterface.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if DD_PLATFORM == DD_LINUX
+
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+// owner of a completion, kept in the top byte of user_data
+enum
+{
+    TAG_LISTENER = 1,
+    TAG_STDIN,
+    TAG_WAKE,
+    TAG_WATCH,   // low bits are the watch's poll_id
+    TAG_SEND,    // low bits are the send slot
+    TAG_REMOVE,  // poll removal, nothing to do
+};
+
+#define TAG_SHIFT 56
+#define USER_DATA( tag, id ) ( (uint64_t)( tag ) << TAG_SHIFT | ( id ) )
+#define USER_ID( user_data ) ( ( user_data ) & ( ( 1ULL << TAG_SHIFT ) - 1 ) )
+
+#define REQUIRED_FEATURES \
+    ( IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG )
+
+#define RECV_GROUP 0
+#define RECV_NAME_SIZE ( (uint32_t)sizeof( struct sockaddr_storage ) )
+
+// recvmsg_out header, sender address, control data & payload. Payload room
+// matches the other receive paths, which keep a byte for the terminator
+#define RECV_PAYLOAD_SIZE ( MAX_MSG_LENGTH - 1 )
+#define RECV_BUFFER_SIZE                                                 \
+    ( (uint32_t)sizeof( struct io_uring_recvmsg_out ) + RECV_NAME_SIZE + \
+      DD_RECV_CONTROL_SIZE + RECV_PAYLOAD_SIZE )
+
+// descriptors point into the slot, so only lengths change per send
+struct uring_send
+{
+    struct msghdr header;
+    struct iovec iov;
+    struct sockaddr_storage addr;
+    char data[MAX_MSG_LENGTH];
+};
+
+struct ddUring
+{
+    int32_t fd;
+
+    void* ring_map;  // sq & cq rings share one mapping
+    size_t ring_map_size;
+
+    uint32_t* sq_head;
+    uint32_t* sq_tail;
+    uint32_t sq_mask;
+    uint32_t sq_entries;
+    uint32_t sq_local_tail;  // entries written but not yet published
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+
+    uint32_t* cq_head;
+    uint32_t* cq_tail;
+    uint32_t cq_mask;
+    struct io_uring_cqe* cqes;
+
+    // provided buffers for the multishot recvmsg
+    struct io_uring_buf_ring* buf_ring;
+    size_t buf_ring_size;
+    char* recv_buffers;
+    uint16_t buf_tail;
+    struct msghdr recv_header;  // name & control sizes for each buffer
+    bool recv_multishot;        // false: poll the listener instead
+    bool listener_armed;
+
+    struct uring_send* sends;
+    uint32_t* free_sends;
+    uint32_t free_count;
+
+    uint64_t next_poll_id;
+};
+
+static int32_t uring_setup( const uint32_t entries,
+                            struct io_uring_params* c_restrict params )
+{
+    return (int32_t)syscall( __NR_io_uring_setup, entries, params );
+}
+
+static int32_t uring_enter( const int32_t fd,
+                            const uint32_t to_submit,
+                            const uint32_t min_complete,
+                            const uint32_t flags,
+                            void* arg,
+                            const size_t arg_size )
+{
+    return (int32_t)syscall( __NR_io_uring_enter,
+                             fd,
+                             to_submit,
+                             min_complete,
+                             flags,
+                             arg,
+                             arg_size );
+}
+
+static int32_t uring_register( const int32_t fd,
+                               const uint32_t opcode,
+                               void* arg,
+                               const uint32_t count )
+{
+    return (int32_t)syscall( __NR_io_uring_register, fd, opcode, arg, count );
+}
+
+bool dd_uring_supported()
+{
+    struct io_uring_params params = {0};
+    const int32_t fd = uring_setup( 4, &params );
+
+    if( fd == -1 ) return false;
+
+    const size_t probe_size =
+        sizeof( struct io_uring_probe ) +
+        IORING_OP_LAST * sizeof( struct io_uring_probe_op );
+    struct io_uring_probe* probe = calloc( 1, probe_size );
+
+    bool supported =
+        probe && ( params.features & REQUIRED_FEATURES ) == REQUIRED_FEATURES &&
+        uring_register( fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST ) == 0;
+
+    const uint8_t needed[] = {
+        IORING_OP_POLL_ADD,
+        IORING_OP_POLL_REMOVE,
+        IORING_OP_SENDMSG,
+        IORING_OP_RECVMSG,
+    };
+
+    for( uint32_t i = 0; supported && i < sizeof( needed ); i++ )
+        supported = needed[i] <= probe->last_op &&
+                    ( probe->ops[needed[i]].flags & IO_URING_OP_SUPPORTED );
+
+    free( probe );
+    close( fd );
+
+    return supported;
+}
+
+static bool map_rings( struct ddUring* c_restrict ring,
+                       const struct io_uring_params* c_restrict params )
+{
+    const size_t sq_size =
+        params->sq_off.array + params->sq_entries * sizeof( uint32_t );
+    const size_t cq_size = params->cq_off.cqes +
+                           params->cq_entries * sizeof( struct io_uring_cqe );
+
+    ring->ring_map_size = sq_size > cq_size ? sq_size : cq_size;
+    ring->ring_map = mmap( NULL,
+                           ring->ring_map_size,
+                           PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE,
+                           ring->fd,
+                           IORING_OFF_SQ_RING );
+
+    if( ring->ring_map == MAP_FAILED )
+    {
+        ring->ring_map = NULL;
+        return false;
+    }
+
+    ring->sqes_size = params->sq_entries * sizeof( struct io_uring_sqe );
+    ring->sqes = mmap( NULL,
+                       ring->sqes_size,
+                       PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE,
+                       ring->fd,
+                       IORING_OFF_SQES );
+
+    if( ring->sqes == MAP_FAILED )
+    {
+        ring->sqes = NULL;
+        return false;
+    }
+
+    char* base = ring->ring_map;
+
+    ring->sq_head = (uint32_t*)( base + params->sq_off.head );
+    ring->sq_tail = (uint32_t*)( base + params->sq_off.tail );
+    ring->sq_mask = *(uint32_t*)( base + params->sq_off.ring_mask );
+    ring->sq_entries = params->sq_entries;
+    ring->sq_local_tail = *ring->sq_tail;
+
+    ring->cq_head = (uint32_t*)( base + params->cq_off.head );
+    ring->cq_tail = (uint32_t*)( base + params->cq_off.tail );
+    ring->cq_mask = *(uint32_t*)( base + params->cq_off.ring_mask );
+    ring->cqes = (struct io_uring_cqe*)( base + params->cq_off.cqes );
+
+    // sqe slot i always sits at array index i
+    uint32_t* array = (uint32_t*)( base + params->sq_off.array );
+    for( uint32_t i = 0; i < params->sq_entries; i++ ) array[i] = i;
+
+    return true;
+}
+
+static void recycle_buffer( struct ddUring* c_restrict ring,
+                            const uint16_t bid )
+{
+    struct io_uring_buf* buf =
+        &ring->buf_ring->bufs[ring->buf_tail & ( DD_URING_RECV_BUFFERS - 1 )];
+
+    buf->addr =
+        (uintptr_t)( ring->recv_buffers + (size_t)bid * RECV_BUFFER_SIZE );
+    buf->len = RECV_BUFFER_SIZE;
+    buf->bid = bid;
+
+    ring->buf_tail++;
+    __atomic_store_n( &ring->buf_ring->tail, ring->buf_tail, __ATOMIC_RELEASE );
+}
+
+static bool setup_recv_buffers( struct ddUring* c_restrict ring )
+{
+    // the ring has to be page aligned
+    ring->buf_ring_size = DD_URING_RECV_BUFFERS * sizeof( struct io_uring_buf );
+    ring->buf_ring = mmap( NULL,
+                           ring->buf_ring_size,
+                           PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS,
+                           -1,
+                           0 );
+
+    if( ring->buf_ring == MAP_FAILED )
+    {
+        ring->buf_ring = NULL;
+        return false;
+    }
+
+    ring->recv_buffers =
+        malloc( (size_t)DD_URING_RECV_BUFFERS * RECV_BUFFER_SIZE );
+
+    if( !ring->recv_buffers ) return false;
+
+    struct io_uring_buf_reg reg = {
+        .ring_addr = (uintptr_t)ring->buf_ring,
+        .ring_entries = DD_URING_RECV_BUFFERS,
+        .bgid = RECV_GROUP,
+    };
+
+    if( uring_register( ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1 ) != 0 )
+        return false;
+
+    for( uint32_t bid = 0; bid < DD_URING_RECV_BUFFERS; bid++ )
+        recycle_buffer( ring, (uint16_t)bid );
+
+    ring->recv_header = ( struct msghdr ){
+        .msg_namelen = RECV_NAME_SIZE,
+        .msg_controllen = DD_RECV_CONTROL_SIZE,
+    };
+
+    return true;
+}
+
+// entries written since the last enter, made visible to the kernel
+static uint32_t publish_sqes( struct ddUring* c_restrict ring )
+{
+    __atomic_store_n( ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE );
+
+    return ring->sq_local_tail -
+           __atomic_load_n( ring->sq_head, __ATOMIC_ACQUIRE );
+}
+
+static bool submit( struct ddUring* c_restrict ring )
+{
+    const uint32_t pending = publish_sqes( ring );
+
+    if( pending == 0 ) return true;
+
+    int32_t rc;
+    do
+    {
+        rc = uring_enter( ring->fd, pending, 0, 0, NULL, 0 );
+    } while( rc == -1 && errno == EINTR );
+
+    return rc != -1;
+}
+
+static struct io_uring_sqe* get_sqe( struct ddUring* c_restrict ring )
+{
+    uint32_t head = __atomic_load_n( ring->sq_head, __ATOMIC_ACQUIRE );
+
+    if( ring->sq_local_tail - head >= ring->sq_entries )
+    {
+        // full, hand what's queued to the kernel to free up space
+        submit( ring );
+        head = __atomic_load_n( ring->sq_head, __ATOMIC_ACQUIRE );
+
+        if( ring->sq_local_tail - head >= ring->sq_entries ) return NULL;
+    }
+
+    struct io_uring_sqe* sqe =
+        &ring->sqes[ring->sq_local_tail & ring->sq_mask];
+
+    ring->sq_local_tail++;
+    memset( sqe, 0, sizeof( *sqe ) );
+
+    return sqe;
+}
+
+// one shot, so readiness is re-checked each time it's armed like epoll's
+// level triggering
+static bool arm_poll( struct ddUring* c_restrict ring,
+                      const ddSocket fd,
+                      const uint64_t user_data )
+{
+    struct io_uring_sqe* sqe = get_sqe( ring );
+
+    if( !sqe ) return false;
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = user_data;
+
+    return true;
+}
+
+static bool arm_listener( struct ddLoop* c_restrict loop )
+{
+    struct ddUring* ring = loop->uring;
+    const uint64_t user_data = USER_DATA( TAG_LISTENER, 0 );
+
+    if( !ring->recv_multishot )
+        ring->listener_armed =
+            arm_poll( ring, loop->listener->socket_fd, user_data );
+    else
+    {
+        struct io_uring_sqe* sqe = get_sqe( ring );
+
+        if( sqe )
+        {
+            sqe->opcode = IORING_OP_RECVMSG;
+            sqe->fd = loop->listener->socket_fd;
+            sqe->addr = (uintptr_t)&ring->recv_header;
+            sqe->len = 1;
+            sqe->ioprio = IORING_RECV_MULTISHOT;
+            sqe->flags = IOSQE_BUFFER_SELECT;
+            sqe->buf_group = RECV_GROUP;
+            sqe->user_data = user_data;
+        }
+
+        ring->listener_armed = sqe != NULL;
+    }
+
+    return ring->listener_armed;
+}
+
+// pipes, sockets & terminals only. Files & /dev/null poll ready forever
+static bool stdin_pollable()
+{
+    struct stat info;
+
+    if( fstat( STDIN_FILENO, &info ) == -1 ) return false;
+
+    return S_ISFIFO( info.st_mode ) || S_ISSOCK( info.st_mode ) ||
+           isatty( STDIN_FILENO );
+}
+
+static void close_ring( struct ddUring* c_restrict ring )
+{
+    if( ring->fd != -1 ) close( ring->fd );
+    if( ring->ring_map ) munmap( ring->ring_map, ring->ring_map_size );
+    if( ring->sqes ) munmap( ring->sqes, ring->sqes_size );
+    if( ring->buf_ring ) munmap( ring->buf_ring, ring->buf_ring_size );
+
+    free( ring->recv_buffers );
+    free( ring->sends );
+    free( ring->free_sends );
+    free( ring );
+}
+
+bool dd_uring_open( struct ddLoop* c_restrict loop )
+{
+    struct ddUring* ring = calloc( 1, sizeof( *ring ) );
+
+    if( !ring ) return false;
+
+    ring->fd = -1;
+    ring->sends = calloc( DD_URING_SEND_SLOTS, sizeof( *ring->sends ) );
+    ring->free_sends =
+        malloc( DD_URING_SEND_SLOTS * sizeof( *ring->free_sends ) );
+
+    struct io_uring_params params = {
+        .flags = IORING_SETUP_CQSIZE,
+        .cq_entries = DD_URING_ENTRIES * 4,  // room for bursts of receives
+    };
+
+    if( ring->sends && ring->free_sends )
+        ring->fd = uring_setup( DD_URING_ENTRIES, &params );
+
+    // a plain read callback reads the listener itself, so only batches
+    // take datagrams straight from the ring. GRO super-packets don't fit
+    // the provided buffers
+    ring->recv_multishot =
+        loop->batch_callback != NULL && !loop->listener->gro;
+
+    if( ring->fd == -1 ||
+        ( params.features & REQUIRED_FEATURES ) != REQUIRED_FEATURES ||
+        !map_rings( ring, &params ) ||
+        ( ring->recv_multishot && !setup_recv_buffers( ring ) ) )
+    {
+        close_ring( ring );
+        return false;
+    }
+
+    for( uint32_t i = 0; i < DD_URING_SEND_SLOTS; i++ )
+    {
+        struct uring_send* send = &ring->sends[i];
+
+        send->iov.iov_base = send->data;
+        send->header.msg_name = &send->addr;
+        send->header.msg_iov = &send->iov;
+        send->header.msg_iovlen = 1;
+
+        ring->free_sends[ring->free_count++] = DD_URING_SEND_SLOTS - 1 - i;
+    }
+
+    loop->uring = ring;
+    loop->poll_fd = ring->fd;
+
+    if( loop->batch ) loop->batch->count = 0;
+
+    arm_listener( loop );
+
+    if( loop->wake_fd != -1 )
+        arm_poll( ring, loop->wake_fd, USER_DATA( TAG_WAKE, 0 ) );
+
+    if( loop->console && stdin_pollable() )
+        arm_poll( ring, STDIN_FILENO, USER_DATA( TAG_STDIN, 0 ) );
+
+    for( uint32_t i = 0; i < loop->watches_count; i++ )
+        dd_uring_watch( loop, loop->watches[i] );
+
+    return true;
+}
+
+void dd_uring_close( struct ddLoop* c_restrict loop )
+{
+    struct ddUring* ring = loop->uring;
+
+    if( !ring ) return;
+
+    submit( ring );
+
+    // queued sends still point at their slots, give them a moment to finish
+    while( ring->free_count < DD_URING_SEND_SLOTS )
+    {
+        struct __kernel_timespec wait = {.tv_nsec = 100000000};
+        struct io_uring_getevents_arg arg = {.ts = (uintptr_t)&wait};
+
+        const int32_t rc = uring_enter( ring->fd,
+                                        0,
+                                        1,
+                                        IORING_ENTER_GETEVENTS |
+                                            IORING_ENTER_EXT_ARG,
+                                        &arg,
+                                        sizeof( arg ) );
+
+        uint32_t head = *ring->cq_head;
+        const uint32_t tail =
+            __atomic_load_n( ring->cq_tail, __ATOMIC_ACQUIRE );
+
+        for( ; head != tail; head++ )
+        {
+            const uint64_t user_data =
+                ring->cqes[head & ring->cq_mask].user_data;
+
+            if( user_data >> TAG_SHIFT == TAG_SEND )
+                ring->free_sends[ring->free_count++] =
+                    (uint32_t)USER_ID( user_data );
+        }
+
+        __atomic_store_n( ring->cq_head, head, __ATOMIC_RELEASE );
+
+        if( rc == -1 && errno != EINTR ) break;
+    }
+
+    close_ring( ring );
+
+    loop->uring = NULL;
+    loop->poll_fd = -1;
+}
+
+void dd_uring_submit( struct ddLoop* c_restrict loop )
+{
+    if( loop->uring ) submit( loop->uring );
+}
+
+bool dd_uring_watch( struct ddLoop* c_restrict loop,
+                     struct ddLoopWatch* c_restrict watch )
+{
+    struct ddUring* ring = loop->uring;
+
+    watch->poll_id = ++ring->next_poll_id;
+
+    return arm_poll(
+        ring, watch->fd, USER_DATA( TAG_WATCH, watch->poll_id ) );
+}
+
+void dd_uring_unwatch( struct ddLoop* c_restrict loop,
+                       struct ddLoopWatch* c_restrict watch )
+{
+    struct io_uring_sqe* sqe = get_sqe( loop->uring );
+
+    // a completion that raced the removal finds no watch & is dropped
+    if( !sqe ) return;
+
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = USER_DATA( TAG_WATCH, watch->poll_id );
+    sqe->user_data = USER_DATA( TAG_REMOVE, 0 );
+}
+
+static void complete_send( struct ddUring* c_restrict ring,
+                           const struct io_uring_cqe* c_restrict cqe )
+{
+    ring->free_sends[ring->free_count++] = (uint32_t)USER_ID( cqe->user_data );
+
+    if( cqe->res < 0 )
+    {
+        dd_stats_add( DDSTAT_SEND_ERRORS, 1 );
+        console_write( LOG_ERROR, "io_uring sendmsg Failure\n" );
+        return;
+    }
+
+    dd_stats_add( DDSTAT_PACKETS_OUT, 1 );
+    dd_stats_add( DDSTAT_BYTES_OUT, (uint64_t)cqe->res );
+}
+
+// frees the slots of finished sends still in the completion queue. The
+// other entries are packed against the tail in order & the head moves up
+// past the room left, so sends can't fill the queue during a dispatch
+static uint32_t reclaim_sends( struct ddUring* c_restrict ring )
+{
+    const uint32_t head = *ring->cq_head;
+    const uint32_t tail = __atomic_load_n( ring->cq_tail, __ATOMIC_ACQUIRE );
+    uint32_t kept = tail;
+    uint32_t reclaimed = 0;
+
+    for( uint32_t i = tail; i != head; i-- )
+    {
+        const struct io_uring_cqe* cqe =
+            &ring->cqes[( i - 1 ) & ring->cq_mask];
+
+        if( cqe->user_data >> TAG_SHIFT == TAG_SEND )
+        {
+            complete_send( ring, cqe );
+            reclaimed++;
+            continue;
+        }
+
+        if( --kept != i - 1 ) ring->cqes[kept & ring->cq_mask] = *cqe;
+    }
+
+    __atomic_store_n( ring->cq_head, kept, __ATOMIC_RELEASE );
+
+    return reclaimed;
+}
+
+// submits queued entries & blocks until one more completion than is already
+// waiting arrives
+static bool wait_completion( struct ddUring* c_restrict ring )
+{
+    const uint32_t waiting =
+        __atomic_load_n( ring->cq_tail, __ATOMIC_ACQUIRE ) - *ring->cq_head;
+
+    int32_t rc;
+    do
+    {
+        rc = uring_enter( ring->fd,
+                          publish_sqes( ring ),
+                          waiting + 1,
+                          IORING_ENTER_GETEVENTS,
+                          NULL,
+                          0 );
+    } while( rc == -1 && errno == EINTR );
+
+    return rc != -1;
+}
+
+bool dd_uring_send_to( struct ddLoop* c_restrict loop,
+                       const ddSocket fd,
+                       const char* c_restrict data,
+                       const int32_t length,
+                       const struct sockaddr* c_restrict addr,
+                       const socklen_t addr_len )
+{
+    struct ddUring* ring = loop->uring;
+
+    if( length < 0 || length > MAX_MSG_LENGTH ||
+        addr_len > sizeof( struct sockaddr_storage ) )
+        return false;
+
+    // every slot is in flight, wait for one so a direct send can't
+    // overtake them
+    while( ring->free_count == 0 && !reclaim_sends( ring ) )
+    {
+        if( !wait_completion( ring ) )
+        {
+            console_write( LOG_ERROR, "io_uring send slot wait error\n" );
+            return false;
+        }
+    }
+
+    struct io_uring_sqe* sqe = get_sqe( ring );
+
+    if( !sqe ) return false;
+
+    const uint32_t slot = ring->free_sends[--ring->free_count];
+    struct uring_send* send = &ring->sends[slot];
+
+    memcpy( send->data, data, (size_t)length );
+    memcpy( &send->addr, addr, addr_len );
+    send->iov.iov_len = (size_t)length;
+    send->header.msg_namelen = addr_len;
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = (uintptr_t)&send->header;
+    sqe->len = 1;
+    sqe->user_data = USER_DATA( TAG_SEND, slot );
+
+    return true;
+}
+
+static void deliver_batch( struct ddLoop* c_restrict loop )
+{
+#ifdef DD_LOOP_STATS
+    const uint64_t read_start = get_high_res_time();
+
+    dd_loop_stats_queue( loop, loop->batch );
+#endif  // DD_LOOP_STATS
+
+    loop->batch_callback( loop, loop->batch );
+    loop->batch->count = 0;
+
+#ifdef DD_LOOP_STATS
+    if( loop->stats )
+        dd_hist_record( &loop->stats->read,
+                        get_high_res_time() - read_start );
+#endif  // DD_LOOP_STATS
+}
+
+// same listener dispatch as the select & epoll backends
+static void read_listener( struct ddLoop* c_restrict loop )
+{
+#ifdef DD_LOOP_STATS
+    const uint64_t read_start = get_high_res_time();
+#endif  // DD_LOOP_STATS
+
+    if( !loop->batch_callback )
+        loop->callback( loop );
+    else
+    {
+        int32_t received;
+
+        while( ( received = dd_server_recieve_batch( loop->listener,
+                                                     loop->batch ) ) > 0 )
+        {
+#ifdef DD_LOOP_STATS
+            dd_loop_stats_queue( loop, loop->batch );
+#endif  // DD_LOOP_STATS
+
+            loop->batch_callback( loop, loop->batch );
+
+            if( !dd_recv_batch_pending( loop->batch ) || !loop->active )
+                break;
+        }
+
+        if( received == -1 ) dd_loop_break( loop );  // server read error
+
+        // handed over, so the end of dd_uring_wait doesn't deliver it again
+        loop->batch->count = 0;
+    }
+
+#ifdef DD_LOOP_STATS
+    if( loop->stats )
+        dd_hist_record( &loop->stats->read,
+                        get_high_res_time() - read_start );
+#endif  // DD_LOOP_STATS
+}
+
+static void on_recv( struct ddLoop* c_restrict loop,
+                     const struct io_uring_cqe* c_restrict cqe )
+{
+    struct ddUring* ring = loop->uring;
+
+    if( !( cqe->flags & IORING_CQE_F_MORE ) ) ring->listener_armed = false;
+
+    if( cqe->res < 0 )
+    {
+        if( cqe->res == -EINVAL )
+        {
+            // kernel w/o multishot recvmsg, read after polls instead
+            console_write( LOG_WARN, "Multishot recvmsg unsupported\n" );
+            ring->recv_multishot = false;
+        }
+        else if( cqe->res != -ENOBUFS )
+        {
+            dd_stats_add( DDSTAT_RECV_ERRORS, 1 );
+            console_write( LOG_ERROR, "io_uring recvmsg Error\n" );
+            dd_loop_break( loop );
+        }
+
+        return;
+    }
+
+    if( !( cqe->flags & IORING_CQE_F_BUFFER ) ) return;
+
+    const uint16_t bid = (uint16_t)( cqe->flags >> IORING_CQE_BUFFER_SHIFT );
+    const char* buffer = ring->recv_buffers + (size_t)bid * RECV_BUFFER_SIZE;
+
+    struct io_uring_recvmsg_out out;
+    memcpy( &out, buffer, sizeof( out ) );
+
+    const char* name = buffer + sizeof( out );
+    const char* payload =
+        name + RECV_NAME_SIZE + ring->recv_header.msg_controllen;
+
+    // payloadlen is the datagram's full size, truncated to the buffer
+    const uint32_t length = out.payloadlen < RECV_PAYLOAD_SIZE
+                                ? out.payloadlen
+                                : RECV_PAYLOAD_SIZE;
+    const uint32_t name_length =
+        out.namelen < RECV_NAME_SIZE ? out.namelen : RECV_NAME_SIZE;
+
+    dd_stats_add( DDSTAT_PACKETS_IN, 1 );
+    dd_stats_add( DDSTAT_BYTES_IN, out.payloadlen );
+
+    struct ddRecvBatch* batch = loop->batch;
+    struct ddRecvMsg* msg = &batch->msgs[batch->count];
+
+    struct msghdr control = {
+        .msg_control = (char*)name + RECV_NAME_SIZE,
+        .msg_controllen = out.controllen,
+    };
+
+    msg->arrival = dd_recv_read_control( loop->listener, &control );
+
+    memcpy( msg->msg, payload, length );
+    msg->msg[length] = '\0';
+    msg->bytes_read = (int32_t)length;
+
+    msg->sender = ( struct sockaddr_storage ){0};
+    memcpy( &msg->sender, name, name_length );
+    msg->addr_len = name_length;
+
+    recycle_buffer( ring, bid );
+
+    if( loop->listener->decompress ) dd_decompress_in_place( msg );
+
+    if( ++batch->count == batch->capacity ) deliver_batch( loop );
+}
+
+static struct ddLoopWatch* find_watch( const struct ddLoop* c_restrict loop,
+                                       const uint64_t poll_id )
+{
+    for( uint32_t i = 0; i < loop->watches_count; i++ )
+        if( loop->watches[i]->poll_id == poll_id ) return loop->watches[i];
+
+    return NULL;
+}
+
+static void dispatch( struct ddLoop* c_restrict loop,
+                      const struct io_uring_cqe* c_restrict cqe )
+{
+    struct ddUring* ring = loop->uring;
+    const uint64_t id = USER_ID( cqe->user_data );
+
+    switch( cqe->user_data >> TAG_SHIFT )
+    {
+        case TAG_LISTENER:
+            if( ring->recv_multishot && loop->batch_callback )
+                on_recv( loop, cqe );
+            else
+            {
+                ring->listener_armed = false;
+
+                if( cqe->res > 0 ) read_listener( loop );
+            }
+            break;
+        case TAG_STDIN:
+            // closed stdin would report ready forever
+            if( cqe->res > 0 && !( cqe->res & ( POLLHUP | POLLERR ) ) )
+                arm_poll( ring, STDIN_FILENO, cqe->user_data );
+            break;
+        case TAG_WAKE:
+        {
+            uint64_t count;
+            if( read( loop->wake_fd, &count, sizeof( count ) ) == -1 &&
+                errno != EAGAIN )
+                console_write( LOG_ERROR, "Loop wakeup read failed\n" );
+
+            arm_poll( ring, loop->wake_fd, cqe->user_data );
+            break;
+        }
+        case TAG_WATCH:
+        {
+            // removed watches were dropped from the list
+            struct ddLoopWatch* watch = find_watch( loop, id );
+
+            if( !watch || cqe->res < 0 ) break;
+
+            watch->callback( loop, watch );
+
+            // the callback may have removed it
+            if( find_watch( loop, id ) == watch )
+                arm_poll( ring, watch->fd, cqe->user_data );
+            break;
+        }
+        case TAG_SEND:
+            complete_send( ring, cqe );
+            break;
+        default:
+            break;
+    }
+}
+
+bool dd_uring_wait( struct ddLoop* c_restrict loop, const uint64_t timeout )
+{
+    struct ddUring* ring = loop->uring;
+
+    struct __kernel_timespec wait = {
+        .tv_sec = (int64_t)( timeout / 1000000000ULL ),
+        .tv_nsec = (long long)( timeout % 1000000000ULL ),
+    };
+    struct io_uring_getevents_arg arg = {
+        .ts = timeout == UINT64_MAX ? 0 : (uintptr_t)&wait,
+    };
+
+#ifdef DD_LOOP_STATS
+    const uint64_t wait_start = get_high_res_time();
+#endif  // DD_LOOP_STATS
+
+    // submission & waiting share one syscall
+    const int32_t rc = uring_enter( ring->fd,
+                                    publish_sqes( ring ),
+                                    1,
+                                    IORING_ENTER_GETEVENTS |
+                                        IORING_ENTER_EXT_ARG,
+                                    &arg,
+                                    sizeof( arg ) );
+
+    // timeouts, signals & full completion queues still reap below
+    if( rc == -1 && errno != ETIME && errno != EINTR && errno != EBUSY &&
+        errno != EAGAIN )
+    {
+        console_write( LOG_ERROR, "io_uring_enter error\n" );
+        return false;
+    }
+
+    loop->active_time = get_high_res_time();
+
+#ifdef DD_LOOP_STATS
+    if( loop->stats )
+        dd_hist_record( &loop->stats->wait, loop->active_time - wait_start );
+#endif  // DD_LOOP_STATS
+
+    const uint32_t tail = __atomic_load_n( ring->cq_tail, __ATOMIC_ACQUIRE );
+
+    // a send waiting on a slot reclaims entries & moves the head, reread it
+    for( uint32_t head = *ring->cq_head; (int32_t)( tail - head ) > 0;
+         head = *ring->cq_head )
+    {
+        // copied out & released first, callbacks may queue new entries
+        const struct io_uring_cqe cqe = ring->cqes[head & ring->cq_mask];
+        __atomic_store_n( ring->cq_head, head + 1, __ATOMIC_RELEASE );
+
+        dispatch( loop, &cqe );
+
+        if( !loop->active ) return true;
+    }
+
+    if( loop->batch && loop->batch->count ) deliver_batch( loop );
+
+    if( !ring->listener_armed ) arm_listener( loop );
+
+    return true;
+}
+
+#else
+
+bool dd_uring_supported()
+{
+    return false;
+}
+
+#endif  // DD_PLATFORM
@@ -0,0 +1,340 @@
+#include "PeerTable.h"
+#include "ConsoleWrite.h"
+#include "TimeInterface.h"
+#include "Compress.h"
+#include "StatsSegment.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static uint64_t mix64( uint64_t x )
+{
+    // splitmix64 finalizer
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+uint32_t dd_peers_hash_addr( const struct sockaddr* c_restrict addr )
+{
+    uint64_t key = 0;
+
+    if( addr->sa_family == AF_INET )
+    {
+        const struct sockaddr_in* v4 = (const struct sockaddr_in*)addr;
+        uint32_t ip;
+        memcpy( &ip, &v4->sin_addr, sizeof( ip ) );
+
+        key = mix64( ( (uint64_t)ip << 16 ) | v4->sin_port );
+    }
+    else
+    {
+        const struct sockaddr_in6* v6 = (const struct sockaddr_in6*)addr;
+        uint64_t ip[2];
+        memcpy( ip, &v6->sin6_addr, sizeof( ip ) );
+
+        key = mix64( ip[0] ^ mix64( ip[1] ^ v6->sin6_port ) );
+    }
+
+    const uint32_t hash = (uint32_t)( key >> 32 );
+    return hash ? hash : 1;
+}
+
+bool dd_peers_addr_equal( const struct sockaddr* c_restrict lhs,
+                          const struct sockaddr* c_restrict rhs )
+{
+    if( lhs->sa_family != rhs->sa_family ) return false;
+
+    if( lhs->sa_family == AF_INET )
+    {
+        const struct sockaddr_in* a = (const struct sockaddr_in*)lhs;
+        const struct sockaddr_in* b = (const struct sockaddr_in*)rhs;
+
+        return a->sin_port == b->sin_port &&
+               a->sin_addr.s_addr == b->sin_addr.s_addr;
+    }
+
+    const struct sockaddr_in6* a = (const struct sockaddr_in6*)lhs;
+    const struct sockaddr_in6* b = (const struct sockaddr_in6*)rhs;
+
+    return a->sin6_port == b->sin6_port &&
+           memcmp( &a->sin6_addr, &b->sin6_addr, sizeof( a->sin6_addr ) ) == 0;
+}
+
+bool dd_peers_supported( const struct sockaddr* c_restrict addr )
+{
+    return addr->sa_family == AF_INET || addr->sa_family == AF_INET6;
+}
+
+// slot holding addr, or the empty slot ending its probe sequence
+static uint32_t probe( const struct ddPeerTable* c_restrict table,
+                       const struct sockaddr* c_restrict addr,
+                       const uint32_t hash )
+{
+    const uint32_t mask = table->capacity - 1;
+    uint32_t idx = hash & mask;
+
+    while( table->entries[idx].hash )
+    {
+        if( table->entries[idx].hash == hash &&
+            dd_peers_addr_equal( &table->entries[idx].addr.sa, addr ) )
+            break;
+
+        idx = ( idx + 1 ) & mask;
+    }
+
+    return idx;
+}
+
+static bool grow( struct ddPeerTable* c_restrict table )
+{
+    const uint32_t old_capacity = table->capacity;
+    struct ddPeer* old_entries = table->entries;
+
+    struct ddPeer* entries = calloc( old_capacity * 2, sizeof( *entries ) );
+
+    if( !entries )
+    {
+        console_write( LOG_ERROR, "Peer table allocation failed\n" );
+        return false;
+    }
+
+    table->entries = entries;
+    table->capacity = old_capacity * 2;
+
+    for( uint32_t i = 0; i < old_capacity; i++ )
+    {
+        if( !old_entries[i].hash ) continue;
+
+        const uint32_t idx =
+            probe( table, &old_entries[i].addr.sa, old_entries[i].hash );
+        table->entries[idx] = old_entries[i];
+    }
+
+    free( old_entries );
+    return true;
+}
+
+static void remove_at( struct ddPeerTable* c_restrict table, uint32_t idx )
+{
+    const uint32_t mask = table->capacity - 1;
+
+    // shift later members of the probe run back so no tombstones are needed
+    uint32_t next = idx;
+    while( true )
+    {
+        next = ( next + 1 ) & mask;
+
+        if( !table->entries[next].hash ) break;
+
+        const uint32_t home = table->entries[next].hash & mask;
+
+        // entry can't move before its home slot
+        const bool movable = ( next > idx ) ? ( home <= idx || home > next )
+                                            : ( home <= idx && home > next );
+        if( movable )
+        {
+            table->entries[idx] = table->entries[next];
+            idx = next;
+        }
+    }
+
+    table->entries[idx] = ( struct ddPeer ){0};
+    table->count--;
+    dd_stats_sub( DDSTAT_PEERS_ACTIVE, 1 );
+}
+
+bool dd_peers_init( struct ddPeerTable* c_restrict table,
+                    const uint32_t capacity_hint,
+                    const double idle_seconds,
+                    dd_peer_cb evict_cb )
+{
+    *table = ( struct ddPeerTable ){
+        .capacity = DD_PEERS_MIN_CAPACITY,
+        .idle_timeout = seconds_to_nano( idle_seconds ),
+        .evict_cb = evict_cb,
+    };
+
+    // keep load under 3/4 for the hinted peer count
+    while( table->capacity < capacity_hint + capacity_hint / 3 )
+        table->capacity *= 2;
+
+    table->entries = calloc( table->capacity, sizeof( struct ddPeer ) );
+
+    if( !table->entries )
+    {
+        console_write( LOG_ERROR, "Peer table allocation failed\n" );
+        table->capacity = 0;
+        return false;
+    }
+
+    return true;
+}
+
+void dd_peers_free( struct ddPeerTable* c_restrict table )
+{
+    dd_stats_sub( DDSTAT_PEERS_ACTIVE, table->count );
+
+    free( table->entries );
+    *table = ( struct ddPeerTable ){0};
+}
+
+struct ddPeer* dd_peers_find( const struct ddPeerTable* c_restrict table,
+                              const struct sockaddr_storage* c_restrict addr )
+{
+    const struct sockaddr* sa = (const struct sockaddr*)addr;
+
+    if( !table->capacity || !dd_peers_supported( sa ) ) return NULL;
+
+    const uint32_t idx = probe( table, sa, dd_peers_hash_addr( sa ) );
+
+    return table->entries[idx].hash ? &table->entries[idx] : NULL;
+}
+
+struct ddPeer* dd_peers_touch( struct ddPeerTable* c_restrict table,
+                               const struct sockaddr_storage* c_restrict addr,
+                               const socklen_t addr_len,
+                               const uint64_t now,
+                               bool* c_restrict created )
+{
+    const struct sockaddr* sa = (const struct sockaddr*)addr;
+
+    if( created ) *created = false;
+
+    if( !table->capacity || !dd_peers_supported( sa ) ) return NULL;
+
+    const uint32_t hash = dd_peers_hash_addr( sa );
+    uint32_t idx = probe( table, sa, hash );
+
+    if( !table->entries[idx].hash )
+    {
+        if( ( table->count + 1 ) * 4 > table->capacity * 3 )
+        {
+            if( !grow( table ) ) return NULL;
+
+            idx = probe( table, sa, hash );
+        }
+
+        struct ddPeer* peer = &table->entries[idx];
+
+        *peer = ( struct ddPeer ){
+            .addr_len = addr_len,
+            .hash = hash,
+            .first_seen = now,
+        };
+
+        memcpy( &peer->addr,
+                addr,
+                sa->sa_family == AF_INET ? sizeof( struct sockaddr_in )
+                                         : sizeof( struct sockaddr_in6 ) );
+
+        table->count++;
+        dd_stats_add( DDSTAT_PEERS_ACTIVE, 1 );
+        if( created ) *created = true;
+    }
+
+    table->entries[idx].last_seen = now;
+    return &table->entries[idx];
+}
+
+bool dd_peers_remove( struct ddPeerTable* c_restrict table,
+                      const struct sockaddr_storage* c_restrict addr )
+{
+    const struct sockaddr* sa = (const struct sockaddr*)addr;
+
+    if( !table->capacity || !dd_peers_supported( sa ) ) return false;
+
+    const uint32_t idx = probe( table, sa, dd_peers_hash_addr( sa ) );
+
+    if( !table->entries[idx].hash ) return false;
+
+    remove_at( table, idx );
+    return true;
+}
+
+uint32_t dd_peers_evict_idle( struct ddPeerTable* c_restrict table,
+                              const uint64_t now )
+{
+    if( table->idle_timeout == 0 ) return 0;
+
+    uint32_t evicted = 0;
+    uint32_t idx = 0;
+
+    while( idx < table->capacity )
+    {
+        struct ddPeer* peer = &table->entries[idx];
+
+        if( peer->hash && now > peer->last_seen &&
+            now - peer->last_seen > table->idle_timeout )
+        {
+            if( table->evict_cb ) table->evict_cb( table, peer );
+
+            // removal shifts a later entry into idx, so check it again
+            remove_at( table, idx );
+            evicted++;
+            continue;
+        }
+
+        idx++;
+    }
+
+    return evicted;
+}
+
+uint32_t dd_peers_broadcast( const struct ddAddressInfo* c_restrict sender,
+                             const struct ddPeerTable* c_restrict table,
+                             const uint32_t msg_type,
+                             const struct ddMsgVal* c_restrict msg )
+{
+    char output[MAX_MSG_LENGTH];
+    char packed[MAX_MSG_LENGTH];
+
+    // nobody to reach, not even through the group
+    if( table->count == 0 ) return 0;
+
+    int32_t msg_length =
+        dd_msg_encode( msg_type, msg, output, sizeof( output ) );
+
+    if( msg_length == -1 ) return 0;
+
+    const char* wire = dd_compress_stage(
+        sender, output, &msg_length, packed, sizeof( packed ) );
+
+    // peers joined the sender's group, one datagram reaches them all
+    if( sender->multicast )
+        return dd_server_send_group( sender, wire, msg_length, NULL ) ? 1 : 0;
+
+    const struct sockaddr* addrs[MAX_SEND_BATCH];
+    socklen_t addr_lens[MAX_SEND_BATCH];
+    uint32_t batch_size = 0;
+    uint32_t sent_count = 0;
+
+    for( uint32_t i = 0; i < table->capacity; i++ )
+    {
+        if( !table->entries[i].hash ) continue;
+
+        addrs[batch_size] = &table->entries[i].addr.sa;
+        addr_lens[batch_size] = table->entries[i].addr_len;
+
+        if( ++batch_size == MAX_SEND_BATCH )
+        {
+            sent_count += dd_server_send_many( sender,
+                                               wire,
+                                               msg_length,
+                                               addrs,
+                                               addr_lens,
+                                               batch_size,
+                                               NULL );
+            batch_size = 0;
+        }
+    }
+
+    if( batch_size )
+        sent_count += dd_server_send_many(
+            sender, wire, msg_length, addrs, addr_lens, batch_size, NULL );
+
+    return sent_count;
+}
@@ -0,0 +1,560 @@
+#include "Quantize.h"
+#include "WireFormat.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined( __x86_64__ ) && defined( __GNUC__ )
+#include <immintrin.h>
+#define DD_HAS_QUANT_SIMD 1
+#endif
+
+// values per byte aligned group: 8 x bits bits is always bits bytes
+#define GROUP 8
+
+// per call constants shared by every kernel
+struct quant_params
+{
+    float min;
+    float max;
+    float scale;  // steps per unit
+    float step;   // units per step
+    uint32_t bits;
+};
+
+typedef void ( *pack_fn )( const struct quant_params* c_restrict params,
+                           const float* c_restrict values,
+                           const uint32_t count,
+                           uint8_t* c_restrict output );
+
+typedef void ( *unpack_fn )( const struct quant_params* c_restrict params,
+                             const uint8_t* c_restrict input,
+                             const uint32_t count,
+                             float* c_restrict values );
+
+struct quant_kernel
+{
+    const char* name;
+    pack_fn pack;  // NULL when not compiled in
+    unpack_fn unpack;
+};
+
+static bool make_params( const struct ddQuantRange* c_restrict range,
+                         struct quant_params* c_restrict params )
+{
+    if( range->bits < DD_QUANT_MIN_BITS || range->bits > DD_QUANT_MAX_BITS ||
+        !isfinite( range->min ) || !isfinite( range->max ) ||
+        !( range->min < range->max ) )
+        return false;
+
+    const float levels = (float)( ( 1u << range->bits ) - 1 );
+    const float span = range->max - range->min;
+
+    *params = ( struct quant_params ){
+        .min = range->min,
+        .max = range->max,
+        .scale = levels / span,
+        .step = span / levels,
+        .bits = range->bits,
+    };
+
+    // spans that overflow or are too narrow to divide into steps
+    return isfinite( span ) && isfinite( params->scale ) && params->step > 0.f;
+}
+
+// same operation order as the simd kernels so every level agrees. NaN lands
+// on min like maxps does
+static uint32_t quantize_one( const struct quant_params* c_restrict params,
+                              const float value )
+{
+    float clamped = value > params->min ? value : params->min;
+    clamped = clamped < params->max ? clamped : params->max;
+
+    return (uint32_t)( ( clamped - params->min ) * params->scale + 0.5f );
+}
+
+static float dequantize_one( const struct quant_params* c_restrict params,
+                             const uint32_t quantized )
+{
+    return (float)quantized * params->step + params->min;
+}
+
+static void pack_scalar( const struct quant_params* c_restrict params,
+                         const float* c_restrict values,
+                         const uint32_t count,
+                         uint8_t* c_restrict output )
+{
+    uint64_t pending = 0;
+    uint32_t pending_bits = 0;
+
+    for( uint32_t i = 0; i < count; i++ )
+    {
+        pending |= (uint64_t)quantize_one( params, values[i] ) << pending_bits;
+        pending_bits += params->bits;
+
+        for( ; pending_bits >= 8; pending_bits -= 8, pending >>= 8 )
+            *output++ = (uint8_t)pending;
+    }
+
+    if( pending_bits ) *output = (uint8_t)pending;
+}
+
+static void unpack_scalar( const struct quant_params* c_restrict params,
+                           const uint8_t* c_restrict input,
+                           const uint32_t count,
+                           float* c_restrict values )
+{
+    const uint32_t mask = ( 1u << params->bits ) - 1;
+
+    uint64_t pending = 0;
+    uint32_t pending_bits = 0;
+
+    for( uint32_t i = 0; i < count; i++ )
+    {
+        // only reads as far as the packed size, no overrun on the tail
+        for( ; pending_bits < params->bits; pending_bits += 8 )
+            pending |= (uint64_t)*input++ << pending_bits;
+
+        values[i] = dequantize_one( params, (uint32_t)pending & mask );
+        pending >>= params->bits;
+        pending_bits -= params->bits;
+    }
+}
+
+#ifdef DD_HAS_QUANT_SIMD
+
+/* Pack quantizes 8 lanes at a time, then folds neighbouring 32-bit lanes
+ * into 64-bit pairs ( v0 | v1 << bits ) w/ uniform shifts. The last two
+ * folds & the bits byte store happen on a 128-bit scalar. Unpack shuffles
+ * the up to 3 bytes holding each value into its lane & shifts it down */
+
+struct unpack_layout
+{
+    uint8_t shuffle[GROUP * 4];  // pshufb control, 0x80 zeroes a byte
+    uint32_t shifts[GROUP];      // bit offset within the first byte
+};
+
+static void make_layout( const uint32_t bits,
+                         struct unpack_layout* c_restrict layout )
+{
+    for( uint32_t i = 0; i < GROUP; i++ )
+    {
+        const uint32_t first_bit = i * bits;
+        const uint32_t first_byte = first_bit / 8;
+
+        layout->shifts[i] = first_bit % 8;
+
+        // only bytes w/ bits of this value, which never reach past the group
+        for( uint32_t k = 0; k < 4; k++ )
+        {
+            const uint32_t byte = first_byte + k;
+
+            layout->shuffle[i * 4 + k] =
+                k < 3 && byte * 8 < first_bit + bits ? (uint8_t)byte : 0x80;
+        }
+    }
+}
+
+// groups whose 16 byte load stays inside the packed input
+static uint32_t loadable_groups( const uint32_t count, const uint32_t bits )
+{
+    const uint32_t packed_size = dd_quant_packed_size( count, bits );
+    const uint32_t groups = count / GROUP;
+
+    if( packed_size < 16 ) return 0;
+
+    const uint32_t loadable = ( packed_size - 16 ) / bits + 1;
+    return loadable < groups ? loadable : groups;
+}
+
+static void store_group( const uint64_t pairs[4],
+                         const uint32_t bits,
+                         uint8_t* c_restrict output )
+{
+    const uint32_t pair_bits = 2 * bits;
+    const uint64_t low = pairs[0] | pairs[1] << pair_bits;
+    const uint64_t high = pairs[2] | pairs[3] << pair_bits;
+
+    const unsigned __int128 group =
+        low | (unsigned __int128)high << ( 2 * pair_bits );
+
+    memcpy( output, &group, bits );  // little-endian
+}
+
+// the last groups' bytes go through a zeroed copy instead of overreading
+#define DEFINE_LOAD_GROUP( name, isa )                                      \
+    __attribute__( ( target( isa ) ) ) static __m128i name(                \
+        const uint8_t* c_restrict input,                                   \
+        const uint32_t bits,                                               \
+        const bool in_bounds )                                             \
+    {                                                                      \
+        if( in_bounds ) return _mm_loadu_si128( (const __m128i*)input );   \
+                                                                           \
+        uint8_t bytes[16] = {0};                                           \
+        memcpy( bytes, input, bits );                                      \
+                                                                           \
+        return _mm_loadu_si128( (const __m128i*)bytes );                   \
+    }
+
+// one per isa, mixing legacy sse code into avx2 loops stalls on transitions
+DEFINE_LOAD_GROUP( load_group_sse41, "sse4.1" )
+DEFINE_LOAD_GROUP( load_group_avx2, "avx2" )
+
+__attribute__( ( target( "sse4.1" ) ) ) static __m128i quantize_sse41(
+    const __m128 values,
+    const __m128 min,
+    const __m128 max,
+    const __m128 scale )
+{
+    const __m128 clamped = _mm_min_ps( _mm_max_ps( values, min ), max );
+    const __m128 steps = _mm_mul_ps( _mm_sub_ps( clamped, min ), scale );
+
+    return _mm_cvttps_epi32( _mm_add_ps( steps, _mm_set1_ps( 0.5f ) ) );
+}
+
+__attribute__( ( target( "sse4.1" ) ) ) static __m128i fold_pairs_sse41(
+    const __m128i quantized,
+    const __m128i shift )
+{
+    const __m128i odd = _mm_srli_epi64( quantized, 32 );
+    const __m128i even =
+        _mm_and_si128( quantized, _mm_set1_epi64x( 0xffffffff ) );
+
+    return _mm_or_si128( even, _mm_sll_epi64( odd, shift ) );
+}
+
+__attribute__( ( target( "sse4.1" ) ) ) static void pack_sse41(
+    const struct quant_params* c_restrict params,
+    const float* c_restrict values,
+    const uint32_t count,
+    uint8_t* c_restrict output )
+{
+    const __m128 min = _mm_set1_ps( params->min );
+    const __m128 max = _mm_set1_ps( params->max );
+    const __m128 scale = _mm_set1_ps( params->scale );
+    const __m128i shift = _mm_cvtsi32_si128( (int)params->bits );
+
+    const uint32_t groups = count / GROUP;
+    uint64_t pairs[4];
+
+    for( uint32_t g = 0; g < groups; g++ )
+    {
+        const float* in = values + g * GROUP;
+
+        const __m128i low =
+            quantize_sse41( _mm_loadu_ps( in ), min, max, scale );
+        const __m128i high =
+            quantize_sse41( _mm_loadu_ps( in + 4 ), min, max, scale );
+
+        _mm_storeu_si128( (__m128i*)pairs, fold_pairs_sse41( low, shift ) );
+        _mm_storeu_si128( (__m128i*)( pairs + 2 ),
+                          fold_pairs_sse41( high, shift ) );
+
+        store_group( pairs, params->bits, output + g * params->bits );
+    }
+
+    pack_scalar( params,
+                 values + groups * GROUP,
+                 count - groups * GROUP,
+                 output + groups * params->bits );
+}
+
+__attribute__( ( target( "sse4.1" ) ) ) static void unpack_sse41(
+    const struct quant_params* c_restrict params,
+    const uint8_t* c_restrict input,
+    const uint32_t count,
+    float* c_restrict values )
+{
+    struct unpack_layout layout;
+    make_layout( params->bits, &layout );
+
+    // no per lane shift before avx2, multiply up to a common shift of 8
+    uint32_t factors[GROUP];
+    for( uint32_t i = 0; i < GROUP; i++ )
+        factors[i] = 1u << ( 8 - layout.shifts[i] );
+
+    const __m128i control_low =
+        _mm_loadu_si128( (const __m128i*)layout.shuffle );
+    const __m128i control_high =
+        _mm_loadu_si128( (const __m128i*)( layout.shuffle + 16 ) );
+    const __m128i factor_low = _mm_loadu_si128( (const __m128i*)factors );
+    const __m128i factor_high =
+        _mm_loadu_si128( (const __m128i*)( factors + 4 ) );
+    const __m128i mask = _mm_set1_epi32( ( 1 << params->bits ) - 1 );
+    const __m128 min = _mm_set1_ps( params->min );
+    const __m128 step = _mm_set1_ps( params->step );
+
+    const uint32_t groups = count / GROUP;
+    const uint32_t loadable = loadable_groups( count, params->bits );
+
+    for( uint32_t g = 0; g < groups; g++ )
+    {
+        const __m128i bytes = load_group_sse41(
+            input + g * params->bits, params->bits, g < loadable );
+
+        const __m128i low = _mm_and_si128(
+            _mm_srli_epi32(
+                _mm_mullo_epi32( _mm_shuffle_epi8( bytes, control_low ),
+                                 factor_low ),
+                8 ),
+            mask );
+        const __m128i high = _mm_and_si128(
+            _mm_srli_epi32(
+                _mm_mullo_epi32( _mm_shuffle_epi8( bytes, control_high ),
+                                 factor_high ),
+                8 ),
+            mask );
+
+        float* out = values + g * GROUP;
+
+        _mm_storeu_ps(
+            out,
+            _mm_add_ps( _mm_mul_ps( _mm_cvtepi32_ps( low ), step ), min ) );
+        _mm_storeu_ps(
+            out + 4,
+            _mm_add_ps( _mm_mul_ps( _mm_cvtepi32_ps( high ), step ), min ) );
+    }
+
+    unpack_scalar( params,
+                   input + groups * params->bits,
+                   count - groups * GROUP,
+                   values + groups * GROUP );
+}
+
+__attribute__( ( target( "avx2" ) ) ) static void pack_avx2(
+    const struct quant_params* c_restrict params,
+    const float* c_restrict values,
+    const uint32_t count,
+    uint8_t* c_restrict output )
+{
+    const __m256 min = _mm256_set1_ps( params->min );
+    const __m256 max = _mm256_set1_ps( params->max );
+    const __m256 scale = _mm256_set1_ps( params->scale );
+    const __m256 half = _mm256_set1_ps( 0.5f );
+    const __m256i even_mask = _mm256_set1_epi64x( 0xffffffff );
+    const __m128i shift = _mm_cvtsi32_si128( (int)params->bits );
+
+    const uint32_t groups = count / GROUP;
+    uint64_t pairs[4];
+
+    for( uint32_t g = 0; g < groups; g++ )
+    {
+        const __m256 clamped = _mm256_min_ps(
+            _mm256_max_ps( _mm256_loadu_ps( values + g * GROUP ), min ), max );
+        const __m256 steps =
+            _mm256_mul_ps( _mm256_sub_ps( clamped, min ), scale );
+        const __m256i quantized =
+            _mm256_cvttps_epi32( _mm256_add_ps( steps, half ) );
+
+        const __m256i folded = _mm256_or_si256(
+            _mm256_and_si256( quantized, even_mask ),
+            _mm256_sll_epi64( _mm256_srli_epi64( quantized, 32 ), shift ) );
+
+        _mm256_storeu_si256( (__m256i*)pairs, folded );
+        store_group( pairs, params->bits, output + g * params->bits );
+    }
+
+    pack_scalar( params,
+                 values + groups * GROUP,
+                 count - groups * GROUP,
+                 output + groups * params->bits );
+}
+
+__attribute__( ( target( "avx2" ) ) ) static void unpack_avx2(
+    const struct quant_params* c_restrict params,
+    const uint8_t* c_restrict input,
+    const uint32_t count,
+    float* c_restrict values )
+{
+    struct unpack_layout layout;
+    make_layout( params->bits, &layout );
+
+    // pshufb indexes within each 128-bit half, so both get the same bytes
+    const __m256i control =
+        _mm256_loadu_si256( (const __m256i*)layout.shuffle );
+    const __m256i shifts = _mm256_loadu_si256( (const __m256i*)layout.shifts );
+    const __m256i mask = _mm256_set1_epi32( ( 1 << params->bits ) - 1 );
+    const __m256 min = _mm256_set1_ps( params->min );
+    const __m256 step = _mm256_set1_ps( params->step );
+
+    const uint32_t groups = count / GROUP;
+    const uint32_t loadable = loadable_groups( count, params->bits );
+
+    for( uint32_t g = 0; g < groups; g++ )
+    {
+        const __m128i bytes = load_group_avx2(
+            input + g * params->bits, params->bits, g < loadable );
+
+        const __m256i quantized = _mm256_and_si256(
+            _mm256_srlv_epi32(
+                _mm256_shuffle_epi8( _mm256_broadcastsi128_si256( bytes ),
+                                     control ),
+                shifts ),
+            mask );
+
+        _mm256_storeu_ps(
+            values + g * GROUP,
+            _mm256_add_ps(
+                _mm256_mul_ps( _mm256_cvtepi32_ps( quantized ), step ),
+                min ) );
+    }
+
+    unpack_scalar( params,
+                   input + groups * params->bits,
+                   count - groups * GROUP,
+                   values + groups * GROUP );
+}
+
+static const struct quant_kernel s_kernels[DDQUANT_ISA_COUNT] = {
+    [DDQUANT_SCALAR] = {"scalar", pack_scalar, unpack_scalar},
+    [DDQUANT_SSE41] = {"sse4.1", pack_sse41, unpack_sse41},
+    [DDQUANT_AVX2] = {"avx2", pack_avx2, unpack_avx2},
+};
+
+#else
+
+static const struct quant_kernel s_kernels[DDQUANT_ISA_COUNT] = {
+    [DDQUANT_SCALAR] = {"scalar", pack_scalar, unpack_scalar},
+    [DDQUANT_SSE41] = {"sse4.1", NULL, NULL},
+    [DDQUANT_AVX2] = {"avx2", NULL, NULL},
+};
+
+#endif  // DD_HAS_QUANT_SIMD
+
+static uint32_t s_isa = DDQUANT_ISA_COUNT;  // picked on first use
+
+bool dd_quant_isa_supported( const uint32_t isa )
+{
+    if( isa >= DDQUANT_ISA_COUNT || !s_kernels[isa].pack ) return false;
+
+#ifdef DD_HAS_QUANT_SIMD
+    if( isa == DDQUANT_SSE41 ) return __builtin_cpu_supports( "sse4.1" );
+    if( isa == DDQUANT_AVX2 ) return __builtin_cpu_supports( "avx2" );
+#endif
+
+    return true;
+}
+
+bool dd_quant_set_isa( const uint32_t isa )
+{
+    if( !dd_quant_isa_supported( isa ) ) return false;
+
+    s_isa = isa;
+    return true;
+}
+
+uint32_t dd_quant_isa()
+{
+    if( s_isa == DDQUANT_ISA_COUNT )
+    {
+        s_isa = DDQUANT_ISA_COUNT - 1;
+        while( !dd_quant_isa_supported( s_isa ) ) s_isa--;
+    }
+
+    return s_isa;
+}
+
+const char* dd_quant_isa_name( const uint32_t isa )
+{
+    return isa < DDQUANT_ISA_COUNT ? s_kernels[isa].name : "unknown";
+}
+
+bool dd_quant_pack( const float* c_restrict values,
+                    const uint32_t count,
+                    const struct ddQuantRange* c_restrict range,
+                    uint8_t* c_restrict output )
+{
+    struct quant_params params;
+
+    if( !make_params( range, &params ) ) return false;
+
+    s_kernels[dd_quant_isa()].pack( &params, values, count, output );
+    return true;
+}
+
+bool dd_quant_unpack( const uint8_t* c_restrict input,
+                      const uint32_t count,
+                      const struct ddQuantRange* c_restrict range,
+                      float* c_restrict values )
+{
+    struct quant_params params;
+
+    if( !make_params( range, &params ) ) return false;
+
+    s_kernels[dd_quant_isa()].unpack( &params, input, count, values );
+    return true;
+}
+
+static void write_f32_le( uint8_t* c_restrict out, const float val )
+{
+    uint32_t raw;
+    memcpy( &raw, &val, sizeof( raw ) );
+    dd_write_u32_le( out, raw );
+}
+
+static float read_f32_le( const uint8_t* c_restrict in )
+{
+    const uint32_t raw = dd_read_u32_le( in );
+
+    float val;
+    memcpy( &val, &raw, sizeof( val ) );
+    return val;
+}
+
+int32_t dd_quant_encode( const float* c_restrict values,
+                         const uint32_t count,
+                         const struct ddQuantRange* c_restrict range,
+                         char* c_restrict output,
+                         const uint32_t output_size )
+{
+    if( count > UINT16_MAX || range->bits > DD_QUANT_MAX_BITS ) return -1;
+
+    const uint32_t size =
+        DD_QUANT_HEADER_SIZE + dd_quant_packed_size( count, range->bits );
+
+    if( size > output_size ) return -1;
+
+    uint8_t* out = (uint8_t*)output;
+
+    if( !dd_quant_pack( values, count, range, out + DD_QUANT_HEADER_SIZE ) )
+        return -1;
+
+    out[0] = (uint8_t)( DDFRAME_MARK | DDFRAME_QUANT );
+    out[DDFRAME_HEADER_SIZE] = (uint8_t)range->bits;
+    dd_write_u16_le( out + DDFRAME_HEADER_SIZE + 1, (uint16_t)count );
+    write_f32_le( out + DDFRAME_HEADER_SIZE + 3, range->min );
+    write_f32_le( out + DDFRAME_HEADER_SIZE + 7, range->max );
+
+    return (int32_t)size;
+}
+
+int32_t dd_quant_decode( const char* c_restrict data,
+                         const int32_t length,
+                         float* c_restrict values,
+                         const uint32_t max_count,
+                         struct ddQuantRange* c_restrict range )
+{
+    const uint8_t* in = (const uint8_t*)data;
+
+    if( length < DD_QUANT_HEADER_SIZE ||
+        in[0] != ( DDFRAME_MARK | DDFRAME_QUANT ) )
+        return -1;
+
+    *range = ( struct ddQuantRange ){
+        .min = read_f32_le( in + DDFRAME_HEADER_SIZE + 3 ),
+        .max = read_f32_le( in + DDFRAME_HEADER_SIZE + 7 ),
+        .bits = in[DDFRAME_HEADER_SIZE],
+    };
+
+    const uint32_t count = dd_read_u16_le( in + DDFRAME_HEADER_SIZE + 1 );
+
+    if( count > max_count || range->bits > DD_QUANT_MAX_BITS ||
+        (uint32_t)length !=
+            DD_QUANT_HEADER_SIZE + dd_quant_packed_size( count, range->bits ) )
+        return -1;
+
+    if( !dd_quant_unpack( in + DD_QUANT_HEADER_SIZE, count, range, values ) )
+        return -1;
+
+    return (int32_t)count;
+}
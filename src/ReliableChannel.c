@@ -0,0 +1,371 @@
+#include "ReliableChannel.h"
+#include "ConsoleWrite.h"
+#include "WireFormat.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// signed distance from b to a on the 16-bit sequence circle
+static int32_t seq_diff( const uint16_t a, const uint16_t b )
+{
+    return (int16_t)( a - b );
+}
+
+static uint32_t slot_of( const uint16_t seq )
+{
+    return seq % DD_RELIABLE_WINDOW;
+}
+
+static void write_ack_fields( const struct ddReliableChannel* c_restrict ch,
+                              uint8_t* c_restrict out )
+{
+    dd_write_u16_le( out, ch->recv_latest );
+    dd_write_u32_le( out + 2, ch->received_any ? ch->recv_bits : 0 );
+}
+
+static bool transmit( struct ddReliableChannel* c_restrict ch,
+                      const struct ddReliablePacket* c_restrict packet )
+{
+    char out[MAX_MSG_LENGTH];
+    uint8_t* header = (uint8_t*)out;
+
+    header[0] = (uint8_t)( DDFRAME_MARK | DDFRAME_RELIABLE );
+    dd_write_u16_le( header + DDFRAME_HEADER_SIZE, packet->seq );
+    write_ack_fields( ch, header + DDFRAME_HEADER_SIZE + 2 );
+
+    memcpy( out + DD_RELIABLE_HEADER_SIZE, packet->frame, packet->length );
+
+    // any outgoing envelope carries the current ack
+    ch->ack_pending = false;
+
+    return ch->send_cb(
+        ch, out, (int32_t)( DD_RELIABLE_HEADER_SIZE + packet->length ) );
+}
+
+static void send_ack( struct ddReliableChannel* c_restrict ch )
+{
+    uint8_t out[DDFRAME_HEADER_SIZE + 6];
+
+    out[0] = (uint8_t)( DDFRAME_MARK | DDFRAME_ACK );
+    write_ack_fields( ch, out + DDFRAME_HEADER_SIZE );
+
+    ch->ack_pending = false;
+    ch->stats.acks_sent++;
+
+    ch->send_cb( ch, (const char*)out, (int32_t)sizeof( out ) );
+}
+
+static void sample_rtt( struct ddReliableChannel* c_restrict ch,
+                        const uint64_t rtt )
+{
+    if( ch->srtt == 0 )
+    {
+        ch->srtt = rtt;
+        ch->rttvar = rtt / 2;
+    }
+    else
+    {
+        const uint64_t err = rtt > ch->srtt ? rtt - ch->srtt : ch->srtt - rtt;
+
+        ch->rttvar = ( 3 * ch->rttvar + err ) / 4;
+        ch->srtt = ( 7 * ch->srtt + rtt ) / 8;
+    }
+
+    // rfc 6298 w/ the granularity term as a floor on the variance, plus
+    // the time the peer may sit on an ack
+    const uint64_t variance =
+        4 * ch->rttvar > DD_RELIABLE_RTO_GRANULARITY
+            ? 4 * ch->rttvar
+            : DD_RELIABLE_RTO_GRANULARITY;
+
+    ch->rto = ch->srtt + variance + DD_RELIABLE_ACK_DELAY;
+
+    if( ch->rto < DD_RELIABLE_MIN_RTO ) ch->rto = DD_RELIABLE_MIN_RTO;
+    if( ch->rto > DD_RELIABLE_MAX_RTO ) ch->rto = DD_RELIABLE_MAX_RTO;
+}
+
+static void ack_packet( struct ddReliableChannel* c_restrict ch,
+                        const uint16_t seq,
+                        const uint64_t now )
+{
+    // only sequences still in flight
+    if( seq_diff( seq, ch->send_base ) < 0 ||
+        seq_diff( seq, ch->next_seq ) >= 0 )
+        return;
+
+    struct ddReliablePacket* packet = &ch->outgoing[slot_of( seq )];
+
+    if( !packet->in_use || packet->seq != seq ) return;
+
+    // Karn: resent frames give ambiguous samples
+    if( packet->retries == 0 && now >= packet->sent_at )
+        sample_rtt( ch, now - packet->sent_at );
+
+    packet->in_use = false;
+}
+
+static void process_acks( struct ddReliableChannel* c_restrict ch,
+                          const uint8_t* c_restrict fields,
+                          const uint64_t now )
+{
+    const uint16_t ack = dd_read_u16_le( fields );
+    const uint32_t bits = dd_read_u32_le( fields + 2 );
+
+    ack_packet( ch, ack, now );
+
+    for( uint32_t i = 0; i < 32; i++ )
+    {
+        if( bits & ( 1u << i ) )
+            ack_packet( ch, (uint16_t)( ack - 1 - i ), now );
+    }
+
+    // slide past everything acked at the front of the window
+    while( ch->send_base != ch->next_seq &&
+           !ch->outgoing[slot_of( ch->send_base )].in_use )
+        ch->send_base++;
+}
+
+static void note_received( struct ddReliableChannel* c_restrict ch,
+                           const uint16_t seq )
+{
+    if( !ch->received_any )
+    {
+        ch->received_any = true;
+        ch->recv_latest = seq;
+        ch->recv_bits = 0;
+        return;
+    }
+
+    const int32_t ahead = seq_diff( seq, ch->recv_latest );
+
+    if( ahead > 0 )
+    {
+        // old latest becomes bit ( ahead - 1 )
+        ch->recv_bits = ahead < 32 ? ( ch->recv_bits << ahead ) : 0;
+        if( ahead <= 32 ) ch->recv_bits |= 1u << ( ahead - 1 );
+
+        ch->recv_latest = seq;
+    }
+    else if( ahead < 0 && ahead >= -32 )
+        ch->recv_bits |= 1u << ( -ahead - 1 );
+}
+
+static void receive_frame( struct ddReliableChannel* c_restrict ch,
+                           const uint16_t seq,
+                           const char* c_restrict frame,
+                           const int32_t length,
+                           const uint64_t now )
+{
+    const int32_t offset = seq_diff( seq, ch->recv_next );
+
+    // ack even duplicates, the sender may have missed our last ack
+    if( !ch->ack_pending )
+    {
+        ch->ack_pending = true;
+        ch->ack_due = now + DD_RELIABLE_ACK_DELAY;
+    }
+
+    if( offset < 0 )
+    {
+        ch->stats.duplicates++;
+        note_received( ch, seq );
+        return;
+    }
+
+    // beyond the window the sender can't have sent it yet
+    if( offset >= DD_RELIABLE_WINDOW || length > DD_RELIABLE_MAX_FRAME )
+        return;
+
+    note_received( ch, seq );
+
+    struct ddReliablePacket* slot = &ch->incoming[slot_of( seq )];
+
+    if( slot->in_use )
+    {
+        ch->stats.duplicates++;
+        return;
+    }
+
+    slot->in_use = true;
+    slot->seq = seq;
+    slot->length = (uint16_t)length;
+    memcpy( slot->frame, frame, (size_t)length );
+
+    // hand over every frame that's now contiguous
+    while( ( slot = &ch->incoming[slot_of( ch->recv_next )] )->in_use &&
+           slot->seq == ch->recv_next )
+    {
+        slot->in_use = false;
+        ch->recv_next++;
+        ch->stats.delivered++;
+
+        ch->deliver_cb( ch, slot->frame, slot->length );
+    }
+}
+
+bool dd_reliable_init( struct ddReliableChannel* c_restrict channel,
+                       dd_reliable_send_cb send_cb,
+                       dd_reliable_deliver_cb deliver_cb,
+                       void* data )
+{
+    *channel = ( struct ddReliableChannel ){
+        .rto = DD_RELIABLE_INITIAL_RTO,
+        .send_cb = send_cb,
+        .deliver_cb = deliver_cb,
+        .data = data,
+    };
+
+    channel->outgoing =
+        calloc( DD_RELIABLE_WINDOW, sizeof( struct ddReliablePacket ) );
+    channel->incoming =
+        calloc( DD_RELIABLE_WINDOW, sizeof( struct ddReliablePacket ) );
+
+    if( !channel->outgoing || !channel->incoming )
+    {
+        console_write( LOG_ERROR, "Reliable channel allocation failed\n" );
+        dd_reliable_free( channel );
+        return false;
+    }
+
+    return true;
+}
+
+void dd_reliable_free( struct ddReliableChannel* c_restrict channel )
+{
+    free( channel->outgoing );
+    free( channel->incoming );
+
+    channel->outgoing = channel->incoming = NULL;
+}
+
+bool dd_reliable_send_frame( struct ddReliableChannel* c_restrict channel,
+                             const char* c_restrict frame,
+                             const int32_t length,
+                             const uint64_t now )
+{
+    if( length <= 0 || length > DD_RELIABLE_MAX_FRAME ) return false;
+
+    if( dd_reliable_in_flight( channel ) >= DD_RELIABLE_WINDOW ) return false;
+
+    struct ddReliablePacket* packet =
+        &channel->outgoing[slot_of( channel->next_seq )];
+
+    packet->seq = channel->next_seq++;
+    packet->length = (uint16_t)length;
+    packet->retries = 0;
+    packet->sent_at = now;
+    packet->rto = channel->rto;
+    packet->in_use = true;
+    memcpy( packet->frame, frame, (size_t)length );
+
+    channel->stats.sent++;
+
+    // lost on the wire or not, the retransmit timer covers it
+    transmit( channel, packet );
+    return true;
+}
+
+bool dd_reliable_send( struct ddReliableChannel* c_restrict channel,
+                       const uint32_t msg_type,
+                       const struct ddMsgVal* c_restrict msg,
+                       const uint64_t now )
+{
+    char frame[DD_RELIABLE_MAX_FRAME];
+
+    const int32_t length =
+        dd_msg_encode( msg_type, msg, frame, sizeof( frame ) );
+
+    if( length == -1 ) return false;
+
+    return dd_reliable_send_frame( channel, frame, length, now );
+}
+
+bool dd_reliable_recv( struct ddReliableChannel* c_restrict channel,
+                       const char* c_restrict data,
+                       const int32_t length,
+                       const uint64_t now )
+{
+    if( length < DDFRAME_HEADER_SIZE ) return false;
+
+    const uint8_t* in = (const uint8_t*)data;
+
+    if( in[0] == ( DDFRAME_MARK | DDFRAME_ACK ) )
+    {
+        if( length >= DDFRAME_HEADER_SIZE + 6 )
+            process_acks( channel, in + DDFRAME_HEADER_SIZE, now );
+
+        return true;
+    }
+
+    if( in[0] != ( DDFRAME_MARK | DDFRAME_RELIABLE ) ) return false;
+
+    // truncated envelopes are still ours, just unusable
+    if( length <= DD_RELIABLE_HEADER_SIZE ) return true;
+
+    process_acks( channel, in + DDFRAME_HEADER_SIZE + 2, now );
+
+    receive_frame( channel,
+                   dd_read_u16_le( in + DDFRAME_HEADER_SIZE ),
+                   data + DD_RELIABLE_HEADER_SIZE,
+                   length - DD_RELIABLE_HEADER_SIZE,
+                   now );
+
+    return true;
+}
+
+uint64_t dd_reliable_update( struct ddReliableChannel* c_restrict channel,
+                             const uint64_t now )
+{
+    uint64_t next = UINT64_MAX;
+
+    for( uint16_t seq = channel->send_base; seq != channel->next_seq; seq++ )
+    {
+        struct ddReliablePacket* packet = &channel->outgoing[slot_of( seq )];
+
+        if( !packet->in_use ) continue;
+
+        uint64_t deadline = packet->sent_at + packet->rto;
+
+        if( deadline <= now && !channel->failed )
+        {
+            if( packet->retries >= DD_RELIABLE_MAX_RETRIES )
+            {
+                console_write( LOG_WARN,
+                               "Reliable frame %u unacked after %u resends\n",
+                               (uint32_t)packet->seq,
+                               (uint32_t)packet->retries );
+                channel->failed = true;
+                continue;
+            }
+
+            // exponential backoff per frame
+            packet->retries++;
+            packet->rto = packet->rto * 2 < DD_RELIABLE_MAX_RTO
+                              ? packet->rto * 2
+                              : DD_RELIABLE_MAX_RTO;
+            packet->sent_at = now;
+            channel->stats.retransmits++;
+
+            transmit( channel, packet );
+            deadline = now + packet->rto;
+        }
+
+        if( !channel->failed && deadline < next ) next = deadline;
+    }
+
+    if( channel->ack_pending )
+    {
+        if( channel->ack_due <= now )
+            send_ack( channel );
+        else if( channel->ack_due < next )
+            next = channel->ack_due;
+    }
+
+    return next;
+}
+
+uint32_t dd_reliable_in_flight(
+    const struct ddReliableChannel* c_restrict channel )
+{
+    return (uint16_t)( channel->next_seq - channel->send_base );
+}
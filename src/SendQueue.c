@@ -0,0 +1,327 @@
+#ifdef __linux__
+#define _GNU_SOURCE  // sendmmsg
+#endif
+
+#include "SendQueue.h"
+#include "ConsoleWrite.h"
+#include "WireFormat.h"
+#include "Compress.h"
+#include "StatsSegment.h"
+
+#include <stddef.h>
+#include <string.h>
+
+// datagram contents of a queue, a lone frame goes out unwrapped
+static const char* queue_datagram( const struct ddSendQueue* c_restrict queue,
+                                   uint32_t* c_restrict length )
+{
+    const uint32_t skip = DDFRAME_HEADER_SIZE + DD_BUNDLE_PREFIX_SIZE;
+
+    if( queue->count == 1 )
+    {
+        *length = queue->used - skip;
+        return queue->buf + skip;
+    }
+
+    *length = queue->used;
+    return queue->buf;
+}
+
+// queue_datagram after the sender's compression stage
+static const char* wire_datagram( const struct ddSendQueueSet* c_restrict set,
+                                  struct ddSendQueue* c_restrict queue,
+                                  uint32_t* c_restrict length )
+{
+    const char* data = queue_datagram( queue, length );
+
+    char packed[MAX_MSG_LENGTH];
+    int32_t size = (int32_t)*length;
+
+    if( dd_compress_stage(
+            set->sender, data, &size, packed, sizeof( packed ) ) == data )
+        return data;
+
+    // the queue empties once sent, so its buffer can hold the packed copy
+    memcpy( queue->buf, packed, (size_t)size );
+    *length = (uint32_t)size;
+
+    return queue->buf;
+}
+
+static void reset_queue( struct ddSendQueue* c_restrict queue )
+{
+    queue->used = 0;
+    queue->count = 0;
+}
+
+static void send_datagram( struct ddSendQueueSet* c_restrict set,
+                           const struct ddSendQueue* c_restrict queue,
+                           const char* c_restrict data,
+                           const uint32_t length )
+{
+    set->stats.syscalls++;
+
+    if( sendto( set->sender->socket_fd,
+                data,
+                (int)length,
+                0,
+                (const struct sockaddr*)&queue->addr,
+                (int)queue->addr_len ) == -1 )
+    {
+        set->stats.errors++;
+        dd_stats_add( DDSTAT_SEND_ERRORS, 1 );
+        return;
+    }
+
+    set->stats.datagrams++;
+    dd_stats_add( DDSTAT_PACKETS_OUT, 1 );
+    dd_stats_add( DDSTAT_BYTES_OUT, length );
+}
+
+static void send_queue( struct ddSendQueueSet* c_restrict set,
+                        struct ddSendQueue* c_restrict queue )
+{
+    uint32_t length = 0;
+    const char* data = wire_datagram( set, queue, &length );
+
+    send_datagram( set, queue, data, length );
+    reset_queue( queue );
+}
+
+void dd_sendq_set_init( struct ddSendQueueSet* c_restrict set,
+                        const struct ddAddressInfo* c_restrict sender,
+                        const uint32_t mtu )
+{
+    *set = ( struct ddSendQueueSet ){
+        .sender = sender,
+        .mtu = mtu == 0 || mtu > DD_SENDQ_MTU ? DD_SENDQ_MTU : mtu,
+    };
+}
+
+void dd_sendq_init( struct ddSendQueue* c_restrict queue,
+                    const struct sockaddr* c_restrict addr,
+                    const socklen_t addr_len )
+{
+    memset( queue, 0, offsetof( struct ddSendQueue, buf ) );
+    memcpy( &queue->addr, addr, addr_len );
+    queue->addr_len = addr_len;
+}
+
+void dd_sendq_discard( struct ddSendQueueSet* c_restrict set,
+                       struct ddSendQueue* c_restrict queue )
+{
+    reset_queue( queue );
+
+    if( !queue->dirty ) return;
+
+    struct ddSendQueue** link = &set->dirty;
+
+    while( *link != queue )
+        link = &( *link )->next_dirty;
+
+    *link = queue->next_dirty;
+    queue->next_dirty = NULL;
+    queue->dirty = false;
+}
+
+bool dd_sendq_push_frame( struct ddSendQueueSet* c_restrict set,
+                          struct ddSendQueue* c_restrict queue,
+                          const char* c_restrict frame,
+                          const int32_t length )
+{
+    const uint32_t needed = DD_BUNDLE_PREFIX_SIZE + (uint32_t)length;
+
+    if( length <= 0 || DDFRAME_HEADER_SIZE + needed > set->mtu )
+    {
+        console_write(
+            LOG_ERROR, "Frame of %d bytes can't be queued\n", length );
+        return false;
+    }
+
+    // no room left, the queued datagram goes now to keep frames in order
+    if( queue->used + needed > set->mtu ) send_queue( set, queue );
+
+    if( queue->used == 0 )
+    {
+        queue->buf[0] = (char)( DDFRAME_MARK | DDFRAME_BUNDLE );
+        queue->used = DDFRAME_HEADER_SIZE;
+    }
+
+    dd_write_u16_le( (uint8_t*)queue->buf + queue->used, (uint16_t)length );
+    memcpy( queue->buf + queue->used + DD_BUNDLE_PREFIX_SIZE,
+            frame,
+            (size_t)length );
+
+    queue->used += needed;
+    queue->count++;
+    set->stats.frames++;
+
+    if( !queue->dirty )
+    {
+        queue->dirty = true;
+        queue->next_dirty = set->dirty;
+        set->dirty = queue;
+    }
+
+    return true;
+}
+
+bool dd_sendq_push_msg( struct ddSendQueueSet* c_restrict set,
+                        struct ddSendQueue* c_restrict queue,
+                        const uint32_t msg_type,
+                        const struct ddMsgVal* c_restrict msg )
+{
+    char frame[MAX_MSG_LENGTH];
+
+    int32_t length = dd_msg_encode( msg_type, msg, frame, sizeof( frame ) );
+
+    if( length == -1 ) return false;
+
+    // decoded strings end at a terminator, which a bundle doesn't put there
+    if( msg_type == DDMSG_STR ) frame[length++] = '\0';
+
+    return dd_sendq_push_frame( set, queue, frame, length );
+}
+
+uint32_t dd_sendq_flush( struct ddSendQueueSet* c_restrict set )
+{
+    const uint64_t sent_before = set->stats.datagrams;
+
+#if DD_PLATFORM == DD_LINUX
+    struct mmsghdr headers[MAX_SEND_BATCH];
+    struct iovec iovecs[MAX_SEND_BATCH];
+
+    while( set->dirty )
+    {
+        // one datagram per queue, so each batch can span many peers
+        uint32_t batch_size = 0;
+        while( set->dirty && batch_size < MAX_SEND_BATCH )
+        {
+            struct ddSendQueue* queue = set->dirty;
+            uint32_t length = 0;
+
+            iovecs[batch_size] = ( struct iovec ){
+                .iov_base = (void*)wire_datagram( set, queue, &length )};
+            iovecs[batch_size].iov_len = length;
+
+            headers[batch_size] = ( struct mmsghdr ){
+                .msg_hdr = {
+                    .msg_name = &queue->addr,
+                    .msg_namelen = queue->addr_len,
+                    .msg_iov = &iovecs[batch_size],
+                    .msg_iovlen = 1,
+                }};
+
+            reset_queue( queue );
+            queue->dirty = false;
+            set->dirty = queue->next_dirty;
+            batch_size++;
+        }
+
+        // sendmmsg stops at the first failing recipient, so skip & resume
+        uint32_t done = 0;
+        while( done < batch_size )
+        {
+            const int32_t rc = sendmmsg(
+                set->sender->socket_fd, headers + done, batch_size - done, 0 );
+
+            set->stats.syscalls++;
+
+            if( rc == -1 )
+            {
+                if( errno == EINTR ) continue;
+
+                set->stats.errors++;
+                dd_stats_add( DDSTAT_SEND_ERRORS, 1 );
+                done++;
+                continue;
+            }
+
+            dd_stats_add( DDSTAT_PACKETS_OUT, (uint64_t)rc );
+
+            for( int32_t i = 0; dd_stats_enabled() && i < rc; i++ )
+                dd_stats_add( DDSTAT_BYTES_OUT, headers[done + i].msg_len );
+
+            done += (uint32_t)rc;
+            set->stats.datagrams += (uint32_t)rc;
+        }
+    }
+#else
+    while( set->dirty )
+    {
+        struct ddSendQueue* queue = set->dirty;
+
+        set->dirty = queue->next_dirty;
+        queue->dirty = false;
+
+        send_queue( set, queue );
+    }
+#endif  // DD_PLATFORM
+
+    return (uint32_t)( set->stats.datagrams - sent_before );
+}
+
+uint32_t dd_sendq_drain( struct ddSendQueueSet* c_restrict set,
+                         dd_sendq_emit_cb emit,
+                         void* ctx )
+{
+    const uint64_t sent_before = set->stats.datagrams;
+
+    while( set->dirty )
+    {
+        struct ddSendQueue* queue = set->dirty;
+
+        set->dirty = queue->next_dirty;
+        queue->dirty = false;
+
+        uint32_t length = 0;
+        const char* data = wire_datagram( set, queue, &length );
+
+        if( emit( ctx,
+                  data,
+                  length,
+                  (const struct sockaddr*)&queue->addr,
+                  queue->addr_len ) )
+            set->stats.datagrams++;
+        else
+            send_datagram( set, queue, data, length );
+
+        reset_queue( queue );
+    }
+
+    return (uint32_t)( set->stats.datagrams - sent_before );
+}
+
+bool dd_bundle_next( const char* c_restrict data,
+                     const int32_t length,
+                     int32_t* c_restrict offset,
+                     const char** c_restrict frame,
+                     int32_t* c_restrict frame_length )
+{
+    if( length <= 0 || *offset >= length ) return false;
+
+    if( (uint8_t)data[0] != ( DDFRAME_MARK | DDFRAME_BUNDLE ) )
+    {
+        // plain datagram, a single frame
+        *frame = data;
+        *frame_length = length;
+        *offset = length;
+        return true;
+    }
+
+    if( *offset == 0 ) *offset = DDFRAME_HEADER_SIZE;
+
+    if( *offset + DD_BUNDLE_PREFIX_SIZE > length ) return false;
+
+    const int32_t size =
+        (int32_t)dd_read_u16_le( (const uint8_t*)data + *offset );
+
+    if( size == 0 || *offset + DD_BUNDLE_PREFIX_SIZE + size > length )
+        return false;
+
+    *frame = data + *offset + DD_BUNDLE_PREFIX_SIZE;
+    *frame_length = size;
+    *offset += DD_BUNDLE_PREFIX_SIZE + size;
+
+    return true;
+}
@@ -1,4 +1,14 @@
+#ifdef __linux__
+#define _GNU_SOURCE  // recvmmsg, sendmmsg
+#endif
+
 #include "ServerInterface.h"
+#include "BufferPool.h"
+#include "SendQueue.h"
+#include "LoopUring.h"
+#include "StatsSegment.h"
+#include "Compress.h"
+#include "WireFormat.h"
 #include "ConsoleWrite.h"
 #include "TimeInterface.h"
 
@@ -7,6 +17,11 @@
 #include <string.h>
 #include <stdarg.h>
 
+#if DD_PLATFORM == DD_LINUX
+#include <netinet/udp.h>  // UDP_SEGMENT, UDP_GRO
+#include <net/if.h>       // if_nametoindex
+#endif  // DD_PLATFORM
+
 #if DD_PLATFORM == DD_WIN32
 
 void dd_server_init_win32()
@@ -51,6 +66,15 @@ static bool create_socket_base( struct ddAddressInfo* c_restrict address,
 {
     if( !address || !ip || !port ) return false;
 
+    // compression & segmentation are opted into per socket
+    address->codec = NULL;
+    address->compress_min = DD_COMPRESS_MIN;
+    address->decompress = false;
+    address->gso = false;
+    address->gro = false;
+    address->rx_timestamps = false;
+    address->multicast = false;
+
     // udp-type socket struct
     memset( &address->hints, 0, sizeof( address->hints ) );
     address->hints.ai_family = AF_UNSPEC;
@@ -125,14 +149,306 @@ static bool create_socket_base( struct ddAddressInfo* c_restrict address,
     return false;
 }
 
-void dd_create_socket( struct ddAddressInfo* c_restrict address,
+static void set_segmentation( struct ddAddressInfo* c_restrict address,
+                              const struct ddSocketOpts* c_restrict opts )
+{
+#if DD_PLATFORM == DD_LINUX
+    int32_t value = 0;
+
+    // a zero segment size is a no-op that fails on kernels w/o UDP_SEGMENT
+    if( opts->udp_gso )
+        address->gso = setsockopt( address->socket_fd,
+                                   IPPROTO_UDP,
+                                   UDP_SEGMENT,
+                                   &value,
+                                   sizeof( value ) ) == 0;
+
+    value = 1;
+
+    if( opts->udp_gro )
+        address->gro = setsockopt( address->socket_fd,
+                                   IPPROTO_UDP,
+                                   UDP_GRO,
+                                   &value,
+                                   sizeof( value ) ) == 0;
+#endif  // DD_PLATFORM
+
+    if( opts->udp_gso && !address->gso )
+        console_write( LOG_WARN, "UDP_SEGMENT not supported\n" );
+
+    if( opts->udp_gro && !address->gro )
+        console_write( LOG_WARN, "UDP_GRO not supported\n" );
+}
+
+static void set_queue_options( struct ddAddressInfo* c_restrict address,
+                               const struct ddSocketOpts* c_restrict opts )
+{
+    const int32_t recv_buffer = opts ? opts->recv_buffer : 0;
+    const int32_t send_buffer = opts ? opts->send_buffer : 0;
+
+    if( recv_buffer > 0 &&
+        setsockopt( address->socket_fd,
+                    SOL_SOCKET,
+                    SO_RCVBUF,
+                    (const char*)&recv_buffer,
+                    sizeof( int32_t ) ) == -1 )
+        console_write( LOG_WARN, "Socket SO_RCVBUF\n" );
+
+    if( send_buffer > 0 &&
+        setsockopt( address->socket_fd,
+                    SOL_SOCKET,
+                    SO_SNDBUF,
+                    (const char*)&send_buffer,
+                    sizeof( int32_t ) ) == -1 )
+        console_write( LOG_WARN, "Socket SO_SNDBUF\n" );
+
+    socklen_t size_len = sizeof( int32_t );
+    getsockopt( address->socket_fd,
+                SOL_SOCKET,
+                SO_RCVBUF,
+                (char*)&address->recv_buffer,
+                &size_len );
+
+    size_len = sizeof( int32_t );
+    getsockopt( address->socket_fd,
+                SOL_SOCKET,
+                SO_SNDBUF,
+                (char*)&address->send_buffer,
+                &size_len );
+
+#if DD_PLATFORM == DD_LINUX
+    // linux doubles the request for its bookkeeping & reports the double
+    const int64_t granted = 2;
+#else
+    const int64_t granted = 1;
+#endif  // DD_PLATFORM
+
+    // silently clamped by the sysctl limits otherwise
+    if( address->recv_buffer < granted * recv_buffer )
+        console_write( LOG_WARN,
+                       "SO_RCVBUF capped at %d bytes ( net.core.rmem_max )\n",
+                       (int32_t)( address->recv_buffer / granted ) );
+
+    if( address->send_buffer < granted * send_buffer )
+        console_write( LOG_WARN,
+                       "SO_SNDBUF capped at %d bytes ( net.core.wmem_max )\n",
+                       (int32_t)( address->send_buffer / granted ) );
+
+#ifdef SO_RXQ_OVFL
+    // the kernel attaches its running drop count to datagrams once the
+    // receive queue has overflowed, see dd_recv_read_control
+    const int32_t overflow = 1;
+
+    address->rxq_overflow = setsockopt( address->socket_fd,
+                                        SOL_SOCKET,
+                                        SO_RXQ_OVFL,
+                                        &overflow,
+                                        sizeof( overflow ) ) == 0;
+
+    if( !address->rxq_overflow )
+        console_write( LOG_WARN, "Socket SO_RXQ_OVFL\n" );
+#endif  // SO_RXQ_OVFL
+
+    if( !opts || !opts->rx_timestamps ) return;
+
+#ifdef SO_TIMESTAMPNS
+    const int32_t yes = 1;
+
+    address->rx_timestamps = setsockopt( address->socket_fd,
+                                         SOL_SOCKET,
+                                         SO_TIMESTAMPNS,
+                                         &yes,
+                                         sizeof( yes ) ) == 0;
+#endif  // SO_TIMESTAMPNS
+
+    if( !address->rx_timestamps )
+        console_write( LOG_WARN, "SO_TIMESTAMPNS not supported\n" );
+}
+
+static bool is_multicast( const struct sockaddr* c_restrict addr )
+{
+    if( addr->sa_family == AF_INET )
+        return IN_MULTICAST(
+            ntohl( ( (const struct sockaddr_in*)addr )->sin_addr.s_addr ) );
+
+    if( addr->sa_family == AF_INET6 )
+        return IN6_IS_ADDR_MULTICAST(
+            &( (const struct sockaddr_in6*)addr )->sin6_addr );
+
+    return false;
+}
+
+// interface index for multicast_iface, 0 lets routing pick
+static bool multicast_iface( const struct ddSocketOpts* c_restrict opts,
+                             uint32_t* c_restrict index )
+{
+    *index = 0;
+
+    if( !opts || !opts->multicast_iface ) return true;
+
+#if DD_PLATFORM == DD_LINUX
+    *index = if_nametoindex( opts->multicast_iface );
+#else
+    // interfaces are only picked by index on linux
+    console_write( LOG_WARN,
+                   "Multicast interface %s ignored, routing picks\n",
+                   opts->multicast_iface );
+    return true;
+#endif  // DD_PLATFORM
+
+    if( *index == 0 )
+    {
+        console_write( LOG_ERROR,
+                       "Unknown multicast interface %s\n",
+                       opts->multicast_iface );
+        return false;
+    }
+
+    return true;
+}
+
+// ttl, loopback & outgoing interface for sends to the group
+static bool set_multicast_send( struct ddAddressInfo* c_restrict address,
+                                const struct ddSocketOpts* c_restrict opts )
+{
+    // ttl 1 keeps the group on the local network unless asked otherwise
+    const int32_t ttl =
+        opts && opts->multicast_ttl > 0 ? opts->multicast_ttl : 1;
+    const int32_t loop = opts && opts->multicast_loop;
+    uint32_t iface;
+
+    if( !multicast_iface( opts, &iface ) ) return false;
+
+    const bool v4 = address->selected->ai_family == AF_INET;
+    const int32_t level = v4 ? IPPROTO_IP : IPPROTO_IPV6;
+
+    if( setsockopt( address->socket_fd,
+                    level,
+                    v4 ? IP_MULTICAST_TTL : IPV6_MULTICAST_HOPS,
+                    (const char*)&ttl,
+                    sizeof( ttl ) ) == -1 ||
+        setsockopt( address->socket_fd,
+                    level,
+                    v4 ? IP_MULTICAST_LOOP : IPV6_MULTICAST_LOOP,
+                    (const char*)&loop,
+                    sizeof( loop ) ) == -1 )
+    {
+        console_write( LOG_ERROR, "Socket multicast ttl/loop\n" );
+        return false;
+    }
+
+    if( !iface ) return true;
+
+    int32_t rc = -1;
+
+    if( v4 )
+    {
+#if DD_PLATFORM == DD_LINUX
+        const struct ip_mreqn request = {.imr_ifindex = (int)iface};
+
+        rc = setsockopt( address->socket_fd,
+                         IPPROTO_IP,
+                         IP_MULTICAST_IF,
+                         &request,
+                         sizeof( request ) );
+#endif  // DD_PLATFORM
+    }
+    else
+        rc = setsockopt( address->socket_fd,
+                         IPPROTO_IPV6,
+                         IPV6_MULTICAST_IF,
+                         (const char*)&iface,
+                         sizeof( iface ) );
+
+    if( rc == -1 ) console_write( LOG_ERROR, "Socket multicast interface\n" );
+
+    return rc != -1;
+}
+
+static bool join_group( struct ddAddressInfo* c_restrict address,
+                        const struct ddSocketOpts* c_restrict opts )
+{
+    uint32_t iface;
+
+    if( !multicast_iface( opts, &iface ) ) return false;
+
+    const struct sockaddr* group = address->selected->ai_addr;
+    int32_t rc;
+
+    if( group->sa_family == AF_INET )
+    {
+#if DD_PLATFORM == DD_LINUX
+        const struct ip_mreqn request = {
+            .imr_multiaddr = ( (const struct sockaddr_in*)group )->sin_addr,
+            .imr_ifindex = (int)iface,
+        };
+#else
+        const struct ip_mreq request = {
+            .imr_multiaddr = ( (const struct sockaddr_in*)group )->sin_addr,
+        };
+#endif  // DD_PLATFORM
+
+        rc = setsockopt( address->socket_fd,
+                         IPPROTO_IP,
+                         IP_ADD_MEMBERSHIP,
+                         (const char*)&request,
+                         sizeof( request ) );
+    }
+    else
+    {
+        const struct ipv6_mreq request = {
+            .ipv6mr_multiaddr =
+                ( (const struct sockaddr_in6*)group )->sin6_addr,
+            .ipv6mr_interface = iface,
+        };
+
+        rc = setsockopt( address->socket_fd,
+                         IPPROTO_IPV6,
+                         IPV6_JOIN_GROUP,
+                         (const char*)&request,
+                         sizeof( request ) );
+    }
+
+    if( rc == -1 ) console_write( LOG_ERROR, "Multicast group join\n" );
+
+    return rc != -1;
+}
+
+bool dd_create_socket( struct ddAddressInfo* c_restrict address,
                        const char* const c_restrict ip,
                        const char* const c_restrict port,
-                       const bool create_server )
+                       const bool create_server,
+                       const struct ddSocketOpts* c_restrict opts )
 {
     const bool success = create_socket_base( address, ip, port );
 
-    if( !success ) return;
+    if( !success ) return false;
+
+    if( opts && opts->codec )
+    {
+        address->codec = opts->codec;
+
+        if( opts->compress_min ) address->compress_min = opts->compress_min;
+    }
+
+    if( opts )
+        address->decompress = opts->accept_compressed || opts->codec != NULL;
+
+    if( opts && ( opts->udp_gso || opts->udp_gro ) )
+        set_segmentation( address, opts );
+
+    set_queue_options( address, opts );
+
+    address->multicast = is_multicast( address->selected->ai_addr );
+
+    if( address->multicast && !create_server &&
+        !set_multicast_send( address, opts ) )
+    {
+        dd_close_socket( &address->socket_fd );
+        freeaddrinfo( address->options );
+        address->selected = NULL;
+        return false;
+    }
 
     if( create_server )
     {
@@ -143,7 +459,7 @@ void dd_create_socket( struct ddAddressInfo* c_restrict address,
         if( address->selected == NULL )
         {
             console_write( LOG_ERROR, "Server failed to bind\n" );
-            return;
+            return false;
         }
 
         // free port if blocked from use
@@ -155,18 +471,46 @@ void dd_create_socket( struct ddAddressInfo* c_restrict address,
                         sizeof( int32_t ) ) == -1 )
         {
             console_write( LOG_ERROR, "Socket port reuse\n" );
-            return;
+            return false;
         }
 
+#ifdef SO_REUSEPORT
+        // several sockets share the port & the kernel hashes senders to them
+        if( opts && opts->reuse_port &&
+            setsockopt( address->socket_fd,
+                        SOL_SOCKET,
+                        SO_REUSEPORT,
+                        (const char*)&yes,
+                        sizeof( int32_t ) ) == -1 )
+        {
+            console_write( LOG_ERROR, "Socket SO_REUSEPORT\n" );
+            return false;
+        }
+#else
+        if( opts && opts->reuse_port )
+            console_write( LOG_WARN, "SO_REUSEPORT not supported\n" );
+#endif  // SO_REUSEPORT
+
         // bind socket to port
         if( bind( address->socket_fd,
                   address->selected->ai_addr,
                   (int)address->selected->ai_addrlen ) == -1 )
         {
             dd_close_socket( &address->socket_fd );
+            freeaddrinfo( address->options );
+            address->selected = NULL;
 
             console_write( LOG_ERROR, "Socket bind\n" );
-            return;
+            return false;
+        }
+
+        // bound to the group itself, so only its datagrams arrive
+        if( address->multicast && !join_group( address, opts ) )
+        {
+            dd_close_socket( &address->socket_fd );
+            freeaddrinfo( address->options );
+            address->selected = NULL;
+            return false;
         }
 
         freeaddrinfo( address->options );
@@ -176,7 +520,7 @@ void dd_create_socket( struct ddAddressInfo* c_restrict address,
 #endif
     }
 
-    return;
+    return true;
 }
 
 bool dd_create_socket2( struct ddAddressInfo* c_restrict address,
@@ -203,221 +547,1758 @@ bool dd_create_socket2( struct ddAddressInfo* c_restrict address,
     return create_socket_base( address, ip_str, port_str );
 }
 
-void dd_server_send_msg( const struct ddAddressInfo* c_restrict recipient,
-                         const uint32_t msg_type,
-                         const struct ddMsgVal* c_restrict msg )
+// frame kind ( bit index ) of a DDMSG_* flag, -1 if not a single known type
+static int32_t msg_kind( const uint32_t msg_type )
 {
-    size_t msg_length = 0;
-    int32_t bytes_sent = 0;
-    char output[MAX_MSG_LENGTH];
+    if( msg_type == 0 || ( msg_type & ( msg_type - 1 ) ) != 0 ||
+        msg_type > DDMSG_BOOL )
+        return -1;
+
+    int32_t kind = 0;
+    while( ( 1u << kind ) != msg_type ) kind++;
+
+    return kind;
+}
+
+// vector width of numeric types ( 0 for others )
+static uint32_t msg_components( const uint32_t msg_type )
+{
+    switch( msg_type )
+    {
+        case DDMSG_FLOAT1:
+        case DDMSG_INT1:
+            return 1;
+        case DDMSG_FLOAT2:
+        case DDMSG_INT2:
+            return 2;
+        case DDMSG_FLOAT3:
+        case DDMSG_INT3:
+            return 3;
+        case DDMSG_FLOAT4:
+        case DDMSG_INT4:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+// 0x80-0xBF, the continuation bytes no UTF-8 text starts with
+static bool is_frame_byte( const uint8_t byte )
+{
+    return ( byte & 0xc0 ) == DDFRAME_MARK;
+}
+
+int32_t dd_msg_encode( const uint32_t msg_type,
+                       const struct ddMsgVal* c_restrict msg,
+                       char* c_restrict output,
+                       const uint32_t output_size )
+{
+    const int32_t kind = msg_kind( msg_type );
+
+    if( kind == -1 )
+    {
+        console_write( LOG_ERROR, "Message type unrecognized\n" );
+        return -1;
+    }
+
+    uint8_t* out = (uint8_t*)output;
+    uint32_t payload = 0;
+    uint32_t header = DDFRAME_HEADER_SIZE;
 
-    // format message for compression (if implemented)
     switch( msg_type )
     {
         case DDMSG_STR:
-            msg_length = strnlen( msg->c, MAX_MSG_LENGTH - 1 );
-            snprintf( output, msg_length + 1, "%s", msg->c );
+            // plain text for existing clients, unless it would read as a frame
+            if( msg->c[0] != '\0' && !is_frame_byte( (uint8_t)msg->c[0] ) )
+                header = 0;
+
+            // leave room for the terminator added on receive
+            payload = (uint32_t)strnlen( msg->c, MAX_MSG_LENGTH - header - 1 );
+
+            // longer payloads go through dd_frag_send_to
+            if( msg->c[payload] != '\0' )
+                console_write( LOG_WARN,
+                               "String truncated to %u bytes\n",
+                               payload );
+            break;
+        case DDMSG_BOOL:
+            payload = 1;
             break;
         default:
-            console_write( LOG_ERROR, "Message type unrecognized\n" );
-            return;
+            // int & float share the same 32-bit layout in the union
+            payload = msg_components( msg_type ) * sizeof( uint32_t );
+            break;
     }
 
-    if( ( bytes_sent = sendto( recipient->socket_fd,
-                               output,
-                               (int)msg_length,
-                               0,
-                               recipient->selected->ai_addr,
-                               (int)recipient->selected->ai_addrlen ) ) == -1 )
+    if( payload + header > output_size )
     {
-        console_write( LOG_ERROR, "sendto Failure\n" );
-        return;
+        console_write( LOG_ERROR, "Message encode buffer too small\n" );
+        return -1;
     }
 
-#ifdef VERBOSE
-    void* addr;
-    struct addrinfo* recvr = recipient->selected;
-    char ip_str[INET6_ADDRSTRLEN];
+    if( header ) out[0] = (uint8_t)( DDFRAME_MARK | kind );
 
-    if( recvr->ai_family == AF_INET )
-        addr = &( ( (struct sockaddr_in*)recvr )->sin_addr );  // IPv4
+    if( msg_type == DDMSG_STR )
+        memcpy( out + header, msg->c, payload );
+    else if( msg_type == DDMSG_BOOL )
+        out[DDFRAME_HEADER_SIZE] = msg->b ? 1 : 0;
     else
-        addr = &( ( (struct sockaddr_in6*)recvr )->sin6_addr );  // IPv6
-
-    inet_ntop(
-        recvr->ai_family, (struct sockaddr*)addr, ip_str, sizeof( ip_str ) );
+    {
+        for( uint32_t i = 0; i < payload / sizeof( uint32_t ); i++ )
+            dd_write_u32_le(
+                out + DDFRAME_HEADER_SIZE + i * sizeof( uint32_t ),
+                (uint32_t)msg->i[i] );
+    }
 
-    console_write( LOG_NOTAG,
-                   "Sent %zuB out of %uB to %s on port %u\n",
-                   bytes_sent,
-                   msg_length,
-                   ip_str,
-                   recipient->port_num );
-#endif
+    return (int32_t)( payload + header );
 }
 
-void dd_server_recieve_msg( const struct ddAddressInfo* c_restrict listener,
-                            struct ddRecvMsg* msg_data )
+uint32_t dd_msg_decode( const char* c_restrict data,
+                        const int32_t length,
+                        struct ddMsgVal* c_restrict msg )
 {
-    msg_data->sender = ( struct sockaddr_storage ){0};
-    msg_data->addr_len = sizeof( msg_data->sender );
+    if( !data || length <= 0 ) return 0;
 
-    msg_data->bytes_read = recvfrom( listener->socket_fd,
-                                     msg_data->msg,
-                                     MAX_MSG_LENGTH - 1,
-                                     0,
-                                     (struct sockaddr*)&( msg_data->sender ),
-                                     &( msg_data->addr_len ) );
+    const uint8_t* in = (const uint8_t*)data;
 
-    if( msg_data->bytes_read == -1 )
+    // unframed text from plain udp clients
+    if( !is_frame_byte( in[0] ) )
     {
-        console_write( LOG_ERROR, "recvfrom Error\n" );
-        return;
+        msg->c = data;
+        return DDMSG_STR;
     }
 
-    msg_data->msg[msg_data->bytes_read] = '\0';
-
-#ifdef VERBOSE
-    char ip_str[INET6_ADDRSTRLEN];
-
-    struct sockaddr* sender_soc = (struct sockaddr*)&msg_data->sender;
-    void* sender_addr = NULL;
-
-    if( sender_soc->sa_family == AF_INET )
-        sender_addr = &( ( (struct sockaddr_in*)sender_soc )->sin_addr );
-    else
-        sender_addr = &( ( (struct sockaddr_in6*)sender_soc )->sin6_addr );
-
-    console_write( LOG_STATUS,
-                   "Recived %zdB packet from: %s\n",
-                   msg_data->bytes_read,
-                   inet_ntop( msg_data->sender.ss_family,
-                              (struct sockaddr*)sender_addr,
-                              ip_str,
-                              sizeof( ip_str ) ) );
-#endif
-}
+    if( ( in[0] & ~DDFRAME_KIND_MASK ) != DDFRAME_MARK ) return 0;
 
-struct ddLoop dd_server_new_loop( dd_loop_cb loop_cb,
-                                  struct ddAddressInfo* listener )
-{
-    return ( struct ddLoop ){
-        .start_time = 0,
-        .active_time = 0,
-        .timers_count = 0,
-        .listener = listener,
-        .callback = loop_cb,
-        .active = true,
-    };
-}
+    const uint32_t msg_type = 1u << ( in[0] & DDFRAME_KIND_MASK );
+    const uint32_t payload = (uint32_t)length - DDFRAME_HEADER_SIZE;
 
-void dd_loop_add_timer( struct ddLoop* c_restrict loop,
-                        dd_timer_cb timer_cb,
-                        double seconds,
-                        bool repeat )
-{
-    if( loop->timers_count >= MAX_ACTIVE_TIMERS )
+    switch( msg_type )
     {
-        console_write( LOG_ERROR, "Loop timer limit reached. Abort add\n" );
-        return;
+        case DDMSG_STR:
+            // receive path null-terminates the buffer
+            msg->c = data + DDFRAME_HEADER_SIZE;
+            return msg_type;
+        case DDMSG_BOOL:
+            if( payload != 1 ) return 0;
+
+            msg->b = in[DDFRAME_HEADER_SIZE] != 0;
+            return msg_type;
+        default:
+            break;
     }
 
-    loop->timer_cbs[loop->timers_count] = timer_cb;
+    const uint32_t components = msg_components( msg_type );
 
-    loop->timer_update[loop->timers_count] = 0;
+    if( components == 0 || payload != components * sizeof( uint32_t ) )
+        return 0;
 
-    loop->timers[loop->timers_count] = ( struct ddServerTimer ){
-        .tick_rate = seconds_to_nano( seconds ), .repeat = repeat,
-    };
+    for( uint32_t i = 0; i < components; i++ )
+        msg->i[i] = (int32_t)dd_read_u32_le( in + DDFRAME_HEADER_SIZE +
+                                             i * sizeof( uint32_t ) );
 
-    loop->timers_count++;
+    return msg_type;
 }
 
-int64_t dd_loop_time_nano( struct ddLoop* c_restrict loop )
+static void print_frame( const char* c_restrict frame, const int32_t length )
 {
-    return loop->active_time - loop->start_time;
+    struct ddMsgVal val;
+    const uint32_t msg_type = dd_msg_decode( frame, length, &val );
+
+    switch( msg_type )
+    {
+        case DDMSG_STR:
+            console_write( LOG_NOTAG, "Data recieved: %s\n", val.c );
+            break;
+        case DDMSG_BOOL:
+            console_write(
+                LOG_NOTAG, "Data recieved: %s\n", val.b ? "true" : "false" );
+            break;
+        case DDMSG_FLOAT1:
+        case DDMSG_FLOAT2:
+        case DDMSG_FLOAT3:
+        case DDMSG_FLOAT4:
+            console_write( LOG_NOTAG,
+                           "Data recieved: %f %f %f %f\n",
+                           val.f[0],
+                           msg_type > DDMSG_FLOAT1 ? val.f[1] : 0.f,
+                           msg_type > DDMSG_FLOAT2 ? val.f[2] : 0.f,
+                           msg_type > DDMSG_FLOAT3 ? val.f[3] : 0.f );
+            break;
+        case DDMSG_INT1:
+        case DDMSG_INT2:
+        case DDMSG_INT3:
+        case DDMSG_INT4:
+            console_write( LOG_NOTAG,
+                           "Data recieved: %d %d %d %d\n",
+                           val.i[0],
+                           msg_type > DDMSG_INT1 ? val.i[1] : 0,
+                           msg_type > DDMSG_INT2 ? val.i[2] : 0,
+                           msg_type > DDMSG_INT3 ? val.i[3] : 0 );
+            break;
+        default:
+            console_write( LOG_WARN, "Malformed message dropped\n" );
+            break;
+    }
 }
 
-double dd_loop_time_seconds( struct ddLoop* c_restrict loop )
+void dd_msg_print( const char* c_restrict data, const int32_t length )
 {
-    return nano_to_seconds( loop->active_time - loop->start_time );
+    int32_t offset = 0;
+    const char* frame;
+    int32_t frame_length;
+
+    // a sender's ddSendQueue may have bundled several frames
+    while( dd_bundle_next( data, length, &offset, &frame, &frame_length ) )
+        print_frame( frame, frame_length );
 }
 
-void dd_loop_break( struct ddLoop* loop )
+#ifdef VERBOSE
+static const char* addr_to_str( const struct sockaddr* c_restrict addr,
+                                char* c_restrict ip_str,
+                                const socklen_t ip_str_size,
+                                uint32_t* c_restrict port )
 {
-    loop->active = false;
-    console_restore_stdin();
+    const void* ip = NULL;
+
+    if( addr->sa_family == AF_INET )
+    {
+        ip = &( (const struct sockaddr_in*)addr )->sin_addr;  // IPv4
+        *port = ntohs( ( (const struct sockaddr_in*)addr )->sin_port );
+    }
+    else
+    {
+        ip = &( (const struct sockaddr_in6*)addr )->sin6_addr;  // IPv6
+        *port = ntohs( ( (const struct sockaddr_in6*)addr )->sin6_port );
+    }
+
+    return inet_ntop( addr->sa_family, ip, ip_str, ip_str_size );
 }
+#endif  // VERBOSE
 
-void dd_loop_run( struct ddLoop* loop )
+void dd_server_send_to( const struct ddAddressInfo* c_restrict sender,
+                        const struct sockaddr* c_restrict addr,
+                        const socklen_t addr_len,
+                        const uint32_t msg_type,
+                        const struct ddMsgVal* c_restrict msg )
 {
-    fd_set master;
-    fd_set read_fd;
-    FD_ZERO( &master );
-    FD_ZERO( &read_fd );
+    int32_t bytes_sent = 0;
+    char output[MAX_MSG_LENGTH];
+    char packed[MAX_MSG_LENGTH];
 
-    int32_t fdmax = (int)loop->listener->socket_fd;  // ignored on windows lol
-    FD_SET( fdmax, &master );
+    int32_t msg_length =
+        dd_msg_encode( msg_type, msg, output, sizeof( output ) );
 
-    loop->start_time = loop->active_time = get_high_res_time();
+    if( msg_length == -1 ) return;
 
-    for( uint32_t i = 0; i < loop->timers_count; i++ )
-        loop->timer_update[i] = loop->start_time;
+    const char* wire = dd_compress_stage(
+        sender, output, &msg_length, packed, sizeof( packed ) );
 
-    while( loop->active )
+    if( ( bytes_sent = sendto( sender->socket_fd,
+                               wire,
+                               (int)msg_length,
+                               0,
+                               addr,
+                               (int)addr_len ) ) == -1 )
     {
-        console_collect_stdin();
-
-        // usec == 1e-6 sec
-        struct timeval select_timeout = {
-            .tv_sec = 0, .tv_usec = 1000,
-        };
+        dd_stats_add( DDSTAT_SEND_ERRORS, 1 );
+        console_write( LOG_ERROR, "sendto Failure\n" );
+        return;
+    }
 
-        read_fd = master;
+    dd_stats_add( DDSTAT_PACKETS_OUT, 1 );
+    dd_stats_add( DDSTAT_BYTES_OUT, (uint64_t)bytes_sent );
 
-        int32_t rc = select( fdmax + 1, &read_fd, NULL, NULL, &select_timeout );
+#ifdef VERBOSE
+    char ip_str[INET6_ADDRSTRLEN];
+    uint32_t port = 0;
 
-        if( rc == -1 )
-        {
-            console_write( LOG_ERROR, "Select error\n" );
-            break;
-        }
+    addr_to_str( addr, ip_str, sizeof( ip_str ), &port );
 
-        // process data thru callback
-        if( rc == 1 ) loop->callback( loop );
+    console_write( LOG_NOTAG,
+                   "Sent %dB out of %dB to %s on port %u\n",
+                   bytes_sent,
+                   msg_length,
+                   ip_str,
+                   port );
+#endif
+}
 
-        if( !loop->active ) return;
+void dd_server_send_msg( const struct ddAddressInfo* c_restrict recipient,
+                         const uint32_t msg_type,
+                         const struct ddMsgVal* c_restrict msg )
+{
+    dd_server_send_to( recipient,
+                       recipient->selected->ai_addr,
+                       (socklen_t)recipient->selected->ai_addrlen,
+                       msg_type,
+                       msg );
+}
 
-        // check timers
-        uint32_t timer_idx = 0;
-        while( timer_idx < loop->timers_count )
-        {
-            const uint64_t delta =
-                loop->active_time - loop->timer_update[timer_idx];
+uint32_t dd_server_send_many( const struct ddAddressInfo* c_restrict sender,
+                              const char* c_restrict data,
+                              const int32_t length,
+                              const struct sockaddr* const* addrs,
+                              const socklen_t* addr_lens,
+                              const uint32_t count,
+                              int32_t* c_restrict errors )
+{
+    uint32_t sent_count = 0;
 
-            struct ddServerTimer* timer = &loop->timers[timer_idx];
+#if DD_PLATFORM == DD_LINUX
+    struct iovec payload = {.iov_base = (void*)data, .iov_len = (size_t)length};
+    struct mmsghdr headers[MAX_SEND_BATCH];
+    uint32_t owners[MAX_SEND_BATCH];
 
-            // update timers
-            if( timer->tick_rate < delta )
+    uint32_t next = 0;
+    while( next < count )
+    {
+        // gather next batch of valid destinations
+        uint32_t batch_size = 0;
+        for( ; next < count && batch_size < MAX_SEND_BATCH; next++ )
+        {
+            if( !addrs[next] )
             {
-                loop->timer_cbs[timer_idx]( loop, timer );
+                if( errors ) errors[next] = EDESTADDRREQ;
+                continue;
+            }
 
-                if( !loop->active ) return;
+            headers[batch_size] = ( struct mmsghdr ){
+                .msg_hdr = {
+                    .msg_name = (void*)addrs[next],
+                    .msg_namelen = addr_lens[next],
+                    .msg_iov = &payload,
+                    .msg_iovlen = 1,
+                }};
+            owners[batch_size++] = next;
+        }
 
-                if( timer->repeat )
-                    loop->timer_update[timer_idx] = loop->active_time;
-                else
-                {
-                    loop->timers_count--;
+        // sendmmsg stops at the first failing recipient, so skip & resume
+        uint32_t done = 0;
+        while( done < batch_size )
+        {
+            const int32_t rc = sendmmsg(
+                sender->socket_fd, headers + done, batch_size - done, 0 );
 
-                    loop->timers[timer_idx] = loop->timers[loop->timers_count];
-                    continue;
-                }
+            if( rc == -1 )
+            {
+                if( errno == EINTR ) continue;
+
+                if( errors ) errors[owners[done]] = errno;
+                done++;
+                continue;
             }
 
-            timer_idx++;
-        }
+            for( int32_t i = 0; i < rc; i++ )
+                if( errors ) errors[owners[done + i]] = 0;
 
-        loop->active_time = get_high_res_time();
+            done += (uint32_t)rc;
+            sent_count += (uint32_t)rc;
+        }
     }
+#else
+    for( uint32_t i = 0; i < count; i++ )
+    {
+        int32_t status = EDESTADDRREQ;
+
+        if( addrs[i] )
+        {
+            status = sendto( sender->socket_fd,
+                             data,
+                             length,
+                             0,
+                             addrs[i],
+                             (int)addr_lens[i] ) == -1
+                         ? errno
+                         : 0;
+        }
+
+        if( status == 0 ) sent_count++;
+        if( errors ) errors[i] = status;
+    }
+#endif  // DD_PLATFORM
+
+    dd_stats_add( DDSTAT_PACKETS_OUT, sent_count );
+    dd_stats_add( DDSTAT_BYTES_OUT, (uint64_t)sent_count * (uint64_t)length );
+    dd_stats_add( DDSTAT_SEND_ERRORS, count - sent_count );
+
+    return sent_count;
+}
+
+#if DD_PLATFORM == DD_LINUX
+union segment_control
+{
+    char buf[CMSG_SPACE( sizeof( uint16_t ) )];
+    struct cmsghdr align;
+};
+#endif  // DD_PLATFORM
+
+uint32_t dd_server_send_segments( const struct ddAddressInfo* c_restrict sender,
+                                  const char* c_restrict data,
+                                  const uint32_t length,
+                                  const uint32_t segment_size,
+                                  const struct sockaddr* c_restrict addr,
+                                  const socklen_t addr_len )
+{
+    // receivers w/o UDP_GRO read at most MAX_MSG_LENGTH - 1 bytes
+    if( segment_size == 0 || segment_size >= MAX_MSG_LENGTH ) return 0;
+
+    const uint32_t count = ( length + segment_size - 1 ) / segment_size;
+    uint32_t sent_count = 0;
+
+#if DD_PLATFORM == DD_LINUX
+    struct mmsghdr headers[MAX_SEND_BATCH];
+    struct iovec iovecs[MAX_SEND_BATCH];
+    union segment_control controls[MAX_SEND_BATCH];
+    uint32_t segments[MAX_SEND_BATCH];
+
+    // datagrams per message
+    uint32_t run = 1;
+    if( sender->gso )
+    {
+        run = DD_GSO_MAX_BYTES / segment_size;
+        if( run > DD_GSO_MAX_SEGMENTS ) run = DD_GSO_MAX_SEGMENTS;
+    }
+
+    uint32_t next = 0;
+    bool failed = false;
+    while( next < count && !failed )
+    {
+        uint32_t batch_size = 0;
+        for( uint32_t queued = next;
+             queued < count && batch_size < MAX_SEND_BATCH;
+             batch_size++ )
+        {
+            const uint32_t offset = queued * segment_size;
+            const uint32_t runs = count - queued < run ? count - queued : run;
+            const uint32_t bytes = runs * segment_size < length - offset
+                                       ? runs * segment_size
+                                       : length - offset;
+
+            iovecs[batch_size] = ( struct iovec ){
+                .iov_base = (void*)( data + offset ), .iov_len = bytes};
+
+            struct msghdr* header = &headers[batch_size].msg_hdr;
+            *header = ( struct msghdr ){
+                .msg_name = (void*)addr,
+                .msg_namelen = addr_len,
+                .msg_iov = &iovecs[batch_size],
+                .msg_iovlen = 1,
+            };
+
+            if( runs > 1 )
+            {
+                const uint16_t gso_size = (uint16_t)segment_size;
+
+                header->msg_control = controls[batch_size].buf;
+                header->msg_controllen = sizeof( controls[batch_size].buf );
+
+                struct cmsghdr* cmsg = CMSG_FIRSTHDR( header );
+                cmsg->cmsg_level = IPPROTO_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN( sizeof( gso_size ) );
+                memcpy( CMSG_DATA( cmsg ), &gso_size, sizeof( gso_size ) );
+            }
+
+            segments[batch_size] = runs;
+            queued += runs;
+        }
+
+        uint32_t done = 0;
+        while( done < batch_size )
+        {
+            const int32_t rc = sendmmsg(
+                sender->socket_fd, headers + done, batch_size - done, 0 );
+
+            if( rc == -1 )
+            {
+                if( errno == EINTR ) continue;
+
+                // EIO when the route's device can't offload checksums,
+                // resend the rest one datagram per message
+                if( run > 1 && ( errno == EIO || errno == EINVAL ) )
+                {
+                    run = 1;
+                    break;
+                }
+
+                console_write( LOG_ERROR, "sendmmsg Failure\n" );
+                dd_stats_add( DDSTAT_SEND_ERRORS, 1 );
+                failed = true;
+                break;
+            }
+
+            for( int32_t i = 0; i < rc; i++ )
+            {
+                next += segments[done + i];
+                sent_count += segments[done + i];
+            }
+
+            done += (uint32_t)rc;
+        }
+    }
+#else
+    for( uint32_t i = 0; i < count; i++ )
+    {
+        const uint32_t offset = i * segment_size;
+        const uint32_t bytes = length - offset < segment_size
+                                   ? length - offset
+                                   : segment_size;
+
+        if( sendto( sender->socket_fd,
+                    data + offset,
+                    (int)bytes,
+                    0,
+                    addr,
+                    (int)addr_len ) == -1 )
+        {
+            console_write( LOG_ERROR, "sendto Failure\n" );
+            dd_stats_add( DDSTAT_SEND_ERRORS, 1 );
+            break;
+        }
+
+        sent_count++;
+    }
+#endif  // DD_PLATFORM
+
+    // segments go out in order, so the sent ones are a prefix of data
+    const uint64_t bytes_sent = (uint64_t)sent_count * segment_size;
+
+    dd_stats_add( DDSTAT_PACKETS_OUT, sent_count );
+    dd_stats_add( DDSTAT_BYTES_OUT, bytes_sent < length ? bytes_sent : length );
+
+    return sent_count;
+}
+
+bool dd_server_send_group( const struct ddAddressInfo* c_restrict sender,
+                           const char* c_restrict data,
+                           const int32_t length,
+                           int32_t* c_restrict error )
+{
+    if( !sender->multicast || !sender->selected )
+    {
+        if( error ) *error = EDESTADDRREQ;
+        return false;
+    }
+
+    const struct sockaddr* group = sender->selected->ai_addr;
+    const socklen_t group_len = (socklen_t)sender->selected->ai_addrlen;
+
+    return dd_server_send_many(
+               sender, data, length, &group, &group_len, 1, error ) == 1;
+}
+
+uint32_t dd_server_broadcast_msg(
+    const struct ddAddressInfo* c_restrict sender,
+    const struct ddAddressInfo* c_restrict recipients,
+    const uint32_t count,
+    const uint32_t msg_type,
+    const struct ddMsgVal* c_restrict msg,
+    int32_t* c_restrict errors )
+{
+    char output[MAX_MSG_LENGTH];
+    char packed[MAX_MSG_LENGTH];
+    uint32_t sent_count = 0;
+
+    // encode & compress once for every recipient
+    int32_t msg_length =
+        dd_msg_encode( msg_type, msg, output, sizeof( output ) );
+
+    if( msg_length == -1 )
+    {
+        if( errors )
+            for( uint32_t i = 0; i < count; i++ ) errors[i] = EINVAL;
+        return 0;
+    }
+
+    const char* wire = dd_compress_stage(
+        sender, output, &msg_length, packed, sizeof( packed ) );
+
+    if( sender->multicast )
+    {
+        if( count == 0 ) return 0;
+
+        int32_t error = 0;
+        const bool sent =
+            dd_server_send_group( sender, wire, msg_length, &error );
+
+        if( errors )
+            for( uint32_t i = 0; i < count; i++ ) errors[i] = error;
+
+        return sent ? 1 : 0;
+    }
+
+    const struct sockaddr* addrs[MAX_SEND_BATCH];
+    socklen_t addr_lens[MAX_SEND_BATCH];
+
+    for( uint32_t base = 0; base < count; base += MAX_SEND_BATCH )
+    {
+        const uint32_t batch_size =
+            count - base < MAX_SEND_BATCH ? count - base : MAX_SEND_BATCH;
+
+        for( uint32_t i = 0; i < batch_size; i++ )
+        {
+            const struct addrinfo* addr = recipients[base + i].selected;
+
+            addrs[i] = addr ? addr->ai_addr : NULL;
+            addr_lens[i] = addr ? (socklen_t)addr->ai_addrlen : 0;
+        }
+
+        sent_count += dd_server_send_many( sender,
+                                           wire,
+                                           msg_length,
+                                           addrs,
+                                           addr_lens,
+                                           batch_size,
+                                           errors ? errors + base : NULL );
+    }
+
+#ifdef VERBOSE
+    console_write( LOG_NOTAG,
+                   "Broadcast %dB to %u of %u recipients\n",
+                   msg_length,
+                   sent_count,
+                   count );
+#endif
+
+    return sent_count;
+}
+
+#ifdef VERBOSE
+static void log_recieved( const struct ddRecvMsg* c_restrict msg_data )
+{
+    char ip_str[INET6_ADDRSTRLEN];
+
+    struct sockaddr* sender_soc = (struct sockaddr*)&msg_data->sender;
+    void* sender_addr = NULL;
+
+    if( sender_soc->sa_family == AF_INET )
+        sender_addr = &( ( (struct sockaddr_in*)sender_soc )->sin_addr );
+    else
+        sender_addr = &( ( (struct sockaddr_in6*)sender_soc )->sin6_addr );
+
+    console_write( LOG_STATUS,
+                   "Recived %zdB packet from: %s\n",
+                   msg_data->bytes_read,
+                   inet_ntop( msg_data->sender.ss_family,
+                              (struct sockaddr*)sender_addr,
+                              ip_str,
+                              sizeof( ip_str ) ) );
+}
+#endif  // VERBOSE
+
+static void recieve_raw( struct ddAddressInfo* c_restrict listener,
+                         struct ddRecvMsg* c_restrict msg_data )
+{
+    msg_data->sender = ( struct sockaddr_storage ){0};
+    msg_data->addr_len = sizeof( msg_data->sender );
+    msg_data->arrival = 0;
+
+#if DD_PLATFORM == DD_LINUX
+    if( listener->rx_timestamps || listener->rxq_overflow )
+    {
+        // recvmsg for the arrival time & drop count in the control data
+        union
+        {
+            char buf[DD_RECV_CONTROL_SIZE];
+            struct cmsghdr align;
+        } control;
+
+        struct iovec iov = {
+            .iov_base = msg_data->msg, .iov_len = MAX_MSG_LENGTH - 1};
+        struct msghdr header = {
+            .msg_name = &msg_data->sender,
+            .msg_namelen = msg_data->addr_len,
+            .msg_iov = &iov,
+            .msg_iovlen = 1,
+            .msg_control = control.buf,
+            .msg_controllen = sizeof( control.buf ),
+        };
+
+        msg_data->bytes_read =
+            (int32_t)recvmsg( listener->socket_fd, &header, 0 );
+        msg_data->addr_len = header.msg_namelen;
+
+        if( msg_data->bytes_read != -1 )
+            msg_data->arrival = dd_recv_read_control( listener, &header );
+    }
+    else
+#endif  // DD_PLATFORM
+        msg_data->bytes_read =
+            recvfrom( listener->socket_fd,
+                      msg_data->msg,
+                      MAX_MSG_LENGTH - 1,
+                      0,
+                      (struct sockaddr*)&( msg_data->sender ),
+                      &( msg_data->addr_len ) );
+
+    if( msg_data->bytes_read == -1 )
+    {
+        dd_stats_add( DDSTAT_RECV_ERRORS, 1 );
+        console_write( LOG_ERROR, "recvfrom Error\n" );
+        return;
+    }
+
+    dd_stats_add( DDSTAT_PACKETS_IN, 1 );
+    dd_stats_add( DDSTAT_BYTES_IN, (uint64_t)msg_data->bytes_read );
+
+    msg_data->msg[msg_data->bytes_read] = '\0';
+}
+
+void dd_server_recieve_msg( struct ddAddressInfo* c_restrict listener,
+                            struct ddRecvMsg* msg_data )
+{
+    recieve_raw( listener, msg_data );
+
+    if( msg_data->bytes_read == -1 ) return;
+
+    if( listener->decompress ) dd_decompress_in_place( msg_data );
+
+#ifdef VERBOSE
+    log_recieved( msg_data );
+#endif
+}
+
+bool dd_recv_batch_init( struct ddRecvBatch* c_restrict batch,
+                         const uint32_t capacity )
+{
+    *batch = ( struct ddRecvBatch ){.capacity = capacity};
+
+    if( capacity == 0 ) return false;
+
+    batch->msgs = calloc( capacity, sizeof( *batch->msgs ) );
+
+#if DD_PLATFORM == DD_LINUX
+    batch->headers = calloc( capacity, sizeof( *batch->headers ) );
+    batch->iovecs = calloc( capacity, sizeof( *batch->iovecs ) );
+    batch->controls = calloc( capacity, DD_RECV_CONTROL_SIZE );
+
+    if( batch->msgs && batch->headers && batch->iovecs && batch->controls )
+    {
+        // slots never move, so the kernel descriptors are wired up once
+        for( uint32_t i = 0; i < capacity; i++ )
+        {
+            batch->iovecs[i].iov_base = batch->msgs[i].msg;
+            batch->iovecs[i].iov_len = MAX_MSG_LENGTH - 1;
+
+            batch->headers[i].msg_hdr.msg_name = &batch->msgs[i].sender;
+            batch->headers[i].msg_hdr.msg_iov = &batch->iovecs[i];
+            batch->headers[i].msg_hdr.msg_iovlen = 1;
+            batch->headers[i].msg_hdr.msg_control =
+                batch->controls + (size_t)i * DD_RECV_CONTROL_SIZE;
+        }
+        return true;
+    }
+#else
+    if( batch->msgs ) return true;
+#endif  // DD_PLATFORM
+
+    console_write( LOG_ERROR, "Receive batch allocation failed\n" );
+    dd_recv_batch_free( batch );
+    return false;
+}
+
+void dd_recv_batch_free( struct ddRecvBatch* c_restrict batch )
+{
+    free( batch->msgs );
+    free( batch->headers );
+    free( batch->iovecs );
+    free( batch->coalesced );
+    free( batch->controls );
+
+    *batch = ( struct ddRecvBatch ){0};
+}
+
+#if DD_PLATFORM == DD_LINUX
+
+uint64_t dd_recv_read_control( struct ddAddressInfo* c_restrict listener,
+                               struct msghdr* c_restrict header )
+{
+    uint64_t arrival = 0;
+
+    if( !header->msg_controllen ) return arrival;
+
+    for( struct cmsghdr* cmsg = CMSG_FIRSTHDR( header ); cmsg;
+         cmsg = CMSG_NXTHDR( header, cmsg ) )
+    {
+        if( cmsg->cmsg_level != SOL_SOCKET ) continue;
+
+        if( cmsg->cmsg_type == SCM_TIMESTAMPNS )
+        {
+            struct timespec stamp;
+            memcpy( &stamp, CMSG_DATA( cmsg ), sizeof( stamp ) );
+
+            arrival = (uint64_t)stamp.tv_sec * 1000000000ULL +
+                      (uint64_t)stamp.tv_nsec;
+        }
+        else if( cmsg->cmsg_type == SO_RXQ_OVFL )
+        {
+            uint32_t drops;
+            memcpy( &drops, CMSG_DATA( cmsg ), sizeof( drops ) );
+
+            // running total for the socket, wraps at 2^32
+            dd_stats_add( DDSTAT_KERNEL_DROPS,
+                          drops - listener->kernel_drops );
+            listener->kernel_drops = drops;
+        }
+    }
+
+    return arrival;
+}
+
+// reads one super-packet, 0 when the socket is empty
+static int32_t read_coalesced( struct ddAddressInfo* c_restrict listener,
+                               struct ddRecvBatch* c_restrict batch )
+{
+    union
+    {
+        char buf[DD_RECV_CONTROL_SIZE];
+        struct cmsghdr align;
+    } control;
+
+    struct iovec iov = {
+        .iov_base = batch->coalesced, .iov_len = DD_GSO_MAX_BYTES};
+    struct msghdr header = {
+        .msg_name = &batch->coalesced_sender,
+        .msg_namelen = sizeof( batch->coalesced_sender ),
+        .msg_iov = &iov,
+        .msg_iovlen = 1,
+        .msg_control = control.buf,
+        .msg_controllen = sizeof( control.buf ),
+    };
+
+    const ssize_t rc = recvmsg( listener->socket_fd, &header, MSG_DONTWAIT );
+
+    if( rc == -1 )
+    {
+        if( errno == EAGAIN || errno == EWOULDBLOCK ) return 0;
+
+        dd_stats_add( DDSTAT_RECV_ERRORS, 1 );
+        console_write( LOG_ERROR, "recvmsg Error\n" );
+        return -1;
+    }
+
+    batch->coalesced_length = (uint32_t)rc;
+    batch->coalesced_offset = 0;
+    batch->coalesced_addr_len = header.msg_namelen;
+
+    // no UDP_GRO cmsg means a lone datagram
+    batch->segment_size = (uint32_t)rc;
+
+    for( struct cmsghdr* cmsg = CMSG_FIRSTHDR( &header ); cmsg;
+         cmsg = CMSG_NXTHDR( &header, cmsg ) )
+    {
+        if( cmsg->cmsg_level != IPPROTO_UDP || cmsg->cmsg_type != UDP_GRO )
+            continue;
+
+        int32_t gso_size;
+        memcpy( &gso_size, CMSG_DATA( cmsg ), sizeof( gso_size ) );
+
+        if( gso_size > 0 ) batch->segment_size = (uint32_t)gso_size;
+    }
+
+    batch->coalesced_arrival = dd_recv_read_control( listener, &header );
+
+    return 1;
+}
+
+static int32_t recieve_coalesced(
+    struct ddAddressInfo* c_restrict listener,
+    struct ddRecvBatch* c_restrict batch )
+{
+    if( !batch->coalesced )
+    {
+        batch->coalesced = malloc( DD_GSO_MAX_BYTES );
+
+        if( !batch->coalesced )
+        {
+            console_write( LOG_ERROR, "GRO buffer allocation failed\n" );
+            return -1;
+        }
+    }
+
+    while( batch->count < batch->capacity )
+    {
+        if( !dd_recv_batch_pending( batch ) )
+        {
+            const int32_t rc = read_coalesced( listener, batch );
+
+            if( rc == 0 ) break;
+            if( rc == -1 ) return batch->count ? (int32_t)batch->count : -1;
+
+            continue;  // split on the next pass, empty ones hold nothing
+        }
+
+        const uint32_t left = batch->coalesced_length - batch->coalesced_offset;
+        const uint32_t segment =
+            left < batch->segment_size ? left : batch->segment_size;
+        const uint32_t bytes =
+            segment < MAX_MSG_LENGTH - 1 ? segment : MAX_MSG_LENGTH - 1;
+
+        struct ddRecvMsg* msg_data = &batch->msgs[batch->count++];
+
+        memcpy( msg_data->msg,
+                batch->coalesced + batch->coalesced_offset,
+                bytes );
+        msg_data->msg[bytes] = '\0';
+        msg_data->bytes_read = (int32_t)bytes;
+        msg_data->sender = batch->coalesced_sender;
+        msg_data->addr_len = batch->coalesced_addr_len;
+        msg_data->arrival = batch->coalesced_arrival;
+
+        batch->coalesced_offset += segment;
+
+        dd_stats_add( DDSTAT_PACKETS_IN, 1 );
+        dd_stats_add( DDSTAT_BYTES_IN, segment );
+
+        if( listener->decompress ) dd_decompress_in_place( msg_data );
+
+#ifdef VERBOSE
+        log_recieved( msg_data );
+#endif
+    }
+
+    return (int32_t)batch->count;
+}
+
+#endif  // DD_PLATFORM
+
+int32_t dd_server_recieve_batch(
+    struct ddAddressInfo* c_restrict listener,
+    struct ddRecvBatch* c_restrict batch )
+{
+    batch->count = 0;
+
+#if DD_PLATFORM == DD_LINUX
+    if( listener->gro ) return recieve_coalesced( listener, batch );
+
+    for( uint32_t i = 0; i < batch->capacity; i++ )
+    {
+        batch->headers[i].msg_hdr.msg_namelen =
+            sizeof( struct sockaddr_storage );
+        batch->headers[i].msg_hdr.msg_controllen = DD_RECV_CONTROL_SIZE;
+    }
+
+    const int32_t rc = recvmmsg( listener->socket_fd,
+                                 batch->headers,
+                                 batch->capacity,
+                                 MSG_DONTWAIT,
+                                 NULL );
+
+    if( rc == -1 )
+    {
+        if( errno == EAGAIN || errno == EWOULDBLOCK ) return 0;
+
+        dd_stats_add( DDSTAT_RECV_ERRORS, 1 );
+        console_write( LOG_ERROR, "recvmmsg Error\n" );
+        return -1;
+    }
+
+    dd_stats_add( DDSTAT_PACKETS_IN, (uint64_t)rc );
+
+    for( int32_t i = 0; i < rc; i++ )
+    {
+        struct ddRecvMsg* msg_data = &batch->msgs[i];
+        struct msghdr* header = &batch->headers[i].msg_hdr;
+
+        dd_stats_add( DDSTAT_BYTES_IN, batch->headers[i].msg_len );
+
+        msg_data->bytes_read = (int32_t)batch->headers[i].msg_len;
+        msg_data->addr_len = header->msg_namelen;
+        msg_data->msg[msg_data->bytes_read] = '\0';
+
+        // w/o timestamps only the newest drop count matters
+        msg_data->arrival =
+            listener->rx_timestamps || i == rc - 1
+                ? dd_recv_read_control( listener, header )
+                : 0;
+
+        if( listener->decompress ) dd_decompress_in_place( msg_data );
+
+#ifdef VERBOSE
+        log_recieved( msg_data );
+#endif
+    }
+
+    batch->count = (uint32_t)rc;
+#else
+    // socket may be blocking, so only one datagram per wakeup
+    dd_server_recieve_msg( listener, &batch->msgs[0] );
+
+    if( batch->msgs[0].bytes_read == -1 ) return -1;
+
+    batch->count = 1;
+#endif  // DD_PLATFORM
+
+    return (int32_t)batch->count;
+}
+
+int32_t dd_server_recieve_pooled(
+    struct ddAddressInfo* c_restrict listener,
+    struct ddBufferPool* c_restrict pool,
+    struct ddPoolBuf** c_restrict buf )
+{
+    *buf = dd_pool_acquire( pool );
+
+    if( !*buf )
+    {
+        // zero length read still consumes the datagram
+        char discard;
+        if( recvfrom( listener->socket_fd, &discard, 0, 0, NULL, NULL ) != -1 )
+            dd_stats_add( DDSTAT_POOL_DROPS, 1 );
+
+        return 0;
+    }
+
+    struct ddRecvMsg* raw = &( *buf )->msg;
+
+    recieve_raw( listener, raw );
+
+    if( raw->bytes_read == -1 )
+    {
+        dd_pool_release( *buf );
+        *buf = NULL;
+        return -1;
+    }
+
+    if( listener->decompress &&
+        dd_frame_compressed( raw->msg, raw->bytes_read ) )
+    {
+        // inflate straight into a second slot, the packed one goes back
+        struct ddPoolBuf* unpacked = dd_pool_acquire( pool );
+
+        if( !unpacked )
+            dd_decompress_in_place( raw );
+        else
+        {
+            struct ddRecvMsg* out = &unpacked->msg;
+            const int32_t length = dd_frame_decompress(
+                raw->msg, raw->bytes_read, out->msg, MAX_MSG_LENGTH - 1 );
+
+            out->bytes_read = length == -1 ? 0 : length;
+            out->msg[out->bytes_read] = '\0';
+            out->sender = raw->sender;
+            out->addr_len = raw->addr_len;
+            out->arrival = raw->arrival;
+
+            if( length == -1 )
+                console_write( LOG_WARN,
+                               "Undecodable compressed frame dropped\n" );
+
+            dd_pool_release( *buf );
+            *buf = unpacked;
+        }
+    }
+
+#ifdef VERBOSE
+    log_recieved( &( *buf )->msg );
+#endif
+
+    return ( *buf )->msg.bytes_read;
+}
+
+struct ddLoop dd_server_new_loop( dd_loop_cb loop_cb,
+                                  struct ddAddressInfo* listener )
+{
+    struct ddLoop loop = {
+        .start_time = 0,
+        .active_time = 0,
+        .listener = listener,
+        .callback = loop_cb,
+        .batch_callback = NULL,
+        .batch = NULL,
+#if DD_PLATFORM == DD_LINUX
+        .backend = DDLOOP_EPOLL,
+#else
+        .backend = DDLOOP_SELECT,
+#endif  // DD_PLATFORM
+        .poll_fd = -1,
+        .wake_fd = -1,
+        .watches = NULL,
+        .watches_count = 0,
+        .watches_capacity = 0,
+        .retired = NULL,
+        .send_queues = NULL,
+        .uring = NULL,
+        .data = NULL,
+        .console = true,
+        .active = true,
+    };
+
+#if DD_PLATFORM == DD_LINUX
+    loop.wake_fd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+#endif  // DD_PLATFORM
+
+    // timers need the wheel, so a loop w/o one comes back inactive
+    if( !dd_wheel_init( &loop.timers, get_high_res_time() ) )
+    {
+        console_write( LOG_ERROR, "Loop not created\n" );
+        loop.active = false;
+    }
+
+#ifdef DD_LOOP_STATS
+    loop.stats = malloc( sizeof( struct ddLoopStats ) );
+    dd_loop_stats_reset( &loop );
+#endif  // DD_LOOP_STATS
+
+    return loop;
+}
+
+void dd_loop_set_batch_cb( struct ddLoop* c_restrict loop,
+                           dd_batch_cb batch_cb,
+                           struct ddRecvBatch* batch )
+{
+    loop->batch_callback = batch ? batch_cb : NULL;
+    loop->batch = batch;
+}
+
+void dd_loop_set_send_queues( struct ddLoop* c_restrict loop,
+                              struct ddSendQueueSet* send_queues )
+{
+    loop->send_queues = send_queues;
+}
+
+bool dd_loop_set_backend( struct ddLoop* c_restrict loop,
+                          const uint32_t backend )
+{
+#if DD_PLATFORM != DD_LINUX
+    if( backend == DDLOOP_EPOLL || backend == DDLOOP_URING )
+    {
+        console_write( LOG_WARN, "epoll & io_uring backends not supported\n" );
+        return false;
+    }
+#endif  // DD_PLATFORM
+
+    // backend is fixed once the loop is running
+    if( loop->poll_fd != -1 ) return false;
+
+    loop->backend = backend;
+    return true;
+}
+
+#if DD_PLATFORM == DD_LINUX
+
+// tags for non-watch descriptors registered w/ epoll
+static char s_stdin_tag;
+static char s_wake_tag;
+
+static bool epoll_watch_fd( struct ddLoop* c_restrict loop,
+                            const ddSocket fd,
+                            void* tag )
+{
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = tag};
+
+    return epoll_ctl( loop->poll_fd, EPOLL_CTL_ADD, fd, &ev ) == 0;
+}
+
+static bool epoll_open( struct ddLoop* c_restrict loop )
+{
+    loop->poll_fd = epoll_create1( EPOLL_CLOEXEC );
+
+    if( loop->poll_fd == -1 ) return false;
+
+    // listener is tagged w/ NULL
+    if( !epoll_watch_fd( loop, loop->listener->socket_fd, NULL ) )
+    {
+        close( loop->poll_fd );
+        loop->poll_fd = -1;
+        return false;
+    }
+
+    // wake on console input ( fails harmlessly if stdin is a file )
+    if( loop->console ) epoll_watch_fd( loop, STDIN_FILENO, &s_stdin_tag );
+
+    if( loop->wake_fd != -1 )
+        epoll_watch_fd( loop, loop->wake_fd, &s_wake_tag );
+
+    for( uint32_t i = 0; i < loop->watches_count; i++ )
+        epoll_watch_fd( loop, loop->watches[i]->fd, loop->watches[i] );
+
+    return true;
+}
+
+#endif  // DD_PLATFORM
+
+struct ddLoopWatch* dd_loop_add_watch( struct ddLoop* c_restrict loop,
+                                       ddSocket fd,
+                                       dd_watch_cb watch_cb,
+                                       void* data )
+{
+    if( !watch_cb ) return NULL;
+
+    if( loop->watches_count == loop->watches_capacity )
+    {
+        const uint32_t new_cap =
+            loop->watches_capacity ? loop->watches_capacity * 2 : 16;
+
+        struct ddLoopWatch** resized =
+            realloc( loop->watches, new_cap * sizeof( *resized ) );
+
+        if( !resized )
+        {
+            console_write( LOG_ERROR, "Loop watch allocation failed\n" );
+            return NULL;
+        }
+
+        loop->watches = resized;
+        loop->watches_capacity = new_cap;
+    }
+
+    struct ddLoopWatch* watch = malloc( sizeof( *watch ) );
+
+    if( !watch )
+    {
+        console_write( LOG_ERROR, "Loop watch allocation failed\n" );
+        return NULL;
+    }
+
+    *watch = ( struct ddLoopWatch ){
+        .fd = fd,
+        .slot = loop->watches_count,
+        .callback = watch_cb,
+        .data = data,
+    };
+
+#if DD_PLATFORM == DD_LINUX
+    if( loop->uring && !dd_uring_watch( loop, watch ) )
+    {
+        console_write( LOG_ERROR, "io_uring failed to add descriptor\n" );
+        free( watch );
+        return NULL;
+    }
+
+    if( !loop->uring && loop->poll_fd != -1 &&
+        !epoll_watch_fd( loop, fd, watch ) )
+    {
+        console_write( LOG_ERROR, "epoll failed to add descriptor\n" );
+        free( watch );
+        return NULL;
+    }
+#endif  // DD_PLATFORM
+
+    loop->watches[loop->watches_count++] = watch;
+
+    return watch;
+}
+
+void dd_loop_remove_watch( struct ddLoop* c_restrict loop,
+                           struct ddLoopWatch* watch )
+{
+    if( !watch || !watch->callback ) return;
+
+#if DD_PLATFORM == DD_LINUX
+    if( loop->uring )
+        dd_uring_unwatch( loop, watch );
+    else if( loop->poll_fd != -1 )
+        epoll_ctl( loop->poll_fd, EPOLL_CTL_DEL, watch->fd, NULL );
+#endif  // DD_PLATFORM
+
+    // swap in last watch
+    loop->watches_count--;
+    loop->watches[watch->slot] = loop->watches[loop->watches_count];
+    loop->watches[watch->slot]->slot = watch->slot;
+
+    // pending events may still reference the watch, so free it later
+    watch->callback = NULL;
+    watch->retired_next = loop->retired;
+    loop->retired = watch;
+}
+
+static void free_retired_watches( struct ddLoop* c_restrict loop )
+{
+    while( loop->retired )
+    {
+        struct ddLoopWatch* next = loop->retired->retired_next;
+        free( loop->retired );
+        loop->retired = next;
+    }
+}
+
+// timers are relative to the loop clock once the loop is running
+static uint64_t loop_now( const struct ddLoop* c_restrict loop )
+{
+    return loop->active_time ? loop->active_time : get_high_res_time();
+}
+
+ddTimerHandle dd_loop_add_timer( struct ddLoop* c_restrict loop,
+                                 dd_timer_cb timer_cb,
+                                 double seconds,
+                                 bool repeat,
+                                 void* data )
+{
+    const ddTimerHandle handle = dd_wheel_add( &loop->timers,
+                                               timer_cb,
+                                               loop_now( loop ),
+                                               seconds_to_nano( seconds ),
+                                               repeat,
+                                               data );
+
+    if( handle == 0 ) console_write( LOG_ERROR, "Loop timer add failed\n" );
+
+    return handle;
+}
+
+bool dd_loop_cancel_timer( struct ddLoop* c_restrict loop,
+                           const ddTimerHandle handle )
+{
+    return dd_wheel_cancel( &loop->timers, handle );
+}
+
+bool dd_loop_restart_timer( struct ddLoop* c_restrict loop,
+                            const ddTimerHandle handle )
+{
+    return dd_wheel_restart( &loop->timers, handle, loop_now( loop ) );
+}
+
+int64_t dd_loop_time_nano( struct ddLoop* c_restrict loop )
+{
+    return loop->active_time - loop->start_time;
+}
+
+double dd_loop_time_seconds( struct ddLoop* c_restrict loop )
+{
+    return nano_to_seconds( loop->active_time - loop->start_time );
+}
+
+void dd_loop_break( struct ddLoop* loop )
+{
+    loop->active = false;
+
+#if DD_PLATFORM == DD_LINUX
+    // interrupt a sleeping epoll_wait ( safe from any thread )
+    if( loop->wake_fd != -1 )
+    {
+        const uint64_t one = 1;
+        if( write( loop->wake_fd, &one, sizeof( one ) ) == -1 &&
+            errno != EAGAIN )
+            console_write( LOG_ERROR, "Loop wakeup failed\n" );
+    }
+#endif  // DD_PLATFORM
+
+    if( loop->console ) console_restore_stdin();
+}
+
+static void loop_read_listener( struct ddLoop* c_restrict loop )
+{
+#ifdef DD_LOOP_STATS
+    const uint64_t read_start = get_high_res_time();
+#endif  // DD_LOOP_STATS
+
+    if( !loop->batch_callback )
+        loop->callback( loop );
+    else
+    {
+        // a super-packet may outlast one batch & its leftovers are already
+        // off the socket, so they won't wake the loop
+        int32_t received;
+
+        while( ( received = dd_server_recieve_batch( loop->listener,
+                                                     loop->batch ) ) > 0 )
+        {
+#ifdef DD_LOOP_STATS
+            dd_loop_stats_queue( loop, loop->batch );
+#endif  // DD_LOOP_STATS
+
+            loop->batch_callback( loop, loop->batch );
+
+            if( !dd_recv_batch_pending( loop->batch ) || !loop->active )
+                break;
+        }
+
+        if( received == -1 ) dd_loop_break( loop );  // server read error
+    }
+
+#ifdef DD_LOOP_STATS
+    if( loop->stats )
+        dd_hist_record( &loop->stats->read,
+                        get_high_res_time() - read_start );
+#endif  // DD_LOOP_STATS
+}
+
+// nanoseconds until the closest timer deadline ( UINT64_MAX if none )
+static uint64_t loop_next_timeout( const struct ddLoop* c_restrict loop )
+{
+    const uint64_t deadline = dd_wheel_next_deadline( &loop->timers );
+
+    if( deadline == UINT64_MAX ) return UINT64_MAX;
+
+    return deadline > loop->active_time ? deadline - loop->active_time : 0;
+}
+
+static bool loop_wait_select( struct ddLoop* c_restrict loop )
+{
+    fd_set read_fd;
+    FD_ZERO( &read_fd );
+
+    int32_t fdmax = (int)loop->listener->socket_fd;  // ignored on windows lol
+    FD_SET( loop->listener->socket_fd, &read_fd );
+
+    for( uint32_t i = 0; i < loop->watches_count; i++ )
+    {
+        FD_SET( loop->watches[i]->fd, &read_fd );
+
+        if( (int)loop->watches[i]->fd > fdmax )
+            fdmax = (int)loop->watches[i]->fd;
+    }
+
+    // stdin isn't selectable on every platform, so keep polling at 1 ms
+    struct timeval select_timeout = {
+        .tv_sec = 0, .tv_usec = 1000,
+    };
+
+#ifdef DD_LOOP_STATS
+    const uint64_t wait_start = get_high_res_time();
+#endif  // DD_LOOP_STATS
+
+    int32_t rc = select( fdmax + 1, &read_fd, NULL, NULL, &select_timeout );
+
+    if( rc == -1 && errno == EINTR ) return true;
+
+    if( rc == -1 )
+    {
+        console_write( LOG_ERROR, "Select error\n" );
+        return false;
+    }
+
+    loop->active_time = get_high_res_time();
+
+#ifdef DD_LOOP_STATS
+    if( loop->stats )
+        dd_hist_record( &loop->stats->wait, loop->active_time - wait_start );
+#endif  // DD_LOOP_STATS
+
+    if( rc == 0 ) return true;
+
+    // process data thru callback
+    if( FD_ISSET( loop->listener->socket_fd, &read_fd ) )
+    {
+        loop_read_listener( loop );
+
+        if( !loop->active ) return true;
+    }
+
+    // callbacks may add or remove watches, which reorders loop->watches, so
+    // collect the ready ones first. Removed watches are retired, not freed,
+    // until the pass ends
+    struct ddLoopWatch* ready[FD_SETSIZE];
+    uint32_t ready_count = 0;
+
+    for( uint32_t i = 0; i < loop->watches_count && ready_count < FD_SETSIZE;
+         i++ )
+        if( FD_ISSET( loop->watches[i]->fd, &read_fd ) )
+            ready[ready_count++] = loop->watches[i];
+
+    for( uint32_t i = 0; i < ready_count; i++ )
+    {
+        // skip watches removed by an earlier callback
+        if( !ready[i]->callback ) continue;
+
+        ready[i]->callback( loop, ready[i] );
+
+        if( !loop->active ) return true;
+    }
+
+    return true;
+}
+
+#if DD_PLATFORM == DD_LINUX
+
+static bool loop_wait_epoll( struct ddLoop* c_restrict loop )
+{
+    struct epoll_event events[MAX_LOOP_EVENTS];
+
+    const uint64_t timeout = loop_next_timeout( loop );
+
+    // round up so the loop never wakes before the deadline
+    int32_t timeout_ms = -1;
+    if( timeout != UINT64_MAX )
+    {
+        const uint64_t millis = ( timeout + 999999 ) / 1000000;
+        timeout_ms = millis > INT32_MAX ? INT32_MAX : (int32_t)millis;
+    }
+
+#ifdef DD_LOOP_STATS
+    const uint64_t wait_start = get_high_res_time();
+#endif  // DD_LOOP_STATS
+
+    int32_t rc =
+        epoll_wait( loop->poll_fd, events, MAX_LOOP_EVENTS, timeout_ms );
+
+    // a handled signal interrupts the wait, just wait again
+    if( rc == -1 && errno == EINTR ) return true;
+
+    if( rc == -1 )
+    {
+        console_write( LOG_ERROR, "epoll_wait error\n" );
+        return false;
+    }
+
+    loop->active_time = get_high_res_time();
+
+#ifdef DD_LOOP_STATS
+    if( loop->stats )
+        dd_hist_record( &loop->stats->wait, loop->active_time - wait_start );
+#endif  // DD_LOOP_STATS
+
+    for( int32_t i = 0; i < rc; i++ )
+    {
+        void* tag = events[i].data.ptr;
+
+        if( tag == NULL )
+            loop_read_listener( loop );
+        else if( tag == &s_stdin_tag )
+        {
+            // closed stdin would report ready forever
+            if( events[i].events & ( EPOLLHUP | EPOLLERR ) )
+                epoll_ctl( loop->poll_fd, EPOLL_CTL_DEL, STDIN_FILENO, NULL );
+        }
+        else if( tag == &s_wake_tag )
+        {
+            uint64_t count;
+            if( read( loop->wake_fd, &count, sizeof( count ) ) == -1 &&
+                errno != EAGAIN )
+                console_write( LOG_ERROR, "Loop wakeup read failed\n" );
+        }
+        else
+        {
+            struct ddLoopWatch* watch = tag;
+
+            // skip watches removed by an earlier callback
+            if( watch->callback ) watch->callback( loop, watch );
+        }
+
+        if( !loop->active ) return true;
+    }
+
+    return true;
+}
+
+static bool loop_wait_uring( struct ddLoop* c_restrict loop )
+{
+    if( !dd_uring_wait( loop, loop_next_timeout( loop ) ) )
+    {
+        console_write( LOG_ERROR, "io_uring wait error\n" );
+        return false;
+    }
+
+    return true;
+}
+
+static bool uring_emit( void* ctx,
+                        const char* data,
+                        const uint32_t length,
+                        const struct sockaddr* addr,
+                        const socklen_t addr_len )
+{
+    struct ddLoop* loop = ctx;
+
+    return dd_uring_send_to( loop,
+                             loop->send_queues->sender->socket_fd,
+                             data,
+                             (int32_t)length,
+                             addr,
+                             addr_len );
+}
+
+#endif  // DD_PLATFORM
+
+// queued sends of an io_uring loop go out w/ its next wait
+static void loop_flush_send_queues( struct ddLoop* c_restrict loop )
+{
+    if( !loop->send_queues ) return;
+
+#if DD_PLATFORM == DD_LINUX
+    if( loop->uring )
+    {
+        dd_sendq_drain( loop->send_queues, uring_emit, loop );
+        return;
+    }
+#endif  // DD_PLATFORM
+
+    dd_sendq_flush( loop->send_queues );
+}
+
+bool dd_loop_send_to( struct ddLoop* c_restrict loop,
+                      const char* c_restrict data,
+                      const int32_t length,
+                      const struct sockaddr* c_restrict addr,
+                      const socklen_t addr_len )
+{
+#if DD_PLATFORM == DD_LINUX
+    if( loop->uring &&
+        dd_uring_send_to(
+            loop, loop->listener->socket_fd, data, length, addr, addr_len ) )
+        return true;
+#endif  // DD_PLATFORM
+
+    if( sendto( loop->listener->socket_fd,
+                data,
+                length,
+                0,
+                addr,
+                (int)addr_len ) == -1 )
+    {
+        dd_stats_add( DDSTAT_SEND_ERRORS, 1 );
+        return false;
+    }
+
+    dd_stats_add( DDSTAT_PACKETS_OUT, 1 );
+    dd_stats_add( DDSTAT_BYTES_OUT, (uint64_t)length );
+
+    return true;
+}
+
+void dd_loop_run( struct ddLoop* loop )
+{
+    loop->start_time = loop->active_time = get_high_res_time();
+
+#if DD_PLATFORM == DD_LINUX
+    if( loop->backend == DDLOOP_URING && loop->poll_fd == -1 &&
+        !dd_uring_open( loop ) )
+    {
+        console_write( LOG_WARN, "io_uring unavailable. Using epoll\n" );
+        loop->backend = DDLOOP_EPOLL;
+    }
+
+    if( loop->backend == DDLOOP_EPOLL && loop->poll_fd == -1 &&
+        !epoll_open( loop ) )
+    {
+        console_write( LOG_WARN, "epoll unavailable. Using select\n" );
+        loop->backend = DDLOOP_SELECT;
+    }
+#endif  // DD_PLATFORM
+
+    while( loop->active )
+    {
+        dd_stats_add( DDSTAT_LOOP_ITERATIONS, 1 );
+
+        if( loop->console ) console_collect_stdin();
+
+        bool success = false;
+
+#if DD_PLATFORM == DD_LINUX
+        if( loop->backend == DDLOOP_URING )
+            success = loop_wait_uring( loop );
+        else if( loop->backend == DDLOOP_EPOLL )
+            success = loop_wait_epoll( loop );
+        else
+#endif  // DD_PLATFORM
+            success = loop_wait_select( loop );
+
+        free_retired_watches( loop );
+
+        if( !success ) break;
+
+        if( !loop->active ) break;
+
+        // fire due timers
+        dd_wheel_advance( &loop->timers, loop->active_time, loop );
+
+        // everything queued this iteration leaves together
+        loop_flush_send_queues( loop );
+    }
+
+    loop_flush_send_queues( loop );
+
+#if DD_PLATFORM == DD_LINUX
+    dd_uring_submit( loop );
+#endif  // DD_PLATFORM
+}
+
+void dd_loop_cleanup( struct ddLoop* loop )
+{
+#if DD_PLATFORM == DD_LINUX
+    dd_uring_close( loop );
+
+    if( loop->poll_fd != -1 ) close( loop->poll_fd );
+#endif  // DD_PLATFORM
+
+    loop->poll_fd = -1;
+
+#if DD_PLATFORM == DD_LINUX
+    if( loop->wake_fd != -1 ) close( loop->wake_fd );
+#endif  // DD_PLATFORM
+
+    loop->wake_fd = -1;
+
+    for( uint32_t i = 0; i < loop->watches_count; i++ )
+        free( loop->watches[i] );
+
+    free( loop->watches );
+    loop->watches = NULL;
+    loop->watches_count = loop->watches_capacity = 0;
+
+    free_retired_watches( loop );
+
+    dd_wheel_free( &loop->timers );
+
+#ifdef DD_LOOP_STATS
+    free( loop->stats );
+    loop->stats = NULL;
+#endif  // DD_LOOP_STATS
+}
+
+#ifdef DD_LOOP_STATS
+
+const struct ddLoopStats* dd_loop_stats( const struct ddLoop* loop )
+{
+    return loop->stats;
+}
+
+void dd_loop_stats_reset( struct ddLoop* loop )
+{
+    if( !loop->stats ) return;
+
+    dd_hist_reset( &loop->stats->wait );
+    dd_hist_reset( &loop->stats->read );
+    dd_hist_reset( &loop->stats->timer );
+    dd_hist_reset( &loop->stats->timer_late );
+    dd_hist_reset( &loop->stats->queue );
+}
+
+void dd_loop_stats_queue( struct ddLoop* c_restrict loop,
+                          const struct ddRecvBatch* c_restrict batch )
+{
+    if( !loop->stats || !loop->listener || !loop->listener->rx_timestamps )
+        return;
+
+    const uint64_t now = get_wall_time();
+
+    for( uint32_t i = 0; i < batch->count; i++ )
+    {
+        const uint64_t arrival = batch->msgs[i].arrival;
+
+        if( arrival && now > arrival )
+            dd_hist_record( &loop->stats->queue, now - arrival );
+    }
+}
+
+static void print_hist( const char* c_restrict name,
+                        const struct ddHistogram* c_restrict hist )
+{
+    console_write( LOG_STATUS,
+                   "%-10s n %llu mean %.2f p50 %.2f p99 %.2f p99.9 %.2f "
+                   "max %.2f usec\n",
+                   name,
+                   (unsigned long long)hist->count,
+                   dd_hist_mean( hist ) / 1000.0,
+                   (double)dd_hist_percentile( hist, 0.5 ) / 1000.0,
+                   (double)dd_hist_percentile( hist, 0.99 ) / 1000.0,
+                   (double)dd_hist_percentile( hist, 0.999 ) / 1000.0,
+                   (double)hist->max / 1000.0 );
+}
+
+void dd_loop_stats_print( const struct ddLoop* loop )
+{
+    if( !loop->stats ) return;
+
+    print_hist( "wait", &loop->stats->wait );
+    print_hist( "read", &loop->stats->read );
+    print_hist( "timer", &loop->stats->timer );
+    print_hist( "timer late", &loop->stats->timer_late );
+
+    if( loop->stats->queue.count )
+        print_hist( "queue", &loop->stats->queue );
 }
+
+#endif  // DD_LOOP_STATS
@@ -0,0 +1,227 @@
+#ifdef __linux__
+#define _GNU_SOURCE  // pthread_setaffinity_np
+#endif
+
+#include "ServerShards.h"
+#include "ConsoleWrite.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if DD_PLATFORM == DD_LINUX
+
+#include <sched.h>
+
+static void* shard_thread( void* arg )
+{
+    struct ddShard* shard = arg;
+
+    if( shard->cpu != -1 )
+    {
+        cpu_set_t cpus;
+        CPU_ZERO( &cpus );
+        CPU_SET( shard->cpu, &cpus );
+
+        if( pthread_setaffinity_np(
+                pthread_self(), sizeof( cpus ), &cpus ) != 0 )
+            console_write( LOG_WARN,
+                           "Shard %u failed to pin to cpu %d\n",
+                           shard->index,
+                           shard->cpu );
+    }
+
+    if( shard->group->config.setup_cb ) shard->group->config.setup_cb( shard );
+
+    dd_loop_run( &shard->loop );
+
+    return NULL;
+}
+
+// cpus this process may run on, which taskset & cgroups can narrow to fewer
+// than are online. Falls back to every online cpu
+static uint32_t allowed_cpus( cpu_set_t* c_restrict allowed )
+{
+    CPU_ZERO( allowed );
+
+    if( sched_getaffinity( 0, sizeof( *allowed ), allowed ) == 0 &&
+        CPU_COUNT( allowed ) > 0 )
+        return (uint32_t)CPU_COUNT( allowed );
+
+    const long online = sysconf( _SC_NPROCESSORS_ONLN );
+    const uint32_t count = online > 0 ? (uint32_t)online : 1;
+
+    CPU_ZERO( allowed );
+    for( uint32_t i = 0; i < count && i < CPU_SETSIZE; i++ )
+        CPU_SET( i, allowed );
+
+    return count < CPU_SETSIZE ? count : CPU_SETSIZE;
+}
+
+// id of the nth cpu in the set
+static int32_t nth_cpu( const cpu_set_t* c_restrict allowed, uint32_t n )
+{
+    for( int32_t cpu = 0; cpu < CPU_SETSIZE; cpu++ )
+        if( CPU_ISSET( cpu, allowed ) && n-- == 0 ) return cpu;
+
+    return -1;
+}
+
+bool dd_shards_create( struct ddShardGroup* c_restrict group,
+                       const struct ddShardConfig* c_restrict config )
+{
+    *group = ( struct ddShardGroup ){.config = *config};
+
+    cpu_set_t allowed;
+    const uint32_t cpus = allowed_cpus( &allowed );
+
+    group->count = config->count ? config->count : cpus;
+    group->shards = calloc( group->count, sizeof( struct ddShard ) );
+
+    if( !group->shards )
+    {
+        console_write( LOG_ERROR, "Shard allocation failed\n" );
+        return false;
+    }
+
+    const struct ddSocketOpts opts = {
+        .reuse_port = true,
+        .recv_buffer = config->recv_buffer,
+        .rx_timestamps = config->rx_timestamps,
+    };
+
+    for( uint32_t i = 0; i < group->count; i++ )
+    {
+        struct ddShard* shard = &group->shards[i];
+
+        shard->group = group;
+        shard->index = i;
+        shard->cpu = config->pin_cpus ? nth_cpu( &allowed, i % cpus ) : -1;
+
+        if( !dd_create_socket(
+                &shard->listener, config->ip, config->port, true, &opts ) )
+        {
+            console_write( LOG_ERROR, "Shard %u socket not created\n", i );
+            group->count = i;
+            dd_shards_free( group );
+            return false;
+        }
+
+        shard->loop = dd_server_new_loop( config->read_cb, &shard->listener );
+        shard->loop.data = shard;
+        shard->loop.console = false;  // console state is process-wide
+
+        if( !shard->loop.active )
+        {
+            group->count = i + 1;
+            dd_shards_free( group );
+            return false;
+        }
+
+        if( config->batch_cb )
+        {
+            if( !dd_recv_batch_init( &shard->batch, MAX_RECV_BATCH ) )
+            {
+                group->count = i + 1;
+                dd_shards_free( group );
+                return false;
+            }
+
+            dd_loop_set_batch_cb(
+                &shard->loop, config->batch_cb, &shard->batch );
+        }
+    }
+
+    return true;
+}
+
+bool dd_shards_start( struct ddShardGroup* c_restrict group )
+{
+    for( uint32_t i = 0; i < group->count; i++ )
+    {
+        struct ddShard* shard = &group->shards[i];
+
+        if( pthread_create( &shard->thread, NULL, shard_thread, shard ) != 0 )
+        {
+            console_write( LOG_ERROR, "Shard %u thread not created\n", i );
+            dd_shards_stop( group );
+            return false;
+        }
+
+        shard->running = true;
+    }
+
+    return true;
+}
+
+void dd_shards_break( struct ddShardGroup* c_restrict group )
+{
+    for( uint32_t i = 0; i < group->count; i++ )
+        dd_loop_break( &group->shards[i].loop );
+}
+
+void dd_shards_stop( struct ddShardGroup* c_restrict group )
+{
+    dd_shards_break( group );
+
+    for( uint32_t i = 0; i < group->count; i++ )
+    {
+        struct ddShard* shard = &group->shards[i];
+
+        if( !shard->running ) continue;
+
+        pthread_join( shard->thread, NULL );
+        shard->running = false;
+    }
+}
+
+void dd_shards_free( struct ddShardGroup* c_restrict group )
+{
+    dd_shards_stop( group );
+
+    for( uint32_t i = 0; i < group->count; i++ )
+    {
+        struct ddShard* shard = &group->shards[i];
+
+        dd_loop_cleanup( &shard->loop );
+        dd_recv_batch_free( &shard->batch );
+        dd_close_socket( &shard->listener.socket_fd );
+    }
+
+    free( group->shards );
+    *group = ( struct ddShardGroup ){0};
+}
+
+#else
+
+bool dd_shards_create( struct ddShardGroup* c_restrict group,
+                       const struct ddShardConfig* c_restrict config )
+{
+    UNUSED_VAR( config );
+
+    *group = ( struct ddShardGroup ){0};
+    console_write( LOG_ERROR, "Sharded loops not supported\n" );
+    return false;
+}
+
+bool dd_shards_start( struct ddShardGroup* c_restrict group )
+{
+    UNUSED_VAR( group );
+    return false;
+}
+
+void dd_shards_break( struct ddShardGroup* c_restrict group )
+{
+    UNUSED_VAR( group );
+}
+
+void dd_shards_stop( struct ddShardGroup* c_restrict group )
+{
+    UNUSED_VAR( group );
+}
+
+void dd_shards_free( struct ddShardGroup* c_restrict group )
+{
+    UNUSED_VAR( group );
+}
+
+#endif  // DD_PLATFORM
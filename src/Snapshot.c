@@ -0,0 +1,403 @@
+#include "Snapshot.h"
+#include "ConsoleWrite.h"
+#include "WireFormat.h"
+#include "Fragment.h"
+#include "Compress.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SLOT( seq ) ( (uint32_t)( seq ) & ( DD_SNAPSHOT_HISTORY - 1 ) )
+
+// signed distance from b to a on the 16-bit sequence circle
+static int32_t seq_diff( const uint16_t a, const uint16_t b )
+{
+    return (int16_t)( a - b );
+}
+
+static uint32_t full_size( const uint32_t words )
+{
+    return DD_SNAPSHOT_HEADER_SIZE + words * sizeof( uint32_t );
+}
+
+static void write_header( uint8_t* c_restrict out,
+                          const uint8_t type,
+                          const uint16_t seq,
+                          const uint16_t baseline,
+                          const uint32_t words )
+{
+    out[0] = (uint8_t)( DDFRAME_MARK | DDFRAME_SNAPSHOT );
+    out[DDFRAME_HEADER_SIZE] = type;
+    dd_write_u16_le( out + DDFRAME_HEADER_SIZE + 1, seq );
+    dd_write_u16_le( out + DDFRAME_HEADER_SIZE + 3, baseline );
+    dd_write_u16_le( out + DDFRAME_HEADER_SIZE + 5, (uint16_t)words );
+}
+
+// LEB128, false when out of room
+static bool write_varint( uint8_t** c_restrict out,
+                          const uint8_t* c_restrict end,
+                          uint32_t val )
+{
+    do
+    {
+        if( *out == end ) return false;
+
+        const uint8_t byte = (uint8_t)( val & 0x7f );
+        val >>= 7;
+        *( *out )++ = byte | ( val ? 0x80 : 0 );
+    } while( val );
+
+    return true;
+}
+
+static bool read_varint( const uint8_t** c_restrict in,
+                         const uint8_t* c_restrict end,
+                         uint32_t* c_restrict val )
+{
+    *val = 0;
+
+    for( uint32_t shift = 0; shift < 35; shift += 7 )
+    {
+        if( *in == end ) return false;
+
+        const uint8_t byte = *( *in )++;
+        *val |= (uint32_t)( byte & 0x7f ) << shift;
+
+        if( !( byte & 0x80 ) ) return true;
+    }
+
+    return false;
+}
+
+bool dd_snapshot_init( struct ddSnapshotServer* c_restrict server,
+                       const uint32_t words )
+{
+    *server = ( struct ddSnapshotServer ){.words = words};
+
+    if( words == 0 || words > DD_SNAPSHOT_MAX_WORDS ) return false;
+
+    server->history =
+        calloc( (size_t)DD_SNAPSHOT_HISTORY * words, sizeof( uint32_t ) );
+    server->scratch = malloc( full_size( words ) );
+
+    if( !server->history || !server->scratch )
+    {
+        console_write( LOG_ERROR, "Snapshot history allocation failed\n" );
+        dd_snapshot_free( server );
+        return false;
+    }
+
+    return true;
+}
+
+void dd_snapshot_free( struct ddSnapshotServer* c_restrict server )
+{
+    free( server->history );
+    free( server->scratch );
+
+    server->history = NULL;
+    server->scratch = NULL;
+}
+
+uint16_t dd_snapshot_commit( struct ddSnapshotServer* c_restrict server,
+                             const uint32_t* c_restrict state )
+{
+    if( server->committed ) server->latest++;
+
+    memcpy( server->history + (size_t)SLOT( server->latest ) * server->words,
+            state,
+            server->words * sizeof( uint32_t ) );
+
+    if( server->committed < DD_SNAPSHOT_HISTORY ) server->committed++;
+
+    return server->latest;
+}
+
+// baseline still in the history & not ahead of the newest snapshot
+static bool baseline_valid( const struct ddSnapshotServer* c_restrict server,
+                            const uint16_t baseline )
+{
+    const int32_t age = seq_diff( server->latest, baseline );
+
+    return age >= 0 && (uint32_t)age < server->committed;
+}
+
+static int32_t encode_full( const struct ddSnapshotServer* c_restrict server,
+                            const uint32_t* c_restrict state,
+                            uint8_t* c_restrict out,
+                            const uint32_t output_size )
+{
+    if( full_size( server->words ) > output_size ) return -1;
+
+    write_header( out, DDSNAP_FULL, server->latest, 0, server->words );
+
+    uint8_t* body = out + DD_SNAPSHOT_HEADER_SIZE;
+    for( uint32_t i = 0; i < server->words; i++ )
+        dd_write_u32_le( body + i * sizeof( uint32_t ), state[i] );
+
+    return (int32_t)full_size( server->words );
+}
+
+// -1 when the delta wouldn't be smaller than a full snapshot
+static int32_t encode_delta( const struct ddSnapshotServer* c_restrict server,
+                             const uint32_t* c_restrict state,
+                             const uint16_t baseline,
+                             uint8_t* c_restrict out,
+                             const uint32_t output_size )
+{
+    const uint32_t* base =
+        server->history + (size_t)SLOT( baseline ) * server->words;
+
+    uint32_t changed = 0;
+    for( uint32_t i = 0; i < server->words; i++ )
+        changed += state[i] != base[i];
+
+    const uint32_t limit = full_size( server->words ) < output_size
+                               ? full_size( server->words )
+                               : output_size;
+
+    if( limit < DD_SNAPSHOT_HEADER_SIZE ) return -1;
+
+    write_header( out, DDSNAP_DELTA, server->latest, baseline, server->words );
+
+    uint8_t* cursor = out + DD_SNAPSHOT_HEADER_SIZE;
+    const uint8_t* end = out + limit;
+
+    if( !write_varint( &cursor, end, changed ) ) return -1;
+
+    // ( gap since the last changed word, value XOR baseline ) pairs. Small
+    // updates only flip low bits, so the XOR packs into few bytes
+    uint32_t next = 0;
+    for( uint32_t i = 0; i < server->words && changed; i++ )
+    {
+        if( state[i] == base[i] ) continue;
+
+        if( !write_varint( &cursor, end, i - next ) ||
+            !write_varint( &cursor, end, state[i] ^ base[i] ) )
+            return -1;
+
+        next = i + 1;
+        changed--;
+    }
+
+    return (int32_t)( cursor - out );
+}
+
+int32_t dd_snapshot_encode( struct ddSnapshotServer* c_restrict server,
+                            const struct ddSnapshotPeer* c_restrict peer,
+                            char* c_restrict output,
+                            const uint32_t output_size )
+{
+    if( server->committed == 0 ) return -1;
+
+    const uint32_t* state =
+        server->history + (size_t)SLOT( server->latest ) * server->words;
+    uint8_t* out = (uint8_t*)output;
+
+    int32_t length = -1;
+
+    if( peer->has_baseline && baseline_valid( server, peer->baseline ) )
+        length = encode_delta(
+            server, state, peer->baseline, out, output_size );
+
+    if( length != -1 )
+        server->stats.delta++;
+    else
+    {
+        length = encode_full( server, state, out, output_size );
+
+        if( length == -1 ) return -1;
+
+        server->stats.full++;
+    }
+
+    server->stats.bytes += (uint64_t)length;
+    server->stats.full_bytes += full_size( server->words );
+
+    return length;
+}
+
+bool dd_snapshot_send_to( struct ddSnapshotServer* c_restrict server,
+                          const struct ddSnapshotPeer* c_restrict peer,
+                          const struct ddAddressInfo* c_restrict sender,
+                          const struct sockaddr* c_restrict addr,
+                          const socklen_t addr_len )
+{
+    int32_t length = dd_snapshot_encode(
+        server, peer, server->scratch, full_size( server->words ) );
+
+    if( length == -1 ) return false;
+
+    // bigger than the receive path takes in one piece
+    if( length > MAX_MSG_LENGTH - 1 )
+    {
+        const uint32_t bytes = (uint32_t)length;
+
+        return dd_frag_send_to(
+                   sender, addr, addr_len, server->scratch, bytes ) ==
+               dd_frag_count( bytes );
+    }
+
+    char packed[MAX_MSG_LENGTH];
+    const char* wire = dd_compress_stage(
+        sender, server->scratch, &length, packed, sizeof( packed ) );
+
+    const struct sockaddr* addrs[1] = {addr};
+
+    return dd_server_send_many(
+               sender, wire, length, addrs, &addr_len, 1, NULL ) == 1;
+}
+
+bool dd_snapshot_on_ack( const struct ddSnapshotServer* c_restrict server,
+                         struct ddSnapshotPeer* c_restrict peer,
+                         const char* c_restrict data,
+                         const int32_t length )
+{
+    const uint8_t* in = (const uint8_t*)data;
+
+    if( length < DDFRAME_HEADER_SIZE + 3 ||
+        in[0] != ( DDFRAME_MARK | DDFRAME_SNAPSHOT ) ||
+        in[DDFRAME_HEADER_SIZE] != DDSNAP_ACK )
+        return false;
+
+    const uint16_t acked = dd_read_u16_le( in + DDFRAME_HEADER_SIZE + 1 );
+
+    // acks can arrive out of order, only ever move forward
+    if( !baseline_valid( server, acked ) ||
+        ( peer->has_baseline && seq_diff( acked, peer->baseline ) <= 0 ) )
+        return true;
+
+    peer->baseline = acked;
+    peer->has_baseline = true;
+
+    return true;
+}
+
+bool dd_snapshot_client_init( struct ddSnapshotClient* c_restrict client,
+                              const uint32_t words )
+{
+    *client = ( struct ddSnapshotClient ){.words = words};
+
+    if( words == 0 || words > DD_SNAPSHOT_MAX_WORDS ) return false;
+
+    client->history =
+        calloc( (size_t)DD_SNAPSHOT_HISTORY * words, sizeof( uint32_t ) );
+
+    if( !client->history )
+    {
+        console_write( LOG_ERROR, "Snapshot history allocation failed\n" );
+        return false;
+    }
+
+    return true;
+}
+
+void dd_snapshot_client_free( struct ddSnapshotClient* c_restrict client )
+{
+    free( client->history );
+    client->history = NULL;
+}
+
+int32_t dd_snapshot_apply( struct ddSnapshotClient* c_restrict client,
+                           const char* c_restrict data,
+                           const int32_t length )
+{
+    const uint8_t* in = (const uint8_t*)data;
+
+    if( length < DD_SNAPSHOT_HEADER_SIZE ||
+        in[0] != ( DDFRAME_MARK | DDFRAME_SNAPSHOT ) )
+        return -1;
+
+    const uint8_t type = in[DDFRAME_HEADER_SIZE];
+    const uint16_t seq = dd_read_u16_le( in + DDFRAME_HEADER_SIZE + 1 );
+    const uint16_t baseline = dd_read_u16_le( in + DDFRAME_HEADER_SIZE + 3 );
+    const uint32_t words = dd_read_u16_le( in + DDFRAME_HEADER_SIZE + 5 );
+
+    if( words != client->words ||
+        ( type != DDSNAP_FULL && type != DDSNAP_DELTA ) )
+        return -1;
+
+    // older than what we have is of no use
+    if( client->has_latest && seq_diff( seq, client->latest ) <= 0 ) return -1;
+
+    const uint32_t slot = SLOT( seq );
+    uint32_t* state = client->history + (size_t)slot * words;
+    const uint8_t* cursor = in + DD_SNAPSHOT_HEADER_SIZE;
+    const uint8_t* end = in + length;
+
+    if( type == DDSNAP_FULL )
+    {
+        if( length != (int32_t)full_size( words ) ) return -1;
+
+        client->filled[slot] = false;
+
+        for( uint32_t i = 0; i < words; i++ )
+            state[i] = dd_read_u32_le( cursor + i * sizeof( uint32_t ) );
+    }
+    else
+    {
+        const uint32_t base_slot = SLOT( baseline );
+
+        if( base_slot == slot || !client->filled[base_slot] ||
+            client->seqs[base_slot] != baseline )
+            return -1;
+
+        client->filled[slot] = false;
+
+        memcpy( state,
+                client->history + (size_t)base_slot * words,
+                words * sizeof( uint32_t ) );
+
+        uint32_t changed = 0;
+        if( !read_varint( &cursor, end, &changed ) || changed > words )
+            return -1;
+
+        uint32_t index = 0;
+        for( uint32_t i = 0; i < changed; i++ )
+        {
+            uint32_t gap = 0;
+            uint32_t delta = 0;
+
+            if( !read_varint( &cursor, end, &gap ) ||
+                !read_varint( &cursor, end, &delta ) || gap >= words - index )
+                return -1;
+
+            index += gap;
+            state[index++] ^= delta;
+        }
+
+        if( cursor != end ) return -1;
+    }
+
+    client->seqs[slot] = seq;
+    client->filled[slot] = true;
+    client->latest = seq;
+    client->has_latest = true;
+
+    return seq;
+}
+
+int32_t dd_snapshot_ack_encode(
+    const struct ddSnapshotClient* c_restrict client,
+    char* c_restrict output,
+    const uint32_t output_size )
+{
+    if( !client->has_latest || output_size < DDFRAME_HEADER_SIZE + 3 )
+        return -1;
+
+    uint8_t* out = (uint8_t*)output;
+
+    out[0] = (uint8_t)( DDFRAME_MARK | DDFRAME_SNAPSHOT );
+    out[DDFRAME_HEADER_SIZE] = DDSNAP_ACK;
+    dd_write_u16_le( out + DDFRAME_HEADER_SIZE + 1, client->latest );
+
+    return DDFRAME_HEADER_SIZE + 3;
+}
+
+const uint32_t* dd_snapshot_state(
+    const struct ddSnapshotClient* c_restrict client )
+{
+    if( !client->has_latest ) return NULL;
+
+    return client->history + (size_t)SLOT( client->latest ) * client->words;
+}
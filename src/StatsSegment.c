@@ -0,0 +1,181 @@
+#include "StatsSegment.h"
+#include "ConsoleWrite.h"
+#include "TimeInterface.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#if DD_PLATFORM == DD_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif  // DD_PLATFORM
+
+#define STATS_NAME_LENGTH 64
+
+struct ddStatsSegment* _Atomic dd_stats_segment;
+
+static char s_name[STATS_NAME_LENGTH];
+
+static const char* s_stat_names[DDSTAT_COUNT] = {
+    [DDSTAT_PACKETS_IN] = "packets_in",
+    [DDSTAT_BYTES_IN] = "bytes_in",
+    [DDSTAT_PACKETS_OUT] = "packets_out",
+    [DDSTAT_BYTES_OUT] = "bytes_out",
+    [DDSTAT_SEND_ERRORS] = "send_errors",
+    [DDSTAT_RECV_ERRORS] = "recv_errors",
+    [DDSTAT_TIMER_FIRES] = "timer_fires",
+    [DDSTAT_LOOP_ITERATIONS] = "loop_iterations",
+    [DDSTAT_PEERS_ACTIVE] = "peers_active",
+    [DDSTAT_POOL_IN_USE] = "pool_in_use",
+    [DDSTAT_POOL_CAPACITY] = "pool_capacity",
+    [DDSTAT_KERNEL_DROPS] = "kernel_drops",
+    [DDSTAT_POOL_DROPS] = "pool_drops",
+};
+
+_Static_assert( DDSTAT_COUNT <= DD_STATS_SLOTS, "stats outgrew the segment" );
+
+const char* dd_stats_name( const uint32_t stat )
+{
+    return stat < DDSTAT_COUNT ? s_stat_names[stat] : "unknown";
+}
+
+bool dd_stats_is_gauge( const uint32_t stat )
+{
+    return stat == DDSTAT_PEERS_ACTIVE || stat == DDSTAT_POOL_IN_USE ||
+           stat == DDSTAT_POOL_CAPACITY;
+}
+
+uint64_t dd_stats_read( const struct ddStatsSegment* c_restrict segment,
+                        const uint32_t stat )
+{
+    if( stat >= segment->stat_count || stat >= DD_STATS_SLOTS ) return 0;
+
+    return atomic_load_explicit(
+        (_Atomic uint64_t*)&segment->slots[stat].value, memory_order_relaxed );
+}
+
+#if DD_PLATFORM == DD_LINUX
+
+bool dd_stats_open( const char* c_restrict name )
+{
+    if( atomic_load( &dd_stats_segment ) )
+    {
+        console_write( LOG_WARN, "Stats segment already open\n" );
+        return false;
+    }
+
+    if( name )
+        snprintf( s_name, sizeof( s_name ), "%s", name );
+    else
+        snprintf( s_name, sizeof( s_name ), "/ddstat.%d", (int)getpid() );
+
+    // readable by anyone, so ddstat needs no privileges
+    const int32_t fd = shm_open( s_name, O_CREAT | O_RDWR | O_TRUNC, 0644 );
+
+    if( fd == -1 )
+    {
+        console_write( LOG_ERROR, "shm_open %s failed\n", s_name );
+        return false;
+    }
+
+    struct ddStatsSegment* segment = MAP_FAILED;
+
+    if( ftruncate( fd, sizeof( *segment ) ) == 0 )
+        segment = mmap( NULL,
+                        sizeof( *segment ),
+                        PROT_READ | PROT_WRITE,
+                        MAP_SHARED,
+                        fd,
+                        0 );
+
+    close( fd );
+
+    if( segment == MAP_FAILED )
+    {
+        console_write( LOG_ERROR, "Stats segment mapping failed\n" );
+        shm_unlink( s_name );
+        return false;
+    }
+
+    // fresh pages are zeroed, so every stat starts at 0
+    segment->version = DD_STATS_VERSION;
+    segment->stat_count = DDSTAT_COUNT;
+    segment->pid = (int32_t)getpid();
+    segment->start_time = get_wall_time();
+
+    atomic_store_explicit(
+        &segment->magic, DD_STATS_MAGIC, memory_order_release );
+    atomic_store( &dd_stats_segment, segment );
+
+    return true;
+}
+
+void dd_stats_close()
+{
+    struct ddStatsSegment* segment = atomic_exchange( &dd_stats_segment, NULL );
+
+    if( !segment ) return;
+
+    munmap( segment, sizeof( *segment ) );
+    shm_unlink( s_name );
+}
+
+const struct ddStatsSegment* dd_stats_attach( const char* c_restrict name )
+{
+    const int32_t fd = shm_open( name, O_RDONLY, 0 );
+
+    if( fd == -1 ) return NULL;
+
+    struct stat info;
+    const struct ddStatsSegment* segment = MAP_FAILED;
+
+    if( fstat( fd, &info ) == 0 &&
+        (size_t)info.st_size >= sizeof( struct ddStatsSegment ) )
+        segment = mmap(
+            NULL, sizeof( *segment ), PROT_READ, MAP_SHARED, fd, 0 );
+
+    close( fd );
+
+    if( segment == MAP_FAILED ) return NULL;
+
+    if( atomic_load_explicit( (_Atomic uint32_t*)&segment->magic,
+                              memory_order_acquire ) != DD_STATS_MAGIC ||
+        segment->version != DD_STATS_VERSION )
+    {
+        munmap( (void*)segment, sizeof( *segment ) );
+        return NULL;
+    }
+
+    return segment;
+}
+
+void dd_stats_detach( const struct ddStatsSegment* c_restrict segment )
+{
+    if( segment ) munmap( (void*)segment, sizeof( *segment ) );
+}
+
+#else
+
+bool dd_stats_open( const char* c_restrict name )
+{
+    (void)name;
+    console_write( LOG_WARN, "Stats segment not supported\n" );
+    return false;
+}
+
+void dd_stats_close() {}
+
+const struct ddStatsSegment* dd_stats_attach( const char* c_restrict name )
+{
+    (void)name;
+    return NULL;
+}
+
+void dd_stats_detach( const struct ddStatsSegment* c_restrict segment )
+{
+    (void)segment;
+}
+
+#endif  // DD_PLATFORM
@@ -4,89 +4,171 @@
 
 #if DD_PLATFORM == DD_LINUX
 #include <time.h>
+#include <stdio.h>
+#include <string.h>
 #include <unistd.h>
-//#include <x86intrin.h>
 
-/*
-static uint64_t RDTSC()
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <cpuid.h>
+#include <x86intrin.h>
+#define DD_HAS_TSC 1
+#endif
+
+static uint32_t s_clock = DDCLOCK_MONOTONIC;
+
+static uint64_t monotonic_time()
 {
-    unsigned int hi, lo;
-    // ask the compiler to read the assembler code
-    // assign the register holding the lower part of the 64-bit number to low
-    // and vice-versa to high
-    __asm__ __volatile__( "rdtsc" : "=a"( lo ), "=d"( hi ) );
-    return ( (uint64_t)hi << 32 ) | lo;
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC_RAW, &now );
+    return ( now.tv_sec * 1000000000ULL ) + now.tv_nsec;
 }
 
-// Calculate cycles per nanosecond
-static double SetCyclesPerNanoSec()
+#ifdef DD_HAS_TSC
+
+// ns = base_nano + ( ( tsc - base_tsc ) * mult ) >> TSC_SHIFT
+#define TSC_SHIFT 32
+
+static uint64_t s_tsc_base;
+static uint64_t s_tsc_base_nano;
+static uint64_t s_tsc_mult;
+
+static bool tsc_invariant()
 {
-    // pure c-struct need keyword
-    struct timespec beginTS, endTS, diffTS;
-    uint64_t _begin = 0, _end = 0;
+    uint32_t eax, ebx, ecx, edx;
 
-    clock_gettime( CLOCK_MONOTONIC_RAW, &beginTS );
+    // invariant tsc: constant rate, keeps counting in deep c-states
+    if( __get_cpuid( 0x80000007, &eax, &ebx, &ecx, &edx ) && ( edx & 0x100 ) )
+        return true;
 
-    _begin = RDTSC();
-    for( uint64_t i = 0; i < 1000000; i++ )
-        ;
-    _end = RDTSC();
+    // hypervisors often hide the bit but the kernel only picks a stable tsc
+    FILE* source = fopen(
+        "/sys/devices/system/clocksource/clocksource0/current_clocksource",
+        "r" );
 
-    clock_gettime( CLOCK_MONOTONIC_RAW, &endTS );
+    if( !source ) return false;
 
-    // calculate difference in time for "for loop" to run
-    diffTS.tv_sec = endTS.tv_sec - beginTS.tv_sec;
-    diffTS.tv_nsec = endTS.tv_nsec - beginTS.tv_nsec;
+    char name[32] = {0};
+    const bool kernel_tsc = fgets( name, sizeof( name ), source ) &&
+                            strncmp( name, "tsc", 3 ) == 0;
 
-    const uint64_t elaspedNanoSecs =
-        diffTS.tv_sec * 1000000000LL + diffTS.tv_nsec;
+    fclose( source );
+    return kernel_tsc;
+}
+
+static uint64_t tsc_time()
+{
+    const uint64_t tsc = __rdtsc();
+
+    // another core's counter may trail the calibration read slightly
+    if( tsc < s_tsc_base ) return s_tsc_base_nano;
+
+    const unsigned __int128 delta = tsc - s_tsc_base;
 
-    return (double)( _end - _begin ) / (double)elaspedNanoSecs;
+    return s_tsc_base_nano + (uint64_t)( ( delta * s_tsc_mult ) >> TSC_SHIFT );
 }
 
-static uint64_t rdtsc_Start()
+static bool tsc_calibrate()
 {
-    unsigned int cycles_high, cycles_low;
-    __asm__ __volatile__(
-        "CPUID\n\t"
-        "RDTSC\n\t"
-        "mov %%edx, %0\n\t"
-        "mov %%eax, %1\n\t"
-        : "=r"( cycles_high ),
-          "=r"( cycles_low )::"%rax",
-          "%rbx",
-          "%rcx",
-          "%rdx" );
-    return ( (uint64_t)cycles_high << 32 ) | cycles_low;
+    // read both clocks back to back & keep the tightest pair at each end
+    uint64_t start_tsc = 0, start_nano = 0, end_tsc = 0, end_nano = 0;
+    uint64_t best = UINT64_MAX;
+
+    for( uint32_t i = 0; i < 16; i++ )
+    {
+        const uint64_t before = __rdtsc();
+        const uint64_t nano = monotonic_time();
+        const uint64_t after = __rdtsc();
+
+        if( after - before < best )
+        {
+            best = after - before;
+            start_tsc = before + ( after - before ) / 2;
+            start_nano = nano;
+        }
+    }
+
+    const struct timespec pause = {.tv_sec = 0,
+                                   .tv_nsec = DD_TSC_CALIBRATE_NANO};
+    nanosleep( &pause, NULL );
+
+    best = UINT64_MAX;
+    for( uint32_t i = 0; i < 16; i++ )
+    {
+        const uint64_t before = __rdtsc();
+        const uint64_t nano = monotonic_time();
+        const uint64_t after = __rdtsc();
+
+        if( after - before < best )
+        {
+            best = after - before;
+            end_tsc = before + ( after - before ) / 2;
+            end_nano = nano;
+        }
+    }
+
+    if( end_tsc <= start_tsc || end_nano <= start_nano ) return false;
+
+    s_tsc_mult = (uint64_t)( ( (unsigned __int128)( end_nano - start_nano )
+                               << TSC_SHIFT ) /
+                             ( end_tsc - start_tsc ) );
+
+    // anchor to the monotonic clock so existing timestamps stay comparable
+    s_tsc_base = end_tsc;
+    s_tsc_base_nano = end_nano;
+
+    return s_tsc_mult != 0;
 }
 
-static uint64_t rdtsc_End()
+#endif  // DD_HAS_TSC
+
+bool dd_time_set_clock( const uint32_t clock )
 {
-    unsigned int cycles_high, cycles_low;
-    __asm__ __volatile__(
-        "RDTSCP\n\t"
-        "mov %%edx, %0\n\t"
-        "mov %%eax, %1\n\t"
-        "CPUID\n\t"
-        : "=r"( cycles_high ),
-          "=r"( cycles_low )::"%rax",
-          "%rbx",
-          "%rcx",
-          "%rdx" );
-    return ( (uint64_t)cycles_high << 32 ) | cycles_low;
+    if( clock == DDCLOCK_MONOTONIC )
+    {
+        s_clock = DDCLOCK_MONOTONIC;
+        return true;
+    }
+
+#ifdef DD_HAS_TSC
+    if( clock == DDCLOCK_TSC && tsc_invariant() && tsc_calibrate() )
+    {
+        s_clock = DDCLOCK_TSC;
+        return true;
+    }
+#endif  // DD_HAS_TSC
+
+    s_clock = DDCLOCK_MONOTONIC;
+    return false;
 }
 
-*/
+uint32_t dd_time_clock() { return s_clock; }
+
+double dd_time_tsc_ghz()
+{
+#ifdef DD_HAS_TSC
+    if( s_clock == DDCLOCK_TSC )
+        return (double)( 1ULL << TSC_SHIFT ) / (double)s_tsc_mult;
+#endif  // DD_HAS_TSC
+
+    return 0.0;
+}
 
 uint64_t get_high_res_time()
 {
-    uint64_t hrTime = 0;
-    struct timespec now;
+#ifdef DD_HAS_TSC
+    if( s_clock == DDCLOCK_TSC ) return tsc_time();
+#endif  // DD_HAS_TSC
 
-    clock_gettime( CLOCK_MONOTONIC_RAW, &now );
-    hrTime = ( now.tv_sec * 1000000000L ) + now.tv_nsec;
+    return monotonic_time();
+}
 
-    return hrTime;
+uint64_t get_wall_time()
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_REALTIME, &now );
+    return ( now.tv_sec * 1000000000ULL ) + now.tv_nsec;
 }
 #elif DD_PLATFORM == DD_WIN32
 
@@ -107,6 +189,30 @@ uint64_t get_high_res_time()
     return ( (uint64_t)now.QuadPart * 1000000000LL ) / (uint64_t)freq.QuadPart;
 }
 
+// QueryPerformanceCounter already reads the tsc when it is invariant
+bool dd_time_set_clock( const uint32_t clock )
+{
+    return clock == DDCLOCK_MONOTONIC;
+}
+
+uint32_t dd_time_clock() { return DDCLOCK_MONOTONIC; }
+
+double dd_time_tsc_ghz() { return 0.0; }
+
+// FILETIME counts 100 ns ticks from 1601
+#define FILETIME_UNIX_EPOCH 116444736000000000ULL
+
+uint64_t get_wall_time()
+{
+    FILETIME now;
+    GetSystemTimePreciseAsFileTime( &now );
+
+    const uint64_t ticks =
+        ( (uint64_t)now.dwHighDateTime << 32 ) | now.dwLowDateTime;
+
+    return ( ticks - FILETIME_UNIX_EPOCH ) * 100;
+}
+
 #endif  // DD_PLATFORM
 
 uint64_t seconds_to_nano( double seconds )
@@ -0,0 +1,422 @@
+#include "TimerWheel.h"
+#include "ServerInterface.h"
+#include "ConsoleWrite.h"
+#include "TimeInterface.h"
+#include "StatsSegment.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+
+static uint32_t lowest_bit( const uint64_t bits )
+{
+    unsigned long idx;
+    _BitScanForward64( &idx, bits );
+    return (uint32_t)idx;
+}
+#else
+static uint32_t lowest_bit( const uint64_t bits )
+{
+    return (uint32_t)__builtin_ctzll( bits );
+}
+#endif  // _MSC_VER
+
+#define WHEEL_MASK ( DD_WHEEL_SLOTS - 1 )
+#define WHEEL_PENDING DD_WHEEL_LEVELS  // level marker for due timers
+
+static uint64_t deadline_to_tick( const struct ddTimerWheel* c_restrict wheel,
+                                  const uint64_t deadline )
+{
+    if( deadline <= wheel->origin ) return 0;
+
+    // round up so timers never fire before their deadline
+    return ( deadline - wheel->origin + DD_WHEEL_TICK_NANO - 1 ) /
+           DD_WHEEL_TICK_NANO;
+}
+
+static void wheel_link( struct ddTimerWheel* c_restrict wheel,
+                        struct ddServerTimer* c_restrict timer )
+{
+    if( timer->expires < wheel->tick ) timer->expires = wheel->tick;
+
+    uint64_t expires = timer->expires;
+    const uint64_t delta = expires - wheel->tick;
+
+    uint32_t level = 0;
+    while( level < DD_WHEEL_LEVELS - 1 &&
+           delta >= ( 1ULL << ( DD_WHEEL_BITS * ( level + 1 ) ) ) )
+        level++;
+
+    // beyond the top level, park in its last bucket & re-cascade later
+    const uint64_t range = 1ULL << ( DD_WHEEL_BITS * DD_WHEEL_LEVELS );
+    if( delta >= range ) expires = wheel->tick + range - 1;
+
+    const uint32_t slot =
+        ( expires >> ( DD_WHEEL_BITS * level ) ) & WHEEL_MASK;
+
+    struct ddServerTimer** head =
+        &wheel->slots[level * DD_WHEEL_SLOTS + slot];
+
+    uint64_t* slot_min = &wheel->slot_min[level * DD_WHEEL_SLOTS + slot];
+    if( !*head || timer->expires < *slot_min ) *slot_min = timer->expires;
+
+    timer->next = *head;
+    if( *head ) ( *head )->pprev = &timer->next;
+    timer->pprev = head;
+    *head = timer;
+
+    timer->level = (uint8_t)level;
+    timer->slot = (uint8_t)slot;
+    wheel->occupied[level] |= 1ULL << slot;
+}
+
+static void wheel_unlink( struct ddTimerWheel* c_restrict wheel,
+                          struct ddServerTimer* c_restrict timer )
+{
+    *timer->pprev = timer->next;
+    if( timer->next ) timer->next->pprev = timer->pprev;
+
+    if( timer->level < DD_WHEEL_LEVELS &&
+        !wheel->slots[timer->level * DD_WHEEL_SLOTS + timer->slot] )
+        wheel->occupied[timer->level] &= ~( 1ULL << timer->slot );
+
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+// move a bucket's list onto the pending list
+static void wheel_take_slot( struct ddTimerWheel* c_restrict wheel,
+                             const uint32_t level,
+                             const uint32_t slot )
+{
+    struct ddServerTimer** head =
+        &wheel->slots[level * DD_WHEEL_SLOTS + slot];
+
+    wheel->pending = *head;
+    if( wheel->pending ) wheel->pending->pprev = &wheel->pending;
+
+    for( struct ddServerTimer* t = wheel->pending; t; t = t->next )
+        t->level = WHEEL_PENDING;
+
+    *head = NULL;
+    wheel->occupied[level] &= ~( 1ULL << slot );
+}
+
+static void wheel_cascade( struct ddTimerWheel* c_restrict wheel,
+                           const uint64_t tick )
+{
+    for( uint32_t level = 1; level < DD_WHEEL_LEVELS; level++ )
+    {
+        const uint32_t slot =
+            ( tick >> ( DD_WHEEL_BITS * level ) ) & WHEEL_MASK;
+
+        wheel_take_slot( wheel, level, slot );
+
+        struct ddServerTimer* timer;
+        while( ( timer = wheel->pending ) )
+        {
+            wheel_unlink( wheel, timer );
+            wheel_link( wheel, timer );
+        }
+
+        // higher levels only turn over when this one wraps
+        if( slot != 0 ) break;
+    }
+}
+
+static struct ddServerTimer* wheel_alloc(
+    struct ddTimerWheel* c_restrict wheel )
+{
+    if( !wheel->free_list )
+    {
+        struct ddServerTimer** blocks =
+            realloc( wheel->blocks,
+                     ( wheel->blocks_count + 1 ) * sizeof( *blocks ) );
+
+        if( !blocks ) return NULL;
+
+        wheel->blocks = blocks;
+
+        struct ddServerTimer* block =
+            calloc( DD_TIMER_BLOCK, sizeof( struct ddServerTimer ) );
+
+        if( !block ) return NULL;
+
+        wheel->blocks[wheel->blocks_count] = block;
+
+        for( uint32_t i = DD_TIMER_BLOCK; i > 0; i-- )
+        {
+            block[i - 1].index = wheel->blocks_count * DD_TIMER_BLOCK + i - 1;
+            block[i - 1].generation = 1;
+            block[i - 1].next = wheel->free_list;
+            wheel->free_list = &block[i - 1];
+        }
+
+        wheel->blocks_count++;
+    }
+
+    struct ddServerTimer* timer = wheel->free_list;
+    wheel->free_list = timer->next;
+    timer->next = NULL;
+
+    return timer;
+}
+
+static void wheel_release( struct ddTimerWheel* c_restrict wheel,
+                           struct ddServerTimer* c_restrict timer )
+{
+    // stale handles stop resolving once the generation moves on
+    timer->generation++;
+    timer->callback = NULL;
+    timer->data = NULL;
+
+    timer->next = wheel->free_list;
+    wheel->free_list = timer;
+    wheel->count--;
+}
+
+bool dd_wheel_init( struct ddTimerWheel* c_restrict wheel, const uint64_t now )
+{
+    *wheel = ( struct ddTimerWheel ){.origin = now};
+
+    wheel->slots = calloc( DD_WHEEL_LEVELS * DD_WHEEL_SLOTS,
+                           sizeof( struct ddServerTimer* ) );
+    wheel->slot_min =
+        calloc( DD_WHEEL_LEVELS * DD_WHEEL_SLOTS, sizeof( uint64_t ) );
+
+    if( !wheel->slots || !wheel->slot_min )
+    {
+        console_write( LOG_ERROR, "Timer wheel allocation failed\n" );
+        dd_wheel_free( wheel );
+        return false;
+    }
+
+    return true;
+}
+
+void dd_wheel_free( struct ddTimerWheel* c_restrict wheel )
+{
+    for( uint32_t i = 0; i < wheel->blocks_count; i++ )
+        free( wheel->blocks[i] );
+
+    free( wheel->blocks );
+    free( wheel->slots );
+    free( wheel->slot_min );
+
+    *wheel = ( struct ddTimerWheel ){0};
+}
+
+ddTimerHandle dd_wheel_add( struct ddTimerWheel* c_restrict wheel,
+                            dd_timer_cb timer_cb,
+                            const uint64_t now,
+                            const uint64_t tick_rate,
+                            const bool repeat,
+                            void* data )
+{
+    if( !wheel->slots || !timer_cb ) return 0;
+
+    struct ddServerTimer* timer = wheel_alloc( wheel );
+
+    if( !timer )
+    {
+        console_write( LOG_ERROR, "Timer allocation failed\n" );
+        return 0;
+    }
+
+    timer->tick_rate = tick_rate;
+    timer->repeat = repeat;
+    timer->data = data;
+    timer->callback = timer_cb;
+    timer->deadline = now + tick_rate;
+    timer->expires = deadline_to_tick( wheel, timer->deadline );
+
+    wheel_link( wheel, timer );
+    wheel->count++;
+
+    return ( (uint64_t)timer->generation << 32 ) | ( timer->index + 1 );
+}
+
+struct ddServerTimer* dd_wheel_get( const struct ddTimerWheel* c_restrict wheel,
+                                    const ddTimerHandle handle )
+{
+    const uint32_t index = (uint32_t)( handle & 0xffffffff ) - 1;
+
+    if( handle == 0 || index >= wheel->blocks_count * DD_TIMER_BLOCK )
+        return NULL;
+
+    struct ddServerTimer* timer =
+        &wheel->blocks[index / DD_TIMER_BLOCK][index % DD_TIMER_BLOCK];
+
+    if( timer->generation != (uint32_t)( handle >> 32 ) || !timer->callback )
+        return NULL;
+
+    return timer;
+}
+
+bool dd_wheel_cancel( struct ddTimerWheel* c_restrict wheel,
+                      const ddTimerHandle handle )
+{
+    struct ddServerTimer* timer = dd_wheel_get( wheel, handle );
+
+    if( !timer ) return false;
+
+    if( timer->pprev ) wheel_unlink( wheel, timer );
+
+    wheel_release( wheel, timer );
+    return true;
+}
+
+bool dd_wheel_restart( struct ddTimerWheel* c_restrict wheel,
+                       const ddTimerHandle handle,
+                       const uint64_t now )
+{
+    struct ddServerTimer* timer = dd_wheel_get( wheel, handle );
+
+    if( !timer ) return false;
+
+    if( timer->pprev ) wheel_unlink( wheel, timer );
+
+    timer->deadline = now + timer->tick_rate;
+    timer->expires = deadline_to_tick( wheel, timer->deadline );
+
+    wheel_link( wheel, timer );
+    return true;
+}
+
+uint64_t dd_wheel_next_deadline( const struct ddTimerWheel* c_restrict wheel )
+{
+    uint64_t next_tick = UINT64_MAX;
+
+    for( uint32_t level = 0; level < DD_WHEEL_LEVELS; level++ )
+    {
+        const uint64_t occupied = wheel->occupied[level];
+
+        if( !occupied ) continue;
+
+        // first occupied bucket at or after the current tick
+        const uint32_t shift = DD_WHEEL_BITS * level;
+        const uint64_t first = ( wheel->tick + ( 1ULL << shift ) - 1 ) >> shift;
+        const uint32_t rot = first & WHEEL_MASK;
+
+        const uint64_t rotated =
+            rot ? ( occupied >> rot ) | ( occupied << ( 64 - rot ) ) : occupied;
+
+        const uint32_t slot = ( rot + lowest_bit( rotated ) ) & WHEEL_MASK;
+
+        // level 0 buckets map to a single tick. Higher buckets track the
+        // earliest expiry, so sleeping skips the cascade ( advance replays it )
+        const uint64_t tick =
+            level == 0 ? first + lowest_bit( rotated )
+                       : wheel->slot_min[level * DD_WHEEL_SLOTS + slot];
+
+        if( tick < next_tick ) next_tick = tick;
+    }
+
+    if( next_tick == UINT64_MAX ) return UINT64_MAX;
+
+    return wheel->origin + next_tick * DD_WHEEL_TICK_NANO;
+}
+
+uint32_t dd_wheel_advance( struct ddTimerWheel* c_restrict wheel,
+                           const uint64_t now,
+                           struct ddLoop* loop )
+{
+    if( !wheel->slots || now < wheel->origin ) return 0;
+
+    const uint64_t target = ( now - wheel->origin ) / DD_WHEEL_TICK_NANO;
+    uint32_t fired = 0;
+
+    while( wheel->tick <= target )
+    {
+        uint64_t tick = wheel->tick;
+        uint32_t idx = tick & WHEEL_MASK;
+
+        // skip straight to the next occupied bucket or turnover
+        if( idx != 0 )
+        {
+            const uint64_t due = wheel->occupied[0] >> idx;
+
+            if( !due )
+            {
+                const uint64_t turnover = ( tick | WHEEL_MASK ) + 1;
+                wheel->tick = turnover <= target ? turnover : target + 1;
+                continue;
+            }
+
+            tick += lowest_bit( due );
+
+            if( tick > target )
+            {
+                wheel->tick = target + 1;
+                break;
+            }
+
+            wheel->tick = tick;
+            idx = tick & WHEEL_MASK;
+        }
+        else
+            wheel_cascade( wheel, tick );
+
+        wheel_take_slot( wheel, 0, idx );
+        wheel->tick = tick + 1;
+
+        struct ddServerTimer* timer;
+        while( ( timer = wheel->pending ) )
+        {
+            wheel_unlink( wheel, timer );
+
+            const uint32_t generation = timer->generation;
+
+#ifdef DD_LOOP_STATS
+            const uint64_t fire_start = get_high_res_time();
+
+            if( loop->stats )
+                dd_hist_record( &loop->stats->timer_late,
+                                fire_start > timer->deadline
+                                    ? fire_start - timer->deadline
+                                    : 0 );
+#endif  // DD_LOOP_STATS
+
+            timer->callback( loop, timer );
+            fired++;
+            dd_stats_add( DDSTAT_TIMER_FIRES, 1 );
+
+#ifdef DD_LOOP_STATS
+            if( loop->stats )
+                dd_hist_record( &loop->stats->timer,
+                                get_high_res_time() - fire_start );
+#endif  // DD_LOOP_STATS
+
+            // cancelled or re-armed inside the callback
+            if( timer->generation != generation || timer->pprev ) continue;
+
+            if( timer->repeat )
+            {
+                // keep cadence, but don't try to catch up on missed ticks
+                timer->deadline += timer->tick_rate;
+                if( timer->deadline <= now )
+                    timer->deadline = now + timer->tick_rate;
+
+                timer->expires = deadline_to_tick( wheel, timer->deadline );
+                wheel_link( wheel, timer );
+            }
+            else
+                wheel_release( wheel, timer );
+
+            if( !loop->active )
+            {
+                // leftover due timers fire on the next advance
+                while( ( timer = wheel->pending ) )
+                {
+                    wheel_unlink( wheel, timer );
+                    wheel_link( wheel, timer );
+                }
+                return fired;
+            }
+        }
+    }
+
+    return fired;
+}
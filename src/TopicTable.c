@@ -0,0 +1,529 @@
+#include "TopicTable.h"
+#include "PeerTable.h"
+#include "ConsoleWrite.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t hash_tag( const char* c_restrict tag, const uint32_t length )
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+
+    for( uint32_t i = 0; i < length; i++ )
+    {
+        hash ^= (uint8_t)tag[i];
+        hash *= 16777619u;
+    }
+
+    return hash ? hash : 1;
+}
+
+static uint32_t hash_member( const uint32_t topic, const uint32_t addr_hash )
+{
+    const uint32_t hash = addr_hash ^ ( ( topic + 1 ) * 0x9e3779b9u );
+    return hash ? hash : 1;
+}
+
+static bool valid_tag( const uint32_t tag_length )
+{
+    return tag_length > 0 && tag_length <= DD_TOPIC_MAX_TAG;
+}
+
+// slot holding the tag's topic id, or the empty slot ending its probe
+static uint32_t probe_tag( const struct ddTopicTable* c_restrict table,
+                           const char* c_restrict tag,
+                           const uint32_t tag_length,
+                           const uint32_t hash )
+{
+    const uint32_t mask = table->tag_capacity - 1;
+    uint32_t idx = hash & mask;
+
+    while( table->tag_index[idx] )
+    {
+        const struct ddTopic* topic =
+            &table->topics[table->tag_index[idx] - 1];
+
+        if( topic->hash == hash && topic->tag_length == tag_length &&
+            memcmp( topic->tag, tag, tag_length ) == 0 )
+            break;
+
+        idx = ( idx + 1 ) & mask;
+    }
+
+    return idx;
+}
+
+// slot holding the subscription, or the empty slot ending its probe
+static uint32_t probe_member( const struct ddTopicTable* c_restrict table,
+                              const uint32_t topic,
+                              const struct sockaddr* c_restrict addr,
+                              const uint32_t hash )
+{
+    const uint32_t mask = table->member_capacity - 1;
+    uint32_t idx = hash & mask;
+
+    while( table->members[idx].hash )
+    {
+        const struct ddSubscription* entry = &table->members[idx];
+
+        if( entry->hash == hash && entry->topic == topic &&
+            dd_peers_addr_equal(
+                &table->topics[topic].subs[entry->index].addr.sa, addr ) )
+            break;
+
+        idx = ( idx + 1 ) & mask;
+    }
+
+    return idx;
+}
+
+static bool grow_tags( struct ddTopicTable* c_restrict table )
+{
+    const uint32_t capacity = table->tag_capacity * 2;
+    uint32_t* tag_index = calloc( capacity, sizeof( *tag_index ) );
+
+    if( !tag_index )
+    {
+        console_write( LOG_ERROR, "Topic table allocation failed\n" );
+        return false;
+    }
+
+    free( table->tag_index );
+    table->tag_index = tag_index;
+    table->tag_capacity = capacity;
+
+    // tags are never removed, so ids just need re-homing
+    for( uint32_t id = 0; id < table->topic_count; id++ )
+    {
+        const struct ddTopic* topic = &table->topics[id];
+
+        table->tag_index[probe_tag(
+            table, topic->tag, topic->tag_length, topic->hash )] = id + 1;
+    }
+
+    return true;
+}
+
+static bool grow_members( struct ddTopicTable* c_restrict table )
+{
+    const uint32_t old_capacity = table->member_capacity;
+    struct ddSubscription* old_members = table->members;
+
+    struct ddSubscription* members =
+        calloc( old_capacity * 2, sizeof( *members ) );
+
+    if( !members )
+    {
+        console_write( LOG_ERROR, "Topic table allocation failed\n" );
+        return false;
+    }
+
+    table->members = members;
+    table->member_capacity = old_capacity * 2;
+
+    const uint32_t mask = table->member_capacity - 1;
+
+    // entries are distinct, so each lands in the first free slot
+    for( uint32_t i = 0; i < old_capacity; i++ )
+    {
+        if( !old_members[i].hash ) continue;
+
+        uint32_t idx = old_members[i].hash & mask;
+
+        while( table->members[idx].hash ) idx = ( idx + 1 ) & mask;
+
+        table->members[idx] = old_members[i];
+    }
+
+    free( old_members );
+    return true;
+}
+
+static void remove_member( struct ddTopicTable* c_restrict table,
+                           uint32_t idx )
+{
+    const uint32_t mask = table->member_capacity - 1;
+
+    // same backward shift as PeerTable, no tombstones
+    uint32_t next = idx;
+    while( true )
+    {
+        next = ( next + 1 ) & mask;
+
+        if( !table->members[next].hash ) break;
+
+        const uint32_t home = table->members[next].hash & mask;
+
+        const bool movable = ( next > idx ) ? ( home <= idx || home > next )
+                                            : ( home <= idx && home > next );
+        if( movable )
+        {
+            table->members[idx] = table->members[next];
+            idx = next;
+        }
+    }
+
+    table->members[idx] = ( struct ddSubscription ){0};
+    table->member_count--;
+}
+
+bool dd_topics_init( struct ddTopicTable* c_restrict table,
+                     const uint32_t subscription_hint )
+{
+    *table = ( struct ddTopicTable ){
+        .topic_capacity = DD_TOPICS_MIN_CAPACITY,
+        .tag_capacity = DD_TOPICS_MIN_CAPACITY * 2,
+        .member_capacity = DD_TOPICS_MIN_CAPACITY,
+    };
+
+    // keep load under 3/4 for the hinted subscription count
+    while( table->member_capacity <
+           subscription_hint + subscription_hint / 3 )
+        table->member_capacity *= 2;
+
+    table->topics = calloc( table->topic_capacity, sizeof( struct ddTopic ) );
+    table->tag_index = calloc( table->tag_capacity, sizeof( uint32_t ) );
+    table->members =
+        calloc( table->member_capacity, sizeof( struct ddSubscription ) );
+
+    if( !table->topics || !table->tag_index || !table->members )
+    {
+        console_write( LOG_ERROR, "Topic table allocation failed\n" );
+        dd_topics_free( table );
+        return false;
+    }
+
+    return true;
+}
+
+void dd_topics_free( struct ddTopicTable* c_restrict table )
+{
+    for( uint32_t id = 0; id < table->topic_count; id++ )
+        free( table->topics[id].subs );
+
+    free( table->topics );
+    free( table->tag_index );
+    free( table->members );
+    *table = ( struct ddTopicTable ){0};
+}
+
+uint32_t dd_topics_find( const struct ddTopicTable* c_restrict table,
+                         const char* c_restrict tag,
+                         const uint32_t tag_length )
+{
+    if( !table->tag_capacity || !valid_tag( tag_length ) )
+        return DD_TOPIC_NONE;
+
+    const uint32_t idx =
+        probe_tag( table, tag, tag_length, hash_tag( tag, tag_length ) );
+
+    return table->tag_index[idx] ? table->tag_index[idx] - 1 : DD_TOPIC_NONE;
+}
+
+uint32_t dd_topics_intern( struct ddTopicTable* c_restrict table,
+                           const char* c_restrict tag,
+                           const uint32_t tag_length )
+{
+    if( !table->tag_capacity || !valid_tag( tag_length ) )
+        return DD_TOPIC_NONE;
+
+    const uint32_t hash = hash_tag( tag, tag_length );
+    uint32_t idx = probe_tag( table, tag, tag_length, hash );
+
+    if( table->tag_index[idx] ) return table->tag_index[idx] - 1;
+
+    if( table->topic_count == table->topic_capacity )
+    {
+        struct ddTopic* topics =
+            realloc( table->topics,
+                     table->topic_capacity * 2 * sizeof( struct ddTopic ) );
+
+        if( !topics )
+        {
+            console_write( LOG_ERROR, "Topic table allocation failed\n" );
+            return DD_TOPIC_NONE;
+        }
+
+        table->topics = topics;
+        table->topic_capacity *= 2;
+    }
+
+    if( ( table->topic_count + 1 ) * 4 > table->tag_capacity * 3 )
+    {
+        if( !grow_tags( table ) ) return DD_TOPIC_NONE;
+
+        idx = probe_tag( table, tag, tag_length, hash );
+    }
+
+    const uint32_t id = table->topic_count++;
+    struct ddTopic* topic = &table->topics[id];
+
+    *topic = ( struct ddTopic ){.tag_length = tag_length, .hash = hash};
+    memcpy( topic->tag, tag, tag_length );
+
+    table->tag_index[idx] = id + 1;
+    return id;
+}
+
+bool dd_topics_subscribe( struct ddTopicTable* c_restrict table,
+                          const uint32_t topic,
+                          const struct sockaddr_storage* c_restrict addr,
+                          const socklen_t addr_len )
+{
+    const struct sockaddr* sa = (const struct sockaddr*)addr;
+
+    if( topic >= table->topic_count || !dd_peers_supported( sa ) )
+        return false;
+
+    const uint32_t hash = hash_member( topic, dd_peers_hash_addr( sa ) );
+    uint32_t idx = probe_member( table, topic, sa, hash );
+
+    if( table->members[idx].hash ) return true;
+
+    if( ( table->member_count + 1 ) * 4 > table->member_capacity * 3 )
+    {
+        if( !grow_members( table ) ) return false;
+
+        idx = probe_member( table, topic, sa, hash );
+    }
+
+    struct ddTopic* entry = &table->topics[topic];
+
+    if( entry->count == entry->capacity )
+    {
+        const uint32_t capacity = entry->capacity ? entry->capacity * 2 : 4;
+        struct ddSubscriber* subs =
+            realloc( entry->subs, capacity * sizeof( *subs ) );
+
+        if( !subs )
+        {
+            console_write( LOG_ERROR, "Topic table allocation failed\n" );
+            return false;
+        }
+
+        entry->subs = subs;
+        entry->capacity = capacity;
+    }
+
+    struct ddSubscriber* sub = &entry->subs[entry->count];
+
+    *sub = ( struct ddSubscriber ){.addr_len = addr_len};
+    memcpy( &sub->addr,
+            addr,
+            sa->sa_family == AF_INET ? sizeof( struct sockaddr_in )
+                                     : sizeof( struct sockaddr_in6 ) );
+
+    table->members[idx] = ( struct ddSubscription ){
+        .hash = hash,
+        .topic = topic,
+        .index = entry->count++,
+    };
+    table->member_count++;
+
+    return true;
+}
+
+bool dd_topics_unsubscribe( struct ddTopicTable* c_restrict table,
+                            const uint32_t topic,
+                            const struct sockaddr_storage* c_restrict addr )
+{
+    const struct sockaddr* sa = (const struct sockaddr*)addr;
+
+    if( topic >= table->topic_count || !dd_peers_supported( sa ) )
+        return false;
+
+    const uint32_t idx = probe_member(
+        table, topic, sa, hash_member( topic, dd_peers_hash_addr( sa ) ) );
+
+    if( !table->members[idx].hash ) return false;
+
+    struct ddTopic* entry = &table->topics[topic];
+    const uint32_t index = table->members[idx].index;
+    const uint32_t last = entry->count - 1;
+
+    remove_member( table, idx );
+
+    if( index != last )
+    {
+        // the last subscriber fills the hole, so repoint its entry
+        const struct sockaddr* moved = &entry->subs[last].addr.sa;
+        const uint32_t moved_idx = probe_member(
+            table,
+            topic,
+            moved,
+            hash_member( topic, dd_peers_hash_addr( moved ) ) );
+
+        table->members[moved_idx].index = index;
+        entry->subs[index] = entry->subs[last];
+    }
+
+    entry->count--;
+    return true;
+}
+
+uint32_t dd_topics_unsubscribe_all(
+    struct ddTopicTable* c_restrict table,
+    const struct sockaddr_storage* c_restrict addr )
+{
+    uint32_t removed = 0;
+
+    for( uint32_t id = 0; id < table->topic_count; id++ )
+    {
+        if( table->topics[id].count &&
+            dd_topics_unsubscribe( table, id, addr ) )
+            removed++;
+    }
+
+    return removed;
+}
+
+bool dd_topics_handle( struct ddTopicTable* c_restrict table,
+                       const struct ddRecvMsg* c_restrict msg )
+{
+    struct ddTopicFrame frame;
+
+    if( !dd_topic_decode( msg->msg, msg->bytes_read, &frame ) ||
+        frame.op == DDTOPIC_PUBLISH )
+        return false;
+
+    // topics are never freed, so peers only pick from the interned ones
+    const uint32_t topic =
+        dd_topics_find( table, frame.tag, frame.tag_length );
+
+    if( topic == DD_TOPIC_NONE )
+    {
+        if( frame.op == DDTOPIC_SUBSCRIBE ) table->refused++;
+
+        return true;
+    }
+
+    if( frame.op == DDTOPIC_SUBSCRIBE )
+        dd_topics_subscribe( table, topic, &msg->sender, msg->addr_len );
+    else
+        dd_topics_unsubscribe( table, topic, &msg->sender );
+
+    return true;
+}
+
+uint32_t dd_topics_publish_raw( const struct ddAddressInfo* c_restrict sender,
+                                const struct ddTopicTable* c_restrict table,
+                                const uint32_t topic,
+                                const char* c_restrict frame,
+                                const uint32_t frame_length )
+{
+    if( topic >= table->topic_count || !table->topics[topic].count ) return 0;
+
+    const struct ddTopic* entry = &table->topics[topic];
+    char output[MAX_MSG_LENGTH];
+
+    const int32_t length = dd_topic_encode( DDTOPIC_PUBLISH,
+                                            entry->tag,
+                                            entry->tag_length,
+                                            frame,
+                                            frame_length,
+                                            output,
+                                            sizeof( output ) );
+
+    if( length == -1 )
+    {
+        console_write( LOG_WARN, "Topic frame too large\n" );
+        return 0;
+    }
+
+    const struct sockaddr* addrs[MAX_SEND_BATCH];
+    socklen_t addr_lens[MAX_SEND_BATCH];
+    uint32_t sent_count = 0;
+
+    for( uint32_t first = 0; first < entry->count; first += MAX_SEND_BATCH )
+    {
+        const uint32_t left = entry->count - first;
+        const uint32_t batch_size =
+            left < MAX_SEND_BATCH ? left : MAX_SEND_BATCH;
+
+        for( uint32_t i = 0; i < batch_size; i++ )
+        {
+            addrs[i] = &entry->subs[first + i].addr.sa;
+            addr_lens[i] = entry->subs[first + i].addr_len;
+        }
+
+        sent_count += dd_server_send_many(
+            sender, output, length, addrs, addr_lens, batch_size, NULL );
+    }
+
+    return sent_count;
+}
+
+uint32_t dd_topics_publish( const struct ddAddressInfo* c_restrict sender,
+                            const struct ddTopicTable* c_restrict table,
+                            const uint32_t topic,
+                            const uint32_t msg_type,
+                            const struct ddMsgVal* c_restrict msg )
+{
+    if( topic >= table->topic_count || !table->topics[topic].count ) return 0;
+
+    char frame[MAX_MSG_LENGTH];
+
+    const int32_t length =
+        dd_msg_encode( msg_type, msg, frame, sizeof( frame ) );
+
+    if( length == -1 ) return 0;
+
+    return dd_topics_publish_raw(
+        sender, table, topic, frame, (uint32_t)length );
+}
+
+int32_t dd_topic_encode( const uint32_t op,
+                         const char* c_restrict tag,
+                         const uint32_t tag_length,
+                         const char* c_restrict payload,
+                         const uint32_t payload_length,
+                         char* c_restrict out,
+                         const uint32_t out_size )
+{
+    const uint32_t length = DD_TOPIC_HEADER_SIZE( tag_length ) + payload_length;
+
+    if( op > DDTOPIC_UNSUBSCRIBE || !valid_tag( tag_length ) ||
+        length > out_size || length > MAX_MSG_LENGTH - 1 )
+        return -1;
+
+    out[0] = (char)( DDFRAME_MARK | DDFRAME_TOPIC | op );
+    out[1] = (char)tag_length;
+    memcpy( out + 2, tag, tag_length );
+
+    if( payload_length )
+        memcpy( out + DD_TOPIC_HEADER_SIZE( tag_length ),
+                payload,
+                payload_length );
+
+    return (int32_t)length;
+}
+
+bool dd_topic_decode( const char* c_restrict data,
+                      const int32_t length,
+                      struct ddTopicFrame* c_restrict frame )
+{
+    const uint8_t* in = (const uint8_t*)data;
+
+    if( length < DD_TOPIC_HEADER_SIZE( 1 ) ||
+        ( in[0] & ~DDFRAME_KIND_MASK ) != ( DDFRAME_MARK | DDFRAME_TOPIC ) )
+        return false;
+
+    const uint32_t op = in[0] & DDFRAME_KIND_MASK;
+    const uint32_t tag_length = in[1];
+
+    if( op > DDTOPIC_UNSUBSCRIBE || !valid_tag( tag_length ) ||
+        (uint32_t)length < DD_TOPIC_HEADER_SIZE( tag_length ) )
+        return false;
+
+    *frame = ( struct ddTopicFrame ){
+        .op = op,
+        .tag = data + 2,
+        .tag_length = tag_length,
+        .payload = data + DD_TOPIC_HEADER_SIZE( tag_length ),
+        .payload_length =
+            (uint32_t)length - DD_TOPIC_HEADER_SIZE( tag_length ),
+    };
+
+    return true;
+}
@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ddConfig.h"
+#include "ArgHandler.h"
+#include "ConsoleWrite.h"
+#include "StatsSegment.h"
+#include "TimeInterface.h"
+
+/* Samples a server's stats segment ( see StatsSegment.h ) read-only & prints
+ * counter rates & gauge values every interval. Nothing goes through the
+ * server's sockets or console */
+
+static void sleep_seconds( const double seconds )
+{
+    const uint64_t nanos = seconds_to_nano( seconds );
+    struct timespec wait = {
+        .tv_sec = (time_t)( nanos / 1000000000ULL ),
+        .tv_nsec = (long)( nanos % 1000000000ULL ),
+    };
+
+    nanosleep( &wait, NULL );
+}
+
+static double uptime_seconds( const struct ddStatsSegment* c_restrict segment )
+{
+    const uint64_t wall = get_wall_time();
+
+    return wall > segment->start_time
+               ? nano_to_seconds( wall - segment->start_time )
+               : 0.0;
+}
+
+static void print_sample( const struct ddStatsSegment* c_restrict segment,
+                          const uint64_t* c_restrict values,
+                          const uint64_t* c_restrict previous,
+                          const double elapsed,
+                          const bool json )
+{
+    if( json )
+    {
+        printf( "{\"pid\": %d, \"uptime\": %.3f, \"interval\": %.3f",
+                segment->pid,
+                uptime_seconds( segment ),
+                elapsed );
+
+        for( uint32_t i = 0; i < DDSTAT_COUNT; i++ )
+        {
+            printf( ", \"%s\": %llu",
+                    dd_stats_name( i ),
+                    (unsigned long long)values[i] );
+
+            if( !dd_stats_is_gauge( i ) )
+                printf( ", \"%s_rate\": %.1f",
+                        dd_stats_name( i ),
+                        (double)( values[i] - previous[i] ) / elapsed );
+        }
+
+        printf( "}\n" );
+        fflush( stdout );
+        return;
+    }
+
+    printf( "pid %d  up %.1f s\n", segment->pid, uptime_seconds( segment ) );
+
+    for( uint32_t i = 0; i < DDSTAT_COUNT; i++ )
+    {
+        if( !dd_stats_is_gauge( i ) )
+            printf( "  %-16s %16llu %14.1f/s\n",
+                    dd_stats_name( i ),
+                    (unsigned long long)values[i],
+                    (double)( values[i] - previous[i] ) / elapsed );
+        else
+            printf( "  %-16s %16llu\n",
+                    dd_stats_name( i ),
+                    (unsigned long long)values[i] );
+    }
+
+    fflush( stdout );
+}
+
+int main( int argc, char const* argv[] )
+{
+    struct ddArgHandler arg_handler;
+
+    init_arg_handler( &arg_handler,
+                      "Prints live counters from a server's stats segment." );
+
+    struct ddArgStat pid_arg = {
+        .description = "Server process id, reads /ddstat.<pid>",
+        .full_id = "pid",
+        .type_flag = ARG_INT,
+        .short_id = 'p',
+        .default_val = {.i = 0}};
+
+    struct ddArgStat name_arg = {
+        .description = "Segment name, overrides --pid",
+        .full_id = "name",
+        .type_flag = ARG_STR,
+        .short_id = 'n',
+        .default_val = {.c = NULL}};
+
+    struct ddArgStat interval_arg = {
+        .description = "Seconds between samples ( default : 1 sec )",
+        .full_id = "interval",
+        .type_flag = ARG_FLT,
+        .short_id = 'i',
+        .default_val = {.f = 1.f}};
+
+    struct ddArgStat count_arg = {
+        .description = "Samples to print, 0 = until the server exits "
+                       "( default : 0 )",
+        .full_id = "count",
+        .type_flag = ARG_INT,
+        .short_id = 'c',
+        .default_val = {.i = 0}};
+
+    struct ddArgStat json_arg = {
+        .description = "Print a JSON object per sample ( default : false )",
+        .full_id = "json",
+        .type_flag = ARG_BOOL,
+        .short_id = 'j',
+        .default_val = {.b = false}};
+
+    register_arg( &arg_handler, &pid_arg );
+    register_arg( &arg_handler, &name_arg );
+    register_arg( &arg_handler, &interval_arg );
+    register_arg( &arg_handler, &count_arg );
+    register_arg( &arg_handler, &json_arg );
+
+    poll_args( &arg_handler, argc, argv );
+
+    if( extract_arg( &arg_handler, 'h' )->val.b )
+    {
+        print_arg_help_msg( &arg_handler );
+        return 0;
+    }
+
+    const int32_t pid = extract_arg( &arg_handler, 'p' )->val.i;
+    const char* name = extract_arg( &arg_handler, 'n' )->val.c;
+    const double interval = (double)extract_arg( &arg_handler, 'i' )->val.f;
+    const int32_t count = extract_arg( &arg_handler, 'c' )->val.i;
+    const bool json = extract_arg( &arg_handler, 'j' )->val.b;
+
+    char pid_name[32];
+
+    if( !name && pid > 0 )
+    {
+        snprintf( pid_name, sizeof( pid_name ), "/ddstat.%d", pid );
+        name = pid_name;
+    }
+
+    if( !name || interval <= 0.0 || count < 0 )
+    {
+        console_write( LOG_ERROR,
+                       "Need --pid or --name, interval > 0 & count >= 0\n" );
+        return 1;
+    }
+
+    const struct ddStatsSegment* segment = dd_stats_attach( name );
+
+    if( !segment )
+    {
+        console_write( LOG_ERROR,
+                       "No stats segment %s ( version %d )\n",
+                       name,
+                       DD_STATS_VERSION );
+        return 1;
+    }
+
+    uint64_t previous[DDSTAT_COUNT];
+    uint64_t values[DDSTAT_COUNT];
+
+    for( uint32_t i = 0; i < DDSTAT_COUNT; i++ )
+        previous[i] = dd_stats_read( segment, i );
+
+    uint64_t last = get_high_res_time();
+
+    for( int32_t sample = 0; count == 0 || sample < count; sample++ )
+    {
+        sleep_seconds( interval );
+
+        // the server unlinks the segment when it stops
+        const struct ddStatsSegment* live = dd_stats_attach( name );
+
+        if( !live ) break;
+
+        dd_stats_detach( live );
+
+        const uint64_t now = get_high_res_time();
+
+        for( uint32_t i = 0; i < DDSTAT_COUNT; i++ )
+            values[i] = dd_stats_read( segment, i );
+
+        print_sample(
+            segment, values, previous, nano_to_seconds( now - last ), json );
+
+        memcpy( previous, values, sizeof( previous ) );
+        last = now;
+    }
+
+    dd_stats_detach( segment );
+
+    return 0;
+}
@@ -1,19 +1,49 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "ddConfig.h"
 #include "ArgHandler.h"
 #include "ConsoleWrite.h"
 #include "ServerInterface.h"
 #include "TimeInterface.h"
+#include "PeerTable.h"
+#include "BufferPool.h"
+#include "Fragment.h"
+#include "ReliableChannel.h"
 
-static struct ddAddressInfo s_clients[BACKLOG];
-static uint32_t s_num_clients;
+#define POOL_SLOTS 256
+#define CLOSE_GRACE 2.0  // secs to wait on close notice acks before exit
+
+// ddPeer.data, replies & the close notice go out the listener
+struct peer_session
+{
+    struct ddReliableChannel channel;
+    const struct ddAddressInfo* listener;
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+};
+
+static struct ddPeerTable s_peers;
+
+// datagrams held until the next timer tick, no copy out of the pool
+static struct ddBufferPool s_pool;
+static struct ddPoolBuf* s_pending[POOL_SLOTS];
+static uint32_t s_pending_count = 0;
+
+// messages too large for one datagram
+static struct ddReassembler s_reasm;
 
 static double s_time_tracker = 0.0;
 static double s_timeout_limit = 0.0;
+static double s_closing_since = -1.0;  // close notice sent, waiting on acks
 
 void read_cb( struct ddLoop* loop );
 void timer_cb( struct ddLoop* loop, struct ddServerTimer* timer );
+void evict_timer_cb( struct ddLoop* loop, struct ddServerTimer* timer );
+void peer_idle_cb( struct ddPeerTable* table, struct ddPeer* peer );
+void flush_pending();
+void free_sessions();
 
 int main( int argc, char const* argv[] )
 {
@@ -57,11 +87,19 @@ int main( int argc, char const* argv[] )
         .short_id = 'm',
         .default_val = {.c = "empty"}};
 
+    struct ddArgStat idle_arg = {
+        .description = "Set time before idle peers drop ( default : 30 sec )",
+        .full_id = "idle",
+        .type_flag = ARG_FLT,
+        .short_id = 'd',
+        .default_val = {.f = 30.f}};
+
     register_arg( &arg_handler, &ip_arg );
     register_arg( &arg_handler, &port_arg );
     register_arg( &arg_handler, &server_arg );
     register_arg( &arg_handler, &timeout_arg );
     register_arg( &arg_handler, &msg_arg );
+    register_arg( &arg_handler, &idle_arg );
 
     poll_args( &arg_handler, argc, argv );
 
@@ -83,7 +121,8 @@ int main( int argc, char const* argv[] )
     const char* port_str = extract_arg( &arg_handler, 'p' )->val.c;
     const bool listen_flag = extract_arg( &arg_handler, 's' )->val.b;
 
-    dd_create_socket( &server_addr, ip_addr_str, port_str, listen_flag );
+    dd_create_socket(
+        &server_addr, ip_addr_str, port_str, listen_flag, NULL );
 
 #ifdef VERBOSE
     console_write(
@@ -98,24 +137,55 @@ int main( int argc, char const* argv[] )
 
     if( listen_flag )
     {
+        const double idle_limit = extract_arg( &arg_handler, 'd' )->val.f;
+
+        if( !dd_peers_init( &s_peers, BACKLOG, idle_limit, peer_idle_cb ) )
+            return 1;
+
+        if( !dd_pool_init( &s_pool, POOL_SLOTS ) ) return 1;
+
+        if( !dd_frag_init( &s_reasm ) ) return 1;
+
         struct ddLoop looper = dd_server_new_loop( read_cb, &server_addr );
 
-        dd_loop_add_timer( &looper, timer_cb, 0.1, true );
+        if( !looper.active ) return 1;
+
+        dd_loop_add_timer( &looper, timer_cb, 0.1, true, NULL );
+        dd_loop_add_timer( &looper, evict_timer_cb, 1.0, true, NULL );
 
         dd_loop_run( &looper );
+
+        dd_loop_cleanup( &looper );
+        free_sessions();
+        dd_peers_free( &s_peers );
+
+        flush_pending();
+        console_write( LOG_STATUS,
+                       "Buffer pool high-water mark: %u/%u\n",
+                       dd_pool_high_water( &s_pool ),
+                       s_pool.capacity );
+        dd_pool_free( &s_pool );
+        dd_frag_free( &s_reasm );
     }
     else
     {
         struct ddMsgVal msg = {.c = extract_arg( &arg_handler, 'm' )->val.c};
+        const uint32_t msg_length = (uint32_t)strlen( msg.c );
 
-        dd_server_send_msg( &server_addr, DDMSG_STR, &msg );
+        if( msg_length < MAX_MSG_LENGTH - DDFRAME_HEADER_SIZE )
+            dd_server_send_msg( &server_addr, DDMSG_STR, &msg );
+        else
+            dd_frag_send_to( &server_addr,
+                             server_addr.selected->ai_addr,
+                             (socklen_t)server_addr.selected->ai_addrlen,
+                             msg.c,
+                             msg_length );
 
         freeaddrinfo( server_addr.options );
     }
 
     dd_close_socket( &server_addr.socket_fd );
 
-    dd_close_clients( s_clients, s_num_clients );
 #ifdef _WIN32
     void dd_server_cleanup_win32();
 #endif  // _WIN32
@@ -127,30 +197,184 @@ int main( int argc, char const* argv[] )
     return 0;
 }
 
-void read_cb( struct ddLoop* loop )
+bool session_send_cb( struct ddReliableChannel* channel,
+                      const char* data,
+                      const int32_t length )
+{
+    const struct peer_session* session = channel->data;
+    const struct sockaddr* addr = (const struct sockaddr*)&session->addr;
+
+    return dd_server_send_many( session->listener,
+                                data,
+                                length,
+                                &addr,
+                                &session->addr_len,
+                                1,
+                                NULL ) == 1;
+}
+
+void session_deliver_cb( struct ddReliableChannel* channel,
+                         const char* frame,
+                         const int32_t length )
+{
+    UNUSED_VAR( channel );
+
+    dd_msg_print( frame, length );
+}
+
+// a reliable channel for each new peer, NULL when it couldn't be set up
+struct peer_session* new_session( const struct ddAddressInfo* listener,
+                                  const struct ddRecvMsg* msg )
+{
+    struct peer_session* session = malloc( sizeof( struct peer_session ) );
+
+    if( !session ) return NULL;
+
+    session->listener = listener;
+    session->addr = msg->sender;
+    session->addr_len = msg->addr_len;
+
+    if( !dd_reliable_init(
+            &session->channel, session_send_cb, session_deliver_cb, session ) )
+    {
+        free( session );
+        return NULL;
+    }
+
+    return session;
+}
+
+void free_session( struct ddPeer* peer )
 {
-    struct ddRecvMsg data = {
-        .bytes_read = 0,
-    };
+    struct peer_session* session = peer->data;
 
-    dd_server_recieve_msg( loop->listener, &data );
+    if( !session ) return;
 
-    if( data.bytes_read == -1 )
+    dd_reliable_free( &session->channel );
+    free( session );
+    peer->data = NULL;
+}
+
+void free_sessions()
+{
+    for( uint32_t i = 0; i < s_peers.capacity; i++ )
+        if( s_peers.entries[i].hash ) free_session( &s_peers.entries[i] );
+}
+
+void read_cb( struct ddLoop* loop )
+{
+    struct ddPoolBuf* buf = NULL;
+
+    if( dd_server_recieve_pooled( loop->listener, &s_pool, &buf ) == -1 )
+    {
         dd_loop_break( loop );
-    else
+        return;
+    }
+
+    // dropped while the pool is empty, ddstat shows the pool_drops count
+    if( !buf ) return;
+
+    // replies go back out the listener, so no socket per peer
+    bool created = false;
+    struct ddPeer* peer = dd_peers_touch( &s_peers,
+                                          &buf->msg.sender,
+                                          buf->msg.addr_len,
+                                          loop->active_time,
+                                          &created );
+
+    if( created )
     {
-        if( s_num_clients < BACKLOG )
-        {
-            const bool success = dd_create_socket2( &s_clients[s_num_clients],
-                                                    &data.sender,
-                                                    loop->listener->port_num );
+        peer->data = new_session( loop->listener, &buf->msg );
 
-            if( success ) s_num_clients++;
-        }
+        console_write(
+            LOG_STATUS, "New peer ( %u connected )\n", s_peers.count );
+    }
+
+    // acks & reliable frames, delivered in order through the session
+    struct peer_session* session = peer ? peer->data : NULL;
+
+    if( session && dd_reliable_recv( &session->channel,
+                                     buf->msg.msg,
+                                     buf->msg.bytes_read,
+                                     loop->active_time ) )
+    {
+        dd_pool_release( buf );
+        s_time_tracker = dd_loop_time_seconds( loop );
+        return;
+    }
 
-        console_write( LOG_NOTAG, "Data: %s\n", data.msg );
+    // fragments are copied into place, so the slot goes straight back
+    struct ddFragMessage* large = NULL;
+
+    if( dd_frag_recv( &s_reasm, &buf->msg, loop->active_time, &large ) )
+    {
+        dd_pool_release( buf );
+
+        if( large )
+        {
+            console_write( LOG_NOTAG,
+                           "Data recieved ( %u bytes ): %s\n",
+                           large->length,
+                           large->data );
+            dd_frag_release( &s_reasm, large );
+        }
 
         s_time_tracker = dd_loop_time_seconds( loop );
+        return;
+    }
+
+    // pending list owns the slot until the next flush
+    s_pending[s_pending_count++] = buf;
+
+    if( s_pending_count == POOL_SLOTS ) flush_pending();
+
+    s_time_tracker = dd_loop_time_seconds( loop );
+}
+
+void flush_pending()
+{
+    for( uint32_t i = 0; i < s_pending_count; i++ )
+    {
+        dd_msg_print( s_pending[i]->msg.msg, s_pending[i]->msg.bytes_read );
+        dd_pool_release( s_pending[i] );
+    }
+
+    s_pending_count = 0;
+}
+
+// resends & acks for every session. Returns frames still unacked
+uint32_t update_sessions( const uint64_t now )
+{
+    uint32_t in_flight = 0;
+
+    for( uint32_t i = 0; i < s_peers.capacity; i++ )
+    {
+        struct peer_session* session = s_peers.entries[i].data;
+
+        if( !s_peers.entries[i].hash || !session ) continue;
+
+        dd_reliable_update( &session->channel, now );
+
+        if( !session->channel.failed )
+            in_flight += dd_reliable_in_flight( &session->channel );
+    }
+
+    return in_flight;
+}
+
+// the close notice must not be lost, so it goes through each session
+void send_close_notice( const uint64_t now )
+{
+    struct ddMsgVal msg = {.c = "Closing connection"};
+
+    for( uint32_t i = 0; i < s_peers.capacity; i++ )
+    {
+        struct peer_session* session = s_peers.entries[i].data;
+
+        if( !s_peers.entries[i].hash || !session ) continue;
+
+        if( !dd_reliable_send( &session->channel, DDMSG_STR, &msg, now ) )
+            console_write( LOG_WARN, "Close notice not queued\n" );
     }
 }
 
@@ -158,7 +382,26 @@ void timer_cb( struct ddLoop* loop, struct ddServerTimer* timer )
 {
     UNUSED_VAR( timer );
 
-    double elapsed = dd_loop_time_seconds( loop ) - s_time_tracker;
+    flush_pending();
+
+    const uint32_t in_flight = update_sessions( loop->active_time );
+    const double now = dd_loop_time_seconds( loop );
+
+    if( s_closing_since >= 0.0 )
+    {
+        if( in_flight == 0 || now - s_closing_since > CLOSE_GRACE )
+        {
+            if( in_flight )
+                console_write(
+                    LOG_WARN, "%u close notices unacked\n", in_flight );
+
+            dd_loop_break( loop );
+        }
+
+        return;
+    }
+
+    double elapsed = now - s_time_tracker;
 
     if( elapsed > s_timeout_limit )
     {
@@ -166,11 +409,23 @@ void timer_cb( struct ddLoop* loop, struct ddServerTimer* timer )
                        "Timeout limit reached (time elapsed %.5f)\n",
                        (float)elapsed );
 
-        struct ddMsgVal msg = {.c = "Closing connection"};
+        send_close_notice( loop->active_time );
+        s_closing_since = now;
+    }
+}
 
-        for( uint32_t i = 0; i < s_num_clients; i++ )
-            dd_server_send_msg( &s_clients[i], DDMSG_STR, &msg );
+void evict_timer_cb( struct ddLoop* loop, struct ddServerTimer* timer )
+{
+    UNUSED_VAR( timer );
 
-        dd_loop_break( loop );
-    }
+    dd_peers_evict_idle( &s_peers, loop->active_time );
+    dd_frag_expire( &s_reasm, loop->active_time );
+}
+
+void peer_idle_cb( struct ddPeerTable* table, struct ddPeer* peer )
+{
+    free_session( peer );
+
+    console_write(
+        LOG_STATUS, "Idle peer dropped ( %u connected )\n", table->count - 1 );
 }
\ No newline at end of file
@@ -4,17 +4,64 @@
 #include "ddConfig.h"
 #include "ArgHandler.h"
 #include "ConsoleWrite.h"
+#include "PeerTable.h"
 #include "ServerInterface.h"
+#include "StatsSegment.h"
 #include "TimeInterface.h"
+#include "TopicTable.h"
 
-#define IP_LENGTH INET6_ADDRSTRLEN
+// everyone messages go to, replies leave through the listener
+static struct ddPeerTable s_peers;
 
-static struct ddAddressInfo s_clients[BACKLOG];
-static char s_client_ips[BACKLOG][IP_LENGTH];
-static char s_client_ports[BACKLOG][10];
-static uint32_t s_num_clients;
+// tags opened w/ "+tag", peers subscribe to them w/ topic frames
+static struct ddTopicTable s_topics;
+
+static void read_cb( struct ddLoop* loop, struct ddRecvBatch* batch );
+// "+tag" opens a topic for peers to subscribe to
+static void open_topic( const char* c_restrict tag )
+{
+    const uint32_t topic =
+        dd_topics_intern( &s_topics, tag, (uint32_t)strlen( tag ) );
+
+    if( topic == DD_TOPIC_NONE )
+        console_write( LOG_ERROR,
+                       "Topic not opened-> tags are 1 to %d bytes\n",
+                       DD_TOPIC_MAX_TAG );
+    else
+        console_write( LOG_STATUS, "Topic %s open ( id %u )\n", tag, topic );
+}
+
+// "/tag message" goes to the topic's subscribers only
+static void publish( struct ddLoop* loop, char* c_restrict entry )
+{
+    char* text = strchr( entry, ' ' );
+
+    if( text ) *text++ = '\0';
+
+    const uint32_t topic =
+        dd_topics_find( &s_topics, entry, (uint32_t)strlen( entry ) );
+
+    if( topic == DD_TOPIC_NONE )
+    {
+        console_write( LOG_ERROR, "Unknown topic-> %s\n", entry );
+        return;
+    }
+
+    struct ddMsgVal msg = {
+        .c = text ? text : "",
+    };
+
+    const uint32_t expected = s_topics.topics[topic].count;
+    const uint32_t sent = dd_topics_publish(
+        loop->listener, &s_topics, topic, DDMSG_STR, &msg );
+
+    if( sent < expected )
+        console_write( LOG_ERROR,
+                       "Publish failed-> %u of %u subscribers reached\n",
+                       sent,
+                       expected );
+}
 
-static void read_cb( struct ddLoop* loop );
 static void timer_cb( struct ddLoop* loop, struct ddServerTimer* timer );
 
 static char input_msg[MAX_MSG_LENGTH];
@@ -41,8 +88,26 @@ int main( int argc, char const* argv[] )
         .short_id = 'p',
         .default_val = {.c = "4321"}};
 
+    struct ddArgStat async_arg = {
+        .description = "Format log output on a writer thread ( default : "
+                       "false )",
+        .full_id = "async-log",
+        .type_flag = ARG_BOOL,
+        .short_id = 'a',
+        .default_val = {.b = false}};
+
+    struct ddArgStat stats_arg = {
+        .description = "Publish counters for ddstat in /ddstat.<pid> ( "
+                       "default : false )",
+        .full_id = "stats",
+        .type_flag = ARG_BOOL,
+        .short_id = 's',
+        .default_val = {.b = false}};
+
     register_arg( &arg_handler, &ip_arg );
     register_arg( &arg_handler, &port_arg );
+    register_arg( &arg_handler, &async_arg );
+    register_arg( &arg_handler, &stats_arg );
 
     // get arguments passed in
     poll_args( &arg_handler, argc, argv );
@@ -53,6 +118,10 @@ int main( int argc, char const* argv[] )
         return 0;
     }
 
+    if( extract_arg( &arg_handler, 'a' )->val.b ) console_async_start();
+
+    if( extract_arg( &arg_handler, 's' )->val.b ) dd_stats_open( NULL );
+
 #if DD_PLATFORM == DD_WIN32
     dd_server_init_win32();
 #endif  // DD_PLATFORM == DD_WIN32
@@ -63,24 +132,47 @@ int main( int argc, char const* argv[] )
     const char* ip_addr_str = extract_arg( &arg_handler, 'i' )->val.c;
     const char* port_str = extract_arg( &arg_handler, 'p' )->val.c;
 
-    dd_create_socket( &server_addr, ip_addr_str, port_str, true );
+    dd_create_socket( &server_addr, ip_addr_str, port_str, true, NULL );
 
     if( server_addr.selected == NULL )
     {
         console_write( LOG_ERROR, "Socket not created\n" );
+        console_async_stop();
         return 1;
     }
 
-    struct ddLoop looper = dd_server_new_loop( read_cb, &server_addr );
+    // drain up to MAX_RECV_BATCH datagrams per wakeup
+    struct ddRecvBatch batch;
+
+    if( !dd_recv_batch_init( &batch, MAX_RECV_BATCH ) ) return 1;
+
+    // peers are added by hand or by messaging us & never go idle
+    if( !dd_peers_init( &s_peers, BACKLOG, 0.0, NULL ) ) return 1;
+
+    if( !dd_topics_init( &s_topics, BACKLOG ) ) return 1;
+
+    struct ddLoop looper = dd_server_new_loop( NULL, &server_addr );
+
+    if( !looper.active ) return 1;
+
+    dd_loop_set_batch_cb( &looper, read_cb, &batch );
 
     // add timed callback for processing messages
-    dd_loop_add_timer( &looper, timer_cb, 0.1, true );
+    dd_loop_add_timer( &looper, timer_cb, 0.1, true, NULL );
 
     dd_loop_run( &looper );
 
+#ifdef DD_LOOP_STATS
+    dd_loop_stats_print( &looper );
+#endif  // DD_LOOP_STATS
+
     // cleanup resources
+    dd_loop_cleanup( &looper );
+    dd_recv_batch_free( &batch );
     dd_close_socket( &server_addr.socket_fd );
-    dd_close_clients( s_clients, s_num_clients );
+    dd_peers_free( &s_peers );
+    dd_topics_free( &s_topics );
+    dd_stats_close();
 
 #if DD_PLATFORM == DD_WIN32
     void dd_server_cleanup_win32();
@@ -90,33 +182,81 @@ int main( int argc, char const* argv[] )
     console_write( LOG_STATUS, "Closing server/client program\n" );
 #endif  // VERBOSE
 
+    console_async_stop();
+
     return 0;
 }
 
-static void read_cb( struct ddLoop* loop )
+static void read_cb( struct ddLoop* loop, struct ddRecvBatch* batch )
 {
-    // buffer for message retrieval
-    struct ddRecvMsg data = {
-        .bytes_read = 0,
-    };
+    for( uint32_t i = 0; i < batch->count; i++ )
+    {
+        struct ddRecvMsg* data = &batch->msgs[i];
 
-    dd_server_recieve_msg( loop->listener, &data );
+        // every sender joins the messaging list
+        bool created = false;
+        dd_peers_touch( &s_peers,
+                        &data->sender,
+                        data->addr_len,
+                        loop->active_time,
+                        &created );
 
-    if( data.bytes_read == -1 )
-        dd_loop_break( loop );  // server read error
-    else
+        if( created )
+            console_write(
+                LOG_STATUS, "New peer ( %u connected )\n", s_peers.count );
+
+        // subscribe & unsubscribe frames stop here
+        if( dd_topics_handle( &s_topics, data ) ) continue;
+
+        dd_msg_print( data->msg, data->bytes_read );
+    }
+}
+
+// resolves an "ip#port" entry & adds it to the messaging list
+static void add_peer( struct ddLoop* loop, char* c_restrict entry )
+{
+    char* port_ptr = strchr( entry, '#' );
+
+    if( !port_ptr ) return;
+
+    *port_ptr++ = '\0';
+
+    // remove whitespace ( can lead to failed connections )
+    char* whitespace = strchr( entry, ' ' );
+    if( whitespace ) *whitespace = '\0';
+
+    whitespace = strchr( port_ptr, ' ' );
+    if( whitespace ) *whitespace = '\0';
+
+    struct addrinfo hints = {
+        .ai_family = AF_UNSPEC,
+        .ai_socktype = SOCK_DGRAM,
+    };
+    struct addrinfo* found = NULL;
+
+    if( getaddrinfo( entry, port_ptr, &hints, &found ) != 0 || !found ||
+        found->ai_addrlen > sizeof( struct sockaddr_storage ) )
     {
-        // add 1st responder to messaging list
-        if( s_num_clients == 0 )
-        {
-            const bool success = dd_create_socket2( &s_clients[s_num_clients],
-                                                    &data.sender,
-                                                    loop->listener->port_num );
-            if( success ) s_num_clients++;
-        }
+        console_write( LOG_ERROR,
+                       "Connection un-established-> IP: %s PORT: %s\n",
+                       entry,
+                       port_ptr );
 
-        console_write( LOG_NOTAG, "Data recieved: %s\n", data.msg );
+        if( found ) freeaddrinfo( found );
+        return;
     }
+
+    struct sockaddr_storage addr = {0};
+    memcpy( &addr, found->ai_addr, found->ai_addrlen );
+
+    if( !dd_peers_touch( &s_peers,
+                         &addr,
+                         (socklen_t)found->ai_addrlen,
+                         loop->active_time,
+                         NULL ) )
+        console_write( LOG_ERROR, "Peer not added-> IP: %s\n", entry );
+
+    freeaddrinfo( found );
 }
 
 static void timer_cb( struct ddLoop* loop, struct ddServerTimer* timer )
@@ -130,43 +270,11 @@ static void timer_cb( struct ddLoop* loop, struct ddServerTimer* timer )
         if( strcmp( input_msg, "exit" ) == 0 ) dd_loop_break( loop );
         // process new ip to send messages to
         else if( input_msg[0] == '@' )
-        {
-            char* port_ptr = strchr( input_msg + 1, '#' );
-
-            if( port_ptr )
-            {
-                const size_t ip_len = port_ptr - input_msg;
-
-                snprintf( s_client_ips[s_num_clients],
-                          ip_len < IP_LENGTH ? ip_len : IP_LENGTH,
-                          "%s",
-                          input_msg + 1 );
-                snprintf(
-                    s_client_ports[s_num_clients], 10, "%s", port_ptr + 1 );
-
-                // remove whitespace ( can lead to failed connections )
-                char* whitespace = strchr( s_client_ips[s_num_clients], ' ' );
-                if( whitespace ) *whitespace = '\0';
-
-                whitespace = strchr( s_client_ports[s_num_clients], ' ' );
-                if( whitespace ) *whitespace = '\0';
-
-                // connection attempt
-                dd_create_socket( &s_clients[s_num_clients],
-                                  s_client_ips[s_num_clients],
-                                  s_client_ports[s_num_clients],
-                                  false );
-
-                if( s_clients[s_num_clients].selected == NULL )
-                    console_write(
-                        LOG_ERROR,
-                        "Connection un-established-> IP: %s PORT: %s\n",
-                        s_client_ips[s_num_clients],
-                        s_client_ports[s_num_clients] );
-                else
-                    s_num_clients++;
-            }
-        }
+            add_peer( loop, input_msg + 1 );
+        else if( input_msg[0] == '+' )
+            open_topic( input_msg + 1 );
+        else if( input_msg[0] == '/' )
+            publish( loop, input_msg + 1 );
         else
         {
             // send message to all connections
@@ -174,10 +282,21 @@ static void timer_cb( struct ddLoop* loop, struct ddServerTimer* timer )
                 .c = input_msg,
             };
 
-            for( uint32_t i = 0; i < s_num_clients; i++ )
-                dd_server_send_msg( &s_clients[i], DDMSG_STR, &msg );
+            const uint32_t sent = dd_peers_broadcast(
+                loop->listener, &s_peers, DDMSG_STR, &msg );
+
+            // a multicast listener sends one datagram to its group
+            const uint32_t expected =
+                loop->listener->multicast && s_peers.count ? 1
+                                                           : s_peers.count;
+
+            if( sent < expected )
+                console_write( LOG_ERROR,
+                               "Send failed-> %u of %u datagrams sent\n",
+                               sent,
+                               expected );
 
             input_msg[0] = '\0';
         }
     }
-}
\ No newline at end of file
+}
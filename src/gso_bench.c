@@ -0,0 +1,394 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+
+#include "ddConfig.h"
+#include "ArgHandler.h"
+#include "ConsoleWrite.h"
+#include "ServerInterface.h"
+#include "TimeInterface.h"
+
+/* Bulk transfer over loopback, one burst of equal sized datagrams at a time,
+ * through each send & receive path: a sendto/recvfrom per datagram,
+ * sendmmsg/recvmmsg & UDP_SEGMENT/UDP_GRO. Every datagram carries its
+ * sequence number & is checked on arrival */
+
+#define BENCH_SEQ_DIGITS 8
+#define BENCH_WAIT_MS 100  // give up on a burst's stragglers after this
+
+enum
+{
+    MODE_SENDTO = 0,
+    MODE_MMSG,
+    MODE_GSO,
+    MODE_COUNT,
+};
+
+static const char* s_mode_names[MODE_COUNT] = {"sendto", "mmsg", "gso"};
+
+struct mode_result
+{
+    bool available;
+    uint64_t sent;
+    uint64_t received;
+    uint64_t corrupt;  // wrong length, sequence or contents
+    double elapsed;    // seconds
+};
+
+static void fill_burst( char* c_restrict burst,
+                        const uint32_t segment_size,
+                        const uint32_t count,
+                        const uint64_t first_seq )
+{
+    for( uint32_t i = 0; i < count; i++ )
+    {
+        char* segment = burst + (size_t)i * segment_size;
+        const uint64_t seq = first_seq + i;
+
+        char digits[BENCH_SEQ_DIGITS + 1];
+        snprintf( digits,
+                  sizeof( digits ),
+                  "%0*llu",
+                  BENCH_SEQ_DIGITS,
+                  (unsigned long long)( seq % 100000000ULL ) );
+
+        memcpy( segment, digits, BENCH_SEQ_DIGITS );
+        memset( segment + BENCH_SEQ_DIGITS,
+                'a' + (int)( seq % 26 ),
+                segment_size - BENCH_SEQ_DIGITS );
+    }
+}
+
+static bool check_segment( const struct ddRecvMsg* c_restrict msg,
+                           const uint32_t segment_size,
+                           const uint64_t seq )
+{
+    if( msg->bytes_read != (int32_t)segment_size ) return false;
+
+    char digits[BENCH_SEQ_DIGITS + 1];
+    snprintf( digits,
+              sizeof( digits ),
+              "%0*llu",
+              BENCH_SEQ_DIGITS,
+              (unsigned long long)( seq % 100000000ULL ) );
+
+    if( memcmp( msg->msg, digits, BENCH_SEQ_DIGITS ) != 0 ) return false;
+
+    for( uint32_t i = BENCH_SEQ_DIGITS; i < segment_size; i++ )
+        if( msg->msg[i] != 'a' + (int)( seq % 26 ) ) return false;
+
+    return true;
+}
+
+static bool wait_readable( const ddSocket fd )
+{
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+
+    return poll( &pfd, 1, BENCH_WAIT_MS ) > 0;
+}
+
+static void send_burst( const uint32_t mode,
+                        const struct ddAddressInfo* c_restrict sender,
+                        const char* c_restrict burst,
+                        const uint32_t segment_size,
+                        const uint32_t count,
+                        struct mode_result* c_restrict result )
+{
+    const struct sockaddr* addr = sender->selected->ai_addr;
+    const socklen_t addr_len = (socklen_t)sender->selected->ai_addrlen;
+
+    if( mode != MODE_SENDTO )
+    {
+        result->sent += dd_server_send_segments( sender,
+                                                 burst,
+                                                 segment_size * count,
+                                                 segment_size,
+                                                 addr,
+                                                 addr_len );
+        return;
+    }
+
+    for( uint32_t i = 0; i < count; i++ )
+    {
+        if( sendto( sender->socket_fd,
+                    burst + (size_t)i * segment_size,
+                    segment_size,
+                    0,
+                    addr,
+                    addr_len ) != -1 )
+            result->sent++;
+    }
+}
+
+// receives until the burst is in or the socket goes quiet
+static void recv_burst( const uint32_t mode,
+                        struct ddAddressInfo* c_restrict listener,
+                        struct ddRecvBatch* c_restrict batch,
+                        const uint32_t segment_size,
+                        const uint32_t count,
+                        uint64_t* c_restrict next_seq,
+                        struct mode_result* c_restrict result )
+{
+    const uint64_t end_seq = *next_seq + count;
+
+    while( *next_seq < end_seq && wait_readable( listener->socket_fd ) )
+    {
+        if( mode == MODE_SENDTO )
+        {
+            batch->count = 0;
+            dd_server_recieve_msg( listener, &batch->msgs[0] );
+
+            if( batch->msgs[0].bytes_read != -1 ) batch->count = 1;
+        }
+        else if( dd_server_recieve_batch( listener, batch ) < 0 )
+            break;
+
+        for( uint32_t i = 0; i < batch->count; i++ )
+        {
+            // loopback keeps order, so a gap is a lost datagram
+            uint64_t seq = *next_seq;
+
+            while( seq < end_seq &&
+                   !check_segment( &batch->msgs[i], segment_size, seq ) )
+                seq++;
+
+            if( seq == end_seq )
+            {
+                result->corrupt++;
+                continue;
+            }
+
+            result->received++;
+            *next_seq = seq + 1;
+        }
+    }
+
+    *next_seq = end_seq;
+}
+
+static void run_mode( const uint32_t mode,
+                      const char* c_restrict ip,
+                      const char* c_restrict port,
+                      const uint32_t segment_size,
+                      const uint32_t count,
+                      const double duration,
+                      char* c_restrict burst,
+                      struct mode_result* c_restrict result )
+{
+    *result = ( struct mode_result ){0};
+
+    const struct ddSocketOpts opts = {
+        .udp_gso = mode == MODE_GSO,
+        .udp_gro = mode == MODE_GSO,
+    };
+
+    struct ddAddressInfo listener = {.options = NULL, .selected = NULL};
+    struct ddAddressInfo sender = {.options = NULL, .selected = NULL};
+    struct ddRecvBatch batch = {0};
+
+    if( !dd_create_socket( &listener, ip, port, true, &opts ) ) return;
+
+    if( !dd_create_socket( &sender, ip, port, false, &opts ) ||
+        !dd_recv_batch_init( &batch, MAX_RECV_BATCH ) )
+    {
+        dd_close_socket( &listener.socket_fd );
+        return;
+    }
+
+    result->available =
+        mode != MODE_GSO || ( sender.gso && listener.gro );
+
+    if( result->available )
+    {
+        uint64_t next_seq = 0;
+        const uint64_t start = get_high_res_time();
+        const uint64_t end = start + seconds_to_nano( duration );
+
+        while( get_high_res_time() < end )
+        {
+            fill_burst( burst, segment_size, count, next_seq );
+            send_burst( mode, &sender, burst, segment_size, count, result );
+            recv_burst( mode,
+                        &listener,
+                        &batch,
+                        segment_size,
+                        count,
+                        &next_seq,
+                        result );
+        }
+
+        result->elapsed = nano_to_seconds( get_high_res_time() - start );
+    }
+
+    dd_recv_batch_free( &batch );
+    dd_close_socket( &sender.socket_fd );
+    freeaddrinfo( sender.options );
+    dd_close_socket( &listener.socket_fd );
+}
+
+int main( int argc, char const* argv[] )
+{
+    struct ddArgHandler arg_handler;
+
+    init_arg_handler( &arg_handler,
+                      "Compares per datagram, mmsg & GSO/GRO bulk transfer "
+                      "over loopback." );
+
+    struct ddArgStat ip_arg = {
+        .description = "IP address to bind ( default : \"127.0.0.1\" )",
+        .full_id = "IP",
+        .type_flag = ARG_STR,
+        .short_id = 'i',
+        .default_val = {.c = "127.0.0.1"}};
+
+    struct ddArgStat port_arg = {
+        .description = "Port to bind ( default : 4701 )",
+        .full_id = "port",
+        .type_flag = ARG_STR,
+        .short_id = 'p',
+        .default_val = {.c = "4701"}};
+
+    struct ddArgStat size_arg = {
+        .description = "Datagram size in bytes ( default : 900 )",
+        .full_id = "size",
+        .type_flag = ARG_INT,
+        .short_id = 's',
+        .default_val = {.i = 900}};
+
+    struct ddArgStat count_arg = {
+        .description = "Datagrams per burst ( default : 64 )",
+        .full_id = "count",
+        .type_flag = ARG_INT,
+        .short_id = 'n',
+        .default_val = {.i = 64}};
+
+    struct ddArgStat duration_arg = {
+        .description = "Seconds per mode ( default : 2 sec )",
+        .full_id = "duration",
+        .type_flag = ARG_FLT,
+        .short_id = 'd',
+        .default_val = {.f = 2.f}};
+
+    struct ddArgStat json_arg = {
+        .description = "Print results as JSON ( default : false )",
+        .full_id = "json",
+        .type_flag = ARG_BOOL,
+        .short_id = 'j',
+        .default_val = {.b = false}};
+
+    register_arg( &arg_handler, &ip_arg );
+    register_arg( &arg_handler, &port_arg );
+    register_arg( &arg_handler, &size_arg );
+    register_arg( &arg_handler, &count_arg );
+    register_arg( &arg_handler, &duration_arg );
+    register_arg( &arg_handler, &json_arg );
+
+    poll_args( &arg_handler, argc, argv );
+
+    if( extract_arg( &arg_handler, 'h' )->val.b )
+    {
+        print_arg_help_msg( &arg_handler );
+        return 0;
+    }
+
+    const char* ip = extract_arg( &arg_handler, 'i' )->val.c;
+    const char* port = extract_arg( &arg_handler, 'p' )->val.c;
+    const int32_t size = extract_arg( &arg_handler, 's' )->val.i;
+    const int32_t count = extract_arg( &arg_handler, 'n' )->val.i;
+    const double duration = (double)extract_arg( &arg_handler, 'd' )->val.f;
+    const bool json = extract_arg( &arg_handler, 'j' )->val.b;
+
+    if( size <= BENCH_SEQ_DIGITS || size >= MAX_MSG_LENGTH || count < 1 ||
+        duration <= 0.0 )
+    {
+        console_write( LOG_ERROR,
+                       "Need %d < size < %d, count >= 1, duration > 0\n",
+                       BENCH_SEQ_DIGITS,
+                       MAX_MSG_LENGTH );
+        return 1;
+    }
+
+    char* burst = malloc( (size_t)size * (size_t)count );
+
+    if( !burst )
+    {
+        console_write( LOG_ERROR, "Allocation failed\n" );
+        return 1;
+    }
+
+    struct mode_result results[MODE_COUNT];
+
+    for( uint32_t mode = 0; mode < MODE_COUNT; mode++ )
+        run_mode( mode,
+                  ip,
+                  port,
+                  (uint32_t)size,
+                  (uint32_t)count,
+                  duration,
+                  burst,
+                  &results[mode] );
+
+    free( burst );
+
+    bool clean = true;
+
+    if( json )
+        printf( "{\"size\": %d, \"count\": %d, \"modes\": [", size, count );
+
+    bool first = true;
+
+    for( uint32_t mode = 0; mode < MODE_COUNT; mode++ )
+    {
+        const struct mode_result* result = &results[mode];
+
+        if( !result->available )
+        {
+            if( !json )
+                console_write( LOG_WARN,
+                               "%-6s unavailable\n",
+                               s_mode_names[mode] );
+            continue;
+        }
+
+        if( result->corrupt ) clean = false;
+
+        const double pps = result->elapsed > 0.0
+                               ? (double)result->received / result->elapsed
+                               : 0.0;
+        const double loss =
+            result->sent
+                ? 1.0 - (double)result->received / (double)result->sent
+                : 0.0;
+
+        if( json )
+        {
+            printf( "%s{\"name\": \"%s\", \"sent\": %llu, \"received\": "
+                    "%llu, \"corrupt\": %llu, \"pps\": %.1f, \"mbps\": "
+                    "%.1f, \"loss\": %.6f}",
+                    first ? "" : ", ",
+                    s_mode_names[mode],
+                    (unsigned long long)result->sent,
+                    (unsigned long long)result->received,
+                    (unsigned long long)result->corrupt,
+                    pps,
+                    pps * size * 8.0 / 1e6,
+                    loss );
+            first = false;
+            continue;
+        }
+
+        console_write( result->corrupt ? LOG_ERROR : LOG_STATUS,
+                       "%-6s %10.1f pps %9.1f Mbit/s  %.4f%% loss  %llu "
+                       "corrupt\n",
+                       s_mode_names[mode],
+                       pps,
+                       pps * size * 8.0 / 1e6,
+                       loss * 100.0,
+                       (unsigned long long)result->corrupt );
+    }
+
+    if( json ) printf( "]}\n" );
+
+    return clean ? 0 : 1;
+}
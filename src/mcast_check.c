@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <string.h>
+#include <poll.h>
+
+#include "ddConfig.h"
+#include "ConsoleWrite.h"
+#include "PeerTable.h"
+#include "ServerInterface.h"
+
+/* Multicast broadcast checks over the loopback route. A listener joins the
+ * group & a sender w/ multicast_loop broadcasts to it. However many
+ * recipients or peers the call is given, one datagram must go out & arrive
+ * exactly once, & both broadcast calls must report it as one send. An empty
+ * peer table sends nothing */
+
+#define CHECK_GROUP "239.255.42.99"
+#define CHECK_PORT "4791"
+#define CHECK_RECIPIENTS 3
+#define CHECK_WAIT_MS 200  // quiet time before a receive count is final
+
+// datagrams that arrive before the socket stays quiet, the last value in i0
+static uint32_t count_arrivals( struct ddAddressInfo* c_restrict listener,
+                                struct ddRecvBatch* c_restrict batch,
+                                int32_t* c_restrict value )
+{
+    struct pollfd poll_fd = {.fd = listener->socket_fd, .events = POLLIN};
+    uint32_t arrived = 0;
+
+    while( poll( &poll_fd, 1, CHECK_WAIT_MS ) > 0 )
+    {
+        const int32_t read = dd_server_recieve_batch( listener, batch );
+
+        if( read <= 0 ) break;
+
+        for( int32_t i = 0; i < read; i++ )
+        {
+            struct ddMsgVal msg;
+
+            if( dd_msg_decode(
+                    batch->msgs[i].msg, batch->msgs[i].bytes_read, &msg ) ==
+                DDMSG_INT1 )
+                *value = msg.i[0];
+        }
+
+        arrived += (uint32_t)read;
+    }
+
+    return arrived;
+}
+
+static uint32_t check_result( const char* c_restrict name,
+                              const uint32_t returned,
+                              const uint32_t expected,
+                              const uint32_t arrived,
+                              const uint32_t expected_arrivals )
+{
+    const bool ok = returned == expected && arrived == expected_arrivals;
+
+    console_write( ok ? LOG_STATUS : LOG_ERROR,
+                   "%-16s returned %u ( want %u ), %u arrived ( want %u )\n",
+                   name,
+                   returned,
+                   expected,
+                   arrived,
+                   expected_arrivals );
+
+    return ok ? 0 : 1;
+}
+
+int main( void )
+{
+    const struct ddSocketOpts sender_opts = {.multicast_loop = true,
+                                             .multicast_ttl = 1};
+
+    struct ddAddressInfo listener = {.options = NULL};
+    struct ddAddressInfo sender = {.options = NULL};
+    struct ddRecvBatch batch;
+    struct ddPeerTable peers;
+    uint32_t failed = 0;
+
+    if( !dd_recv_batch_init( &batch, 8 ) ||
+        !dd_peers_init( &peers, 8, 0.0, NULL ) ||
+        !dd_create_socket( &listener, CHECK_GROUP, CHECK_PORT, true, NULL ) ||
+        !dd_create_socket(
+            &sender, CHECK_GROUP, CHECK_PORT, false, &sender_opts ) )
+    {
+        console_write( LOG_ERROR, "Check setup failed\n" );
+        return 1;
+    }
+
+    if( !listener.multicast || !sender.multicast )
+    {
+        console_write( LOG_ERROR, "%s not seen as a group\n", CHECK_GROUP );
+        return 1;
+    }
+
+    // recipients are ignored for a group, any address stands in for them
+    struct ddAddressInfo recipients[CHECK_RECIPIENTS];
+    int32_t errors[CHECK_RECIPIENTS];
+
+    for( uint32_t i = 0; i < CHECK_RECIPIENTS; i++ )
+        recipients[i] = listener;
+
+    struct ddMsgVal msg = {.i = {1}};
+    int32_t value = 0;
+
+    uint32_t sent = dd_server_broadcast_msg(
+        &sender, recipients, CHECK_RECIPIENTS, DDMSG_INT1, &msg, errors );
+    uint32_t arrived = count_arrivals( &listener, &batch, &value );
+
+    failed += check_result( "broadcast_msg", sent, 1, arrived, 1 );
+    failed += value == 1 ? 0 : 1;
+
+    sent = dd_server_broadcast_msg(
+        &sender, recipients, 0, DDMSG_INT1, &msg, NULL );
+    arrived = count_arrivals( &listener, &batch, &value );
+
+    failed += check_result( "broadcast_msg 0", sent, 0, arrived, 0 );
+
+    // peers stand for members of the group, none of them is sent to
+    sent = dd_peers_broadcast( &sender, &peers, DDMSG_INT1, &msg );
+    arrived = count_arrivals( &listener, &batch, &value );
+
+    failed += check_result( "peers empty", sent, 0, arrived, 0 );
+
+    struct sockaddr_storage addr = {0};
+    struct sockaddr_in* addr_in = (struct sockaddr_in*)&addr;
+
+    addr_in->sin_family = AF_INET;
+    addr_in->sin_port = htons( 1 );
+
+    for( uint32_t i = 0; i < CHECK_RECIPIENTS; i++ )
+    {
+        addr_in->sin_addr.s_addr = htonl( 0x7f000002 + i );
+        dd_peers_touch( &peers, &addr, sizeof( *addr_in ), 0, NULL );
+    }
+
+    msg.i[0] = 2;
+    sent = dd_peers_broadcast( &sender, &peers, DDMSG_INT1, &msg );
+    arrived = count_arrivals( &listener, &batch, &value );
+
+    failed += check_result( "peers", sent, 1, arrived, 1 );
+    failed += value == 2 ? 0 : 1;
+
+    dd_peers_free( &peers );
+    dd_recv_batch_free( &batch );
+    dd_close_socket( &listener.socket_fd );
+    dd_close_socket( &sender.socket_fd );
+    freeaddrinfo( sender.options );
+
+    return failed ? 1 : 0;
+}
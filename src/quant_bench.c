@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ddConfig.h"
+#include "ArgHandler.h"
+#include "ConsoleWrite.h"
+#include "Quantize.h"
+#include "TimeInterface.h"
+
+/* Pack & unpack throughput in elements per second for each Quantize ISA
+ * level the cpu supports. Every level is checked against the scalar
+ * kernel's bytes & values before it's timed */
+
+struct isa_result
+{
+    uint32_t isa;
+    bool available;
+    bool matches;
+    double pack_rate;    // elements / s
+    double unpack_rate;  // elements / s
+};
+
+static uint64_t s_rng = 0x9e3779b97f4a7c15ULL;
+
+static float random_value( const float min, const float max )
+{
+    // xorshift64*, spills slightly past the range to exercise clamping
+    s_rng ^= s_rng >> 12;
+    s_rng ^= s_rng << 25;
+    s_rng ^= s_rng >> 27;
+
+    const double unit =
+        (double)( ( s_rng * 2685821657736338717ULL ) >> 11 ) /
+        (double)( 1ULL << 53 );
+
+    return (float)( min - 0.05 * ( max - min ) + unit * 1.1 * ( max - min ) );
+}
+
+static double elements_per_sec( const uint32_t count,
+                                const uint32_t iterations,
+                                const uint64_t elapsed )
+{
+    if( elapsed == 0 ) return 0.0;
+
+    return (double)count * iterations / nano_to_seconds( elapsed );
+}
+
+int main( int argc, char const* argv[] )
+{
+    struct ddArgHandler arg_handler;
+
+    init_arg_handler( &arg_handler,
+                      "Times quantized float pack/unpack per ISA level." );
+
+    struct ddArgStat count_arg = {
+        .description = "Floats per array ( default : 4096 )",
+        .full_id = "count",
+        .type_flag = ARG_INT,
+        .short_id = 'n',
+        .default_val = {.i = 4096}};
+
+    struct ddArgStat bits_arg = {
+        .description = "Bits per value, 1 - 16 ( default : 12 )",
+        .full_id = "bits",
+        .type_flag = ARG_INT,
+        .short_id = 'b',
+        .default_val = {.i = 12}};
+
+    struct ddArgStat iter_arg = {
+        .description = "Arrays packed & unpacked per level ( default : 5000 )",
+        .full_id = "iterations",
+        .type_flag = ARG_INT,
+        .short_id = 'i',
+        .default_val = {.i = 5000}};
+
+    struct ddArgStat json_arg = {
+        .description = "Print results as JSON ( default : false )",
+        .full_id = "json",
+        .type_flag = ARG_BOOL,
+        .short_id = 'j',
+        .default_val = {.b = false}};
+
+    register_arg( &arg_handler, &count_arg );
+    register_arg( &arg_handler, &bits_arg );
+    register_arg( &arg_handler, &iter_arg );
+    register_arg( &arg_handler, &json_arg );
+
+    poll_args( &arg_handler, argc, argv );
+
+    if( extract_arg( &arg_handler, 'h' )->val.b )
+    {
+        print_arg_help_msg( &arg_handler );
+        return 0;
+    }
+
+    const int32_t count = extract_arg( &arg_handler, 'n' )->val.i;
+    const int32_t bits = extract_arg( &arg_handler, 'b' )->val.i;
+    const int32_t iterations = extract_arg( &arg_handler, 'i' )->val.i;
+    const bool json = extract_arg( &arg_handler, 'j' )->val.b;
+
+    if( count < 1 || iterations < 1 || bits < DD_QUANT_MIN_BITS ||
+        bits > DD_QUANT_MAX_BITS )
+    {
+        console_write( LOG_ERROR,
+                       "Need count >= 1, iterations >= 1 & bits 1 - 16\n" );
+        return 1;
+    }
+
+    const struct ddQuantRange range = {
+        .min = -512.f, .max = 512.f, .bits = (uint32_t)bits};
+    const uint32_t packed_size =
+        dd_quant_packed_size( (uint32_t)count, range.bits );
+
+    float* values = malloc( (size_t)count * sizeof( float ) );
+    float* unpacked = malloc( (size_t)count * sizeof( float ) );
+    float* reference_values = malloc( (size_t)count * sizeof( float ) );
+    uint8_t* packed = malloc( packed_size );
+    uint8_t* reference = malloc( packed_size );
+
+    if( !values || !unpacked || !reference_values || !packed || !reference )
+    {
+        console_write( LOG_ERROR, "Allocation failed\n" );
+        return 1;
+    }
+
+    for( int32_t i = 0; i < count; i++ )
+        values[i] = random_value( range.min, range.max );
+
+    dd_quant_set_isa( DDQUANT_SCALAR );
+    dd_quant_pack( values, (uint32_t)count, &range, reference );
+    dd_quant_unpack( reference, (uint32_t)count, &range, reference_values );
+
+    struct isa_result results[DDQUANT_ISA_COUNT];
+
+    for( uint32_t isa = 0; isa < DDQUANT_ISA_COUNT; isa++ )
+    {
+        struct isa_result* result = &results[isa];
+
+        *result = ( struct isa_result ){
+            .isa = isa, .available = dd_quant_set_isa( isa )};
+
+        if( !result->available ) continue;
+
+        dd_quant_pack( values, (uint32_t)count, &range, packed );
+        dd_quant_unpack( packed, (uint32_t)count, &range, unpacked );
+
+        result->matches =
+            memcmp( packed, reference, packed_size ) == 0 &&
+            memcmp( unpacked,
+                    reference_values,
+                    (size_t)count * sizeof( float ) ) == 0;
+
+        uint64_t start = get_high_res_time();
+
+        for( int32_t i = 0; i < iterations; i++ )
+            dd_quant_pack( values, (uint32_t)count, &range, packed );
+
+        result->pack_rate = elements_per_sec( (uint32_t)count,
+                                             (uint32_t)iterations,
+                                             get_high_res_time() - start );
+
+        start = get_high_res_time();
+
+        for( int32_t i = 0; i < iterations; i++ )
+            dd_quant_unpack( packed, (uint32_t)count, &range, unpacked );
+
+        result->unpack_rate = elements_per_sec( (uint32_t)count,
+                                               (uint32_t)iterations,
+                                               get_high_res_time() - start );
+    }
+
+    // worst case error inside the range, about half a step
+    float max_error = 0.f;
+
+    for( int32_t i = 0; i < count; i++ )
+    {
+        if( values[i] < range.min || values[i] > range.max ) continue;
+
+        const float error = values[i] > reference_values[i]
+                                ? values[i] - reference_values[i]
+                                : reference_values[i] - values[i];
+
+        if( error > max_error ) max_error = error;
+    }
+
+    bool all_match = true;
+
+    if( json )
+    {
+        printf( "{\"count\": %d, \"bits\": %d, \"packed_bytes\": %u, "
+                "\"max_error\": %g, \"isa\": [",
+                count,
+                bits,
+                packed_size,
+                max_error );
+    }
+    else
+    {
+        console_write( LOG_STATUS,
+                       "%d floats -> %u bytes at %d bits, max error %g\n",
+                       count,
+                       packed_size,
+                       bits,
+                       max_error );
+    }
+
+    bool first = true;
+
+    for( uint32_t isa = 0; isa < DDQUANT_ISA_COUNT; isa++ )
+    {
+        const struct isa_result* result = &results[isa];
+
+        if( result->available && !result->matches ) all_match = false;
+
+        if( json )
+        {
+            if( !result->available ) continue;
+
+            printf( "%s{\"name\": \"%s\", \"pack_eps\": %.0f, "
+                    "\"unpack_eps\": %.0f, \"matches_scalar\": %s}",
+                    first ? "" : ", ",
+                    dd_quant_isa_name( isa ),
+                    result->pack_rate,
+                    result->unpack_rate,
+                    result->matches ? "true" : "false" );
+            first = false;
+        }
+        else if( !result->available )
+        {
+            console_write( LOG_WARN,
+                           "%-7s unavailable on this cpu\n",
+                           dd_quant_isa_name( isa ) );
+        }
+        else
+        {
+            console_write( result->matches ? LOG_STATUS : LOG_ERROR,
+                           "%-7s pack %8.1f M elem/s  unpack %8.1f M elem/s"
+                           "%s\n",
+                           dd_quant_isa_name( isa ),
+                           result->pack_rate / 1e6,
+                           result->unpack_rate / 1e6,
+                           result->matches ? "" : "  ( differs from scalar )" );
+        }
+    }
+
+    if( json ) printf( "]}\n" );
+
+    free( values );
+    free( unpacked );
+    free( reference_values );
+    free( packed );
+    free( reference );
+
+    return all_match ? 0 : 1;
+}
@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ddConfig.h"
+#include "BufferPool.h"
+#include "Compress.h"
+#include "ConsoleWrite.h"
+#include "ServerInterface.h"
+
+/* Receive path checks over loopback. Random binary datagrams, one for every
+ * first byte, must reach a listener w/o accept_compressed unchanged through
+ * each receive call, compressed frames included. A listener that accepts
+ * compressed frames gets them inflated back to the original */
+
+#define CHECK_PORT "4790"
+#define CHECK_MAX_PAYLOAD 256
+
+enum
+{
+    RECV_MSG = 0,
+    RECV_BATCH,
+    RECV_POOLED,
+    RECV_COUNT,
+};
+
+static const char* s_recv_names[RECV_COUNT] = {"msg", "batch", "pooled"};
+
+struct check_ctx
+{
+    struct ddAddressInfo sender;
+    struct ddAddressInfo listener;
+    struct sockaddr_storage addr;  // where the listener is bound
+    socklen_t addr_len;
+
+    struct ddRecvBatch batch;
+    struct ddBufferPool pool;
+};
+
+static bool send_raw( const struct check_ctx* c_restrict ctx,
+                      const char* c_restrict data,
+                      const int32_t length )
+{
+    const struct sockaddr* addr = (const struct sockaddr*)&ctx->addr;
+
+    return dd_server_send_many(
+               &ctx->sender, data, length, &addr, &ctx->addr_len, 1, NULL ) ==
+           1;
+}
+
+// receives one datagram through the given call & compares it w/ expected
+static bool recv_matches( struct check_ctx* c_restrict ctx,
+                          const uint32_t method,
+                          const char* c_restrict expected,
+                          const int32_t length )
+{
+    const struct ddRecvMsg* msg = NULL;
+    struct ddRecvMsg single;
+    struct ddPoolBuf* buf = NULL;
+
+    switch( method )
+    {
+        case RECV_MSG:
+            dd_server_recieve_msg( &ctx->listener, &single );
+            msg = &single;
+            break;
+        case RECV_BATCH:
+            if( dd_server_recieve_batch( &ctx->listener, &ctx->batch ) == 1 )
+                msg = &ctx->batch.msgs[0];
+            break;
+        default:
+            dd_server_recieve_pooled( &ctx->listener, &ctx->pool, &buf );
+            msg = buf ? &buf->msg : NULL;
+            break;
+    }
+
+    const bool match = msg && msg->bytes_read == length &&
+                       memcmp( msg->msg, expected, length ) == 0;
+
+    if( buf ) dd_pool_release( buf );
+
+    return match;
+}
+
+static bool open_listener( struct check_ctx* c_restrict ctx,
+                           const bool accept_compressed )
+{
+    const struct ddSocketOpts opts = {.accept_compressed = accept_compressed};
+
+    ctx->addr_len = sizeof( ctx->addr );
+
+    if( !dd_create_socket(
+            &ctx->listener, "127.0.0.1", CHECK_PORT, true, &opts ) )
+        return false;
+
+    if( getsockname( ctx->listener.socket_fd,
+                     (struct sockaddr*)&ctx->addr,
+                     &ctx->addr_len ) == -1 )
+    {
+        dd_close_socket( &ctx->listener.socket_fd );
+        return false;
+    }
+
+    return true;
+}
+
+// every first byte, compressed frame markers included, w/ random contents
+static uint32_t check_passthrough( struct check_ctx* c_restrict ctx )
+{
+    uint32_t failed = 0;
+    char payload[CHECK_MAX_PAYLOAD];
+
+    for( uint32_t method = 0; method < RECV_COUNT; method++ )
+    {
+        uint32_t mismatched = 0;
+
+        for( uint32_t first = 0; first < 256; first++ )
+        {
+            // long enough to pass for a compressed frame header
+            const int32_t sent =
+                DD_COMPRESS_HEADER_SIZE +
+                rand() % ( CHECK_MAX_PAYLOAD - DD_COMPRESS_HEADER_SIZE + 1 );
+
+            payload[0] = (char)first;
+
+            for( int32_t i = 1; i < sent; i++ )
+                payload[i] = (char)rand();
+
+            if( !send_raw( ctx, payload, sent ) ||
+                !recv_matches( ctx, method, payload, sent ) )
+                mismatched++;
+        }
+
+        console_write( mismatched ? LOG_ERROR : LOG_STATUS,
+                       "passthrough %-6s %u/256 payloads changed\n",
+                       s_recv_names[method],
+                       mismatched );
+        failed += mismatched;
+    }
+
+    return failed;
+}
+
+// a compressible frame & its packed form
+static int32_t make_frames( char* c_restrict frame,
+                            int32_t* c_restrict frame_length,
+                            char* c_restrict packed,
+                            const uint32_t packed_size )
+{
+    *frame_length = CHECK_MAX_PAYLOAD;
+
+    memset( frame, 0, CHECK_MAX_PAYLOAD );
+    frame[0] = (char)( DDFRAME_MARK | DDFRAME_QUANT );
+
+    return dd_frame_compress(
+        &dd_codec_lz, 0, frame, *frame_length, packed, packed_size );
+}
+
+// compressed frames arrive as sent w/o the option & inflated w/ it
+static uint32_t check_compressed( struct check_ctx* c_restrict ctx,
+                                  const bool accept_compressed )
+{
+    char frame[CHECK_MAX_PAYLOAD];
+    char packed[CHECK_MAX_PAYLOAD];
+    int32_t frame_length;
+
+    const int32_t packed_length =
+        make_frames( frame, &frame_length, packed, sizeof( packed ) );
+
+    if( packed_length <= 0 ) return RECV_COUNT;
+
+    uint32_t failed = 0;
+
+    for( uint32_t method = 0; method < RECV_COUNT; method++ )
+    {
+        const bool ok =
+            send_raw( ctx, packed, packed_length ) &&
+            ( accept_compressed
+                  ? recv_matches( ctx, method, frame, frame_length )
+                  : recv_matches( ctx, method, packed, packed_length ) );
+
+        console_write( ok ? LOG_STATUS : LOG_ERROR,
+                       "compressed  %-6s %s\n",
+                       s_recv_names[method],
+                       accept_compressed ? "inflated" : "left packed" );
+        failed += ok ? 0 : 1;
+    }
+
+    return failed;
+}
+
+int main( void )
+{
+    struct check_ctx ctx = {.sender = {.options = NULL}};
+    uint32_t failed = 0;
+
+    srand( 1 );
+
+    if( !dd_recv_batch_init( &ctx.batch, 1 ) ||
+        !dd_pool_init( &ctx.pool, 4 ) ||
+        !dd_create_socket( &ctx.sender, "127.0.0.1", CHECK_PORT, false, NULL ) )
+    {
+        console_write( LOG_ERROR, "Check setup failed\n" );
+        return 1;
+    }
+
+    for( uint32_t accept = 0; accept < 2; accept++ )
+    {
+        if( !open_listener( &ctx, accept ) )
+        {
+            console_write( LOG_ERROR, "Listener not created\n" );
+            failed++;
+            break;
+        }
+
+        if( !accept ) failed += check_passthrough( &ctx );
+
+        failed += check_compressed( &ctx, accept );
+
+        dd_close_socket( &ctx.listener.socket_fd );
+    }
+
+    dd_pool_free( &ctx.pool );
+    dd_recv_batch_free( &ctx.batch );
+    dd_close_socket( &ctx.sender.socket_fd );
+    freeaddrinfo( ctx.sender.options );
+
+    return failed ? 1 : 0;
+}
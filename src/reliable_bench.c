@@ -0,0 +1,331 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ddConfig.h"
+#include "ArgHandler.h"
+#include "ConsoleWrite.h"
+#include "ReliableChannel.h"
+#include "TimeInterface.h"
+
+/* Runs a ReliableChannel pair over a simulated lossy link w/ latency &
+ * jitter, then reports goodput, retransmit overhead & ordering. Time is
+ * simulated, so results don't depend on the host */
+
+#define LINK_CAPACITY 4096
+
+struct link_packet
+{
+    uint64_t deliver_at;
+    int32_t length;
+    char data[MAX_MSG_LENGTH];
+};
+
+struct link
+{
+    struct link_packet* packets;  // unordered, jitter may reorder
+    uint32_t count;
+    uint64_t wire_bytes;
+    uint64_t datagrams;
+    uint64_t dropped;
+};
+
+struct endpoint
+{
+    struct ddReliableChannel channel;
+    struct link* outbound;
+    uint32_t next_expected;  // receiver: next counter value
+    uint32_t out_of_order;
+};
+
+static uint64_t s_now;
+static double s_loss;
+static uint64_t s_one_way;
+static uint64_t s_jitter;
+static uint64_t s_rng = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t next_random()
+{
+    // xorshift64*
+    s_rng ^= s_rng >> 12;
+    s_rng ^= s_rng << 25;
+    s_rng ^= s_rng >> 27;
+    return s_rng * 2685821657736338717ULL;
+}
+
+static double random_unit()
+{
+    return (double)( next_random() >> 11 ) / (double)( 1ULL << 53 );
+}
+
+static bool link_send( struct ddReliableChannel* channel,
+                       const char* data,
+                       const int32_t length )
+{
+    struct endpoint* self = channel->data;
+    struct link* link = self->outbound;
+
+    link->wire_bytes += (uint64_t)length;
+    link->datagrams++;
+
+    if( random_unit() < s_loss || link->count == LINK_CAPACITY )
+    {
+        link->dropped++;
+        return true;  // the sender can't tell either way
+    }
+
+    struct link_packet* packet = &link->packets[link->count++];
+
+    packet->deliver_at =
+        s_now + s_one_way + ( s_jitter ? next_random() % s_jitter : 0 );
+    packet->length = length;
+    memcpy( packet->data, data, (size_t)length );
+
+    return true;
+}
+
+static void on_deliver( struct ddReliableChannel* channel,
+                        const char* frame,
+                        const int32_t length )
+{
+    struct endpoint* self = channel->data;
+    struct ddMsgVal val;
+
+    if( dd_msg_decode( frame, length, &val ) != DDMSG_INT1 ) return;
+
+    if( (uint32_t)val.i[0] != self->next_expected ) self->out_of_order++;
+
+    self->next_expected = (uint32_t)val.i[0] + 1;
+}
+
+// delivers every packet due by s_now, returns the next arrival time
+static uint64_t pump_link( struct link* link, struct endpoint* to )
+{
+    uint64_t next = UINT64_MAX;
+    uint32_t i = 0;
+
+    while( i < link->count )
+    {
+        struct link_packet* packet = &link->packets[i];
+
+        if( packet->deliver_at > s_now )
+        {
+            if( packet->deliver_at < next ) next = packet->deliver_at;
+            i++;
+            continue;
+        }
+
+        dd_reliable_recv( &to->channel, packet->data, packet->length, s_now );
+
+        // swap remove, order in the array doesn't matter
+        *packet = link->packets[--link->count];
+    }
+
+    return next;
+}
+
+static uint64_t min_u64( const uint64_t a, const uint64_t b )
+{
+    return a < b ? a : b;
+}
+
+int main( int argc, char const* argv[] )
+{
+    struct ddArgHandler arg_handler;
+
+    init_arg_handler( &arg_handler,
+                      "Measures ReliableChannel goodput & retransmit "
+                      "overhead over a simulated lossy link." );
+
+    struct ddArgStat count_arg = {
+        .description = "Messages to deliver ( default : 100000 )",
+        .full_id = "count",
+        .type_flag = ARG_INT,
+        .short_id = 'n',
+        .default_val = {.i = 100000}};
+
+    struct ddArgStat loss_arg = {
+        .description = "Packet loss percent, each way ( default : 5 )",
+        .full_id = "loss",
+        .type_flag = ARG_FLT,
+        .short_id = 'l',
+        .default_val = {.f = 5.f}};
+
+    struct ddArgStat rtt_arg = {
+        .description = "Round trip time in ms ( default : 20 )",
+        .full_id = "rtt",
+        .type_flag = ARG_FLT,
+        .short_id = 't',
+        .default_val = {.f = 20.f}};
+
+    struct ddArgStat jitter_arg = {
+        .description = "Extra one way delay up to this many ms "
+                       "( default : 2 )",
+        .full_id = "jitter",
+        .type_flag = ARG_FLT,
+        .short_id = 'x',
+        .default_val = {.f = 2.f}};
+
+    struct ddArgStat json_arg = {
+        .description = "Print results as JSON ( default : false )",
+        .full_id = "json",
+        .type_flag = ARG_BOOL,
+        .short_id = 'j',
+        .default_val = {.b = false}};
+
+    register_arg( &arg_handler, &count_arg );
+    register_arg( &arg_handler, &loss_arg );
+    register_arg( &arg_handler, &rtt_arg );
+    register_arg( &arg_handler, &jitter_arg );
+    register_arg( &arg_handler, &json_arg );
+
+    poll_args( &arg_handler, argc, argv );
+
+    if( extract_arg( &arg_handler, 'h' )->val.b )
+    {
+        print_arg_help_msg( &arg_handler );
+        return 0;
+    }
+
+    const int32_t count = extract_arg( &arg_handler, 'n' )->val.i;
+    const double loss_pct = (double)extract_arg( &arg_handler, 'l' )->val.f;
+    const double rtt_ms = (double)extract_arg( &arg_handler, 't' )->val.f;
+    const double jitter_ms = (double)extract_arg( &arg_handler, 'x' )->val.f;
+    const bool json = extract_arg( &arg_handler, 'j' )->val.b;
+
+    if( count < 1 || loss_pct < 0.0 || loss_pct >= 100.0 || rtt_ms < 0.0 ||
+        jitter_ms < 0.0 )
+    {
+        console_write( LOG_ERROR, "Need count >= 1, 0 <= loss < 100\n" );
+        return 1;
+    }
+
+    s_loss = loss_pct / 100.0;
+    s_one_way = seconds_to_nano( rtt_ms / 2000.0 );
+    s_jitter = seconds_to_nano( jitter_ms / 1000.0 );
+
+    struct link forward = {0};
+    struct link reverse = {0};
+    struct endpoint sender = {.outbound = &forward};
+    struct endpoint receiver = {.outbound = &reverse};
+
+    forward.packets = malloc( LINK_CAPACITY * sizeof( struct link_packet ) );
+    reverse.packets = malloc( LINK_CAPACITY * sizeof( struct link_packet ) );
+
+    if( !forward.packets || !reverse.packets ||
+        !dd_reliable_init( &sender.channel, link_send, on_deliver, &sender ) ||
+        !dd_reliable_init(
+            &receiver.channel, link_send, on_deliver, &receiver ) )
+        return 1;
+
+    const uint64_t wall_start = get_high_res_time();
+    uint32_t queued = 0;
+
+    while( receiver.next_expected < (uint32_t)count &&
+           !sender.channel.failed )
+    {
+        // keep the window full
+        while( queued < (uint32_t)count )
+        {
+            const struct ddMsgVal msg = {.i = {(int32_t)queued}};
+
+            if( !dd_reliable_send( &sender.channel, DDMSG_INT1, &msg, s_now ) )
+                break;
+
+            queued++;
+        }
+
+        uint64_t next = pump_link( &forward, &receiver );
+        next = min_u64( next, pump_link( &reverse, &sender ) );
+        next = min_u64( next, dd_reliable_update( &sender.channel, s_now ) );
+        next = min_u64( next, dd_reliable_update( &receiver.channel, s_now ) );
+
+        if( next == UINT64_MAX )
+        {
+            // acks just opened the window, send more at the same instant
+            if( queued < (uint32_t)count &&
+                dd_reliable_in_flight( &sender.channel ) < DD_RELIABLE_WINDOW )
+                continue;
+
+            break;
+        }
+
+        s_now = next > s_now ? next : s_now + 1;
+    }
+
+    const double wall_secs =
+        nano_to_seconds( get_high_res_time() - wall_start );
+    const double sim_secs = nano_to_seconds( s_now );
+    const struct ddReliableStats* stats = &sender.channel.stats;
+
+    const double goodput = sim_secs > 0.0 ? receiver.next_expected / sim_secs
+                                          : 0.0;
+    const double retransmit_ratio =
+        stats->sent ? (double)stats->retransmits / (double)stats->sent : 0.0;
+
+    // data frame payload is the 5 byte int frame
+    const double payload_bytes = (double)receiver.next_expected * 5.0;
+    const double wire_overhead =
+        payload_bytes > 0.0
+            ? (double)( forward.wire_bytes + reverse.wire_bytes ) /
+                  payload_bytes
+            : 0.0;
+
+    const bool complete = receiver.next_expected == (uint32_t)count &&
+                          receiver.out_of_order == 0;
+
+    if( json )
+    {
+        printf( "{\"count\": %d, \"loss_pct\": %.2f, \"rtt_ms\": %.2f, "
+                "\"jitter_ms\": %.2f, \"complete\": %s, "
+                "\"delivered\": %u, \"out_of_order\": %u, "
+                "\"sim_seconds\": %.4f, \"goodput_msgs\": %.1f, "
+                "\"retransmits\": %llu, \"retransmit_ratio\": %.4f, "
+                "\"acks_sent\": %llu, \"duplicates\": %llu, "
+                "\"wire_per_payload\": %.3f, \"srtt_ms\": %.3f, "
+                "\"wall_seconds\": %.3f}\n",
+                count,
+                loss_pct,
+                rtt_ms,
+                jitter_ms,
+                complete ? "true" : "false",
+                receiver.next_expected,
+                receiver.out_of_order,
+                sim_secs,
+                goodput,
+                (unsigned long long)stats->retransmits,
+                retransmit_ratio,
+                (unsigned long long)receiver.channel.stats.acks_sent,
+                (unsigned long long)receiver.channel.stats.duplicates,
+                wire_overhead,
+                (double)sender.channel.srtt / 1e6,
+                wall_secs );
+    }
+    else
+    {
+        console_write( complete ? LOG_STATUS : LOG_ERROR,
+                       "%u/%d delivered, %u out of order\n",
+                       receiver.next_expected,
+                       count,
+                       receiver.out_of_order );
+        console_write( LOG_STATUS,
+                       "%.1f msgs/s over %.3f simulated sec ( srtt %.2f ms )\n",
+                       goodput,
+                       sim_secs,
+                       (double)sender.channel.srtt / 1e6 );
+        console_write( LOG_STATUS,
+                       "%llu retransmits ( %.2f%% of sends ), %llu acks, "
+                       "%.2fx wire bytes per payload byte\n",
+                       (unsigned long long)stats->retransmits,
+                       retransmit_ratio * 100.0,
+                       (unsigned long long)receiver.channel.stats.acks_sent,
+                       wire_overhead );
+    }
+
+    dd_reliable_free( &sender.channel );
+    dd_reliable_free( &receiver.channel );
+    free( forward.packets );
+    free( reverse.packets );
+
+    return complete ? 0 : 1;
+}
@@ -0,0 +1,355 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ddConfig.h"
+#include "ArgHandler.h"
+#include "ConsoleWrite.h"
+#include "SendQueue.h"
+#include "ServerInterface.h"
+#include "TimeInterface.h"
+
+/* Many small messages to many peers over loopback, sent once w/ a sendto per
+ * message & once through per peer ddSendQueues flushed every tick. Each peer
+ * is a listener on its own port that unbundles & checks every frame, so both
+ * modes deliver the same messages */
+
+struct bench_peer
+{
+    struct ddAddressInfo listener;
+    struct sockaddr_storage addr;  // where the listener is bound
+    socklen_t addr_len;
+};
+
+enum
+{
+    MODE_DIRECT = 0,
+    MODE_QUEUED,
+    MODE_COUNT,
+};
+
+static const char* s_mode_names[MODE_COUNT] = {"direct", "queued"};
+
+struct mode_result
+{
+    uint64_t datagrams;
+    uint64_t syscalls;
+    uint64_t frames;   // decoded by the peers
+    uint64_t corrupt;  // frames w/ the wrong type or values
+    double send_time;  // seconds spent sending
+};
+
+static struct ddMsgVal tick_msg( const uint32_t tick,
+                                 const uint32_t peer,
+                                 const uint32_t index )
+{
+    return ( struct ddMsgVal ){
+        .f = {(float)tick, (float)peer, (float)index},
+    };
+}
+
+// drains a peer's socket, checking each frame against what was sent
+static void drain_peer( struct ddAddressInfo* c_restrict peer,
+                        struct ddRecvBatch* c_restrict batch,
+                        const uint32_t tick,
+                        const uint32_t peer_index,
+                        uint32_t* c_restrict next_index,
+                        struct mode_result* c_restrict result )
+{
+    while( dd_server_recieve_batch( peer, batch ) > 0 )
+    {
+        for( uint32_t i = 0; i < batch->count; i++ )
+        {
+            const struct ddRecvMsg* msg = &batch->msgs[i];
+
+            int32_t offset = 0;
+            const char* frame;
+            int32_t frame_length;
+
+            while( dd_bundle_next(
+                msg->msg, msg->bytes_read, &offset, &frame, &frame_length ) )
+            {
+                struct ddMsgVal val;
+                const struct ddMsgVal want =
+                    tick_msg( tick, peer_index, *next_index );
+
+                if( dd_msg_decode( frame, frame_length, &val ) !=
+                        DDMSG_FLOAT3 ||
+                    memcmp( val.f, want.f, 3 * sizeof( float ) ) != 0 )
+                    result->corrupt++;
+                else
+                    result->frames++;
+
+                ( *next_index )++;
+            }
+        }
+    }
+}
+
+static bool run_mode( const uint32_t mode,
+                      const struct ddAddressInfo* c_restrict sender,
+                      struct bench_peer* c_restrict peers,
+                      const uint32_t peer_count,
+                      const uint32_t msgs,
+                      const uint32_t ticks,
+                      struct ddRecvBatch* c_restrict batch,
+                      struct mode_result* c_restrict result )
+{
+    *result = ( struct mode_result ){0};
+
+    struct ddSendQueueSet set;
+    struct ddSendQueue* queues = NULL;
+
+    if( mode == MODE_QUEUED )
+    {
+        queues = calloc( peer_count, sizeof( *queues ) );
+
+        if( !queues ) return false;
+
+        dd_sendq_set_init( &set, sender, 0 );
+
+        for( uint32_t p = 0; p < peer_count; p++ )
+            dd_sendq_init( &queues[p],
+                           (const struct sockaddr*)&peers[p].addr,
+                           peers[p].addr_len );
+    }
+
+    uint64_t send_nanos = 0;
+
+    for( uint32_t tick = 0; tick < ticks; tick++ )
+    {
+        const uint64_t start = get_high_res_time();
+
+        for( uint32_t p = 0; p < peer_count; p++ )
+        {
+            for( uint32_t m = 0; m < msgs; m++ )
+            {
+                const struct ddMsgVal msg = tick_msg( tick, p, m );
+
+                if( mode == MODE_QUEUED )
+                {
+                    dd_sendq_push_msg( &set, &queues[p], DDMSG_FLOAT3, &msg );
+                    continue;
+                }
+
+                dd_server_send_to( sender,
+                                   (const struct sockaddr*)&peers[p].addr,
+                                   peers[p].addr_len,
+                                   DDMSG_FLOAT3,
+                                   &msg );
+                result->datagrams++;
+                result->syscalls++;
+            }
+        }
+
+        if( mode == MODE_QUEUED ) dd_sendq_flush( &set );
+
+        send_nanos += get_high_res_time() - start;
+
+        // loopback delivers during the send, so every peer has its tick
+        for( uint32_t p = 0; p < peer_count; p++ )
+        {
+            uint32_t next_index = 0;
+
+            drain_peer(
+                &peers[p].listener, batch, tick, p, &next_index, result );
+        }
+    }
+
+    if( mode == MODE_QUEUED )
+    {
+        result->datagrams = set.stats.datagrams;
+        result->syscalls = set.stats.syscalls;
+        free( queues );
+    }
+
+    result->send_time = nano_to_seconds( send_nanos );
+    return true;
+}
+
+int main( int argc, char const* argv[] )
+{
+    struct ddArgHandler arg_handler;
+
+    init_arg_handler( &arg_handler,
+                      "Compares a sendto per message w/ send queues that "
+                      "bundle each peer's messages per tick." );
+
+    struct ddArgStat ip_arg = {
+        .description = "IP address to bind ( default : \"127.0.0.1\" )",
+        .full_id = "IP",
+        .type_flag = ARG_STR,
+        .short_id = 'i',
+        .default_val = {.c = "127.0.0.1"}};
+
+    struct ddArgStat port_arg = {
+        .description = "First peer port, one per peer ( default : 4720 )",
+        .full_id = "port",
+        .type_flag = ARG_INT,
+        .short_id = 'p',
+        .default_val = {.i = 4720}};
+
+    struct ddArgStat peers_arg = {
+        .description = "Peers ( default : 100 )",
+        .full_id = "peers",
+        .type_flag = ARG_INT,
+        .short_id = 'n',
+        .default_val = {.i = 100}};
+
+    struct ddArgStat msgs_arg = {
+        .description = "FLOAT3 messages per peer per tick ( default : 20 )",
+        .full_id = "msgs",
+        .type_flag = ARG_INT,
+        .short_id = 'm',
+        .default_val = {.i = 20}};
+
+    struct ddArgStat ticks_arg = {
+        .description = "Ticks ( default : 100 )",
+        .full_id = "ticks",
+        .type_flag = ARG_INT,
+        .short_id = 't',
+        .default_val = {.i = 100}};
+
+    struct ddArgStat json_arg = {
+        .description = "Print results as JSON ( default : false )",
+        .full_id = "json",
+        .type_flag = ARG_BOOL,
+        .short_id = 'j',
+        .default_val = {.b = false}};
+
+    register_arg( &arg_handler, &ip_arg );
+    register_arg( &arg_handler, &port_arg );
+    register_arg( &arg_handler, &peers_arg );
+    register_arg( &arg_handler, &msgs_arg );
+    register_arg( &arg_handler, &ticks_arg );
+    register_arg( &arg_handler, &json_arg );
+
+    poll_args( &arg_handler, argc, argv );
+
+    if( extract_arg( &arg_handler, 'h' )->val.b )
+    {
+        print_arg_help_msg( &arg_handler );
+        return 0;
+    }
+
+    const char* ip = extract_arg( &arg_handler, 'i' )->val.c;
+    const int32_t port = extract_arg( &arg_handler, 'p' )->val.i;
+    const int32_t peer_count = extract_arg( &arg_handler, 'n' )->val.i;
+    const int32_t msgs = extract_arg( &arg_handler, 'm' )->val.i;
+    const int32_t ticks = extract_arg( &arg_handler, 't' )->val.i;
+    const bool json = extract_arg( &arg_handler, 'j' )->val.b;
+
+    if( peer_count < 1 || msgs < 1 || ticks < 1 || port < 1 ||
+        port + peer_count > 65536 )
+    {
+        console_write( LOG_ERROR,
+                       "Need peers, msgs & ticks >= 1 & ports that fit\n" );
+        return 1;
+    }
+
+    struct bench_peer* peers = calloc( peer_count, sizeof( *peers ) );
+    struct ddAddressInfo sender = {.options = NULL, .selected = NULL};
+    struct ddRecvBatch batch = {0};
+
+    if( !peers || !dd_recv_batch_init( &batch, MAX_RECV_BATCH ) ) return 1;
+
+    int32_t created = 0;
+    bool ready = true;
+
+    for( ; created < peer_count && ready; created++ )
+    {
+        struct bench_peer* peer = &peers[created];
+
+        char port_str[16];
+        snprintf( port_str, sizeof( port_str ), "%d", port + created );
+
+        peer->addr_len = sizeof( peer->addr );
+        ready = dd_create_socket( &peer->listener, ip, port_str, true, NULL );
+
+        if( ready &&
+            getsockname( peer->listener.socket_fd,
+                         (struct sockaddr*)&peer->addr,
+                         &peer->addr_len ) == -1 )
+        {
+            dd_close_socket( &peer->listener.socket_fd );
+            ready = false;
+        }
+    }
+
+    if( !ready ) created--;
+
+    char port_str[16];
+    snprintf( port_str, sizeof( port_str ), "%d", port );
+
+    ready = ready && dd_create_socket( &sender, ip, port_str, false, NULL );
+
+    struct mode_result results[MODE_COUNT];
+    bool clean = ready;
+
+    for( uint32_t mode = 0; mode < MODE_COUNT && ready; mode++ )
+        ready = run_mode( mode,
+                          &sender,
+                          peers,
+                          (uint32_t)peer_count,
+                          (uint32_t)msgs,
+                          (uint32_t)ticks,
+                          &batch,
+                          &results[mode] );
+
+    if( !ready ) console_write( LOG_ERROR, "Bench setup failed\n" );
+
+    const uint64_t expected =
+        (uint64_t)peer_count * (uint64_t)msgs * (uint64_t)ticks;
+
+    if( ready && json )
+        printf( "{\"peers\": %d, \"msgs\": %d, \"ticks\": %d, \"modes\": [",
+                peer_count,
+                msgs,
+                ticks );
+
+    for( uint32_t mode = 0; mode < MODE_COUNT && ready; mode++ )
+    {
+        const struct mode_result* result = &results[mode];
+
+        if( result->corrupt || result->frames != expected ) clean = false;
+
+        if( json )
+        {
+            printf( "%s{\"name\": \"%s\", \"datagrams\": %llu, \"syscalls\": "
+                    "%llu, \"frames\": %llu, \"corrupt\": %llu, "
+                    "\"send_ms\": %.3f}",
+                    mode ? ", " : "",
+                    s_mode_names[mode],
+                    (unsigned long long)result->datagrams,
+                    (unsigned long long)result->syscalls,
+                    (unsigned long long)result->frames,
+                    (unsigned long long)result->corrupt,
+                    result->send_time * 1000.0 );
+            continue;
+        }
+
+        console_write( clean ? LOG_STATUS : LOG_ERROR,
+                       "%-6s %8llu datagrams %8llu syscalls %9.1f ms send  "
+                       "%llu/%llu frames  %llu corrupt\n",
+                       s_mode_names[mode],
+                       (unsigned long long)result->datagrams,
+                       (unsigned long long)result->syscalls,
+                       result->send_time * 1000.0,
+                       (unsigned long long)result->frames,
+                       (unsigned long long)expected,
+                       (unsigned long long)result->corrupt );
+    }
+
+    if( ready && json ) printf( "]}\n" );
+
+    dd_recv_batch_free( &batch );
+    dd_close_socket( &sender.socket_fd );
+    freeaddrinfo( sender.options );
+
+    for( int32_t i = 0; i < created; i++ )
+        dd_close_socket( &peers[i].listener.socket_fd );
+
+    free( peers );
+
+    return clean ? 0 : 1;
+}
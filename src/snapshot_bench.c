@@ -0,0 +1,294 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ddConfig.h"
+#include "ArgHandler.h"
+#include "ConsoleWrite.h"
+#include "Snapshot.h"
+
+/* Replicates a snapshot from server to client over a simulated link that
+ * drops snapshots & acks, then reports deltas vs full snapshots & the
+ * encoded bytes against sending every snapshot in full. A run of lost acks
+ * midway lets the peer's baseline fall out of the history. Every applied
+ * snapshot is checked against the server's state */
+
+struct bench_result
+{
+    uint64_t sent;
+    uint64_t lost;
+    uint64_t applied;
+    uint64_t mismatched;  // applied state differs from what was committed
+    uint64_t rejected;    // apply failed on a delivered snapshot
+};
+
+static uint64_t s_rng = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t next_random()
+{
+    // xorshift64*
+    s_rng ^= s_rng >> 12;
+    s_rng ^= s_rng << 25;
+    s_rng ^= s_rng >> 27;
+    return s_rng * 2685821657736338717ULL;
+}
+
+static double random_unit()
+{
+    return (double)( next_random() >> 11 ) / (double)( 1ULL << 53 );
+}
+
+// nudges change_rate of the words by a small amount, like positions would
+static void update_state( uint32_t* c_restrict state,
+                          const uint32_t words,
+                          const double change_rate )
+{
+    for( uint32_t i = 0; i < words; i++ )
+        if( random_unit() < change_rate )
+            state[i] += (uint32_t)( next_random() % 7 ) - 3;
+}
+
+static void run( struct ddSnapshotServer* c_restrict server,
+                 struct ddSnapshotClient* c_restrict client,
+                 uint32_t* c_restrict state,
+                 char* c_restrict buffer,
+                 const uint32_t buffer_size,
+                 const uint32_t ticks,
+                 const double change_rate,
+                 const double loss,
+                 const double ack_loss,
+                 const uint32_t outage,
+                 struct bench_result* c_restrict result )
+{
+    struct ddSnapshotPeer peer = {0};
+
+    const uint32_t words = server->words;
+    const uint32_t outage_start = ticks / 2;
+
+    for( uint32_t i = 0; i < words; i++ )
+        state[i] = i * 1000;
+
+    for( uint32_t tick = 0; tick < ticks; tick++ )
+    {
+        update_state( state, words, change_rate );
+        dd_snapshot_commit( server, state );
+
+        const int32_t length =
+            dd_snapshot_encode( server, &peer, buffer, buffer_size );
+
+        if( length == -1 ) continue;
+
+        result->sent++;
+
+        if( random_unit() < loss )
+        {
+            result->lost++;
+            continue;
+        }
+
+        if( dd_snapshot_apply( client, buffer, length ) == -1 )
+        {
+            result->rejected++;
+            continue;
+        }
+
+        result->applied++;
+
+        if( memcmp( dd_snapshot_state( client ),
+                    state,
+                    words * sizeof( uint32_t ) ) != 0 )
+            result->mismatched++;
+
+        const bool acks_down =
+            tick >= outage_start && tick - outage_start < outage;
+
+        if( acks_down || random_unit() < ack_loss ) continue;
+
+        char ack[16];
+        const int32_t ack_length =
+            dd_snapshot_ack_encode( client, ack, sizeof( ack ) );
+
+        if( ack_length != -1 )
+            dd_snapshot_on_ack( server, &peer, ack, ack_length );
+    }
+}
+
+int main( int argc, char const* argv[] )
+{
+    struct ddArgHandler arg_handler;
+
+    init_arg_handler( &arg_handler,
+                      "Measures snapshot delta compression over a link that "
+                      "loses snapshots & acks." );
+
+    struct ddArgStat words_arg = {
+        .description = "32-bit words of state ( default : 200 )",
+        .full_id = "words",
+        .type_flag = ARG_INT,
+        .short_id = 'w',
+        .default_val = {.i = 200}};
+
+    struct ddArgStat change_arg = {
+        .description = "Percent of words changing per tick ( default : 5 )",
+        .full_id = "change",
+        .type_flag = ARG_FLT,
+        .short_id = 'c',
+        .default_val = {.f = 5.f}};
+
+    struct ddArgStat ticks_arg = {
+        .description = "Ticks ( default : 5000 )",
+        .full_id = "ticks",
+        .type_flag = ARG_INT,
+        .short_id = 't',
+        .default_val = {.i = 5000}};
+
+    struct ddArgStat loss_arg = {
+        .description = "Snapshot loss percent ( default : 10 )",
+        .full_id = "loss",
+        .type_flag = ARG_FLT,
+        .short_id = 'l',
+        .default_val = {.f = 10.f}};
+
+    struct ddArgStat ack_loss_arg = {
+        .description = "Ack loss percent ( default : 20 )",
+        .full_id = "ack-loss",
+        .type_flag = ARG_FLT,
+        .short_id = 'a',
+        .default_val = {.f = 20.f}};
+
+    struct ddArgStat outage_arg = {
+        .description = "Ticks w/o acks midway through ( default : 50 )",
+        .full_id = "outage",
+        .type_flag = ARG_INT,
+        .short_id = 'o',
+        .default_val = {.i = 50}};
+
+    struct ddArgStat json_arg = {
+        .description = "Print results as JSON ( default : false )",
+        .full_id = "json",
+        .type_flag = ARG_BOOL,
+        .short_id = 'j',
+        .default_val = {.b = false}};
+
+    register_arg( &arg_handler, &words_arg );
+    register_arg( &arg_handler, &change_arg );
+    register_arg( &arg_handler, &ticks_arg );
+    register_arg( &arg_handler, &loss_arg );
+    register_arg( &arg_handler, &ack_loss_arg );
+    register_arg( &arg_handler, &outage_arg );
+    register_arg( &arg_handler, &json_arg );
+
+    poll_args( &arg_handler, argc, argv );
+
+    if( extract_arg( &arg_handler, 'h' )->val.b )
+    {
+        print_arg_help_msg( &arg_handler );
+        return 0;
+    }
+
+    const int32_t words = extract_arg( &arg_handler, 'w' )->val.i;
+    const double change_pct = (double)extract_arg( &arg_handler, 'c' )->val.f;
+    const int32_t ticks = extract_arg( &arg_handler, 't' )->val.i;
+    const double loss_pct = (double)extract_arg( &arg_handler, 'l' )->val.f;
+    const double ack_pct = (double)extract_arg( &arg_handler, 'a' )->val.f;
+    const int32_t outage = extract_arg( &arg_handler, 'o' )->val.i;
+    const bool json = extract_arg( &arg_handler, 'j' )->val.b;
+
+    if( words < 1 || words > DD_SNAPSHOT_MAX_WORDS || ticks < 1 ||
+        outage < 0 || change_pct < 0.0 || change_pct > 100.0 ||
+        loss_pct < 0.0 || loss_pct >= 100.0 || ack_pct < 0.0 ||
+        ack_pct > 100.0 )
+    {
+        console_write( LOG_ERROR,
+                       "Need 1 <= words <= %d, ticks >= 1 & percentages in "
+                       "range\n",
+                       DD_SNAPSHOT_MAX_WORDS );
+        return 1;
+    }
+
+    struct ddSnapshotServer server;
+    struct ddSnapshotClient client;
+
+    const uint32_t buffer_size =
+        DD_SNAPSHOT_HEADER_SIZE + (uint32_t)words * sizeof( uint32_t );
+    uint32_t* state = calloc( (size_t)words, sizeof( uint32_t ) );
+    char* buffer = malloc( buffer_size );
+
+    if( !state || !buffer || !dd_snapshot_init( &server, (uint32_t)words ) ||
+        !dd_snapshot_client_init( &client, (uint32_t)words ) )
+    {
+        console_write( LOG_ERROR, "Bench setup failed\n" );
+        return 1;
+    }
+
+    struct bench_result result = {0};
+
+    run( &server,
+         &client,
+         state,
+         buffer,
+         buffer_size,
+         (uint32_t)ticks,
+         change_pct / 100.0,
+         loss_pct / 100.0,
+         ack_pct / 100.0,
+         (uint32_t)outage,
+         &result );
+
+    const struct ddSnapshotStats* stats = &server.stats;
+    const double ratio =
+        stats->full_bytes ? (double)stats->bytes / (double)stats->full_bytes
+                          : 0.0;
+    const bool clean = result.mismatched == 0 && result.rejected == 0 &&
+                       result.sent == (uint64_t)ticks;
+
+    if( json )
+    {
+        printf( "{\"words\": %d, \"change_pct\": %.2f, \"ticks\": %d, "
+                "\"loss_pct\": %.2f, \"ack_loss_pct\": %.2f, "
+                "\"outage\": %d, \"full\": %llu, \"delta\": %llu, "
+                "\"lost\": %llu, \"applied\": %llu, \"mismatched\": %llu, "
+                "\"rejected\": %llu, \"bytes\": %llu, \"full_bytes\": %llu, "
+                "\"ratio\": %.4f}\n",
+                words,
+                change_pct,
+                ticks,
+                loss_pct,
+                ack_pct,
+                outage,
+                (unsigned long long)stats->full,
+                (unsigned long long)stats->delta,
+                (unsigned long long)result.lost,
+                (unsigned long long)result.applied,
+                (unsigned long long)result.mismatched,
+                (unsigned long long)result.rejected,
+                (unsigned long long)stats->bytes,
+                (unsigned long long)stats->full_bytes,
+                ratio );
+    }
+    else
+    {
+        console_write( LOG_STATUS,
+                       "%llu deltas, %llu full snapshots, %llu lost\n",
+                       (unsigned long long)stats->delta,
+                       (unsigned long long)stats->full,
+                       (unsigned long long)result.lost );
+        console_write( clean ? LOG_STATUS : LOG_ERROR,
+                       "%llu applied, %llu mismatched, %llu rejected\n",
+                       (unsigned long long)result.applied,
+                       (unsigned long long)result.mismatched,
+                       (unsigned long long)result.rejected );
+        console_write( LOG_STATUS,
+                       "%llu bytes vs %llu sent in full ( %.2f%% )\n",
+                       (unsigned long long)stats->bytes,
+                       (unsigned long long)stats->full_bytes,
+                       ratio * 100.0 );
+    }
+
+    dd_snapshot_free( &server );
+    dd_snapshot_client_free( &client );
+    free( state );
+    free( buffer );
+
+    return clean ? 0 : 1;
+}
@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <time.h>
+
+#include "ddConfig.h"
+#include "ArgHandler.h"
+#include "ConsoleWrite.h"
+#include "TimeInterface.h"
+
+/* Cost per get_high_res_time call for each clock backend, plus how far the
+ * calibrated tsc drifts from the monotonic clock */
+
+struct clock_result
+{
+    const char* name;
+    bool available;
+    double nano_per_call;
+};
+
+static uint64_t monotonic_time()
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC_RAW, &now );
+    return ( now.tv_sec * 1000000000ULL ) + now.tv_nsec;
+}
+
+static double measure_calls( const uint32_t iterations )
+{
+    uint64_t sink = 0;
+
+    const uint64_t start = get_high_res_time();
+
+    for( uint32_t i = 0; i < iterations; i++ ) sink += get_high_res_time();
+
+    const uint64_t elapsed = get_high_res_time() - start;
+
+    // keep the loop from being optimized out
+    if( sink == 0 ) console_write( LOG_NOTAG, " " );
+
+    return (double)elapsed / (double)iterations;
+}
+
+int main( int argc, char const* argv[] )
+{
+    struct ddArgHandler arg_handler;
+
+    init_arg_handler( &arg_handler,
+                      "Compares the cost of each get_high_res_time clock." );
+
+    struct ddArgStat iter_arg = {
+        .description = "Calls timed per clock ( default : 10000000 )",
+        .full_id = "iterations",
+        .type_flag = ARG_INT,
+        .short_id = 'n',
+        .default_val = {.i = 10000000}};
+
+    struct ddArgStat drift_arg = {
+        .description = "Seconds to measure tsc drift over ( default : 1 )",
+        .full_id = "drift",
+        .type_flag = ARG_FLT,
+        .short_id = 'd',
+        .default_val = {.f = 1.f}};
+
+    struct ddArgStat json_arg = {
+        .description = "Print results as JSON ( default : false )",
+        .full_id = "json",
+        .type_flag = ARG_BOOL,
+        .short_id = 'j',
+        .default_val = {.b = false}};
+
+    register_arg( &arg_handler, &iter_arg );
+    register_arg( &arg_handler, &drift_arg );
+    register_arg( &arg_handler, &json_arg );
+
+    poll_args( &arg_handler, argc, argv );
+
+    if( extract_arg( &arg_handler, 'h' )->val.b )
+    {
+        print_arg_help_msg( &arg_handler );
+        return 0;
+    }
+
+    const int32_t iterations = extract_arg( &arg_handler, 'n' )->val.i;
+    const double drift_secs = (double)extract_arg( &arg_handler, 'd' )->val.f;
+    const bool json = extract_arg( &arg_handler, 'j' )->val.b;
+
+    if( iterations < 1 || drift_secs < 0.0 )
+    {
+        console_write( LOG_ERROR, "Need iterations >= 1 & drift >= 0\n" );
+        return 1;
+    }
+
+    struct clock_result results[] = {
+        {.name = "monotonic", .available = true},
+        {.name = "tsc", .available = false},
+    };
+
+    dd_time_set_clock( DDCLOCK_MONOTONIC );
+    results[0].nano_per_call = measure_calls( (uint32_t)iterations );
+
+    double drift_ppm = 0.0;
+
+    if( dd_time_set_clock( DDCLOCK_TSC ) )
+    {
+        results[1].available = true;
+        results[1].nano_per_call = measure_calls( (uint32_t)iterations );
+
+        // tsc time is anchored to the monotonic clock, so any gap between
+        // the two after a sleep is calibration error
+        const uint64_t pause_nano = seconds_to_nano( drift_secs );
+        const struct timespec pause = {
+            .tv_sec = (time_t)( pause_nano / 1000000000ULL ),
+            .tv_nsec = (long)( pause_nano % 1000000000ULL )};
+
+        const uint64_t tsc_start = get_high_res_time();
+        const uint64_t mono_start = monotonic_time();
+
+        nanosleep( &pause, NULL );
+
+        const uint64_t tsc_elapsed = get_high_res_time() - tsc_start;
+        const uint64_t mono_elapsed = monotonic_time() - mono_start;
+
+        if( mono_elapsed )
+            drift_ppm = ( (double)tsc_elapsed - (double)mono_elapsed ) /
+                        (double)mono_elapsed * 1e6;
+    }
+
+    const double ghz = dd_time_tsc_ghz();
+
+    if( json )
+    {
+        printf( "{\"iterations\": %d, \"monotonic_ns\": %.2f, ",
+                iterations,
+                results[0].nano_per_call );
+
+        if( results[1].available )
+            printf( "\"tsc_ns\": %.2f, \"tsc_ghz\": %.4f, "
+                    "\"tsc_drift_ppm\": %.3f}\n",
+                    results[1].nano_per_call,
+                    ghz,
+                    drift_ppm );
+        else
+            printf( "\"tsc_ns\": null}\n" );
+
+        return 0;
+    }
+
+    for( uint32_t i = 0; i < sizeof( results ) / sizeof( results[0] ); i++ )
+    {
+        if( results[i].available )
+            console_write( LOG_STATUS,
+                           "%-10s %.2f ns/call\n",
+                           results[i].name,
+                           results[i].nano_per_call );
+        else
+            console_write(
+                LOG_WARN, "%-10s unavailable on this cpu\n", results[i].name );
+    }
+
+    if( results[1].available )
+        console_write( LOG_STATUS,
+                       "tsc %.4f GHz, drift vs monotonic %.3f ppm\n",
+                       ghz,
+                       drift_ppm );
+
+    return 0;
+}
@@ -0,0 +1,647 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+
+#include "ddConfig.h"
+#include "ArgHandler.h"
+#include "ConsoleWrite.h"
+#include "TimeInterface.h"
+#include "TopicTable.h"
+
+/* Exercises the topic layer & checks it along the way. Interns tags &
+ * subscribes distinct ( topic, address ) pairs, then unsubscribes them in
+ * shuffled order so removals hit the middle of probe runs & of the topics'
+ * subscriber arrays. The table is checked against the expected pairs after
+ * each phase. Loopback receivers then subscribe through topic frames &
+ * only they may get a publish. Last, topic frames round trip through
+ * dd_topic_encode/dd_topic_decode at the tag length bounds */
+
+#define BENCH_PORT 4792  // server, receivers take the ports after it
+#define BENCH_MAX_RECEIVERS 16
+#define BENCH_TOPICS_PER_ADDR 4
+#define BENCH_WAIT_MS 100  // quiet time before a receive count is final
+
+static uint64_t s_rng = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t next_random()
+{
+    // xorshift64*
+    s_rng ^= s_rng >> 12;
+    s_rng ^= s_rng << 25;
+    s_rng ^= s_rng >> 27;
+    return s_rng * 2685821657736338717ULL;
+}
+
+// pair k is address k / BENCH_TOPICS_PER_ADDR on that many distinct topics
+static uint32_t pair_topic( const uint32_t pair, const uint32_t topics )
+{
+    const uint32_t addr = pair / BENCH_TOPICS_PER_ADDR;
+    return ( pair % BENCH_TOPICS_PER_ADDR + addr ) % topics;
+}
+
+static struct sockaddr_storage pair_addr( const uint32_t pair )
+{
+    const uint32_t addr = pair / BENCH_TOPICS_PER_ADDR;
+
+    struct sockaddr_storage storage = {0};
+    struct sockaddr_in* addr_in = (struct sockaddr_in*)&storage;
+
+    addr_in->sin_family = AF_INET;
+    addr_in->sin_addr.s_addr = htonl( 0x0a000000u + ( addr >> 8 ) );
+    addr_in->sin_port = htons( (uint16_t)( 1024 + ( addr & 0xff ) ) );
+
+    return storage;
+}
+
+static uint32_t addr_of_sub( const struct ddSubscriber* c_restrict sub )
+{
+    return ( ( ntohl( sub->addr.v4.sin_addr.s_addr ) - 0x0a000000u ) << 8 ) |
+           (uint32_t)( ntohs( sub->addr.v4.sin_port ) - 1024 );
+}
+
+// every subscription entry points at its own subscriber & every subscriber
+// is an expected pair. Returns mismatches
+static uint32_t check_table( const struct ddTopicTable* c_restrict table,
+                             const bool* c_restrict active,
+                             const uint32_t pairs,
+                             const uint32_t topics )
+{
+    uint32_t bad = 0;
+    uint32_t expected = 0;
+    uint32_t subs_total = 0;
+    uint32_t entries = 0;
+
+    for( uint32_t i = 0; i < pairs; i++ ) expected += active[i] ? 1 : 0;
+
+    uint32_t** seen = calloc( topics, sizeof( uint32_t* ) );
+
+    for( uint32_t t = 0; seen && t < topics; t++ )
+    {
+        const struct ddTopic* topic = &table->topics[t];
+        subs_total += topic->count;
+
+        seen[t] = calloc( topic->count + 1, sizeof( uint32_t ) );
+        if( !seen[t] ) bad++;
+
+        for( uint32_t i = 0; i < topic->count; i++ )
+        {
+            const uint32_t addr = addr_of_sub( &topic->subs[i] );
+            uint32_t slot = 0;
+
+            // the pair of this address on topic t, if any
+            for( ; slot < BENCH_TOPICS_PER_ADDR; slot++ )
+            {
+                const uint32_t pair = addr * BENCH_TOPICS_PER_ADDR + slot;
+
+                if( pair < pairs && pair_topic( pair, topics ) == t &&
+                    active[pair] )
+                    break;
+            }
+
+            if( slot == BENCH_TOPICS_PER_ADDR ) bad++;
+        }
+    }
+
+    for( uint32_t i = 0; seen && i < table->member_capacity; i++ )
+    {
+        const struct ddSubscription* entry = &table->members[i];
+
+        if( !entry->hash ) continue;
+
+        entries++;
+
+        if( entry->topic >= topics ||
+            entry->index >= table->topics[entry->topic].count ||
+            !seen[entry->topic] ||
+            seen[entry->topic][entry->index]++ )
+            bad++;
+    }
+
+    for( uint32_t t = 0; seen && t < topics; t++ ) free( seen[t] );
+
+    if( !seen ) bad++;
+    free( seen );
+
+    if( table->member_count != expected || subs_total != expected ||
+        entries != expected )
+        bad++;
+
+    return bad;
+}
+
+struct table_result
+{
+    double subscribe_ns;    // per call
+    double unsubscribe_ns;
+    uint32_t bad;
+};
+
+static void run_table( const uint32_t pairs,
+                       const uint32_t topics,
+                       struct table_result* c_restrict result )
+{
+    struct ddTopicTable table;
+    bool* active = calloc( pairs, sizeof( bool ) );
+    uint32_t* order = malloc( pairs * sizeof( uint32_t ) );
+
+    if( !active || !order || !dd_topics_init( &table, pairs ) )
+    {
+        console_write( LOG_ERROR, "Table setup failed\n" );
+        free( active );
+        free( order );
+        result->bad++;
+        return;
+    }
+
+    char tag[MAX_TAG_LENGTH];
+
+    for( uint32_t t = 0; t < topics; t++ )
+    {
+        const int32_t length = snprintf( tag, sizeof( tag ), "topic/%u", t );
+
+        if( dd_topics_intern( &table, tag, (uint32_t)length ) != t )
+            result->bad++;
+    }
+
+    // interning twice hands back the same id
+    if( dd_topics_intern( &table, "topic/0", 7 ) != 0 ) result->bad++;
+
+    uint64_t start = get_high_res_time();
+
+    for( uint32_t i = 0; i < pairs; i++ )
+    {
+        const struct sockaddr_storage addr = pair_addr( i );
+
+        if( !dd_topics_subscribe( &table,
+                                  pair_topic( i, topics ),
+                                  &addr,
+                                  sizeof( struct sockaddr_in ) ) )
+            result->bad++;
+
+        active[i] = true;
+    }
+
+    result->subscribe_ns =
+        (double)( get_high_res_time() - start ) / (double)pairs;
+
+    // subscribing twice is a no-op
+    for( uint32_t i = 0; i < pairs; i += 97 )
+    {
+        const struct sockaddr_storage addr = pair_addr( i );
+        dd_topics_subscribe( &table,
+                             pair_topic( i, topics ),
+                             &addr,
+                             sizeof( struct sockaddr_in ) );
+    }
+
+    result->bad += check_table( &table, active, pairs, topics );
+
+    for( uint32_t i = 0; i < pairs; i++ ) order[i] = i;
+
+    // Fisher-Yates, removals land all over the probe runs & subs arrays
+    for( uint32_t i = pairs - 1; i > 0; i-- )
+    {
+        const uint32_t j = (uint32_t)( next_random() % ( i + 1 ) );
+        const uint32_t swap = order[i];
+
+        order[i] = order[j];
+        order[j] = swap;
+    }
+
+    // half, then check what's left still points at the right subscribers
+    uint64_t elapsed = 0;
+
+    for( uint32_t half = 0; half < 2; half++ )
+    {
+        const uint32_t first = half ? pairs / 2 : 0;
+        const uint32_t last = half ? pairs : pairs / 2;
+
+        start = get_high_res_time();
+
+        for( uint32_t i = first; i < last; i++ )
+        {
+            const uint32_t pair = order[i];
+            const struct sockaddr_storage addr = pair_addr( pair );
+
+            if( !dd_topics_unsubscribe(
+                    &table, pair_topic( pair, topics ), &addr ) )
+                result->bad++;
+
+            active[pair] = false;
+        }
+
+        elapsed += get_high_res_time() - start;
+
+        if( half ) break;
+
+        result->bad += check_table( &table, active, pairs, topics );
+
+        // already gone, so a second unsubscribe finds nothing
+        const struct sockaddr_storage addr = pair_addr( order[0] );
+
+        if( dd_topics_unsubscribe(
+                &table, pair_topic( order[0], topics ), &addr ) )
+            result->bad++;
+    }
+
+    result->unsubscribe_ns = (double)elapsed / (double)pairs;
+
+    result->bad += check_table( &table, active, pairs, topics );
+
+    dd_topics_free( &table );
+    free( active );
+    free( order );
+}
+
+struct wire_ctx
+{
+    struct ddAddressInfo server;
+    struct ddAddressInfo receivers[BENCH_MAX_RECEIVERS];
+    uint32_t count;
+
+    struct sockaddr_storage server_addr;
+    socklen_t server_addr_len;
+};
+
+static bool open_listener( struct ddAddressInfo* c_restrict address,
+                           const uint32_t port )
+{
+    char port_str[8];
+    snprintf( port_str, sizeof( port_str ), "%u", port );
+
+    *address = ( struct ddAddressInfo ){.options = NULL};
+
+    return dd_create_socket( address, "127.0.0.1", port_str, true, NULL );
+}
+
+// topic frame from a receiver's own socket, so the server sees its address
+static bool send_topic_frame( struct wire_ctx* c_restrict ctx,
+                              const uint32_t receiver,
+                              const uint32_t op,
+                              const char* c_restrict tag )
+{
+    char frame[DD_TOPIC_HEADER_SIZE( DD_TOPIC_MAX_TAG )];
+    const int32_t length = dd_topic_encode(
+        op, tag, (uint32_t)strlen( tag ), NULL, 0, frame, sizeof( frame ) );
+
+    const struct sockaddr* addr = (const struct sockaddr*)&ctx->server_addr;
+
+    return length != -1 && dd_server_send_many( &ctx->receivers[receiver],
+                                                frame,
+                                                length,
+                                                &addr,
+                                                &ctx->server_addr_len,
+                                                1,
+                                                NULL ) == 1;
+}
+
+// what the server does w/ the next datagram. False when it wasn't a topic
+// frame or never arrived
+static bool server_handle( struct wire_ctx* c_restrict ctx,
+                           struct ddTopicTable* c_restrict table )
+{
+    struct pollfd poll_fd = {.fd = ctx->server.socket_fd, .events = POLLIN};
+    struct ddRecvMsg msg;
+
+    if( poll( &poll_fd, 1, BENCH_WAIT_MS ) <= 0 ) return false;
+
+    dd_server_recieve_msg( &ctx->server, &msg );
+
+    return msg.bytes_read != -1 && dd_topics_handle( table, &msg );
+}
+
+// publishes that reached receiver carrying value on topic "chat". Any
+// other datagram counts in strays
+static uint32_t count_publishes( struct wire_ctx* c_restrict ctx,
+                                 const uint32_t receiver,
+                                 const int32_t value,
+                                 uint32_t* c_restrict strays )
+{
+    struct pollfd poll_fd = {.fd = ctx->receivers[receiver].socket_fd,
+                             .events = POLLIN};
+    uint32_t arrived = 0;
+
+    while( poll( &poll_fd, 1, BENCH_WAIT_MS ) > 0 )
+    {
+        struct ddRecvMsg msg;
+        struct ddTopicFrame frame;
+        struct ddMsgVal val;
+
+        dd_server_recieve_msg( &ctx->receivers[receiver], &msg );
+
+        if( msg.bytes_read == -1 ) break;
+
+        if( dd_topic_decode( msg.msg, msg.bytes_read, &frame ) &&
+            frame.op == DDTOPIC_PUBLISH && frame.tag_length == 4 &&
+            memcmp( frame.tag, "chat", 4 ) == 0 &&
+            dd_msg_decode( frame.payload, (int32_t)frame.payload_length,
+                           &val ) == DDMSG_INT1 &&
+            val.i[0] == value )
+            arrived++;
+        else
+            ( *strays )++;
+    }
+
+    return arrived;
+}
+
+// subscribed receivers get exactly one copy, the others nothing
+static uint32_t check_publish( struct wire_ctx* c_restrict ctx,
+                               const struct ddTopicTable* c_restrict table,
+                               const uint32_t topic,
+                               const bool* c_restrict subscribed,
+                               const int32_t value )
+{
+    uint32_t expected = 0;
+    uint32_t bad = 0;
+
+    for( uint32_t i = 0; i < ctx->count; i++ )
+        expected += subscribed[i] ? 1 : 0;
+
+    const struct ddMsgVal msg = {.i = {value}};
+    const uint32_t sent =
+        dd_topics_publish( &ctx->server, table, topic, DDMSG_INT1, &msg );
+
+    if( sent != expected ) bad++;
+
+    for( uint32_t i = 0; i < ctx->count; i++ )
+        if( count_publishes( ctx, i, value, &bad ) !=
+            ( subscribed[i] ? 1u : 0u ) )
+            bad++;
+
+    console_write( bad ? LOG_ERROR : LOG_STATUS,
+                   "publish %d sent %u of %u subscribers\n",
+                   value,
+                   sent,
+                   expected );
+
+    return bad;
+}
+
+static uint32_t run_wire( const uint32_t receivers )
+{
+    struct wire_ctx ctx = {.count = receivers};
+    struct ddTopicTable table;
+    bool subscribed[BENCH_MAX_RECEIVERS] = {false};
+    uint32_t bad = 0;
+    uint32_t opened = 0;
+
+    ctx.server_addr_len = sizeof( ctx.server_addr );
+
+    if( !dd_topics_init( &table, 0 ) ||
+        !open_listener( &ctx.server, BENCH_PORT ) )
+    {
+        console_write( LOG_ERROR, "Topic server not created\n" );
+        return 1;
+    }
+
+    getsockname( ctx.server.socket_fd,
+                 (struct sockaddr*)&ctx.server_addr,
+                 &ctx.server_addr_len );
+
+    for( ; opened < receivers; opened++ )
+        if( !open_listener( &ctx.receivers[opened], BENCH_PORT + 1 + opened ) )
+            break;
+
+    const uint32_t topic = dd_topics_intern( &table, "chat", 4 );
+
+    if( opened < receivers || topic == DD_TOPIC_NONE )
+    {
+        console_write( LOG_ERROR, "Receivers not created\n" );
+        bad++;
+    }
+
+    // every other receiver subscribes, the rest ask for an unknown tag
+    for( uint32_t i = 0; !bad && i < receivers; i++ )
+    {
+        subscribed[i] = i % 2 == 0;
+
+        if( !send_topic_frame( &ctx,
+                               i,
+                               DDTOPIC_SUBSCRIBE,
+                               subscribed[i] ? "chat" : "unknown" ) ||
+            !server_handle( &ctx, &table ) )
+            bad++;
+    }
+
+    if( !bad && table.refused != receivers / 2 ) bad++;
+
+    if( !bad ) bad += check_publish( &ctx, &table, topic, subscribed, 1 );
+
+    // the first subscriber leaves, the rest keep getting publishes
+    if( !bad && ( !send_topic_frame( &ctx, 0, DDTOPIC_UNSUBSCRIBE, "chat" ) ||
+                  !server_handle( &ctx, &table ) ) )
+        bad++;
+
+    subscribed[0] = false;
+
+    if( !bad ) bad += check_publish( &ctx, &table, topic, subscribed, 2 );
+
+    for( uint32_t i = 0; i < opened; i++ )
+        dd_close_socket( &ctx.receivers[i].socket_fd );
+
+    dd_close_socket( &ctx.server.socket_fd );
+    dd_topics_free( &table );
+
+    return bad;
+}
+
+// round trips at the tag length bounds & rejects what falls outside them
+static uint32_t run_codec()
+{
+    char tag[DD_TOPIC_MAX_TAG + 2];
+    char payload[32];
+    char frame[MAX_MSG_LENGTH];
+    struct ddTopicFrame decoded;
+    uint32_t bad = 0;
+
+    memset( tag, 't', sizeof( tag ) );
+    memset( payload, 'p', sizeof( payload ) );
+
+    for( uint32_t tag_length = 1; tag_length <= DD_TOPIC_MAX_TAG; tag_length++ )
+    {
+        for( uint32_t op = DDTOPIC_PUBLISH; op <= DDTOPIC_UNSUBSCRIBE; op++ )
+        {
+            const uint32_t payload_length =
+                op == DDTOPIC_PUBLISH ? sizeof( payload ) : 0;
+
+            const int32_t length = dd_topic_encode( op,
+                                                    tag,
+                                                    tag_length,
+                                                    payload,
+                                                    payload_length,
+                                                    frame,
+                                                    sizeof( frame ) );
+
+            if( length != (int32_t)( DD_TOPIC_HEADER_SIZE( tag_length ) +
+                                     payload_length ) ||
+                !dd_topic_decode( frame, length, &decoded ) ||
+                decoded.op != op || decoded.tag_length != tag_length ||
+                memcmp( decoded.tag, tag, tag_length ) != 0 ||
+                decoded.payload_length != payload_length ||
+                memcmp( decoded.payload, payload, payload_length ) != 0 )
+                bad++;
+
+            // cut inside the tag
+            if( dd_topic_decode( frame,
+                                 (int32_t)DD_TOPIC_HEADER_SIZE( tag_length ) -
+                                     1,
+                                 &decoded ) )
+                bad++;
+        }
+    }
+
+    // empty & over long tags, an unknown op & frames too big for out
+    if( dd_topic_encode(
+            DDTOPIC_PUBLISH, tag, 0, NULL, 0, frame, sizeof( frame ) ) != -1 ||
+        dd_topic_encode( DDTOPIC_PUBLISH,
+                         tag,
+                         DD_TOPIC_MAX_TAG + 1,
+                         NULL,
+                         0,
+                         frame,
+                         sizeof( frame ) ) != -1 ||
+        dd_topic_encode( DDTOPIC_UNSUBSCRIBE + 1,
+                         tag,
+                         1,
+                         NULL,
+                         0,
+                         frame,
+                         sizeof( frame ) ) != -1 ||
+        dd_topic_encode( DDTOPIC_PUBLISH,
+                         tag,
+                         4,
+                         payload,
+                         sizeof( payload ),
+                         frame,
+                         DD_TOPIC_HEADER_SIZE( 4 ) + sizeof( payload ) -
+                             1 ) != -1 ||
+        dd_topic_encode( DDTOPIC_PUBLISH,
+                         tag,
+                         4,
+                         payload,
+                         MAX_MSG_LENGTH - DD_TOPIC_HEADER_SIZE( 4 ),
+                         frame,
+                         sizeof( frame ) ) != -1 )
+        bad++;
+
+    // a tag length byte past the bound or of 0 on the wire
+    const int32_t length = dd_topic_encode(
+        DDTOPIC_SUBSCRIBE, tag, 4, NULL, 0, frame, sizeof( frame ) );
+
+    frame[1] = (char)( DD_TOPIC_MAX_TAG + 1 );
+    if( dd_topic_decode( frame, sizeof( frame ), &decoded ) ) bad++;
+
+    frame[1] = 0;
+    if( dd_topic_decode( frame, length, &decoded ) ) bad++;
+
+    console_write( bad ? LOG_ERROR : LOG_STATUS,
+                   "codec tags 1-%d round trip, %u failures\n",
+                   DD_TOPIC_MAX_TAG,
+                   bad );
+
+    return bad;
+}
+
+int main( int argc, char const* argv[] )
+{
+    struct ddArgHandler arg_handler;
+
+    init_arg_handler( &arg_handler,
+                      "Checks & times topic subscribe, unsubscribe & "
+                      "publish." );
+
+    struct ddArgStat subs_arg = {
+        .description = "( topic, address ) pairs ( default : 50000 )",
+        .full_id = "subs",
+        .type_flag = ARG_INT,
+        .short_id = 's',
+        .default_val = {.i = 50000}};
+
+    struct ddArgStat topics_arg = {
+        .description = "Topics interned ( default : 200 )",
+        .full_id = "topics",
+        .type_flag = ARG_INT,
+        .short_id = 't',
+        .default_val = {.i = 200}};
+
+    struct ddArgStat receivers_arg = {
+        .description = "Loopback receivers ( default : 4 )",
+        .full_id = "receivers",
+        .type_flag = ARG_INT,
+        .short_id = 'r',
+        .default_val = {.i = 4}};
+
+    struct ddArgStat json_arg = {
+        .description = "Print results as JSON ( default : false )",
+        .full_id = "json",
+        .type_flag = ARG_BOOL,
+        .short_id = 'j',
+        .default_val = {.b = false}};
+
+    register_arg( &arg_handler, &subs_arg );
+    register_arg( &arg_handler, &topics_arg );
+    register_arg( &arg_handler, &receivers_arg );
+    register_arg( &arg_handler, &json_arg );
+
+    poll_args( &arg_handler, argc, argv );
+
+    if( extract_arg( &arg_handler, 'h' )->val.b )
+    {
+        print_arg_help_msg( &arg_handler );
+        return 0;
+    }
+
+    const int32_t subs = extract_arg( &arg_handler, 's' )->val.i;
+    const int32_t topics = extract_arg( &arg_handler, 't' )->val.i;
+    const int32_t receivers = extract_arg( &arg_handler, 'r' )->val.i;
+    const bool json = extract_arg( &arg_handler, 'j' )->val.b;
+
+    if( subs < 2 || topics < BENCH_TOPICS_PER_ADDR || receivers < 2 ||
+        receivers > BENCH_MAX_RECEIVERS )
+    {
+        console_write( LOG_ERROR,
+                       "Need subs >= 2, topics >= %d & 2 <= receivers <= "
+                       "%d\n",
+                       BENCH_TOPICS_PER_ADDR,
+                       BENCH_MAX_RECEIVERS );
+        return 1;
+    }
+
+    struct table_result table = {0};
+
+    run_table( (uint32_t)subs, (uint32_t)topics, &table );
+
+    const uint32_t wire_bad = run_wire( (uint32_t)receivers );
+    const uint32_t codec_bad = run_codec();
+    const bool clean = table.bad == 0 && wire_bad == 0 && codec_bad == 0;
+
+    if( json )
+    {
+        printf( "{\"subs\": %d, \"topics\": %d, \"subscribe_ns\": %.1f, "
+                "\"unsubscribe_ns\": %.1f, \"table_failures\": %u, "
+                "\"wire_failures\": %u, \"codec_failures\": %u}\n",
+                subs,
+                topics,
+                table.subscribe_ns,
+                table.unsubscribe_ns,
+                table.bad,
+                wire_bad,
+                codec_bad );
+    }
+    else
+    {
+        console_write( table.bad ? LOG_ERROR : LOG_STATUS,
+                       "%d subscriptions on %d topics, %u table failures\n",
+                       subs,
+                       topics,
+                       table.bad );
+        console_write( LOG_STATUS,
+                       "%.1f ns per subscribe, %.1f ns per unsubscribe\n",
+                       table.subscribe_ns,
+                       table.unsubscribe_ns );
+    }
+
+    return clean ? 0 : 1;
+}
@@ -0,0 +1,607 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <poll.h>
+#include <sched.h>
+
+#include "ddConfig.h"
+#include "ArgHandler.h"
+#include "ConsoleWrite.h"
+#include "ServerInterface.h"
+#include "ServerShards.h"
+#include "TimeInterface.h"
+
+/* Loopback load generator. Client threads send timestamped datagrams at an
+ * in-process echo server built on ddLoop & time the echoes coming back */
+
+#define BENCH_MIN_SIZE 16  // seq + send time
+#define BENCH_GRACE_NANO 500000000ULL  // wait for stragglers after sending
+
+struct bench_header
+{
+    uint64_t seq;
+    uint64_t sent_at;
+};
+
+struct bench_client
+{
+    pthread_t thread;
+    bool started;  // only joined when pthread_create succeeded
+    uint32_t index;
+
+    uint64_t sent;
+    uint64_t send_errors;
+    uint64_t received;
+
+    uint64_t* rtts;  // nanoseconds
+    uint64_t rtts_count;
+    uint64_t rtts_capacity;
+};
+
+static const char* s_ip;
+static const char* s_port;
+static uint32_t s_size;
+static uint32_t s_threads;
+static double s_rate;  // datagrams per second across all threads, 0 = max
+static uint64_t s_start_time;
+static uint64_t s_end_time;
+
+static uint32_t s_backend;
+
+static atomic_uint_fast64_t s_server_rx;
+
+static void echo_cb( struct ddLoop* loop, struct ddRecvBatch* batch )
+{
+    atomic_fetch_add_explicit(
+        &s_server_rx, batch->count, memory_order_relaxed );
+
+    for( uint32_t i = 0; i < batch->count; i++ )
+    {
+        const struct ddRecvMsg* msg = &batch->msgs[i];
+        const struct sockaddr* addr = (const struct sockaddr*)&msg->sender;
+
+        dd_loop_send_to( loop, msg->msg, msg->bytes_read, addr, msg->addr_len );
+    }
+}
+
+static void shard_setup_cb( struct ddShard* shard )
+{
+    dd_loop_set_backend( &shard->loop, s_backend );
+}
+
+static bool parse_backend( const char* c_restrict name,
+                           uint32_t* c_restrict backend )
+{
+    const char* names[] = {
+        [DDLOOP_SELECT] = "select",
+        [DDLOOP_EPOLL] = "epoll",
+        [DDLOOP_URING] = "uring",
+    };
+
+    for( uint32_t i = 0; i < sizeof( names ) / sizeof( names[0] ); i++ )
+    {
+        if( names[i] && strcmp( name, names[i] ) == 0 )
+        {
+            *backend = i;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void* server_thread( void* arg )
+{
+    dd_loop_run( arg );
+    return NULL;
+}
+
+static void record_rtt( struct bench_client* c_restrict client,
+                        const uint64_t rtt )
+{
+    if( client->rtts_count == client->rtts_capacity )
+    {
+        const uint64_t capacity =
+            client->rtts_capacity ? client->rtts_capacity * 2 : 4096;
+        uint64_t* rtts = realloc( client->rtts, capacity * sizeof( *rtts ) );
+
+        if( !rtts ) return;
+
+        client->rtts = rtts;
+        client->rtts_capacity = capacity;
+    }
+
+    client->rtts[client->rtts_count++] = rtt;
+}
+
+static void drain_echoes( struct bench_client* c_restrict client,
+                          const int32_t fd,
+                          char* c_restrict buffer )
+{
+    while( true )
+    {
+        const ssize_t bytes = recv( fd, buffer, s_size, MSG_DONTWAIT );
+
+        if( bytes < (ssize_t)sizeof( struct bench_header ) ) return;
+
+        struct bench_header header;
+        memcpy( &header, buffer, sizeof( header ) );
+
+        client->received++;
+        record_rtt( client, get_high_res_time() - header.sent_at );
+    }
+}
+
+static void wait_readable( const int32_t fd, const uint64_t nanosecs )
+{
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+
+    // sub-millisecond gaps just give the server thread a turn
+    if( nanosecs < 1000000 )
+        sched_yield();
+    else
+        poll( &pfd, 1, (int)nano_to_milli( nanosecs ) );
+}
+
+static void* client_thread( void* arg )
+{
+    struct bench_client* client = arg;
+    struct ddAddressInfo server = {.options = NULL, .selected = NULL};
+
+    if( !dd_create_socket( &server, s_ip, s_port, false, NULL ) )
+        return NULL;
+
+    const int32_t fd = server.socket_fd;
+
+    // connected socket filters out anything but the server's echoes
+    if( connect( fd,
+                 server.selected->ai_addr,
+                 server.selected->ai_addrlen ) == -1 )
+    {
+        console_write(
+            LOG_ERROR, "Client %u connect failed\n", client->index );
+        freeaddrinfo( server.options );
+        dd_close_socket( &server.socket_fd );
+        return NULL;
+    }
+
+    char* buffer = calloc( 2, s_size );
+
+    if( !buffer )
+    {
+        freeaddrinfo( server.options );
+        dd_close_socket( &server.socket_fd );
+        return NULL;
+    }
+
+    char* payload = buffer + s_size;
+
+    const uint64_t interval =
+        s_rate > 0.0 ? seconds_to_nano( (double)s_threads / s_rate ) : 0;
+
+    // stagger threads so paced sends don't land in lock step
+    uint64_t next_send =
+        s_start_time + ( interval / s_threads ) * client->index;
+    uint64_t now = get_high_res_time();
+
+    while( now < s_end_time )
+    {
+        if( interval && now < next_send )
+        {
+            drain_echoes( client, fd, buffer );
+            wait_readable( fd, next_send - now );
+            now = get_high_res_time();
+            continue;
+        }
+
+        const struct bench_header header = {
+            .seq = client->sent + client->send_errors,
+            .sent_at = now,
+        };
+        memcpy( payload, &header, sizeof( header ) );
+
+        if( send( fd, payload, s_size, 0 ) == (ssize_t)s_size )
+            client->sent++;
+        else
+            client->send_errors++;
+
+        next_send += interval;
+        drain_echoes( client, fd, buffer );
+        now = get_high_res_time();
+    }
+
+    const uint64_t grace_end = now + BENCH_GRACE_NANO;
+
+    while( client->received < client->sent && now < grace_end )
+    {
+        wait_readable( fd, 10000000 );
+        drain_echoes( client, fd, buffer );
+        now = get_high_res_time();
+    }
+
+    free( buffer );
+    freeaddrinfo( server.options );
+    dd_close_socket( &server.socket_fd );
+
+    return NULL;
+}
+
+static int compare_u64( const void* lhs, const void* rhs )
+{
+    const uint64_t a = *(const uint64_t*)lhs;
+    const uint64_t b = *(const uint64_t*)rhs;
+
+    return ( a > b ) - ( a < b );
+}
+
+static double percentile_usec( const uint64_t* sorted,
+                               const uint64_t count,
+                               const double fraction )
+{
+    if( count == 0 ) return 0.0;
+
+    uint64_t idx = (uint64_t)( fraction * (double)count );
+    if( idx >= count ) idx = count - 1;
+
+    return (double)sorted[idx] / 1000.0;
+}
+
+int main( int argc, char const* argv[] )
+{
+    struct ddArgHandler arg_handler;
+
+    init_arg_handler( &arg_handler,
+                      "Measures echo rate, loss & latency of a ddLoop "
+                      "server over loopback." );
+
+    struct ddArgStat ip_arg = {
+        .description = "IP address to bind ( default : \"127.0.0.1\" )",
+        .full_id = "IP",
+        .type_flag = ARG_STR,
+        .short_id = 'i',
+        .default_val = {.c = "127.0.0.1"}};
+
+    struct ddArgStat port_arg = {
+        .description = "Port to bind ( default : 4700 )",
+        .full_id = "port",
+        .type_flag = ARG_STR,
+        .short_id = 'p',
+        .default_val = {.c = "4700"}};
+
+    struct ddArgStat threads_arg = {
+        .description = "Sender threads ( default : 1 )",
+        .full_id = "threads",
+        .type_flag = ARG_INT,
+        .short_id = 'n',
+        .default_val = {.i = 1}};
+
+    struct ddArgStat size_arg = {
+        .description = "Datagram size in bytes ( default : 64 )",
+        .full_id = "size",
+        .type_flag = ARG_INT,
+        .short_id = 's',
+        .default_val = {.i = 64}};
+
+    struct ddArgStat rate_arg = {
+        .description = "Total datagrams per second, 0 = flat out "
+                       "( default : 10000 )",
+        .full_id = "rate",
+        .type_flag = ARG_FLT,
+        .short_id = 'r',
+        .default_val = {.f = 10000.f}};
+
+    struct ddArgStat duration_arg = {
+        .description = "Seconds to send for ( default : 5 sec )",
+        .full_id = "duration",
+        .type_flag = ARG_FLT,
+        .short_id = 'd',
+        .default_val = {.f = 5.f}};
+
+    struct ddArgStat shards_arg = {
+        .description = "Server shards, 0 = single loop ( default : 0 )",
+        .full_id = "shards",
+        .type_flag = ARG_INT,
+        .short_id = 'w',
+        .default_val = {.i = 0}};
+
+    struct ddArgStat json_arg = {
+        .description = "Print results as JSON ( default : false )",
+        .full_id = "json",
+        .type_flag = ARG_BOOL,
+        .short_id = 'j',
+        .default_val = {.b = false}};
+
+    struct ddArgStat tsc_arg = {
+        .description = "Time packets w/ the calibrated tsc ( default : "
+                       "false )",
+        .full_id = "tsc",
+        .type_flag = ARG_BOOL,
+        .short_id = 'c',
+        .default_val = {.b = false}};
+
+    struct ddArgStat backend_arg = {
+        .description = "Loop backend, select, epoll or uring ( default : "
+                       "epoll )",
+        .full_id = "backend",
+        .type_flag = ARG_STR,
+        .short_id = 'b',
+        .default_val = {.c = "epoll"}};
+
+    struct ddArgStat rcvbuf_arg = {
+        .description = "Server SO_RCVBUF bytes, 0 = system default ( "
+                       "default : 0 )",
+        .full_id = "rcvbuf",
+        .type_flag = ARG_INT,
+        .short_id = 'k',
+        .default_val = {.i = 0}};
+
+    struct ddArgStat stamps_arg = {
+        .description = "Kernel receive timestamps on the server, queue delay "
+                       "shows in loop stats ( default : false )",
+        .full_id = "timestamps",
+        .type_flag = ARG_BOOL,
+        .short_id = 't',
+        .default_val = {.b = false}};
+
+    register_arg( &arg_handler, &ip_arg );
+    register_arg( &arg_handler, &port_arg );
+    register_arg( &arg_handler, &threads_arg );
+    register_arg( &arg_handler, &size_arg );
+    register_arg( &arg_handler, &rate_arg );
+    register_arg( &arg_handler, &duration_arg );
+    register_arg( &arg_handler, &shards_arg );
+    register_arg( &arg_handler, &json_arg );
+    register_arg( &arg_handler, &tsc_arg );
+    register_arg( &arg_handler, &backend_arg );
+    register_arg( &arg_handler, &rcvbuf_arg );
+    register_arg( &arg_handler, &stamps_arg );
+
+    poll_args( &arg_handler, argc, argv );
+
+    if( extract_arg( &arg_handler, 'h' )->val.b )
+    {
+        print_arg_help_msg( &arg_handler );
+        return 0;
+    }
+
+    s_ip = extract_arg( &arg_handler, 'i' )->val.c;
+    s_port = extract_arg( &arg_handler, 'p' )->val.c;
+    s_rate = (double)extract_arg( &arg_handler, 'r' )->val.f;
+
+    const int32_t threads = extract_arg( &arg_handler, 'n' )->val.i;
+    const int32_t size = extract_arg( &arg_handler, 's' )->val.i;
+    const int32_t shards = extract_arg( &arg_handler, 'w' )->val.i;
+    const double duration = (double)extract_arg( &arg_handler, 'd' )->val.f;
+    const bool json = extract_arg( &arg_handler, 'j' )->val.b;
+    const int32_t rcvbuf = extract_arg( &arg_handler, 'k' )->val.i;
+    const bool stamps = extract_arg( &arg_handler, 't' )->val.b;
+
+    if( threads < 1 || size < BENCH_MIN_SIZE || size >= MAX_MSG_LENGTH ||
+        shards < 0 || duration <= 0.0 || s_rate < 0.0 || rcvbuf < 0 )
+    {
+        console_write( LOG_ERROR,
+                       "Need threads >= 1, %d <= size < %d, duration > 0\n",
+                       BENCH_MIN_SIZE,
+                       MAX_MSG_LENGTH );
+        return 1;
+    }
+
+    const char* backend = extract_arg( &arg_handler, 'b' )->val.c;
+
+    if( !parse_backend( backend, &s_backend ) )
+    {
+        console_write( LOG_ERROR, "Unknown backend %s\n", backend );
+        return 1;
+    }
+
+    if( extract_arg( &arg_handler, 'c' )->val.b &&
+        !dd_time_set_clock( DDCLOCK_TSC ) )
+        console_write( LOG_WARN, "tsc unusable. Using monotonic clock\n" );
+
+    s_threads = (uint32_t)threads;
+    s_size = (uint32_t)size;
+
+    // echo server
+    struct ddAddressInfo listener = {.options = NULL, .selected = NULL};
+    struct ddRecvBatch batch = {0};
+    struct ddShardGroup group = {0};
+    struct ddLoop looper = {0};
+    pthread_t server;
+
+    if( shards > 0 )
+    {
+        const struct ddShardConfig config = {
+            .ip = s_ip,
+            .port = s_port,
+            .count = (uint32_t)shards,
+            .recv_buffer = rcvbuf,
+            .rx_timestamps = stamps,
+            .batch_cb = echo_cb,
+            .setup_cb = shard_setup_cb,
+        };
+
+        if( !dd_shards_create( &group, &config ) ) return 1;
+        if( !dd_shards_start( &group ) )
+        {
+            dd_shards_free( &group );
+            return 1;
+        }
+    }
+    else
+    {
+        const struct ddSocketOpts opts = {
+            .recv_buffer = rcvbuf,
+            .rx_timestamps = stamps,
+        };
+
+        if( !dd_create_socket( &listener, s_ip, s_port, true, &opts ) ||
+            !dd_recv_batch_init( &batch, MAX_RECV_BATCH ) )
+            return 1;
+
+        looper = dd_server_new_loop( NULL, &listener );
+        looper.console = false;
+
+        if( !looper.active ) return 1;
+        dd_loop_set_batch_cb( &looper, echo_cb, &batch );
+        dd_loop_set_backend( &looper, s_backend );
+
+        if( pthread_create( &server, NULL, server_thread, &looper ) != 0 )
+        {
+            console_write( LOG_ERROR, "Server thread not created\n" );
+            return 1;
+        }
+    }
+
+    // load generators
+    struct bench_client* clients = calloc( s_threads, sizeof( *clients ) );
+
+    if( !clients ) return 1;
+
+    s_start_time = get_high_res_time();
+    s_end_time = s_start_time + seconds_to_nano( duration );
+
+    for( uint32_t i = 0; i < s_threads; i++ )
+    {
+        clients[i].index = i;
+        clients[i].started = pthread_create( &clients[i].thread,
+                                             NULL,
+                                             client_thread,
+                                             &clients[i] ) == 0;
+
+        if( !clients[i].started )
+            console_write( LOG_WARN, "Client thread %u not created\n", i );
+    }
+
+    uint64_t sent = 0;
+    uint64_t send_errors = 0;
+    uint64_t received = 0;
+    uint64_t rtts_count = 0;
+
+    for( uint32_t i = 0; i < s_threads; i++ )
+    {
+        if( !clients[i].started ) continue;
+
+        pthread_join( clients[i].thread, NULL );
+
+        sent += clients[i].sent;
+        send_errors += clients[i].send_errors;
+        received += clients[i].received;
+        rtts_count += clients[i].rtts_count;
+    }
+
+    // overflows of the server's receive queue, as opposed to echoes lost
+    // on the way back or still in flight
+    uint64_t kernel_drops = 0;
+
+    if( shards > 0 )
+    {
+        dd_shards_stop( &group );
+
+        for( uint32_t i = 0; i < group.count; i++ )
+            kernel_drops += group.shards[i].listener.kernel_drops;
+
+        dd_shards_free( &group );
+    }
+    else
+    {
+        dd_loop_break( &looper );
+        pthread_join( server, NULL );
+
+        kernel_drops = listener.kernel_drops;
+
+#ifdef DD_LOOP_STATS
+        if( !json ) dd_loop_stats_print( &looper );
+#endif  // DD_LOOP_STATS
+
+        dd_loop_cleanup( &looper );
+        dd_recv_batch_free( &batch );
+        dd_close_socket( &listener.socket_fd );
+    }
+
+    // merge latencies from every client
+    uint64_t* rtts =
+        malloc( ( rtts_count ? rtts_count : 1 ) * sizeof( *rtts ) );
+    uint64_t merged = 0;
+
+    for( uint32_t i = 0; i < s_threads; i++ )
+    {
+        if( rtts && clients[i].rtts_count )
+        {
+            memcpy( rtts + merged,
+                    clients[i].rtts,
+                    clients[i].rtts_count * sizeof( *rtts ) );
+            merged += clients[i].rtts_count;
+        }
+
+        free( clients[i].rtts );
+    }
+
+    free( clients );
+
+    if( rtts ) qsort( rtts, merged, sizeof( *rtts ), compare_u64 );
+
+    const double loss =
+        sent ? 1.0 - (double)received / (double)sent : 0.0;
+    const double p50 = percentile_usec( rtts, merged, 0.50 );
+    const double p99 = percentile_usec( rtts, merged, 0.99 );
+    const double p999 = percentile_usec( rtts, merged, 0.999 );
+    const double max = merged ? (double)rtts[merged - 1] / 1000.0 : 0.0;
+
+    free( rtts );
+
+    const uint64_t server_rx = atomic_load( &s_server_rx );
+
+    if( json )
+    {
+        printf( "{\"threads\": %u, \"size\": %u, \"rate\": %.0f, "
+                "\"duration\": %.3f, \"shards\": %d, \"backend\": \"%s\", "
+                "\"sent\": %llu, \"send_errors\": %llu, "
+                "\"server_rx\": %llu, \"kernel_drops\": %llu, "
+                "\"received\": %llu, "
+                "\"send_pps\": %.1f, \"echo_pps\": %.1f, \"loss\": %.6f, "
+                "\"rtt_us\": {\"p50\": %.2f, \"p99\": %.2f, "
+                "\"p999\": %.2f, \"max\": %.2f}}\n",
+                s_threads,
+                s_size,
+                s_rate,
+                duration,
+                shards,
+                backend,
+                (unsigned long long)sent,
+                (unsigned long long)send_errors,
+                (unsigned long long)server_rx,
+                (unsigned long long)kernel_drops,
+                (unsigned long long)received,
+                (double)sent / duration,
+                (double)received / duration,
+                loss,
+                p50,
+                p99,
+                p999,
+                max );
+        return 0;
+    }
+
+    console_write( LOG_STATUS,
+                   "sent %llu ( %llu errors ), server rx %llu ( %llu kernel "
+                   "drops ), echoed %llu\n",
+                   (unsigned long long)sent,
+                   (unsigned long long)send_errors,
+                   (unsigned long long)server_rx,
+                   (unsigned long long)kernel_drops,
+                   (unsigned long long)received );
+    console_write( LOG_STATUS,
+                   "%.1f pps sent, %.1f pps echoed, %.4f%% loss\n",
+                   (double)sent / duration,
+                   (double)received / duration,
+                   loss * 100.0 );
+    console_write( LOG_STATUS,
+                   "rtt usec p50 %.2f p99 %.2f p99.9 %.2f max %.2f\n",
+                   p50,
+                   p99,
+                   p999,
+                   max );
+
+    return 0;
+}